@@ -0,0 +1,439 @@
+/*
+ * pktring - minimal Linux AF_PACKET TPACKET_V3 receive ring, with a classic
+ * BPF filter accepting a single UDP destination address and port
+ *
+ * Copyright (C) 2011 Mark Smith <markzzzsmith@yahoo.com.au>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA. 
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include "pktring.h"
+
+
+/*
+ * The kernel and this process hand ring blocks back and forth through
+ * their status words, so reading a block's status needs acquire ordering,
+ * and handing it back needs release ordering.
+ */
+#define pktring_load_acquire(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define pktring_store_release(p, v)	__atomic_store_n((p), (v), \
+							__ATOMIC_RELEASE)
+
+enum PKTRING_FILTER_DEFS {
+	PKTRING_FILTER_INSNS_MAX = 32,
+	PKTRING_IP6_HLEN = 40,
+	PKTRING_UDP_HLEN = 8,
+};
+
+struct pktring_filter {
+	struct sock_filter insns[PKTRING_FILTER_INSNS_MAX];
+	unsigned int insns_num;
+	unsigned int drop_jumps[PKTRING_FILTER_INSNS_MAX];
+	unsigned int drop_jumps_num;
+};
+
+
+static int pktring_setup(struct pktring *ring,
+			 const unsigned int ifindex,
+			 const int family,
+			 const void *dst_addr,
+			 const unsigned int dst_port,
+			 const unsigned int block_tov_msec);
+
+static void pktring_filter_emit(struct pktring_filter *filter,
+				const struct sock_filter insn);
+
+static void pktring_filter_match(struct pktring_filter *filter,
+				 const unsigned short size,
+				 const unsigned int offset,
+				 const unsigned int value);
+
+static void pktring_filter_build(struct pktring_filter *filter,
+				 const int family,
+				 const void *dst_addr,
+				 const unsigned int dst_port);
+
+
+int pktring_open(struct pktring *ring,
+		 const unsigned int ifindex,
+		 const int family,
+		 const void *dst_addr,
+		 const unsigned int dst_port,
+		 const unsigned int block_tov_msec)
+{
+	int saved_errno;
+
+
+	memset(ring, 0, sizeof(*ring));
+	ring->sock_fd = -1;
+
+	if (pktring_setup(ring, ifindex, family, dst_addr, dst_port,
+						block_tov_msec) == -1) {
+		saved_errno = errno;
+		pktring_close(ring);
+		errno = saved_errno;
+		return -1;
+	}
+
+	return 0;
+
+}
+
+
+static int pktring_setup(struct pktring *ring,
+			 const unsigned int ifindex,
+			 const int family,
+			 const void *dst_addr,
+			 const unsigned int dst_port,
+			 const unsigned int block_tov_msec)
+{
+	struct pktring_filter filter;
+	struct sock_fprog fprog;
+	struct tpacket_req3 req;
+	struct sockaddr_ll sll;
+	const int version = TPACKET_V3;
+	const int one = 1;
+	uint16_t protocol;
+
+
+	if (family == AF_INET) {
+		protocol = htons(ETH_P_IP);
+	} else {
+		protocol = htons(ETH_P_IPV6);
+	}
+
+	/*
+	 * The socket doesn't receive anything until it is bound to a
+	 * protocol, so the filter is in place before the first packet.
+	 */
+	ring->sock_fd = socket(AF_PACKET, SOCK_DGRAM, 0);
+	if (ring->sock_fd == -1) {
+		return -1;
+	}
+
+	pktring_filter_build(&filter, family, dst_addr, dst_port);
+	fprog.len = filter.insns_num;
+	fprog.filter = filter.insns;
+	if (setsockopt(ring->sock_fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog,
+							sizeof(fprog)) == -1) {
+		return -1;
+	}
+
+	/*
+	 * Datagrams replicast itself sends out this interface aren't wanted,
+	 * although older kernels can't ignore them.
+	 */
+	setsockopt(ring->sock_fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &one,
+								sizeof(one));
+
+	if (setsockopt(ring->sock_fd, SOL_PACKET, PACKET_VERSION, &version,
+						sizeof(version)) == -1) {
+		return -1;
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size = PKTRING_BLOCK_SIZE;
+	req.tp_block_nr = PKTRING_BLOCKS_NUM;
+	req.tp_frame_size = PKTRING_FRAME_SIZE;
+	req.tp_frame_nr = (PKTRING_BLOCK_SIZE * PKTRING_BLOCKS_NUM) /
+							PKTRING_FRAME_SIZE;
+	req.tp_retire_blk_tov = block_tov_msec;
+	if (setsockopt(ring->sock_fd, SOL_PACKET, PACKET_RX_RING, &req,
+							sizeof(req)) == -1) {
+		return -1;
+	}
+
+	ring->map_size = PKTRING_BLOCK_SIZE * PKTRING_BLOCKS_NUM;
+	ring->map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->sock_fd, 0);
+	if (ring->map == MAP_FAILED) {
+		ring->map = NULL;
+		return -1;
+	}
+
+	memset(&sll, 0, sizeof(sll));
+	sll.sll_family = AF_PACKET;
+	sll.sll_protocol = protocol;
+	sll.sll_ifindex = ifindex;
+	if (bind(ring->sock_fd, (struct sockaddr *)&sll, sizeof(sll)) == -1) {
+		return -1;
+	}
+
+	return 0;
+
+}
+
+
+static void pktring_filter_emit(struct pktring_filter *filter,
+				const struct sock_filter insn)
+{
+
+
+	filter->insns[filter->insns_num++] = insn;
+
+}
+
+
+/*
+ * Load a header field and jump to the drop return if it doesn't match.
+ * Classic BPF loads convert from network to host byte order, so the match
+ * value is in host byte order.
+ */
+static void pktring_filter_match(struct pktring_filter *filter,
+				 const unsigned short size,
+				 const unsigned int offset,
+				 const unsigned int value)
+{
+	struct sock_filter load = BPF_STMT(BPF_LD | BPF_ABS | size, offset);
+	struct sock_filter jeq = BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, value,
+									0, 0);
+
+
+	pktring_filter_emit(filter, load);
+	filter->drop_jumps[filter->drop_jumps_num++] = filter->insns_num;
+	pktring_filter_emit(filter, jeq);
+
+}
+
+
+static void pktring_filter_build(struct pktring_filter *filter,
+				 const int family,
+				 const void *dst_addr,
+				 const unsigned int dst_port)
+{
+	const struct in_addr *in_addr = dst_addr;
+	const struct in6_addr *in6_addr = dst_addr;
+	struct sock_filter insn;
+	unsigned int i;
+
+
+	filter->insns_num = 0;
+	filter->drop_jumps_num = 0;
+
+	/*
+	 * The socket receives from the network header onwards. Fragments
+	 * are dropped, as are IPv6 datagrams with extension headers.
+	 */
+	if (family == AF_INET) {
+		pktring_filter_match(filter, BPF_B, 9, IPPROTO_UDP);
+
+		insn = (struct sock_filter)BPF_STMT(BPF_LD | BPF_ABS | BPF_H,
+									6);
+		pktring_filter_emit(filter, insn);
+		insn = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K,
+							0x3fff, 0, 0);
+		filter->drop_jumps[filter->drop_jumps_num++] =
+							filter->insns_num;
+		pktring_filter_emit(filter, insn);
+
+		if (dst_addr != NULL) {
+			pktring_filter_match(filter, BPF_W, 16,
+						ntohl(in_addr->s_addr));
+		}
+
+		insn = (struct sock_filter)BPF_STMT(BPF_LDX | BPF_B | BPF_MSH,
+									0);
+		pktring_filter_emit(filter, insn);
+		insn = (struct sock_filter)BPF_STMT(BPF_LD | BPF_IND | BPF_H,
+									2);
+		pktring_filter_emit(filter, insn);
+		insn = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+							dst_port, 0, 0);
+		filter->drop_jumps[filter->drop_jumps_num++] =
+							filter->insns_num;
+		pktring_filter_emit(filter, insn);
+	} else {
+		pktring_filter_match(filter, BPF_B, 6, IPPROTO_UDP);
+		if (dst_addr != NULL) {
+			for (i = 0; i < 4; i++) {
+				pktring_filter_match(filter, BPF_W,
+					24 + (i * 4),
+					ntohl(in6_addr->s6_addr32[i]));
+			}
+		}
+		pktring_filter_match(filter, BPF_H, PKTRING_IP6_HLEN + 2,
+								dst_port);
+	}
+
+	insn = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0xffffffff);
+	pktring_filter_emit(filter, insn);
+
+	/*
+	 * A JSET jumps to drop when true, the JEQs when false.
+	 */
+	for (i = 0; i < filter->drop_jumps_num; i++) {
+		if (BPF_OP(filter->insns[filter->drop_jumps[i]].code) ==
+								BPF_JSET) {
+			filter->insns[filter->drop_jumps[i]].jt =
+				filter->insns_num - filter->drop_jumps[i] - 1;
+		} else {
+			filter->insns[filter->drop_jumps[i]].jf =
+				filter->insns_num - filter->drop_jumps[i] - 1;
+		}
+	}
+
+	insn = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0);
+	pktring_filter_emit(filter, insn);
+
+}
+
+
+unsigned int pktring_rx(struct pktring *ring,
+			struct iovec pkts[],
+			const unsigned int pkts_max,
+			unsigned int *blocks_done)
+{
+	struct tpacket_block_desc *block;
+	struct tpacket3_hdr *pkt_hdr;
+	unsigned int pkts_num = 0;
+
+
+	*blocks_done = 0;
+
+	/*
+	 * A block is only handed back to the kernel once all its packets
+	 * have been returned and the caller has come back for more, as
+	 * until then it may still be using them.
+	 */
+	if ((ring->block != NULL) && (ring->pkts_left == 0)) {
+		pktring_store_release(&ring->block->hdr.bh1.block_status,
+							TP_STATUS_KERNEL);
+		ring->block = NULL;
+		ring->block_idx = (ring->block_idx + 1) % PKTRING_BLOCKS_NUM;
+		(*blocks_done)++;
+	}
+
+	if (ring->block == NULL) {
+		block = (struct tpacket_block_desc *)(ring->map +
+				(ring->block_idx * PKTRING_BLOCK_SIZE));
+		if (!(pktring_load_acquire(&block->hdr.bh1.block_status) &
+							TP_STATUS_USER)) {
+			return 0;
+		}
+		ring->block = block;
+		ring->next_pkt = (struct tpacket3_hdr *)((uint8_t *)block +
+					block->hdr.bh1.offset_to_first_pkt);
+		ring->pkts_left = block->hdr.bh1.num_pkts;
+	}
+
+	while ((ring->pkts_left > 0) && (pkts_num < pkts_max)) {
+		pkt_hdr = ring->next_pkt;
+		pkts[pkts_num].iov_base = (uint8_t *)pkt_hdr + pkt_hdr->tp_mac;
+		pkts[pkts_num].iov_len = pkt_hdr->tp_snaplen;
+		pkts_num++;
+
+		ring->next_pkt = (struct tpacket3_hdr *)((uint8_t *)pkt_hdr +
+						pkt_hdr->tp_next_offset);
+		ring->pkts_left--;
+	}
+
+	return pkts_num;
+
+}
+
+
+int pktring_udp_payload(const struct iovec *pkt,
+			struct iovec *payload)
+{
+	const uint8_t *ip_hdr = pkt->iov_base;
+	size_t hdr_len;
+	uint16_t udp_len;
+
+
+	if (pkt->iov_len < 1) {
+		return -1;
+	}
+
+	if ((ip_hdr[0] >> 4) == 4) {
+		hdr_len = (ip_hdr[0] & 0x0f) * 4;
+	} else if ((ip_hdr[0] >> 4) == 6) {
+		hdr_len = PKTRING_IP6_HLEN;
+	} else {
+		return -1;
+	}
+
+	if (pkt->iov_len < (hdr_len + PKTRING_UDP_HLEN)) {
+		return -1;
+	}
+
+	memcpy(&udp_len, ip_hdr + hdr_len + 4, sizeof(udp_len));
+	udp_len = ntohs(udp_len);
+	if ((udp_len < PKTRING_UDP_HLEN) ||
+	    (pkt->iov_len < (hdr_len + udp_len))) {
+		return -1;
+	}
+
+	payload->iov_base = (uint8_t *)ip_hdr + hdr_len + PKTRING_UDP_HLEN;
+	payload->iov_len = udp_len - PKTRING_UDP_HLEN;
+
+	return 0;
+
+}
+
+
+int pktring_stats(const struct pktring *ring,
+		  struct tpacket_stats_v3 *stats)
+{
+	socklen_t stats_len = sizeof(*stats);
+
+
+	return getsockopt(ring->sock_fd, SOL_PACKET, PACKET_STATISTICS, stats,
+								&stats_len);
+
+}
+
+
+int pktring_drop_all_filter(const int sock_fd)
+{
+	struct sock_filter drop_all = BPF_STMT(BPF_RET | BPF_K, 0);
+	struct sock_fprog fprog;
+
+
+	fprog.len = 1;
+	fprog.filter = &drop_all;
+
+	return setsockopt(sock_fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog,
+								sizeof(fprog));
+
+}
+
+
+void pktring_close(struct pktring *ring)
+{
+
+
+	if (ring->map != NULL) {
+		munmap(ring->map, ring->map_size);
+		ring->map = NULL;
+	}
+
+	if (ring->sock_fd != -1) {
+		close(ring->sock_fd);
+		ring->sock_fd = -1;
+	}
+
+}
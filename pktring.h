@@ -0,0 +1,73 @@
+/*
+ * pktring - minimal Linux AF_PACKET TPACKET_V3 receive ring, with a classic
+ * BPF filter accepting a single UDP destination address and port
+ *
+ * Copyright (C) 2011 Mark Smith <markzzzsmith@yahoo.com.au>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA. 
+ */
+#ifndef __PKTRING_H
+#define __PKTRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <linux/if_packet.h>
+#include <sys/uio.h>
+
+
+enum PKTRING_DEFS {
+	PKTRING_BLOCK_SIZE = 1 << 17,
+	PKTRING_BLOCKS_NUM = 32,
+	PKTRING_FRAME_SIZE = 2048,
+};
+
+struct pktring {
+	int sock_fd;
+
+	uint8_t *map;
+	size_t map_size;
+
+	unsigned int block_idx;
+	struct tpacket_block_desc *block;
+	struct tpacket3_hdr *next_pkt;
+	unsigned int pkts_left;
+};
+
+
+int pktring_open(struct pktring *ring,
+		 const unsigned int ifindex,
+		 const int family,
+		 const void *dst_addr,
+		 const unsigned int dst_port,
+		 const unsigned int block_tov_msec);
+
+unsigned int pktring_rx(struct pktring *ring,
+			struct iovec pkts[],
+			const unsigned int pkts_max,
+			unsigned int *blocks_retired);
+
+int pktring_udp_payload(const struct iovec *pkt,
+			struct iovec *payload);
+
+int pktring_stats(const struct pktring *ring,
+		  struct tpacket_stats_v3 *stats);
+
+int pktring_drop_all_filter(const int sock_fd);
+
+void pktring_close(struct pktring *ring);
+
+#endif /* __PKTRING_H */
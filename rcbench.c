@@ -0,0 +1,421 @@
+/*
+ * rcbench - measure the CPU time a running replicast spends per datagram
+ * received
+ *
+ * Copyright (C) 2011 Mark Smith <markzzzsmith@yahoo.com.au>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+/*
+ * Usage: rcbench [-n datagrams] [-s size] [-p pps] [-r runs]
+ *		  <file> <addr> <port>
+ *
+ * Sends datagrams (1000000 of 1316 bytes by default) with sendmmsg() to
+ * replicast's -4in or -6in address and port, as fast as it can or at pps
+ * datagrams a second, runs times (5 by default), and for each prints the
+ * user and system CPU time replicast used, over all its threads, per
+ * datagram it received. The datagrams received and dropped are read from
+ * the -shmstats file, and the CPU time from /proc for the pid the file
+ * gives. A run ends once a publish of the counters shows no more datagrams
+ * received. The median of the runs is printed last.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "shmstats.h"
+
+
+enum RCBENCH_DEFS {
+	RCBENCH_PKTS = 1000000,
+	RCBENCH_PKT_LEN = 1316,
+	RCBENCH_PKT_LEN_MAX = 65507,
+	RCBENCH_RUNS = 5,
+	RCBENCH_RUNS_MAX = 100,
+	RCBENCH_BATCH = 64,
+	RCBENCH_PACED_BATCH = 8,
+};
+
+
+static int open_tx_sock(const char *addr_str,
+			const char *port_str)
+{
+	struct sockaddr_in sa_in;
+	struct sockaddr_in6 sa_in6;
+	int sock_fd;
+	int ret;
+
+
+	memset(&sa_in, 0, sizeof(sa_in));
+	memset(&sa_in6, 0, sizeof(sa_in6));
+
+	if (inet_pton(AF_INET, addr_str, &sa_in.sin_addr) == 1) {
+		sa_in.sin_family = AF_INET;
+		sa_in.sin_port = htons(atoi(port_str));
+		sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
+		if (sock_fd == -1) {
+			return -1;
+		}
+		ret = connect(sock_fd, (struct sockaddr *)&sa_in,
+							sizeof(sa_in));
+	} else if (inet_pton(AF_INET6, addr_str, &sa_in6.sin6_addr) == 1) {
+		sa_in6.sin6_family = AF_INET6;
+		sa_in6.sin6_port = htons(atoi(port_str));
+		sock_fd = socket(AF_INET6, SOCK_DGRAM, 0);
+		if (sock_fd == -1) {
+			return -1;
+		}
+		ret = connect(sock_fd, (struct sockaddr *)&sa_in6,
+							sizeof(sa_in6));
+	} else {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (ret == -1) {
+		close(sock_fd);
+		return -1;
+	}
+
+	return sock_fd;
+
+}
+
+
+/* the process's user and system time, in clock ticks */
+static int read_cpu_ticks(const int pid,
+			  unsigned long long *ticks)
+{
+	char path[64];
+	char buf[1024];
+	FILE *stat_file;
+	char *fields;
+	unsigned long long utime;
+	unsigned long long stime;
+	int ret;
+
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+
+	stat_file = fopen(path, "r");
+	if (stat_file == NULL) {
+		return -1;
+	}
+
+	if (fgets(buf, sizeof(buf), stat_file) == NULL) {
+		fclose(stat_file);
+		errno = EIO;
+		return -1;
+	}
+	fclose(stat_file);
+
+	/* the command name may hold spaces, the fields follow its ')' */
+	fields = strrchr(buf, ')');
+	if (fields == NULL) {
+		errno = EIO;
+		return -1;
+	}
+
+	ret = sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u "
+		"%*u %llu %llu", &utime, &stime);
+	if (ret != 2) {
+		errno = EIO;
+		return -1;
+	}
+
+	*ticks = utime + stime;
+
+	return 0;
+
+}
+
+
+/* the datagrams received by replicast, and when they were published */
+static int read_in_pkts(const struct shm_stats *stats,
+			void *snapshot,
+			unsigned long long *in_pkts,
+			unsigned long long *in_drops,
+			unsigned long long *publishes)
+{
+	const struct shm_stats_header *header = snapshot;
+	const struct shm_stats_counter *counter;
+	unsigned int i;
+
+
+	if (shm_stats_read(stats, snapshot) == -1) {
+		return -1;
+	}
+
+	*in_pkts = 0;
+	*in_drops = 0;
+	for (i = 0; i < header->counters_num; i++) {
+		counter = shm_stats_counter(header, i);
+		if ((strcmp(counter->name, "inet_in_pkts") == 0) ||
+		    (strcmp(counter->name, "inet6_in_pkts") == 0)) {
+			*in_pkts += counter->value;
+		} else if ((strcmp(counter->name, "inet_in_drops") == 0) ||
+			   (strcmp(counter->name, "inet6_in_drops") == 0)) {
+			*in_drops += counter->value;
+		}
+	}
+
+	*publishes = header->publishes;
+
+	return 0;
+
+}
+
+
+/*
+ * Waits for replicast to publish its counters twice running without having
+ * received any more datagrams, which it has then all caught up with.
+ */
+static int wait_in_pkts(const struct shm_stats *stats,
+			void *snapshot,
+			unsigned long long *in_pkts,
+			unsigned long long *in_drops)
+{
+	const struct shm_stats_header *header = snapshot;
+	const struct timespec wait = { 0, 10000000 };
+	unsigned long long last_pkts;
+	unsigned long long last_publishes;
+	unsigned long long publishes;
+	unsigned int quiet = 0;
+
+
+	if (read_in_pkts(stats, snapshot, &last_pkts, in_drops,
+						&last_publishes) == -1) {
+		return -1;
+	}
+
+	while (quiet < 2) {
+		nanosleep(&wait, NULL);
+		if (read_in_pkts(stats, snapshot, in_pkts, in_drops,
+						&publishes) == -1) {
+			return -1;
+		}
+		if (publishes == last_publishes) {
+			continue;
+		}
+		if (*in_pkts == last_pkts) {
+			quiet++;
+		} else {
+			quiet = 0;
+		}
+		last_pkts = *in_pkts;
+		last_publishes = publishes;
+		if (kill(header->pid, 0) == -1) {
+			return -1;
+		}
+	}
+
+	return 0;
+
+}
+
+
+/* paced sends go in smaller batches, so the bursts stay short */
+static void send_pkts(const int sock_fd,
+		      const unsigned int pkt_len,
+		      const unsigned long pkts,
+		      const unsigned long pps)
+{
+	static char buf[RCBENCH_PKT_LEN_MAX];
+	struct iovec iov = { buf, pkt_len };
+	struct mmsghdr mmsgs[RCBENCH_BATCH];
+	const unsigned int batch_max = (pps > 0) ? RCBENCH_PACED_BATCH :
+							RCBENCH_BATCH;
+	struct timespec start;
+	struct timespec next;
+	unsigned long long next_nsecs;
+	unsigned long sent = 0;
+	unsigned int batch;
+	unsigned int i;
+	int ret;
+
+
+	memset(buf, 0x5a, pkt_len);
+	memset(mmsgs, 0, sizeof(mmsgs));
+	for (i = 0; i < RCBENCH_BATCH; i++) {
+		mmsgs[i].msg_hdr.msg_iov = &iov;
+		mmsgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while (sent < pkts) {
+		if (pps > 0) {
+			next_nsecs = (start.tv_sec * 1000000000ULL) +
+				start.tv_nsec + (sent * 1000000000ULL / pps);
+			next.tv_sec = next_nsecs / 1000000000ULL;
+			next.tv_nsec = next_nsecs % 1000000000ULL;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+									NULL);
+		}
+		batch = ((pkts - sent) < batch_max) ? pkts - sent : batch_max;
+		ret = sendmmsg(sock_fd, mmsgs, batch, 0);
+		if (ret > 0) {
+			sent += ret;
+		}
+	}
+
+}
+
+
+static int cmp_double(const void *a,
+		      const void *b)
+{
+	const double *x = a;
+	const double *y = b;
+
+
+	return (*x > *y) - (*x < *y);
+
+}
+
+
+int main(int argc, char *argv[])
+{
+	struct shm_stats stats;
+	const struct shm_stats_header *header;
+	void *snapshot;
+	double ns_per_pkt[RCBENCH_RUNS_MAX];
+	unsigned long pkts = RCBENCH_PKTS;
+	unsigned long pps = 0;
+	unsigned int pkt_len = RCBENCH_PKT_LEN;
+	unsigned int runs = RCBENCH_RUNS;
+	unsigned long long start_pkts;
+	unsigned long long end_pkts;
+	unsigned long long start_drops;
+	unsigned long long end_drops;
+	unsigned long long start_ticks;
+	unsigned long long end_ticks;
+	long ticks_per_sec;
+	int sock_fd;
+	unsigned int run;
+	int opt;
+
+
+	while ((opt = getopt(argc, argv, "n:s:p:r:")) != -1) {
+		switch (opt) {
+		case 'n':
+			pkts = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			pkt_len = strtoul(optarg, NULL, 10);
+			break;
+		case 'p':
+			pps = strtoul(optarg, NULL, 10);
+			break;
+		case 'r':
+			runs = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			fprintf(stderr, "usage: rcbench [-n datagrams] "
+				"[-s size] [-p pps] [-r runs] <file> <addr> "
+				"<port>\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	if ((optind != (argc - 3)) || (pkts == 0) || (pkt_len == 0) ||
+	    (pkt_len > RCBENCH_PKT_LEN_MAX) || (runs == 0) ||
+	    (runs > RCBENCH_RUNS_MAX)) {
+		fprintf(stderr, "usage: rcbench [-n datagrams] [-s size] "
+			"[-p pps] [-r runs] <file> <addr> <port>\n");
+		return EXIT_FAILURE;
+	}
+
+	if (shm_stats_open(&stats, argv[optind]) == -1) {
+		fprintf(stderr, "opening %s: %s\n", argv[optind],
+			(errno == EPROTONOSUPPORT) ? "unsupported version" :
+			strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	snapshot = malloc(stats.size);
+	if (snapshot == NULL) {
+		fprintf(stderr, "%s\n", strerror(errno));
+		return EXIT_FAILURE;
+	}
+	header = snapshot;
+
+	sock_fd = open_tx_sock(argv[optind + 1], argv[optind + 2]);
+	if (sock_fd == -1) {
+		fprintf(stderr, "%s port %s: %s\n", argv[optind + 1],
+			argv[optind + 2], strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	ticks_per_sec = sysconf(_SC_CLK_TCK);
+
+	for (run = 0; run < runs; run++) {
+		if ((wait_in_pkts(&stats, snapshot, &start_pkts,
+						&start_drops) == -1) ||
+		    (read_cpu_ticks(header->pid, &start_ticks) == -1)) {
+			fprintf(stderr, "reading replicast: %s\n",
+				strerror(errno));
+			return EXIT_FAILURE;
+		}
+
+		send_pkts(sock_fd, pkt_len, pkts, pps);
+
+		if ((wait_in_pkts(&stats, snapshot, &end_pkts,
+						&end_drops) == -1) ||
+		    (read_cpu_ticks(header->pid, &end_ticks) == -1)) {
+			fprintf(stderr, "reading replicast: %s\n",
+				strerror(errno));
+			return EXIT_FAILURE;
+		}
+
+		if (end_pkts == start_pkts) {
+			fprintf(stderr, "replicast received no datagrams\n");
+			return EXIT_FAILURE;
+		}
+
+		ns_per_pkt[run] = (end_ticks - start_ticks) * 1e9 /
+			ticks_per_sec / (end_pkts - start_pkts);
+
+		printf("run %u: %lu sent, %llu received, %llu dropped, %.0f "
+			"nsecs cpu per datagram received\n", run + 1, pkts,
+			end_pkts - start_pkts, end_drops - start_drops,
+			ns_per_pkt[run]);
+		fflush(stdout);
+	}
+
+	qsort(ns_per_pkt, runs, sizeof(ns_per_pkt[0]), cmp_double);
+	printf("median %.0f nsecs cpu per datagram received\n",
+		ns_per_pkt[runs / 2]);
+
+	close(sock_fd);
+	free(snapshot);
+	shm_stats_close(&stats);
+
+	return EXIT_SUCCESS;
+
+}
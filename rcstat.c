@@ -0,0 +1,180 @@
+/*
+ * rcstat - print the counters replicast publishes with -shmstats
+ *
+ * Copyright (C) 2011 Mark Smith <markzzzsmith@yahoo.com.au>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+/*
+ * Usage: rcstat [-i secs] [-c count] <file>
+ *
+ * Prints a consistent snapshot of the counters in the file, or with -i,
+ * a snapshot every secs seconds, count times or until interrupted. Each
+ * snapshot is a line per counter, flow and destination, followed by a
+ * blank line.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shmstats.h"
+
+
+static void print_snapshot(const struct shm_stats_header *header)
+{
+	const struct shm_stats_counter *counter;
+	const struct shm_stats_flow *flow;
+	const struct shm_stats_dest *dest;
+	unsigned int i;
+	unsigned int j;
+
+
+	printf("pid %d, published %llu times, %.3f secs ago\n", header->pid,
+		(unsigned long long)header->publishes,
+		(shm_stats_nsecs() - header->publish_nsecs) / 1e9);
+
+	for (i = 0; i < header->counters_num; i++) {
+		counter = shm_stats_counter(header, i);
+		printf("%.*s %llu\n", SHM_STATS_NAME_LEN, counter->name,
+			(unsigned long long)counter->value);
+	}
+
+	for (i = 0; i < header->flows_num; i++) {
+		flow = shm_stats_flow(header, i);
+		printf("%.*s: pkts in %llu, rx drops %llu, "
+			"inet pkts out %llu, inet6 pkts out %llu\n",
+			SHM_STATS_NAME_LEN, flow->name,
+			(unsigned long long)flow->in_pkts,
+			(unsigned long long)flow->in_drops,
+			(unsigned long long)flow->inet_out_pkts,
+			(unsigned long long)flow->inet6_out_pkts);
+	}
+
+	for (i = 0; i < header->dests_num; i++) {
+		dest = shm_stats_dest(header, i);
+		printf("%.*s: pkts out %llu, bytes out %llu",
+			SHM_STATS_NAME_LEN, dest->name,
+			(unsigned long long)dest->pkts,
+			(unsigned long long)dest->bytes);
+		for (j = 0; j < SHM_STATS_DEST_ERRS; j++) {
+			printf(", %s %llu", shm_stats_dest_err_strs[j],
+				(unsigned long long)dest->errs[j]);
+		}
+		/* an older writer's records end before the latencies */
+		if ((header->dest_size >= sizeof(struct shm_stats_dest)) &&
+		    (dest->latency_pkts > 0)) {
+			printf(", latency usecs p50 %.1f, p99 %.1f, "
+				"p99.9 %.1f, max %.1f (%llu pkts)",
+				dest->latency_p50 / 1000.0,
+				dest->latency_p99 / 1000.0,
+				dest->latency_p999 / 1000.0,
+				dest->latency_max / 1000.0,
+				(unsigned long long)dest->latency_pkts);
+		}
+		printf("\n");
+	}
+
+	printf("\n");
+
+}
+
+
+int main(int argc, char *argv[])
+{
+	struct shm_stats stats;
+	struct timespec interval = { 0, 0 };
+	void *snapshot;
+	double secs;
+	long count = -1;
+	int opt;
+
+
+	while ((opt = getopt(argc, argv, "i:c:")) != -1) {
+		switch (opt) {
+		case 'i':
+			secs = strtod(optarg, NULL);
+			if (secs <= 0) {
+				fprintf(stderr, "invalid interval\n");
+				return EXIT_FAILURE;
+			}
+			interval.tv_sec = secs;
+			interval.tv_nsec = (secs - interval.tv_sec) * 1e9;
+			break;
+		case 'c':
+			count = strtol(optarg, NULL, 10);
+			if (count <= 0) {
+				fprintf(stderr, "invalid count\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		default:
+			fprintf(stderr, "usage: rcstat [-i secs] [-c count] "
+				"<file>\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind != (argc - 1)) {
+		fprintf(stderr, "usage: rcstat [-i secs] [-c count] <file>\n");
+		return EXIT_FAILURE;
+	}
+
+	/* a count of 0 streams snapshots until interrupted */
+	if (count == -1) {
+		count = (interval.tv_sec || interval.tv_nsec) ? 0 : 1;
+	}
+
+	if (shm_stats_open(&stats, argv[optind]) == -1) {
+		fprintf(stderr, "opening %s: %s\n", argv[optind],
+			(errno == EPROTONOSUPPORT) ? "unsupported version" :
+			strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	snapshot = malloc(stats.size);
+	if (snapshot == NULL) {
+		fprintf(stderr, "%s\n", strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	for ( ;; ) {
+		if (shm_stats_read(&stats, snapshot) == -1) {
+			fprintf(stderr, "reading %s: %s\n", argv[optind],
+				strerror(errno));
+			return EXIT_FAILURE;
+		}
+		print_snapshot(snapshot);
+		fflush(stdout);
+
+		if ((count > 0) && (--count == 0)) {
+			break;
+		}
+		nanosleep(&interval, NULL);
+	}
+
+	free(snapshot);
+	shm_stats_close(&stats);
+
+	return EXIT_SUCCESS;
+
+}
@@ -21,27 +21,122 @@
  *
  */
 
+#define _GNU_SOURCE
+
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <linux/errqueue.h>
+#include <linux/filter.h>
+#include <linux/net_tstamp.h>
+#include <linux/sock_diag.h>
+
 #include <arpa/inet.h>
 #include <net/if.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/poll.h>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
 
 #include "hacks.h"
 #include "inetaddr.h"
 #include "log.h"
+#include "pktring.h"
+#include "shmstats.h"
+#include "spscring.h"
+#include "stringz.h"
+#include "udpmib.h"
+#include "uring.h"
+#include "xsk.h"
 
 
 enum GLOBAL_DEFS {
 	PKT_BUF_SIZE = 0xffff,
+	RX_BATCH_MAX = 1024,
+	RX_BATCH_WAIT_MAX = 1000000,
+	RX_BUSY_POLL_MAX = 1000000,
+	RX_BUSY_IDLE_MAX = 3600000,
+	RX_BUSY_IDLE_DEF = 1000,
+	RX_LATENCY_BUCKETS = 168,
+	RX_BUF_TUNE_RECVS = 64,
+	RX_BUF_TUNE_MSECS = 1000,
+	SOCK_BUF_MIN = 4096,
+	SOCK_BUF_MAX = 1024 * 1024 * 1024,
+	UDP_MIB_SAMPLE_SECS = 1,
+	SHM_STATS_PUBLISH_MSECS = 100,
+	METRICS_REQUEST_MAX_LEN = 4096,
+	METRICS_TIMEOUT_SECS = 1,
+	UDP_GSO_MAX_SEGS = 64,
+	UDP_GSO_MAX_PAYLOAD = 0xffff - 40 - 8,
+	UDP_GRO_MAX_SEGS = 64,
+	TX_ZEROCOPY_MIN_LEN = 8192,
+	TX_ZEROCOPY_CMSG_BUF_SIZE = 128,
+	TX_ZEROCOPY_WAIT_MSECS = 10,
+	RX_ZC_BUF_SETS = 4,
+	RX_CMSG_BUF_SIZE = 256,
+	URING_ENTRIES = 256,
+	URING_BUFS_NUM = 128,
+	URING_BUF_GROUP = 0,
+	URING_TX_LEGS_MAX = 2,
+	URING_RECV_ERRS_MAX = 64,
+	XDP_RX_BATCH = 64,
+	XDP_QUEUE_MAX = 1023,
+	PKT_RING_RX_BATCH = 64,
+	PKT_RING_TOV_MAX = 1000,
+	WORKERS_MAX = 64,
+	RT_CPUS_MAX = 64,
+	RT_THREADS_MAX = WORKERS_MAX + 2,
+	RT_PRIO_MAX = 99,
+	RT_PREFAULT_STACK_SIZE = 256 * 1024,
+	PIPE_TX_LEGS = 2,
+	PIPE_RING_SIZE = 4096,
+	PIPE_BUF_SIZE = 8 * 1024 * 1024,
+	PIPE_TX_BATCH = 64,
+	TX_CONN_BATCH = 64,
+	TX_BACKLOG_MAX = 4096,
+	TX_BACKLOG_EVENTS = 64,
+	TX_RATE_MAX = 100000000,
+	TX_RATE_BURST_MSECS = 10,
+	TX_RATE_BURST_MIN = 3000,
+	TX_RATE_TIMER_USECS = 1000,
+	TX_PACE_HORIZON_MSECS = 200,
+	TX_PACE_EWMA_WEIGHT = 64,
+	FLOW_LINE_SIZE = 4096,
+	FLOW_ARGS_MAX = 64,
+	FLOW_EVENTS = 64,
+	RATES_INTERVAL_MAX = 3600,
+	RATES_EWMA_WEIGHT = 8,
+	CACHE_LINE = 64,
+	TX_LEGS_MAX = 2,
+};
+
+/*
+ * The errno buckets of a destination's failed sends.
+ */
+enum TX_DEST_ERR {
+	TX_DEST_ERR_CONNREFUSED,
+	TX_DEST_ERR_HOSTUNREACH,
+	TX_DEST_ERR_NETUNREACH,
+	TX_DEST_ERR_MSGSIZE,
+	TX_DEST_ERR_NOBUFS,
+	TX_DEST_ERR_OTHER,
+	TX_DEST_ERRS,
 };
 
 enum VALIDATE_PROG_OPTS {
@@ -57,6 +152,8 @@ enum VALIDATE_PROG_OPTS {
 	VPO_MODE_INET6INETINET6,
 	VPO_MODE_INET6INET,
 	VPO_MODE_INET6INET6,
+	VPO_MODE_FLOWS,
+	VPO_ERR_FLOWS_ADDRS,
 	VPO_ERR_UNKNOWN,
 };
 
@@ -71,6 +168,40 @@ enum VALIDATE_PROG_OPTS_VALS {
 	VPOV_ERR_INET6_OUT_INTF,
 	VPOV_ERR_INET6_DST_ADDR,
 	VPOV_ERR_INET6_TX_HOPS_RANGE,
+	VPOV_ERR_RX_BATCH_RANGE,
+	VPOV_ERR_RX_BATCH_WAIT_RANGE,
+	VPOV_ERR_RX_BUSY_POLL_RANGE,
+	VPOV_ERR_RX_BUSY_IDLE_RANGE,
+	VPOV_ERR_RX_BUSY_POLL_OPTS,
+	VPOV_ERR_RX_LATENCY_OPTS,
+	VPOV_ERR_SOCK_BUF_RANGE,
+	VPOV_ERR_RX_BUF_OPTS,
+	VPOV_ERR_ENGINE,
+	VPOV_ERR_ENGINE_OPTS,
+	VPOV_ERR_ENGINE_MODE,
+	VPOV_ERR_CONNECT_OPTS,
+	VPOV_ERR_TX_BACKLOG_RANGE,
+	VPOV_ERR_TX_BACKLOG_OPTS,
+	VPOV_ERR_TX_RATE_RANGE,
+	VPOV_ERR_TX_RATE_POLICY,
+	VPOV_ERR_TX_RATE_QUEUE,
+	VPOV_ERR_TX_RATE_OPTS,
+	VPOV_ERR_TX_PACE,
+	VPOV_ERR_TX_PACE_MODE,
+	VPOV_ERR_TX_PACE_OPTS,
+	VPOV_ERR_XDP_INTF,
+	VPOV_ERR_XDP_QUEUE_RANGE,
+	VPOV_ERR_PKT_RING_INTF,
+	VPOV_ERR_PKT_RING_TOV_RANGE,
+	VPOV_ERR_RX_PATH_OPTS,
+	VPOV_ERR_WORKERS_RANGE,
+	VPOV_ERR_WORKERS_OPTS,
+	VPOV_ERR_CPU_LIST,
+	VPOV_ERR_RT_PRIO,
+	VPOV_ERR_TX_CPU_OPTS,
+	VPOV_ERR_FLOWS_OPTS,
+	VPOV_ERR_METRICS_ADDR,
+	VPOV_ERR_RATES_RANGE,
 	VPOV_ERR_UNKNOWN,
 	VPOV_ERR_MEMORY,
 	VPOV_OPTS_VALS_VALID,
@@ -91,6 +222,45 @@ enum OPT_ERR {
 	OE_INET6_OUT_INTF,
 	OE_INET6_DST_ADDR,
 	OE_INET6_TX_HOPS_RANGE,
+	OE_RX_BATCH_RANGE,
+	OE_RX_BATCH_WAIT_RANGE,
+	OE_RX_BUSY_POLL_RANGE,
+	OE_RX_BUSY_IDLE_RANGE,
+	OE_RX_BUSY_POLL_OPTS,
+	OE_RX_LATENCY_OPTS,
+	OE_SOCK_BUF_RANGE,
+	OE_RX_BUF_OPTS,
+	OE_ENGINE,
+	OE_ENGINE_OPTS,
+	OE_ENGINE_MODE,
+	OE_CONNECT_OPTS,
+	OE_TX_BACKLOG_RANGE,
+	OE_TX_BACKLOG_OPTS,
+	OE_TX_RATE_RANGE,
+	OE_TX_RATE_POLICY,
+	OE_TX_RATE_QUEUE,
+	OE_TX_RATE_OPTS,
+	OE_TX_PACE,
+	OE_TX_PACE_MODE,
+	OE_TX_PACE_OPTS,
+	OE_XDP_INTF,
+	OE_XDP_QUEUE_RANGE,
+	OE_PKT_RING_INTF,
+	OE_PKT_RING_TOV_RANGE,
+	OE_RX_PATH_OPTS,
+	OE_WORKERS_RANGE,
+	OE_WORKERS_OPTS,
+	OE_CPU_LIST,
+	OE_RT_PRIO,
+	OE_TX_CPU_OPTS,
+	OE_FLOWS_ADDRS,
+	OE_FLOWS_OPTS,
+	OE_METRICS_ADDR,
+	OE_RATES_RANGE,
+	OE_FLOWS_FILE,
+	OE_NO_FLOWS,
+	OE_FLOW_OPTS,
+	OE_FLOW_LINE,
 	OE_MEMORY_ERROR,
 	OE_UNKNOWN_ERROR,
 };
@@ -107,6 +277,19 @@ enum REPLICAST_MODE {
 	RCMODE_INET6_TO_INET6,
 	RCMODE_INET6_TO_INET,
 	RCMODE_INET6_TO_INET_INET6,
+	RCMODE_FLOWS,
+};
+
+enum RCAST_ENGINE {
+	ENGINE_LOOP,
+	ENGINE_URING,
+	ENGINE_PIPE,
+};
+
+enum TX_PACE_MODE {
+	TX_PACE_FQ,
+	TX_PACE_ETF,
+	TX_PACE_TIMER,
 };
 
 
@@ -115,6 +298,15 @@ struct inet_rx_sock_params {
 	struct in_addr rx_addr;
 	unsigned int port;
 	struct in_addr in_intf_addr;	
+	unsigned int udp_gro;
+	unsigned int rcvbuf;
+	unsigned int xdp_intf_idx;
+	unsigned int xdp_queue;
+	unsigned int xdp_skb_mode;
+	unsigned int pkt_ring_intf_idx;
+	unsigned int pkt_ring_block_tov;
+	unsigned int workers_num;
+	unsigned int worker_idx;
 };
 
 struct inet_tx_sock_params {
@@ -124,12 +316,32 @@ struct inet_tx_sock_params {
 	struct sockaddr_in *dests;
 	unsigned int dests_num;	
 	unsigned int mc_dests_num;
+	unsigned int sndbuf;
+	unsigned int udp_gso;
+	unsigned int zerocopy;
+	unsigned int connect;
+	unsigned int backlog;
+	unsigned int rate;
+	unsigned int dest_rate;
+	unsigned int rate_queue;
+	unsigned int pace_rate;
+	unsigned int pace_input;
+	enum TX_PACE_MODE pace_mode;
 };
 
 struct inet6_rx_sock_params {
 	struct in6_addr rx_addr;
 	unsigned int port;
 	unsigned int in_intf_idx;
+	unsigned int udp_gro;
+	unsigned int rcvbuf;
+	unsigned int xdp_intf_idx;
+	unsigned int xdp_queue;
+	unsigned int xdp_skb_mode;
+	unsigned int pkt_ring_intf_idx;
+	unsigned int pkt_ring_block_tov;
+	unsigned int workers_num;
+	unsigned int worker_idx;
 };
 
 struct inet6_tx_sock_params {
@@ -139,6 +351,228 @@ struct inet6_tx_sock_params {
 	struct sockaddr_in6 *dests;
 	unsigned int dests_num;
 	unsigned int mc_dests_num;
+	unsigned int sndbuf;
+	unsigned int udp_gso;
+	unsigned int zerocopy;
+	unsigned int connect;
+	unsigned int backlog;
+	unsigned int rate;
+	unsigned int dest_rate;
+	unsigned int rate_queue;
+	unsigned int pace_rate;
+	unsigned int pace_input;
+	enum TX_PACE_MODE pace_mode;
+};
+
+struct rx_batch_params {
+	unsigned int batch_size;
+	unsigned int batch_wait_usec;
+	unsigned int busy_poll_usec;
+	unsigned int busy_idle_msec;
+	unsigned int latency;
+	unsigned int tstamps;
+	unsigned int buf_max;
+};
+
+struct rx_batch {
+	struct mmsghdr *mmsgs;
+	struct iovec *iovs;
+	struct iovec *pkts;
+	uint8_t *bufs;
+	uint8_t *cmsg_bufs;
+	unsigned int size;
+	unsigned int wait_usec;
+	unsigned int udp_gro;
+	struct xsk *xsk;
+	struct iovec *xsk_frames;
+	struct pktring *pkt_ring;
+	struct iovec *ring_pkts;
+	unsigned int busy_poll;
+	unsigned int busy_spinning;
+	unsigned long long busy_idle_nsecs;
+	unsigned long long busy_idle_start;
+	unsigned int latency;
+	unsigned int tstamps;
+	struct timespec *rx_tstamps;
+	unsigned long long *rx_nsecs;
+	uint32_t rx_drops;
+	unsigned int buf_max;
+	unsigned int buf_size;
+	unsigned int buf_maxed;
+	unsigned int buf_recvs;
+	unsigned long long buf_check_nsecs;
+	uint32_t buf_drops;
+	unsigned int buf_set;
+	unsigned int buf_sets;
+	struct tx_dests **zc_dests;
+	int *zc_sock_fds;
+	unsigned int zc_dests_num;
+};
+
+/*
+ * Datagrams waiting for a destination's socket to become writable, in
+ * a ring of copies, along with how long the destination has been blocked.
+ */
+struct tx_backlog {
+	int sock_fd;
+	struct msghdr msg;
+	const struct sockaddr *dest;
+	struct iovec *pkts;
+	unsigned int head;
+	unsigned int depth;
+	unsigned int hwm;
+	unsigned long long queued;
+	unsigned long long drops;
+	unsigned long long blocked_usecs;
+	struct timespec blocked_start;
+};
+
+/*
+ * A token bucket node of the transmit rate shaper, with its rate in bytes
+ * per second, or 0 if unlimited.
+ */
+struct tx_rate_bucket {
+	unsigned long long rate;
+	long long burst;
+	long long tokens;
+	unsigned long long last_nsecs;
+	unsigned long long conform_pkts;
+	unsigned long long conform_bytes;
+	unsigned long long exceed_pkts;
+	unsigned long long exceed_bytes;
+};
+
+/*
+ * A destination's transmit counters, a cache line each, as each is only
+ * written by the thread sending to the destination.
+ */
+struct tx_dest_stats {
+	unsigned long long pkts;
+	unsigned long long bytes;
+	unsigned long long errs[TX_DEST_ERRS];
+} __attribute__((aligned(CACHE_LINE)));
+
+/*
+ * Latencies in nsecs, counted in the log-linear buckets of
+ * rx_latency_bucket().
+ */
+struct latency_hist {
+	unsigned long long pkts;
+	unsigned long long sum;
+	unsigned long long max;
+	unsigned long long buckets[RX_LATENCY_BUCKETS];
+};
+
+struct tx_dests {
+	struct mmsghdr *mmsgs;
+	struct iovec pkt_iov;
+	unsigned int dests_num;
+	unsigned int udp_gso;
+	unsigned int zerocopy;
+	unsigned long long zc_issued;
+	unsigned long long zc_completed;
+	unsigned long long zc_marks[RX_ZC_BUF_SETS];
+	unsigned int zc_rotated;
+	struct mmsghdr *gso_mmsgs;
+	unsigned int *gso_dests;
+	unsigned int gso_dests_num;
+	struct mmsghdr *mc_mmsgs;
+	unsigned int *mc_dests;
+	unsigned int mc_dests_num;
+	struct tx_dest_stats *dest_stats;
+	const unsigned long long *rx_nsecs;
+	const unsigned long long *pkt_rx_nsecs;
+	unsigned long long sent_nsecs;
+	struct latency_hist *latency;
+	struct latency_hist *dest_latency;
+	int *conn_fds;
+	const struct sockaddr **conn_dests;
+	unsigned int conn_dests_num;
+	struct mmsghdr conn_mmsgs[TX_CONN_BATCH];
+	unsigned int backlog_size;
+	struct tx_backlog *backlogs;
+	unsigned int backlogs_pending;
+	unsigned int sock_blocked;
+	int epoll_fd;
+	struct mmsghdr *send_mmsgs;
+	unsigned int *send_dests;
+	unsigned int rate_limited;
+	unsigned int rate_queue;
+	unsigned long long rate_nsecs;
+	struct tx_rate_bucket *rate_dests;
+	struct tx_rate_bucket rate_intf;
+	struct tx_rate_bucket *rate_global;
+	int rate_timer_fd;
+	unsigned int rate_timer_armed;
+	unsigned int paced;
+	unsigned int pace_rate;
+	unsigned int pace_input;
+	enum TX_PACE_MODE pace_mode;
+	clockid_t pace_clock;
+	unsigned long long pace_next_nsecs;
+	const unsigned long long *pace_rx_nsecs;
+	unsigned long long pace_last_arrival_nsecs;
+	long long pace_gap_nsecs;
+	union {
+		uint8_t buf[CMSG_SPACE(sizeof(uint16_t))];
+		struct cmsghdr align;
+	} gso_cmsg;
+	union {
+		uint8_t buf[CMSG_SPACE(sizeof(uint64_t))];
+		struct cmsghdr align;
+	} pace_cmsg;
+};
+
+/*
+ * The receive family and transmit families of a forwarding mode.
+ */
+struct rcast_mode {
+	enum REPLICAST_MODE rc_mode;
+	int rx_family;
+	unsigned int inet_tx;
+	unsigned int inet6_tx;
+};
+
+/*
+ * A transmit leg of the forwarding loop, an output socket and the
+ * destinations sent to through it.
+ */
+struct tx_leg {
+	int family;
+	int sock_fd;
+	struct tx_dests *tx_dests;
+	unsigned long long *out_pkts;
+};
+
+/*
+ * io_uring completion user_data holds the provided buffer id in the low
+ * 16 bits and the tx leg plus one above them, with a leg of zero for the
+ * receive.
+ */
+#define URING_UD(leg, dest, bid)	(((unsigned long long)(dest) << 32) | \
+				 ((unsigned long long)(leg) << 16) | (bid))
+#define URING_UD_DEST(ud)	((unsigned int)((ud) >> 32))
+#define URING_UD_LEG(ud)	((unsigned int)(((ud) >> 16) & 0xffff))
+#define URING_UD_BID(ud)	((unsigned short)((ud) & 0xffff))
+
+struct uring_tx_leg {
+	int sock_fd;
+	struct tx_dests *tx_dests;
+	unsigned long long *out_pkts;
+};
+
+/*
+ * A transmit thread of the pipe engine, sending the datagrams the receive
+ * thread hands it through its ring to one address family's destinations.
+ */
+struct pipe_tx_leg {
+	pthread_t thread;
+	struct spsc_ring ring;
+	const uint8_t *buf;
+	int sock_fd;
+	struct tx_dests *tx_dests;
+	struct packet_counters *pkt_counters;
+	unsigned long long *out_pkts;
 };
 
 struct socket_fds {
@@ -146,15 +580,172 @@ struct socket_fds {
 	int inet6_in_sock_fd;
 	int inet_out_sock_fd;
 	int inet6_out_sock_fd;
+	int xdp_sock_fd;
 };
 
 struct packet_counters {
 	unsigned long long inet_in_pkts;
 	unsigned long long inet6_in_pkts;
+	unsigned long long inet_in_drops;
+	unsigned long long inet6_in_drops;
 	unsigned long long inet_out_pkts;
 	unsigned long long inet6_out_pkts;
+	unsigned long long rx_batches;
+	unsigned long long rx_batch_pkts;
+	unsigned long long rx_batches_full;
+	unsigned long long rx_busy_polls;
+	unsigned long long rx_busy_empty;
+	unsigned long long rx_busy_backoffs;
+	unsigned long long rx_buf_drops;
+	unsigned long long rx_buf_grows;
+	unsigned long long rx_bytes;
+	struct latency_hist rx_latency;
+	unsigned long long rx_gro_bufs;
+	unsigned long long rx_gro_segs;
+	unsigned long long tx_gso_sends;
+	unsigned long long tx_gso_segs;
+	unsigned long long tx_zc_sends;
+	unsigned long long tx_zc_hits;
+	unsigned long long tx_zc_fallbacks;
+	unsigned long long tx_zc_timeouts;
+	unsigned long long uring_enters;
+	unsigned long long uring_sqes;
+	unsigned long long uring_cqes;
+	unsigned long long uring_recv_errs;
+	unsigned long long xdp_rx_pkts;
+	unsigned long long xdp_rx_polls;
+	unsigned long long xdp_stack_pkts;
+	unsigned long long xdp_ring_full;
+	unsigned long long xdp_fill_empty;
+	unsigned long long xdp_dropped;
+	unsigned long long pkt_ring_pkts;
+	unsigned long long pkt_ring_blocks;
+	unsigned long long pkt_ring_kernel_pkts;
+	unsigned long long pkt_ring_drops;
+	unsigned long long pkt_ring_freezes;
+	unsigned long long pipe_ring_hwm[PIPE_TX_LEGS];
+	unsigned long long pipe_ring_full[PIPE_TX_LEGS];
+	unsigned long long pipe_buf_full;
+	unsigned long long tx_backlog_queued;
+	unsigned long long tx_backlog_drops;
+	unsigned long long tx_paced;
+	unsigned long long tx_pace_drops;
+	/* not summed, for logging the per destination backlogs */
+	struct tx_dests *inet_tx_dests;
+	struct tx_dests *inet6_tx_dests;
+};
+
+/*
+ * A worker forwarding from its own SO_REUSEPORT receive socket, in addition
+ * to the main thread.
+ */
+struct worker {
+	pthread_t thread;
+	struct socket_fds sock_fds;
+	struct inet_rx_sock_params inet_rx_sock_parms;
+	struct inet6_rx_sock_params inet6_rx_sock_parms;
+	struct packet_counters pkt_counters;
+};
+
+/*
+ * The UDP MIB counters when replicast started, and as last sampled.
+ */
+struct udp_mib_samples {
+	pthread_t thread;
+	unsigned int inet_ok;
+	unsigned int inet6_ok;
+	struct udp_mib inet_start;
+	struct udp_mib inet6_start;
+	struct udp_mib inet;
+	struct udp_mib inet6;
+};
+
+/*
+ * The -shmstats file, and the packet counters published in it by name.
+ */
+struct shm_stats_publisher {
+	pthread_t thread;
+	struct shm_stats stats;
+	unsigned int latency_hist;
+	unsigned int rates;
+};
+
+struct shm_stats_field {
+	const char *name;
+	size_t offset;
+	unsigned int gauge;
+};
+
+/*
+ * The -metrics listener, serving the counters to one client at a time.
+ */
+struct metrics_server {
+	pthread_t thread;
+	int listen_fd;
+	unsigned int latency_hist;
+	unsigned int rates;
+};
+
+enum METRICS_DEST_STAT {
+	METRICS_DEST_PKTS,
+	METRICS_DEST_BYTES,
+	METRICS_DEST_ERRS,
+	METRICS_DEST_LATENCY,
+	METRICS_DEST_LATENCY_MAX,
+};
+
+/*
+ * The -rates reporter, woken every interval by its timer, with the totals
+ * at its last tick, and the rates per second over the interval and
+ * smoothed over those before.
+ */
+enum RATE_STAT {
+	RATE_RX_PKTS,
+	RATE_RX_BITS,
+	RATE_TX_PKTS,
+	RATE_TX_BITS,
+	RATE_STATS,
+};
+
+struct rate_reporter {
+	pthread_t thread;
+	int timer_fd;
+	unsigned long long tick_nsecs;
+	unsigned long long totals[RATE_STATS];
+	unsigned long long rates[RATE_STATS];
+	unsigned long long ewma_rates[RATE_STATS];
+	unsigned int ticks;
+};
+
+/*
+ * A flow given in the -flows file, with the mode and socket parameters its
+ * line selected.
+ */
+struct flow_params {
+	enum REPLICAST_MODE rc_mode;
+	unsigned int line;
+	struct inet_rx_sock_params inet_rx_sock_parms;
+	struct inet_tx_sock_params inet_tx_sock_parms;
+	struct inet6_rx_sock_params inet6_rx_sock_parms;
+	struct inet6_tx_sock_params inet6_tx_sock_parms;
 };
 
+/*
+ * What the flows engine touches for each flow it forwards, on cache lines
+ * of its own so neighbouring flows don't share them.
+ */
+struct flow {
+	int rx_sock_fd;
+	int inet_out_sock_fd;
+	int inet6_out_sock_fd;
+	struct tx_dests *inet_tx_dests;
+	struct tx_dests *inet6_tx_dests;
+	unsigned long long in_pkts;
+	unsigned long long in_drops;
+	unsigned long long inet_out_pkts;
+	unsigned long long inet6_out_pkts;
+} __attribute__((aligned(CACHE_LINE)));
+
 struct program_options {
 	unsigned int help_set;
 	unsigned int license_set;
@@ -163,6 +754,77 @@ struct program_options {
 
 	unsigned int no_daemon_set;
 
+	unsigned int engine_set;
+	char *engine_str;
+
+	unsigned int workers_set;
+	char *workers_str;
+
+	unsigned int flows_set;
+	char *flows_str;
+
+	unsigned int shm_stats_set;
+	char *shm_stats_str;
+
+	unsigned int metrics_set;
+	char *metrics_str;
+
+	unsigned int rates_set;
+	char *rates_str;
+
+	unsigned int rx_cpus_set;
+	char *rx_cpus_str;
+	unsigned int tx_cpus_set;
+	char *tx_cpus_str;
+	unsigned int rt_prio_set;
+	char *rt_prio_str;
+	unsigned int mem_lock_set;
+
+	unsigned int tx_backlog_set;
+	char *tx_backlog_str;
+
+	unsigned int tx_rate_set;
+	char *tx_rate_str;
+	unsigned int tx_dest_rate_set;
+	char *tx_dest_rate_str;
+	unsigned int tx_rate_policy_set;
+	char *tx_rate_policy_str;
+
+	unsigned int tx_pace_set;
+	char *tx_pace_str;
+	unsigned int tx_pace_mode_set;
+	char *tx_pace_mode_str;
+
+	unsigned int rx_batch_size_set;
+	char *rx_batch_size_str;
+	unsigned int rx_batch_wait_set;
+	char *rx_batch_wait_str;
+	unsigned int rx_udp_gro_set;
+
+	unsigned int rx_busy_poll_set;
+	char *rx_busy_poll_str;
+	unsigned int rx_busy_idle_set;
+	char *rx_busy_idle_str;
+	unsigned int rx_latency_set;
+
+	unsigned int rx_buf_set;
+	char *rx_buf_str;
+	unsigned int rx_buf_max_set;
+	char *rx_buf_max_str;
+	unsigned int tx_buf_set;
+	char *tx_buf_str;
+
+	unsigned int rx_xdp_intf_set;
+	char *rx_xdp_intf_str;
+	unsigned int rx_xdp_queue_set;
+	char *rx_xdp_queue_str;
+	unsigned int rx_xdp_skb_set;
+
+	unsigned int rx_pkt_ring_intf_set;
+	char *rx_pkt_ring_intf_str;
+	unsigned int rx_pkt_ring_tov_set;
+	char *rx_pkt_ring_tov_str;
+
 	unsigned int inet_rx_sock_mcgroup_set;
 	char *inet_rx_sock_mcgroup_str;
 
@@ -173,6 +835,11 @@ struct program_options {
 	char *inet_tx_sock_out_intf_str;
 	unsigned int inet_tx_sock_dests_set;
 	char *inet_tx_sock_dests_str;
+	unsigned int inet_tx_sock_udp_gso_set;
+	unsigned int inet_tx_sock_zerocopy_set;
+	unsigned int inet_tx_sock_connect_set;
+	unsigned int inet_tx_sock_rate_set;
+	char *inet_tx_sock_rate_str;
 
 	unsigned int inet6_rx_sock_mcgroup_set;
 	char *inet6_rx_sock_mcgroup_str;
@@ -184,16 +851,40 @@ struct program_options {
 	char *inet6_tx_sock_out_intf_str;
 	unsigned int inet6_tx_sock_dests_set;
 	char *inet6_tx_sock_dests_str;
+	unsigned int inet6_tx_sock_udp_gso_set;
+	unsigned int inet6_tx_sock_zerocopy_set;
+	unsigned int inet6_tx_sock_connect_set;
+	unsigned int inet6_tx_sock_rate_set;
+	char *inet6_tx_sock_rate_str;
 };
 
 
 struct program_parameters {
 	enum REPLICAST_MODE rc_mode;
 	unsigned int become_daemon;
+	enum RCAST_ENGINE engine;
+	unsigned int workers_num;
+	unsigned int tx_rate;
+	unsigned int tx_rate_queue;
+	int rx_cpus[RT_CPUS_MAX];
+	unsigned int rx_cpus_num;
+	int tx_cpus[RT_CPUS_MAX];
+	unsigned int tx_cpus_num;
+	unsigned int rt_prio;
+	unsigned int mem_lock;
+	struct rx_batch_params rx_batch_parms;
 	struct inet_rx_sock_params inet_rx_sock_parms;
 	struct inet_tx_sock_params inet_tx_sock_parms;
 	struct inet6_rx_sock_params inet6_rx_sock_parms;
 	struct inet6_tx_sock_params inet6_tx_sock_parms;
+	const char *flows_file;
+	struct flow_params *flows;
+	unsigned int flows_num;
+	const char *shm_stats_file;
+	const char *metrics_addr_str;
+	struct sockaddr_storage metrics_addr;
+	socklen_t metrics_addr_len;
+	unsigned int rates_interval;
 };
 
 
@@ -227,10 +918,52 @@ int validate_prog_opts_values(const struct program_options *prog_opts,
 			      char *err_str_parm,
 			      const unsigned int err_str_size);
 
+int get_flows(struct program_parameters *prog_parms,
+	      char err_str[],
+	      const unsigned int err_str_size);
+
+int get_flow(int argc, char *argv[],
+	     const struct program_parameters *prog_parms,
+	     struct flow_params *flow_parms,
+	     char err_str[],
+	     const unsigned int err_str_size);
+
+int flow_opts_valid(const struct program_options *flow_opts);
+
 void log_prog_banner(void);
 
 void log_prog_parms(const struct program_parameters *prog_parms);
 
+void log_sock_parms(const enum REPLICAST_MODE rc_mode,
+		    const struct inet_rx_sock_params *inet_rx_sock_parms,
+		    const struct inet_tx_sock_params *inet_tx_sock_parms,
+		    const struct inet6_rx_sock_params *inet6_rx_sock_parms,
+		    const struct inet6_tx_sock_params *inet6_tx_sock_parms);
+
+void log_flows_parms(const struct program_parameters *prog_parms);
+
+void log_rx_batch_parms(const struct rx_batch_params *rx_batch_parms);
+
+void log_engine_parms(const enum RCAST_ENGINE engine);
+
+void log_workers_parms(const unsigned int workers_num);
+
+void log_shm_stats_parms(const char *shm_stats_file);
+
+void log_metrics_parms(const char *metrics_addr_str);
+
+void log_rates_parms(const unsigned int rates_interval);
+
+void log_tx_rate_parms(const struct program_parameters *prog_parms);
+
+void log_cpu_list(const char *name_str,
+		  const int cpus[],
+		  const unsigned int cpus_num);
+
+void log_rt_parms(const struct program_parameters *prog_parms);
+
+void log_sock_buf_parms(const struct program_parameters *prog_parms);
+
 void log_inet_rx_sock_parms(const struct inet_rx_sock_params *inet_rx_parms);
 
 void log_inet6_rx_sock_parms(const struct inet6_rx_sock_params *inet6_rx_parms);
@@ -246,49 +979,117 @@ void cleanup_prog_parms(struct program_parameters *prog_parms);
 
 void init_sock_fds(struct socket_fds *sock_fds);
 
-void inet_to_inet_rcast(int *inet_in_sock_fd,
-			const struct inet_rx_sock_params *rx_sock_parms,
-			int *inet_out_sock_fd,
-			const struct inet_tx_sock_params *tx_sock_parms,
-			struct packet_counters *pkt_counters);
+int parse_cpu_list(const char *cpu_list_str,
+		   int cpus[],
+		   unsigned int *cpus_num);
 
-void inet_to_inet6_rcast(int *inet_in_sock_fd,
-			 const struct inet_rx_sock_params *rx_sock_parms,
-			 int *inet6_out_sock_fd,
-			 const struct inet6_tx_sock_params *tx_sock_parms,
-			 struct packet_counters *pkt_counters);
+void rt_prefault_stack(void);
 
-void inet_to_inet_inet6_rcast(int *inet_in_sock_fd,
-			      const struct inet_rx_sock_params *rx_sock_parms,
-			      int *inet_out_sock_fd,
-			      const struct inet_tx_sock_params
-							*inet_tx_sock_parms,
-			      int *inet6_out_sock_fd,
-			      const struct inet6_tx_sock_params
-							*inet6_tx_sock_parms,
-			      struct packet_counters *pkt_counters);
+void rt_setup(const struct program_parameters *prog_parms);
 
-void inet6_to_inet6_rcast(int *inet6_in_sock_fd,
-			  const struct inet6_rx_sock_params *rx_sock_parms,
-			  int *inet6_out_sock_fd,
-			  const struct inet6_tx_sock_params *tx_sock_parms,
-			  struct packet_counters *pkt_counters);
+int rt_cpu(const int cpus[],
+	   const unsigned int cpus_num,
+	   const unsigned int thread_idx);
 
-void inet6_to_inet_rcast(int *inet6_in_sock_fd,
-			 const struct inet6_rx_sock_params *rx_sock_parms,
-			 int *inet_out_sock_fd,
-			 const struct inet_tx_sock_params *tx_sock_parms,
-			 struct packet_counters *pkt_counters);
+void rt_thread_setup(const pthread_t thread,
+		     const char *name_str,
+		     const int cpu,
+		     const unsigned int prio);
 
-void inet6_to_inet_inet6_rcast(int *inet6_in_sock_fd,
-			       const struct inet6_rx_sock_params *rx_sock_parms,
-			       int *inet_out_sock_fd,
-			       const struct inet_tx_sock_params
-							*inet_tx_sock_parms,
-			       int *inet6_out_sock_fd,
-			       const struct inet6_tx_sock_params
-							*inet6_tx_sock_parms,
-			       struct packet_counters *pkt_counters);
+void start_workers(const struct program_parameters *prog_parms);
+
+void *worker_thread(void *arg);
+
+void start_udp_mib_sampler(void);
+
+void *udp_mib_sampler_thread(void *arg);
+
+void start_shm_stats(const struct program_parameters *prog_parms);
+
+void *shm_stats_thread(void *arg);
+
+void publish_shm_stats(void);
+
+void publish_shm_stats_dests(const char *name_str,
+			     const struct tx_dests *tx_dests,
+			     unsigned int *dests_num);
+
+void close_shm_stats(void);
+
+int parse_metrics_addr(const char *addr_str,
+		       struct sockaddr_storage *addr,
+		       socklen_t *addr_len);
+
+void start_metrics(const struct program_parameters *prog_parms);
+
+void *metrics_thread(void *arg);
+
+void serve_metrics(const int conn_fd);
+
+int metrics_send(const int conn_fd,
+		 const char *buf,
+		 size_t len);
+
+void write_metrics(FILE *out);
+
+void write_metrics_dests(FILE *out,
+			 const enum METRICS_DEST_STAT stat);
+
+void write_metrics_tx_latency(FILE *out);
+
+void write_metrics_rates(FILE *out);
+
+void write_metrics_latency(FILE *out,
+			   const char *metric_str,
+			   const char *labels_str,
+			   const struct latency_hist *hist);
+
+void write_metrics_tx_dests(FILE *out,
+			    const enum METRICS_DEST_STAT stat,
+			    const char *labels_str,
+			    const struct tx_dests *tx_dests);
+
+void close_metrics(void);
+
+void start_rates(const struct program_parameters *prog_parms);
+
+void *rates_thread(void *arg);
+
+void update_rates(const unsigned long long tick_nsecs);
+
+void sum_rate_totals(unsigned long long totals[]);
+
+void sum_rate_tx_dests(unsigned long long totals[],
+		       const struct tx_dests *tx_dests);
+
+void log_rates(void);
+
+void rcast(const enum REPLICAST_MODE rc_mode,
+	   struct socket_fds *sock_fds,
+	   const struct inet_rx_sock_params *inet_rx_sock_parms,
+	   const struct inet6_rx_sock_params *inet6_rx_sock_parms,
+	   struct packet_counters *pkt_counters);
+
+const struct rcast_mode *find_rcast_mode(const enum REPLICAST_MODE rc_mode);
+
+void rcast_loop(const struct rcast_mode *mode,
+		struct socket_fds *sock_fds,
+		const struct inet_rx_sock_params *inet_rx_sock_parms,
+		const struct inet6_rx_sock_params *inet6_rx_sock_parms,
+		const struct rx_batch_params *rx_batch_parms,
+		const enum RCAST_ENGINE engine,
+		const struct inet_tx_sock_params *inet_tx_sock_parms,
+		const struct inet6_tx_sock_params *inet6_tx_sock_parms,
+		struct packet_counters *pkt_counters);
+
+int open_flow(struct flow *flow,
+	      const struct flow_params *flow_parms);
+
+void flows_rcast(const struct flow_params flow_parms[],
+		 const unsigned int flows_num,
+		 const struct rx_batch_params *rx_batch_parms,
+		 const unsigned int udp_gro,
+		 struct packet_counters *pkt_counters);
 
 void exit_errno(const char *func_name, const unsigned int linenum, int errnum);
 
@@ -334,6 +1135,20 @@ int open_inet6_rx_sock(const struct inet6_rx_sock_params *sock_parms);
 
 void close_inet6_rx_sock(const int sock_fd);
 
+int rx_sock_worker_filter(const int sock_fd,
+			  const int family,
+			  const unsigned int worker_idx,
+			  const unsigned int workers_num);
+
+int sock_buf_get(const int sock_fd,
+		 const int optname);
+
+int sock_buf_set(const int sock_fd,
+		 const int optname,
+		 const unsigned int size,
+		 const char *sock_str,
+		 const char *reason_str);
+
 int open_inet_tx_sock(const struct inet_tx_sock_params *sock_parms);
 
 void close_inet_tx_sock(int sock_fd);
@@ -342,27 +1157,452 @@ int open_inet6_tx_sock(const struct inet6_tx_sock_params *sock_parms);
 
 void close_inet6_tx_sock(int sock_fd);
 
-int inet_tx_rcast(const int sock_fd,
-		  const void *pkt,
-		  const size_t pkt_len,
- 		  const struct sockaddr_in inet_dests[]);
+int open_inet_tx_conn_socks(const struct inet_tx_sock_params *sock_parms,
+			    int conn_fds[]);
+
+int open_inet6_tx_conn_socks(const struct inet6_tx_sock_params *sock_parms,
+			     int conn_fds[]);
+
+void close_xdp_sock(const int sock_fd);
+
+int udp_gso_probe(const int sock_fd);
+
+int tx_zerocopy_enable(const int sock_fd);
+
+int tx_txtime_enable(const int sock_fd,
+		     const int conn_fds[],
+		     const unsigned int conn_fds_num,
+		     const enum TX_PACE_MODE pace_mode);
+
+int init_tx_dests(struct tx_dests *tx_dests,
+		  const void *dests,
+		  const socklen_t dest_len,
+		  const unsigned int dests_num,
+		  const unsigned int udp_gso,
+		  const unsigned int zerocopy,
+		  int *conn_fds);
+
+int init_inet_tx_dests(struct tx_dests *tx_dests,
+		       const int sock_fd,
+		       const struct inet_tx_sock_params *sock_parms);
+
+int init_inet6_tx_dests(struct tx_dests *tx_dests,
+			const int sock_fd,
+			const struct inet6_tx_sock_params *sock_parms);
+
+int tx_sendmmsg(const int sock_fd,
+		struct mmsghdr mmsgs[],
+		const unsigned int mmsgs_num,
+		const int flags,
+		struct tx_dests *tx_dests,
+		struct packet_counters *pkt_counters);
+
+unsigned int tx_mmsgs_send(const int sock_fd,
+			   struct mmsghdr mmsgs[],
+			   const unsigned int dest_nums[],
+			   const unsigned int mmsgs_num,
+			   const int flags,
+			   struct tx_dests *tx_dests,
+			   struct packet_counters *pkt_counters);
+
+void tx_mmsgs_sent(struct tx_dests *tx_dests,
+		   const struct mmsghdr mmsgs[],
+		   const unsigned int dest_nums[],
+		   const unsigned int mmsg_num,
+		   const unsigned int sent_num,
+		   const unsigned int pkts);
+
+void tx_dest_sent(struct tx_dests *tx_dests,
+		  const unsigned int dest_num,
+		  const unsigned int pkts,
+		  const unsigned long long bytes);
+
+void tx_dest_failed(struct tx_dests *tx_dests,
+		    const unsigned int dest_num,
+		    const int err);
+
+unsigned long long mmsgs_len(const struct mmsghdr mmsgs[],
+			     const unsigned int mmsgs_num);
+
+void tx_zerocopy_reap(const int sock_fd,
+		      struct tx_dests *tx_dests,
+		      struct packet_counters *pkt_counters);
+
+void tx_zerocopy_wait(const int sock_fd,
+		      struct tx_dests *tx_dests,
+		      const unsigned long long zc_mark,
+		      struct packet_counters *pkt_counters);
+
+unsigned int tx_dest_pkts_send(const int sock_fd,
+			       const struct msghdr *dest_msg,
+			       const struct iovec pkts[],
+			       const unsigned int pkts_num,
+			       struct tx_dests *tx_dests,
+			       const unsigned int dest_num);
+
+unsigned int tx_conn_dests_rcast(struct iovec pkts[],
+				 const unsigned int pkts_num,
+				 struct tx_dests *tx_dests);
+
+int init_tx_backlogs(struct tx_dests *tx_dests,
+		     const int sock_fd,
+		     const unsigned int backlog_size);
+
+void tx_backlog_arm(const struct tx_dests *tx_dests,
+		    const int sock_fd,
+		    const uint32_t sock_idx,
+		    const uint32_t events);
+
+void tx_backlog_park(struct tx_dests *tx_dests,
+		     struct tx_backlog *backlog,
+		     const struct iovec *pkt,
+		     struct packet_counters *pkt_counters);
+
+unsigned int tx_backlog_send(struct tx_dests *tx_dests,
+			     struct tx_backlog *backlog,
+			     const unsigned int pkts_max,
+			     unsigned int *blocked,
+			     struct packet_counters *pkt_counters);
+
+unsigned int tx_backlog_rcast(const int sock_fd,
+			      struct iovec pkts[],
+			      const unsigned int pkts_num,
+			      struct tx_dests *tx_dests,
+			      struct packet_counters *pkt_counters);
+
+unsigned int tx_backlogs_drain(struct tx_dests *tx_dests,
+			       struct packet_counters *pkt_counters);
+
+void tx_backlogs_wait(const int sock_fd,
+		      const struct rx_batch *rx_batch,
+		      struct tx_dests *inet_tx_dests,
+		      struct tx_dests *inet6_tx_dests,
+		      struct packet_counters *pkt_counters);
+
+void init_tx_rate_bucket(struct tx_rate_bucket *bucket,
+			 const unsigned int rate_kbps);
+
+void init_tx_pace(struct tx_dests *tx_dests,
+		  const unsigned int pace_rate,
+		  const unsigned int pace_input,
+		  const enum TX_PACE_MODE pace_mode);
+
+unsigned int tx_pace_departure(struct tx_dests *tx_dests,
+			       const struct iovec *pkt,
+			       const unsigned long long rx_nsecs,
+			       unsigned long long *departure_nsecs);
+
+unsigned int tx_pace_rcast(const int sock_fd,
+			   struct iovec pkts[],
+			   const unsigned int pkts_num,
+			   struct tx_dests *tx_dests,
+			   struct packet_counters *pkt_counters);
+
+int init_tx_rate(struct tx_dests *tx_dests,
+		 const unsigned int intf_rate,
+		 const unsigned int dest_rate,
+		 const unsigned int rate_queue);
+
+void tx_rate_bucket_refill(struct tx_rate_bucket *bucket,
+			   const unsigned long long now_nsecs);
+
+void tx_rate_clock(struct tx_dests *tx_dests);
+
+unsigned int tx_rate_conforms(struct tx_dests *tx_dests,
+			      const unsigned int dest_idx,
+			      const size_t pkt_len,
+			      const unsigned int count_exceed);
+
+unsigned int tx_rate_dests(struct tx_dests *tx_dests,
+			   const struct iovec *pkt);
+
+void tx_rate_timer_arm(struct tx_dests *tx_dests);
+
+int tx_pkt_send_flags(const struct tx_dests *tx_dests,
+		      const struct iovec *pkt);
+
+unsigned int udp_gso_run_len(const struct iovec pkts[],
+			     const unsigned int pkts_num);
+
+unsigned int tx_dests_gso_rcast(const int sock_fd,
+				struct iovec pkts[],
+				const unsigned int pkts_num,
+				struct tx_dests *tx_dests,
+				struct packet_counters *pkt_counters);
+
+int tx_dests_rcast(const int sock_fd,
+		   struct iovec pkts[],
+		   const unsigned int pkts_num,
+		   struct tx_dests *tx_dests,
+		   struct packet_counters *pkt_counters);
+
+int init_rx_batch(struct rx_batch *rx_batch,
+		  const int sock_fd,
+		  const struct rx_batch_params *rx_batch_parms,
+		  const unsigned int udp_gro);
+
+unsigned int rx_batch_split_gro(struct rx_batch *rx_batch,
+				const unsigned int rx_msgs,
+				struct packet_counters *pkt_counters);
+
+int rx_batch_inet_xsk_open(struct rx_batch *rx_batch,
+			   const struct inet_rx_sock_params *sock_parms,
+			   int *xdp_sock_fd);
+
+int rx_batch_inet6_xsk_open(struct rx_batch *rx_batch,
+			    const struct inet6_rx_sock_params *sock_parms,
+			    int *xdp_sock_fd);
+
+int rx_batch_xsk_open(struct rx_batch *rx_batch,
+		      const unsigned int xdp_intf_idx,
+		      const unsigned int xdp_queue,
+		      const unsigned int xdp_skb_mode,
+		      const int family,
+		      const void *dst_addr,
+		      const unsigned int dst_port,
+		      int *xdp_sock_fd);
+
+int rx_batch_inet_pkt_ring_open(struct rx_batch *rx_batch,
+				const struct inet_rx_sock_params *sock_parms,
+				const int sock_fd);
+
+int rx_batch_inet6_pkt_ring_open(struct rx_batch *rx_batch,
+				 const struct inet6_rx_sock_params *sock_parms,
+				 const int sock_fd);
+
+int rx_batch_pkt_ring_open(struct rx_batch *rx_batch,
+			   const unsigned int pkt_ring_intf_idx,
+			   const unsigned int pkt_ring_block_tov,
+			   const int family,
+			   const void *dst_addr,
+			   const unsigned int dst_port,
+			   const int sock_fd);
+
+int rx_batch_pkts_resize(struct rx_batch *rx_batch,
+			 const unsigned int pkts_num);
+
+int rx_batch_recv(const int sock_fd,
+		  struct rx_batch *rx_batch,
+		  struct packet_counters *pkt_counters);
+
+int rx_batch_zc_add(struct rx_batch *rx_batch,
+		    const int sock_fd,
+		    struct tx_dests *tx_dests);
+
+void rx_batch_zc_rotate(struct rx_batch *rx_batch,
+			struct packet_counters *pkt_counters);
+
+int rx_batch_sock_recv(const int sock_fd,
+		       struct rx_batch *rx_batch,
+		       struct packet_counters *pkt_counters);
+
+int rx_busy_poll_enable(const int sock_fd,
+			const unsigned int busy_poll_usec);
+
+void rx_batch_busy_update(struct rx_batch *rx_batch,
+			  const unsigned int rx_ok,
+			  struct packet_counters *pkt_counters);
+
+int rx_sock_drops(const int sock_fd,
+		  uint32_t *drops);
+
+void rx_batch_buf_tune(const int sock_fd,
+		       struct rx_batch *rx_batch,
+		       struct packet_counters *pkt_counters);
+
+void rx_batch_tstamps(struct rx_batch *rx_batch,
+		      const unsigned int rx_msgs);
+
+void rx_batch_drops(struct rx_batch *rx_batch,
+		    const unsigned int rx_msgs);
+
+unsigned int rx_latency_bucket(const unsigned long long nsecs);
+
+unsigned long long rx_latency_bucket_max(const unsigned int bucket);
+
+void latency_hist_add(struct latency_hist *hist,
+		      const unsigned long long nsecs,
+		      const unsigned int pkts);
+
+void latency_hist_sum(struct latency_hist *total_hist,
+		      const struct latency_hist *hist);
+
+unsigned long long latency_hist_percentile(const struct latency_hist *hist,
+					   const double percentile);
+
+void rx_batch_latency(const struct rx_batch *rx_batch,
+		      const unsigned int pkts_num,
+		      struct packet_counters *pkt_counters);
+
+int init_tx_latency(struct tx_dests *tx_dests,
+		    const unsigned long long *rx_nsecs);
+
+void tx_dests_latency(struct tx_dests *tx_dests,
+		      const unsigned int dest_nums[],
+		      const unsigned int dest_num,
+		      const unsigned int sent_num,
+		      const unsigned long long rx_nsecs[],
+		      const unsigned int pkts);
 
-int inet6_tx_rcast(const int sock_fd,
-		   const void *pkt,
-		   const size_t pkt_len,
- 		   const struct sockaddr_in6 inet6_dests[]);
+void tx_family_latency(struct tx_dests *tx_dests,
+		       const unsigned long long rx_nsecs,
+		       const unsigned int pkts);
+
+void tx_conn_dest_latency(struct tx_dests *tx_dests,
+			  const unsigned int dest_num,
+			  const struct iovec pkts[],
+			  const struct mmsghdr mmsgs[],
+			  const unsigned int sent_num);
+
+unsigned long long rx_tstamp_nsecs(const struct timespec *rx_tstamp);
+
+int rx_batch_xsk_recv(const int sock_fd,
+		      struct rx_batch *rx_batch,
+		      struct packet_counters *pkt_counters);
+
+int rx_batch_pkt_ring_recv(struct rx_batch *rx_batch,
+			   struct packet_counters *pkt_counters);
+
+void update_pkt_ring_counters(const struct pktring *pkt_ring,
+			      struct packet_counters *pkt_counters);
+
+int uring_rcast(const int rx_sock_fd,
+		unsigned long long *in_pkts,
+		const struct uring_tx_leg tx_legs[],
+		const unsigned int tx_legs_num,
+		struct packet_counters *pkt_counters);
+
+void uring_submit(struct uring *ring,
+		  const unsigned int wait_nr,
+		  struct packet_counters *pkt_counters);
+
+void uring_dests_send(struct uring *ring,
+		      const struct uring_tx_leg *tx_leg,
+		      const unsigned int leg,
+		      void *pkt,
+		      const unsigned int pkt_len,
+		      const unsigned short bid,
+		      struct packet_counters *pkt_counters);
+
+int uring_recv_arm(struct uring *ring,
+		   const int rx_sock_fd);
+
+void pipe_rcast(const int rx_sock_fd,
+		struct rx_batch *rx_batch,
+		unsigned long long *in_pkts,
+		unsigned long long *in_drops,
+		struct pipe_tx_leg tx_legs[],
+		struct packet_counters *pkt_counters);
+
+void pipe_tx_legs_start(struct pipe_tx_leg tx_legs[],
+			const uint8_t *buf);
+
+void pipe_pkt_push(const struct iovec *pkt,
+		   uint8_t *buf,
+		   unsigned long long *buf_head,
+		   struct pipe_tx_leg tx_legs[],
+		   struct packet_counters *pkt_counters);
+
+void *pipe_tx_thread(void *arg);
 
 void close_sockets(const struct socket_fds *sock_fds);
 
+void close_flows(void);
+
+void sum_packet_counters(struct packet_counters *total_counters);
+
+void add_packet_counters(struct packet_counters *total_counters,
+			 const struct packet_counters *pkt_counters);
+
 void log_packet_counters(const enum REPLICAST_MODE rc_mode,
 			 const struct packet_counters *pkt_counters);
 
+void log_rx_batch_counters(const struct packet_counters *pkt_counters);
+
+void log_rx_busy_counters(const struct packet_counters *pkt_counters);
+
+void log_rx_buf_counters(const struct packet_counters *pkt_counters);
+
+void log_udp_mib_counters(const enum REPLICAST_MODE rc_mode);
+
+void log_flow_counters(void);
+
+void log_rx_latency_counters(const struct packet_counters *pkt_counters);
+
+void log_latency_hist(const char *name_str,
+		      const struct latency_hist *hist);
+
+void log_tx_latency(const struct packet_counters *pkt_counters);
+
+void sum_tx_latency(struct latency_hist *total_hist,
+		    const struct tx_dests *tx_dests);
+
+void log_tx_gso_counters(const struct packet_counters *pkt_counters);
+
+void log_tx_zerocopy_counters(const struct packet_counters *pkt_counters);
+
+void log_uring_counters(const struct packet_counters *pkt_counters);
+
+void update_xdp_counters(const int xdp_sock_fd,
+			 struct packet_counters *pkt_counters);
+
+void log_xdp_counters(const struct packet_counters *pkt_counters);
+
+void log_pkt_ring_counters(const struct packet_counters *pkt_counters);
+
+void log_pipe_counters(const struct packet_counters *pkt_counters);
+
+void log_tx_backlog_counters(const struct packet_counters *pkt_counters);
+
+void log_tx_pace_counters(const struct packet_counters *pkt_counters);
+
+void log_tx_backlog_dests(const char *family_str,
+			  const struct tx_dests *tx_dests);
+
+void log_tx_backlogs(const struct packet_counters *pkt_counters);
+
+void log_tx_rate_bucket(const char *name_str,
+			const struct tx_rate_bucket *bucket);
+
+void log_tx_rate_dests(const char *family_str,
+		       const struct tx_dests *tx_dests);
+
+void log_tx_rates(const struct packet_counters *pkt_counters);
+
+void tx_dest_str(const struct tx_dests *tx_dests,
+		 const unsigned int dest_num,
+		 char *dest_str,
+		 const size_t dest_str_size);
+
+void log_tx_dest_stats(const char *name_str,
+		       const struct tx_dests *tx_dests);
+
+void log_tx_dests_stats(const struct packet_counters *pkt_counters);
+
 void exit_program(void);
 
 struct socket_fds sock_fds;
 
 struct program_parameters prog_parms;
 
+/*
+ * The CPU affinity and scheduling each thread actually got, and whether
+ * memory is locked, for logging with the program parameters.
+ */
+struct rt_thread_state {
+	char name[16];
+	int cpu;
+	unsigned int prio;
+};
+
+struct rt_state {
+	unsigned int mem_locked;
+	struct rt_thread_state threads[RT_THREADS_MAX];
+	unsigned int threads_num;
+};
+
+struct rt_state rt_state;
+
 const float replicast_version = 0.1;
 const char *program_name = "replicast";
 
@@ -376,6 +1616,152 @@ struct sigaction sigusr2_action;
 
 struct packet_counters pkt_counters;
 
+struct worker *workers = NULL;
+
+struct flow *flows = NULL;
+
+const int tx_dest_errnos[TX_DEST_ERR_OTHER] = {
+	[TX_DEST_ERR_CONNREFUSED] = ECONNREFUSED,
+	[TX_DEST_ERR_HOSTUNREACH] = EHOSTUNREACH,
+	[TX_DEST_ERR_NETUNREACH] = ENETUNREACH,
+	[TX_DEST_ERR_MSGSIZE] = EMSGSIZE,
+	[TX_DEST_ERR_NOBUFS] = ENOBUFS,
+};
+
+const char *tx_dest_err_strs[TX_DEST_ERRS] = {
+	[TX_DEST_ERR_CONNREFUSED] = "econnrefused",
+	[TX_DEST_ERR_HOSTUNREACH] = "ehostunreach",
+	[TX_DEST_ERR_NETUNREACH] = "enetunreach",
+	[TX_DEST_ERR_MSGSIZE] = "emsgsize",
+	[TX_DEST_ERR_NOBUFS] = "enobufs",
+	[TX_DEST_ERR_OTHER] = "other",
+};
+
+const struct rcast_mode rcast_modes[] = {
+	{ RCMODE_INET_TO_INET, AF_INET, 1, 0 },
+	{ RCMODE_INET_TO_INET6, AF_INET, 0, 1 },
+	{ RCMODE_INET_TO_INET_INET6, AF_INET, 1, 1 },
+	{ RCMODE_INET6_TO_INET6, AF_INET6, 0, 1 },
+	{ RCMODE_INET6_TO_INET, AF_INET6, 1, 0 },
+	{ RCMODE_INET6_TO_INET_INET6, AF_INET6, 1, 1 },
+};
+
+struct packet_counters pipe_tx_counters[PIPE_TX_LEGS];
+
+struct tx_rate_bucket tx_rate_global;
+
+struct udp_mib_samples udp_mibs;
+
+struct shm_stats_publisher shm_stats_pub;
+
+struct metrics_server metrics_srv = { .listen_fd = -1 };
+
+struct rate_reporter rate_rep = { .timer_fd = -1 };
+
+#define SHM_STATS_FIELD(field)	\
+		{ #field, offsetof(struct packet_counters, field), 0 }
+#define SHM_STATS_GAUGE(field)	\
+		{ #field, offsetof(struct packet_counters, field), 1 }
+
+const struct shm_stats_field shm_stats_fields[] = {
+	SHM_STATS_FIELD(inet_in_pkts),
+	SHM_STATS_FIELD(inet6_in_pkts),
+	SHM_STATS_FIELD(inet_in_drops),
+	SHM_STATS_FIELD(inet6_in_drops),
+	SHM_STATS_FIELD(inet_out_pkts),
+	SHM_STATS_FIELD(inet6_out_pkts),
+	SHM_STATS_FIELD(rx_batches),
+	SHM_STATS_FIELD(rx_batch_pkts),
+	SHM_STATS_FIELD(rx_batches_full),
+	SHM_STATS_FIELD(rx_busy_polls),
+	SHM_STATS_FIELD(rx_busy_empty),
+	SHM_STATS_FIELD(rx_busy_backoffs),
+	SHM_STATS_FIELD(rx_buf_drops),
+	SHM_STATS_FIELD(rx_buf_grows),
+	SHM_STATS_FIELD(rx_bytes),
+	{ "rx_latency_pkts", offsetof(struct packet_counters,
+							rx_latency.pkts), 0 },
+	{ "rx_latency_max", offsetof(struct packet_counters,
+							rx_latency.max), 1 },
+	SHM_STATS_FIELD(rx_gro_bufs),
+	SHM_STATS_FIELD(rx_gro_segs),
+	SHM_STATS_FIELD(tx_gso_sends),
+	SHM_STATS_FIELD(tx_gso_segs),
+	SHM_STATS_FIELD(tx_zc_sends),
+	SHM_STATS_FIELD(tx_zc_hits),
+	SHM_STATS_FIELD(tx_zc_fallbacks),
+	SHM_STATS_FIELD(tx_zc_timeouts),
+	SHM_STATS_FIELD(uring_enters),
+	SHM_STATS_FIELD(uring_sqes),
+	SHM_STATS_FIELD(uring_cqes),
+	SHM_STATS_FIELD(uring_recv_errs),
+	SHM_STATS_FIELD(xdp_rx_pkts),
+	SHM_STATS_FIELD(xdp_rx_polls),
+	SHM_STATS_FIELD(xdp_stack_pkts),
+	SHM_STATS_FIELD(xdp_ring_full),
+	SHM_STATS_FIELD(xdp_fill_empty),
+	SHM_STATS_FIELD(xdp_dropped),
+	SHM_STATS_FIELD(pkt_ring_pkts),
+	SHM_STATS_FIELD(pkt_ring_blocks),
+	SHM_STATS_FIELD(pkt_ring_kernel_pkts),
+	SHM_STATS_FIELD(pkt_ring_drops),
+	SHM_STATS_FIELD(pkt_ring_freezes),
+	{ "pipe_inet_ring_hwm", offsetof(struct packet_counters,
+							pipe_ring_hwm[0]), 1 },
+	{ "pipe_inet6_ring_hwm", offsetof(struct packet_counters,
+							pipe_ring_hwm[1]), 1 },
+	{ "pipe_inet_ring_full", offsetof(struct packet_counters,
+							pipe_ring_full[0]), 0 },
+	{ "pipe_inet6_ring_full", offsetof(struct packet_counters,
+							pipe_ring_full[1]), 0 },
+	SHM_STATS_FIELD(pipe_buf_full),
+	SHM_STATS_FIELD(tx_backlog_queued),
+	SHM_STATS_FIELD(tx_backlog_drops),
+	SHM_STATS_FIELD(tx_paced),
+	SHM_STATS_FIELD(tx_pace_drops),
+};
+
+#define SHM_STATS_FIELDS_NUM	(sizeof(shm_stats_fields) / \
+						sizeof(shm_stats_fields[0]))
+
+/* the UDP MIB counters follow the packet counters */
+const char *shm_stats_udp_mib_strs[] = {
+	"inet_udp_rcvbuf_errors",
+	"inet_udp_sndbuf_errors",
+	"inet6_udp_rcvbuf_errors",
+	"inet6_udp_sndbuf_errors",
+};
+
+#define SHM_STATS_UDP_MIBS_NUM	(sizeof(shm_stats_udp_mib_strs) / \
+					sizeof(shm_stats_udp_mib_strs[0]))
+
+/* with -rxlatency, the histogram and then each family's latency follow */
+const char *shm_stats_tx_latency_strs[] = {
+	"inet_tx_latency_pkts",
+	"inet_tx_latency_p50",
+	"inet_tx_latency_p99",
+	"inet_tx_latency_p999",
+	"inet_tx_latency_max",
+	"inet6_tx_latency_pkts",
+	"inet6_tx_latency_p50",
+	"inet6_tx_latency_p99",
+	"inet6_tx_latency_p999",
+	"inet6_tx_latency_max",
+};
+
+#define SHM_STATS_TX_LATENCY_NUM	(sizeof(shm_stats_tx_latency_strs) / \
+					sizeof(shm_stats_tx_latency_strs[0]))
+
+/* with -rates, each rate and then each smoothed rate follow */
+const char *rate_stat_strs[] = {
+	"rx_pps",
+	"rx_bps",
+	"tx_pps",
+	"tx_bps",
+};
+
+#define SHM_STATS_RATES_NUM	(2 * RATE_STATS)
+
 
 int main(int argc, char *argv[])
 {
@@ -390,10 +1776,15 @@ int main(int argc, char *argv[])
 
 	init_packet_counters(&pkt_counters);
 
+	init_packet_counters(&pipe_tx_counters[0]);
+	init_packet_counters(&pipe_tx_counters[1]);
+
 	install_exit_signal_handlers();
 
 	get_prog_parms(argc, argv, &prog_parms, err_str, 0);
 
+	init_tx_rate_bucket(&tx_rate_global, prog_parms.tx_rate);
+
 	switch (prog_parms.rc_mode) {
 	case RCMODE_HELP:
 		log_debug_med("%s() rc_mode = RCMODE_HELP\n", __func__);
@@ -406,97 +1797,28 @@ int main(int argc, char *argv[])
 		log_prog_license();
 		break;
 	case RCMODE_INET_TO_INET:
-		log_debug_med("%s() rc_mode = RCMODE_INET_TO_INET\n", __func__);
-		install_usr_signal_handlers();
-		if (prog_parms.become_daemon) {
-			daemonise();
-		}
-		log_prog_banner();
-		log_prog_parms(&prog_parms);
-		inet_to_inet_rcast(&sock_fds.inet_in_sock_fd,
-				   &prog_parms.inet_rx_sock_parms,
-				   &sock_fds.inet_out_sock_fd,
-				   &prog_parms.inet_tx_sock_parms,
-				   &pkt_counters);
-		break;
 	case RCMODE_INET_TO_INET6:
-		log_debug_med("%s() rc_mode = RCMODE_INET_TO_INET6\n",
-								__func__);
+	case RCMODE_INET_TO_INET_INET6:
+	case RCMODE_INET6_TO_INET6:
+	case RCMODE_INET6_TO_INET:
+	case RCMODE_INET6_TO_INET_INET6:
+	case RCMODE_FLOWS:
 		install_usr_signal_handlers();
 		if (prog_parms.become_daemon) {
 			daemonise();
 		}
+		start_udp_mib_sampler();
+		start_shm_stats(&prog_parms);
+		start_metrics(&prog_parms);
+		start_rates(&prog_parms);
+		rt_setup(&prog_parms);
 		log_prog_banner();
 		log_prog_parms(&prog_parms);
-		inet_to_inet6_rcast(&sock_fds.inet_in_sock_fd,
-				    &prog_parms.inet_rx_sock_parms,
-				    &sock_fds.inet6_out_sock_fd,
-				    &prog_parms.inet6_tx_sock_parms,
-				    &pkt_counters);
-		break;
-	case RCMODE_INET_TO_INET_INET6:
-		log_debug_med("%s() rc_mode = RCMODE_INET_TO_INET_INET6\n",
-								__func__);
-		install_usr_signal_handlers();
-		if (prog_parms.become_daemon) {
-			daemonise();
-		}
-		log_prog_banner();
-		log_prog_parms(&prog_parms);
-		inet_to_inet_inet6_rcast(&sock_fds.inet_in_sock_fd,
-					 &prog_parms.inet_rx_sock_parms,
-					 &sock_fds.inet_out_sock_fd,
-					 &prog_parms.inet_tx_sock_parms,
-					 &sock_fds.inet6_out_sock_fd,
-					 &prog_parms.inet6_tx_sock_parms,
-					 &pkt_counters);
-		break;
-	case RCMODE_INET6_TO_INET6:
-		log_debug_med("%s() rc_mode = RCMODE_INET6_TO_INET6\n",
-								__func__);
-		install_usr_signal_handlers();
-		if (prog_parms.become_daemon) {
-			daemonise();
-		}
-		log_prog_banner();
-		log_prog_parms(&prog_parms);
-		inet6_to_inet6_rcast(&sock_fds.inet6_in_sock_fd,
-				     &prog_parms.inet6_rx_sock_parms,
-				     &sock_fds.inet6_out_sock_fd,
-				     &prog_parms.inet6_tx_sock_parms,
-				     &pkt_counters);
-		break;
-	case RCMODE_INET6_TO_INET:
-		log_debug_med("%s() rc_mode = RCMODE_INET6_TO_INET\n",
-								__func__);
-		install_usr_signal_handlers();
-		if (prog_parms.become_daemon) {
-			daemonise();
-		}
-		log_prog_banner();
-		log_prog_parms(&prog_parms);
-		inet6_to_inet_rcast(&sock_fds.inet6_in_sock_fd,
-				    &prog_parms.inet6_rx_sock_parms,
-				    &sock_fds.inet_out_sock_fd,
-				    &prog_parms.inet_tx_sock_parms,
-				    &pkt_counters);
-		break;
-	case RCMODE_INET6_TO_INET_INET6:
-		log_debug_med("%s() rc_mode = RCMODE_INET6_TO_INET_INET6\n",
-								__func__);
-		install_usr_signal_handlers();
-		if (prog_parms.become_daemon) {
-			daemonise();
-		}
-		log_prog_banner();
-		log_prog_parms(&prog_parms);
-		inet6_to_inet_inet6_rcast(&sock_fds.inet6_in_sock_fd,
-				    &prog_parms.inet6_rx_sock_parms,
-				    &sock_fds.inet_out_sock_fd,
-				    &prog_parms.inet_tx_sock_parms,
-				    &sock_fds.inet6_out_sock_fd,
-				    &prog_parms.inet6_tx_sock_parms,
-				    &pkt_counters);
+		start_workers(&prog_parms);
+		rcast(prog_parms.rc_mode, &sock_fds,
+		      &prog_parms.inet_rx_sock_parms,
+		      &prog_parms.inet6_rx_sock_parms,
+		      &pkt_counters);
 		break;
 	case RCMODE_ERROR:
 		log_debug_med("%s() rc_mode = RCMODE_ERROR\n",
@@ -527,6 +1849,132 @@ void log_prog_help(void)
 	log_msg(LOG_SEV_INFO, "-license\n");
 	log_msg(LOG_SEV_INFO, "-nodaemon\n");
 
+	log_msg(LOG_SEV_INFO, "-engine <loop|uring|pipe> - forwarding "
+		"engine. default is loop.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -engine uring\n");
+
+	log_msg(LOG_SEV_INFO, "-workers <num> - forwarding threads, each "
+		"with its own sockets. default is 1.\n");
+	log_msg(LOG_SEV_INFO, "\tthe input is shared by source address and "
+		"port, so a single source's\n");
+	log_msg(LOG_SEV_INFO, "\tdatagrams all go to one worker.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -workers 4\n");
+
+	log_msg(LOG_SEV_INFO, "-flows <file> - forward many flows, each given "
+		"on a line of the file by its\n");
+	log_msg(LOG_SEV_INFO, "\t-4in or -6in source, destinations and "
+		"per-family options.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -flows /etc/replicast.flows\n");
+
+	log_msg(LOG_SEV_INFO, "-shmstats <file> - publish the counters in "
+		"this memory mapped file, for rcstat.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -shmstats /dev/shm/replicast.stats\n");
+
+	log_msg(LOG_SEV_INFO, "-metrics <path|addr:port> - serve the counters "
+		"in the Prometheus text format on this unix socket or local "
+		"TCP address.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -metrics 127.0.0.1:9100\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -metrics /run/replicast.metrics\n");
+
+	log_msg(LOG_SEV_INFO, "-rates <secs> - log the packet and bit rates "
+		"received and sent every so many seconds.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -rates 10\n");
+
+	log_msg(LOG_SEV_INFO, "-rxcpu <cpu[,cpu...]> - CPUs for the receiving "
+		"threads, the main thread then each worker.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -rxcpu 2,3\n");
+
+	log_msg(LOG_SEV_INFO, "-txcpu <cpu[,cpu...]> - CPUs for the pipe "
+		"engine's IPv4 and IPv6 transmit threads.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -txcpu 4,5\n");
+
+	log_msg(LOG_SEV_INFO, "-rtprio <prio> - SCHED_FIFO priority for the "
+		"forwarding threads, from 1 to 99.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -rtprio 50\n");
+
+	log_msg(LOG_SEV_INFO, "-mlock - lock all memory, with buffers faulted "
+		"in when allocated.\n");
+
+	log_msg(LOG_SEV_INFO, "-txbacklog <pkts> - non-blocking transmit, "
+		"queueing up to this many datagrams per blocked destination.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -txbacklog 256\n");
+
+	log_msg(LOG_SEV_INFO, "-txrate <kbps> - transmit rate limit for all "
+		"destinations.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -txrate 100000\n");
+
+	log_msg(LOG_SEV_INFO, "-desttxrate <kbps> - transmit rate limit for "
+		"each unicast destination.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -desttxrate 8000\n");
+
+	log_msg(LOG_SEV_INFO, "-txratepolicy <drop|queue> - datagrams over "
+		"a rate limit are dropped, or queued on the -txbacklog. default "
+		"is drop.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -txratepolicy queue\n");
+
+	log_msg(LOG_SEV_INFO, "-txpace <kbps|input> - pace datagrams sent to "
+		"each destination at a rate, or at the average spacing of "
+		"their receive timestamps.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -txpace 8000\n");
+
+	log_msg(LOG_SEV_INFO, "-txpacemode <fq|etf|timer> - release paced "
+		"datagrams with SO_TXTIME through the fq or etf qdisc, or with "
+		"a timer. default is fq.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -txpacemode etf\n");
+
+	log_msg(LOG_SEV_INFO, "-rxbatch <num> - datagrams received per "
+		"system call. default is 1.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -rxbatch 64\n");
+
+	log_msg(LOG_SEV_INFO, "-rxbatchwait <usecs> - maximum wait to fill "
+		"a receive batch. default is 0.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -rxbatchwait 500\n");
+
+	log_msg(LOG_SEV_INFO, "-rxbusypoll <usecs> - busy poll the receive "
+		"socket, spinning rather than sleeping while idle.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -rxbusypoll 50\n");
+
+	log_msg(LOG_SEV_INFO, "-rxbusyidle <msecs> - idle time after which "
+		"busy polling goes back to sleeping until a datagram arrives. "
+		"default is 1000.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -rxbusyidle 100\n");
+
+	log_msg(LOG_SEV_INFO, "-rxlatency - measure the latency from receive "
+		"to transmit.\n");
+
+	log_msg(LOG_SEV_INFO, "-rxbuf <bytes> - receive socket buffer size. "
+		"default is net.core.rmem_default.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -rxbuf 4194304\n");
+
+	log_msg(LOG_SEV_INFO, "-rxbufmax <bytes> - grow the receive socket "
+		"buffer when the kernel drops datagrams, up to this size.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -rxbufmax 33554432\n");
+
+	log_msg(LOG_SEV_INFO, "-txbuf <bytes> - transmit socket buffer size. "
+		"default is net.core.wmem_default.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -txbuf 1048576\n");
+
+	log_msg(LOG_SEV_INFO, "-rxgro - receive coalesced datagrams using "
+		"UDP generic receive offload.\n");
+
+	log_msg(LOG_SEV_INFO, "-xdpif <ifname> - receive via an AF_XDP "
+		"socket on this interface.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -xdpif eth0\n");
+
+	log_msg(LOG_SEV_INFO, "-xdpqueue <num> - AF_XDP interface queue. "
+		"default is 0.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -xdpqueue 2\n");
+
+	log_msg(LOG_SEV_INFO, "-xdpskb - use generic (SKB) mode XDP.\n");
+
+	log_msg(LOG_SEV_INFO, "-pktringif <ifname> - receive via an "
+		"AF_PACKET ring on this interface.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -pktringif eth0\n");
+
+	log_msg(LOG_SEV_INFO, "-pktringtov <msecs> - AF_PACKET ring block "
+		"timeout. default is kernel chosen.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -pktringtov 2\n");
+
 	log_msg(LOG_SEV_INFO, "-4in <addr>[%<ifname>|<ifaddr>]:<port>\n");
 	log_msg(LOG_SEV_INFO, "\te.g. -4in 224.0.0.35:1234\n");
 	log_msg(LOG_SEV_INFO, "\te.g. -4in 224.0.0.35%%eth0:1234\n");
@@ -556,6 +2004,19 @@ void log_prog_help(void)
 		"interface.\n");
 	log_msg(LOG_SEV_INFO, "\te.g. -4mcoutif eth0\n");
 
+	log_msg(LOG_SEV_INFO, "-4gso - UDP segmentation offload of batched "
+		"unicast datagrams.\n");
+
+	log_msg(LOG_SEV_INFO, "-4zerocopy - zero copy transmit of large "
+		"datagrams.\n");
+
+	log_msg(LOG_SEV_INFO, "-4connect - a connected socket per unicast "
+		"destination.\n");
+
+	log_msg(LOG_SEV_INFO, "-4txrate <kbps> - transmit rate limit for the "
+		"IPv4 output interface.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -4txrate 50000\n");
+
 	log_msg(LOG_SEV_INFO, "-6out <\\[addr\\]>:<port>,<\\[addr\\]>:<port>,"
 		"...\n");
 	log_msg(LOG_SEV_INFO, "\te.g. -6out [ff05::36]:1234,");
@@ -571,6 +2032,19 @@ void log_prog_help(void)
 		" interface.\n");
 	log_msg(LOG_SEV_INFO, "\te.g. -6mcoutif eth0\n");
 
+	log_msg(LOG_SEV_INFO, "-6gso - UDP segmentation offload of batched "
+		"unicast datagrams.\n");
+
+	log_msg(LOG_SEV_INFO, "-6zerocopy - zero copy transmit of large "
+		"datagrams.\n");
+
+	log_msg(LOG_SEV_INFO, "-6connect - a connected socket per unicast "
+		"destination.\n");
+
+	log_msg(LOG_SEV_INFO, "-6txrate <kbps> - transmit rate limit for the "
+		"IPv6 output interface.\n");
+	log_msg(LOG_SEV_INFO, "\te.g. -6txrate 50000\n");
+
 	log_msg(LOG_SEV_INFO, "\nsignals:\n");
 
 	log_msg(LOG_SEV_INFO, "SIGUSR1 - log current UDP datagram rx and tx "
@@ -739,6 +2213,24 @@ void get_prog_parms(int argc, char *argv[],
 			prog_parms->rc_mode = RCMODE_ERROR;
 		}
 		break;
+	case VPO_MODE_FLOWS:
+		prog_parms->rc_mode = RCMODE_FLOWS;
+		vpo_values_ret = validate_prog_opts_values(&prog_opts,
+							   prog_parms,
+							   err_str,
+							   err_str_size);
+		if (vpo_values_ret == 0) {
+			vpo_values_ret = get_flows(prog_parms, err_str,
+							   err_str_size);
+		}
+		if (vpo_values_ret == -1) {
+			prog_parms->rc_mode = RCMODE_ERROR;
+		}
+		break;
+	case VPO_ERR_FLOWS_ADDRS:
+		prog_parms->rc_mode = RCMODE_ERROR;
+		log_opt_error(OE_FLOWS_ADDRS, NULL);
+		break;
 	case VPO_ERR_UNKNOWN:
 		prog_parms->rc_mode = RCMODE_ERROR;
 		log_opt_error(OE_UNKNOWN_ERROR, NULL);
@@ -769,6 +2261,77 @@ void init_prog_opts(struct program_options *prog_opts)
 
 	prog_opts->no_daemon_set = 0;
 
+	prog_opts->engine_set = 0;
+	prog_opts->engine_str = NULL;
+
+	prog_opts->workers_set = 0;
+	prog_opts->workers_str = NULL;
+
+	prog_opts->flows_set = 0;
+	prog_opts->flows_str = NULL;
+
+	prog_opts->shm_stats_set = 0;
+	prog_opts->shm_stats_str = NULL;
+
+	prog_opts->metrics_set = 0;
+	prog_opts->metrics_str = NULL;
+
+	prog_opts->rates_set = 0;
+	prog_opts->rates_str = NULL;
+
+	prog_opts->rx_cpus_set = 0;
+	prog_opts->rx_cpus_str = NULL;
+	prog_opts->tx_cpus_set = 0;
+	prog_opts->tx_cpus_str = NULL;
+	prog_opts->rt_prio_set = 0;
+	prog_opts->rt_prio_str = NULL;
+	prog_opts->mem_lock_set = 0;
+
+	prog_opts->tx_backlog_set = 0;
+	prog_opts->tx_backlog_str = NULL;
+
+	prog_opts->tx_rate_set = 0;
+	prog_opts->tx_rate_str = NULL;
+	prog_opts->tx_dest_rate_set = 0;
+	prog_opts->tx_dest_rate_str = NULL;
+	prog_opts->tx_rate_policy_set = 0;
+	prog_opts->tx_rate_policy_str = NULL;
+
+	prog_opts->tx_pace_set = 0;
+	prog_opts->tx_pace_str = NULL;
+	prog_opts->tx_pace_mode_set = 0;
+	prog_opts->tx_pace_mode_str = NULL;
+
+	prog_opts->rx_batch_size_set = 0;
+	prog_opts->rx_batch_size_str = NULL;
+	prog_opts->rx_batch_wait_set = 0;
+	prog_opts->rx_batch_wait_str = NULL;
+
+	prog_opts->rx_busy_poll_set = 0;
+	prog_opts->rx_busy_poll_str = NULL;
+	prog_opts->rx_busy_idle_set = 0;
+	prog_opts->rx_busy_idle_str = NULL;
+	prog_opts->rx_latency_set = 0;
+
+	prog_opts->rx_buf_set = 0;
+	prog_opts->rx_buf_str = NULL;
+	prog_opts->rx_buf_max_set = 0;
+	prog_opts->rx_buf_max_str = NULL;
+	prog_opts->tx_buf_set = 0;
+	prog_opts->tx_buf_str = NULL;
+	prog_opts->rx_udp_gro_set = 0;
+
+	prog_opts->rx_xdp_intf_set = 0;
+	prog_opts->rx_xdp_intf_str = NULL;
+	prog_opts->rx_xdp_queue_set = 0;
+	prog_opts->rx_xdp_queue_str = NULL;
+	prog_opts->rx_xdp_skb_set = 0;
+
+	prog_opts->rx_pkt_ring_intf_set = 0;
+	prog_opts->rx_pkt_ring_intf_str = NULL;
+	prog_opts->rx_pkt_ring_tov_set = 0;
+	prog_opts->rx_pkt_ring_tov_str = NULL;
+
 	prog_opts->inet_rx_sock_mcgroup_set = 0;
 	prog_opts->inet_rx_sock_mcgroup_str = NULL;
 
@@ -779,6 +2342,11 @@ void init_prog_opts(struct program_options *prog_opts)
 	prog_opts->inet_tx_sock_out_intf_str = NULL;
 	prog_opts->inet_tx_sock_dests_set = 0;
 	prog_opts->inet_tx_sock_dests_str = NULL;
+	prog_opts->inet_tx_sock_udp_gso_set = 0;
+	prog_opts->inet_tx_sock_zerocopy_set = 0;
+	prog_opts->inet_tx_sock_connect_set = 0;
+	prog_opts->inet_tx_sock_rate_set = 0;
+	prog_opts->inet_tx_sock_rate_str = NULL;
 
 	prog_opts->inet6_rx_sock_mcgroup_set = 0;
 	prog_opts->inet6_rx_sock_mcgroup_str = NULL;
@@ -790,6 +2358,11 @@ void init_prog_opts(struct program_options *prog_opts)
 	prog_opts->inet6_tx_sock_out_intf_str = NULL;
 	prog_opts->inet6_tx_sock_dests_set = 0;
 	prog_opts->inet6_tx_sock_dests_str = NULL;
+	prog_opts->inet6_tx_sock_udp_gso_set = 0;
+	prog_opts->inet6_tx_sock_zerocopy_set = 0;
+	prog_opts->inet6_tx_sock_connect_set = 0;
+	prog_opts->inet6_tx_sock_rate_set = 0;
+	prog_opts->inet6_tx_sock_rate_str = NULL;
 	
 	log_debug_med("%s() exit\n", __func__);
 
@@ -806,9 +2379,36 @@ void init_prog_parms(struct program_parameters *prog_parms)
 
 	prog_parms->become_daemon = 1;
 
+	prog_parms->engine = ENGINE_LOOP;
+
+	prog_parms->workers_num = 1;
+	prog_parms->tx_rate = 0;
+	prog_parms->tx_rate_queue = 0;
+	prog_parms->rx_cpus_num = 0;
+	prog_parms->tx_cpus_num = 0;
+	prog_parms->rt_prio = 0;
+	prog_parms->mem_lock = 0;
+
+	prog_parms->rx_batch_parms.batch_size = 1;
+	prog_parms->rx_batch_parms.batch_wait_usec = 0;
+	prog_parms->rx_batch_parms.busy_poll_usec = 0;
+	prog_parms->rx_batch_parms.busy_idle_msec = RX_BUSY_IDLE_DEF;
+	prog_parms->rx_batch_parms.latency = 0;
+	prog_parms->rx_batch_parms.tstamps = 0;
+	prog_parms->rx_batch_parms.buf_max = 0;
+
 	prog_parms->inet_rx_sock_parms.rx_addr.s_addr = ntohl(INADDR_NONE);
 	prog_parms->inet_rx_sock_parms.port = 0;
 	prog_parms->inet_rx_sock_parms.in_intf_addr.s_addr = ntohl(INADDR_ANY);
+	prog_parms->inet_rx_sock_parms.udp_gro = 0;
+	prog_parms->inet_rx_sock_parms.rcvbuf = 0;
+	prog_parms->inet_rx_sock_parms.xdp_intf_idx = 0;
+	prog_parms->inet_rx_sock_parms.xdp_queue = 0;
+	prog_parms->inet_rx_sock_parms.xdp_skb_mode = 0;
+	prog_parms->inet_rx_sock_parms.pkt_ring_intf_idx = 0;
+	prog_parms->inet_rx_sock_parms.pkt_ring_block_tov = 0;
+	prog_parms->inet_rx_sock_parms.workers_num = 1;
+	prog_parms->inet_rx_sock_parms.worker_idx = 0;
 
 	prog_parms->inet_tx_sock_parms.mc_ttl = 1;
 	prog_parms->inet_tx_sock_parms.mc_loop = 0;
@@ -816,11 +2416,31 @@ void init_prog_parms(struct program_parameters *prog_parms)
 	prog_parms->inet_tx_sock_parms.dests = NULL;
 	prog_parms->inet_tx_sock_parms.dests_num = 0;
 	prog_parms->inet_tx_sock_parms.mc_dests_num = 0;
+	prog_parms->inet_tx_sock_parms.sndbuf = 0;
+	prog_parms->inet_tx_sock_parms.udp_gso = 0;
+	prog_parms->inet_tx_sock_parms.zerocopy = 0;
+	prog_parms->inet_tx_sock_parms.connect = 0;
+	prog_parms->inet_tx_sock_parms.backlog = 0;
+	prog_parms->inet_tx_sock_parms.rate = 0;
+	prog_parms->inet_tx_sock_parms.dest_rate = 0;
+	prog_parms->inet_tx_sock_parms.rate_queue = 0;
+	prog_parms->inet_tx_sock_parms.pace_rate = 0;
+	prog_parms->inet_tx_sock_parms.pace_input = 0;
+	prog_parms->inet_tx_sock_parms.pace_mode = TX_PACE_FQ;
 
 	memcpy(&prog_parms->inet6_rx_sock_parms.rx_addr, &in6addr_any,
 		sizeof(in6addr_any));
 	prog_parms->inet6_rx_sock_parms.port = 0;
 	prog_parms->inet6_rx_sock_parms.in_intf_idx = 0;
+	prog_parms->inet6_rx_sock_parms.udp_gro = 0;
+	prog_parms->inet6_rx_sock_parms.rcvbuf = 0;
+	prog_parms->inet6_rx_sock_parms.xdp_intf_idx = 0;
+	prog_parms->inet6_rx_sock_parms.xdp_queue = 0;
+	prog_parms->inet6_rx_sock_parms.xdp_skb_mode = 0;
+	prog_parms->inet6_rx_sock_parms.pkt_ring_intf_idx = 0;
+	prog_parms->inet6_rx_sock_parms.pkt_ring_block_tov = 0;
+	prog_parms->inet6_rx_sock_parms.workers_num = 1;
+	prog_parms->inet6_rx_sock_parms.worker_idx = 0;
 
 	prog_parms->inet6_tx_sock_parms.mc_hops = 1;
 	prog_parms->inet6_tx_sock_parms.mc_loop = 0;
@@ -828,6 +2448,29 @@ void init_prog_parms(struct program_parameters *prog_parms)
 	prog_parms->inet6_tx_sock_parms.dests = NULL;
 	prog_parms->inet6_tx_sock_parms.dests_num = 0;
 	prog_parms->inet6_tx_sock_parms.mc_dests_num = 0;
+	prog_parms->inet6_tx_sock_parms.sndbuf = 0;
+	prog_parms->inet6_tx_sock_parms.udp_gso = 0;
+	prog_parms->inet6_tx_sock_parms.zerocopy = 0;
+	prog_parms->inet6_tx_sock_parms.connect = 0;
+	prog_parms->inet6_tx_sock_parms.backlog = 0;
+	prog_parms->inet6_tx_sock_parms.rate = 0;
+	prog_parms->inet6_tx_sock_parms.dest_rate = 0;
+	prog_parms->inet6_tx_sock_parms.rate_queue = 0;
+	prog_parms->inet6_tx_sock_parms.pace_rate = 0;
+	prog_parms->inet6_tx_sock_parms.pace_input = 0;
+	prog_parms->inet6_tx_sock_parms.pace_mode = TX_PACE_FQ;
+
+	prog_parms->flows_file = NULL;
+	prog_parms->flows = NULL;
+	prog_parms->flows_num = 0;
+
+	prog_parms->shm_stats_file = NULL;
+
+	prog_parms->metrics_addr_str = NULL;
+	memset(&prog_parms->metrics_addr, 0, sizeof(prog_parms->metrics_addr));
+	prog_parms->metrics_addr_len = 0;
+
+	prog_parms->rates_interval = 0;
 
 	log_debug_med("%s() exit\n", __func__);
 
@@ -841,31 +2484,111 @@ void get_prog_opts_cmdline(int argc, char *argv[],
 		CMDLINE_OPT_HELP = 1,
 		CMDLINE_OPT_LICENSE,
 		CMDLINE_OPT_NODAEMON,
+		CMDLINE_OPT_ENGINE,
+		CMDLINE_OPT_WORKERS,
+		CMDLINE_OPT_FLOWS,
+		CMDLINE_OPT_SHMSTATS,
+		CMDLINE_OPT_METRICS,
+		CMDLINE_OPT_RATES,
+		CMDLINE_OPT_RXCPU,
+		CMDLINE_OPT_TXCPU,
+		CMDLINE_OPT_RTPRIO,
+		CMDLINE_OPT_MLOCK,
+		CMDLINE_OPT_TXBACKLOG,
+		CMDLINE_OPT_TXRATE,
+		CMDLINE_OPT_DESTTXRATE,
+		CMDLINE_OPT_TXRATEPOLICY,
+		CMDLINE_OPT_TXPACE,
+		CMDLINE_OPT_TXPACEMODE,
+		CMDLINE_OPT_RXBATCH,
+		CMDLINE_OPT_RXBATCHWAIT,
+		CMDLINE_OPT_RXGRO,
+		CMDLINE_OPT_RXBUSYPOLL,
+		CMDLINE_OPT_RXBUSYIDLE,
+		CMDLINE_OPT_RXLATENCY,
+		CMDLINE_OPT_RXBUF,
+		CMDLINE_OPT_RXBUFMAX,
+		CMDLINE_OPT_TXBUF,
+		CMDLINE_OPT_XDPIF,
+		CMDLINE_OPT_XDPQUEUE,
+		CMDLINE_OPT_XDPSKB,
+		CMDLINE_OPT_PKTRINGIF,
+		CMDLINE_OPT_PKTRINGTOV,
 		CMDLINE_OPT_4IN,
 		CMDLINE_OPT_4MCTTL,
 		CMDLINE_OPT_4MCLOOP,
 		CMDLINE_OPT_4MCOUTIF,
 		CMDLINE_OPT_4DSTS,
+		CMDLINE_OPT_4GSO,
+		CMDLINE_OPT_4ZEROCOPY,
+		CMDLINE_OPT_4CONNECT,
+		CMDLINE_OPT_4TXRATE,
 		CMDLINE_OPT_6IN,
 		CMDLINE_OPT_6MCHOPS,
 		CMDLINE_OPT_6MCLOOP,
 		CMDLINE_OPT_6MCOUTIF,
 		CMDLINE_OPT_6DSTS,
+		CMDLINE_OPT_6GSO,
+		CMDLINE_OPT_6ZEROCOPY,
+		CMDLINE_OPT_6CONNECT,
+		CMDLINE_OPT_6TXRATE,
 	};
 	struct option cmdline_opts[] = {
 		{"help", no_argument, NULL, CMDLINE_OPT_HELP},
 		{"license", no_argument, NULL, CMDLINE_OPT_LICENSE},
 		{"nodaemon", no_argument, NULL, CMDLINE_OPT_NODAEMON},
+		{"engine", required_argument, NULL, CMDLINE_OPT_ENGINE},
+		{"workers", required_argument, NULL, CMDLINE_OPT_WORKERS},
+		{"flows", required_argument, NULL, CMDLINE_OPT_FLOWS},
+		{"shmstats", required_argument, NULL, CMDLINE_OPT_SHMSTATS},
+		{"metrics", required_argument, NULL, CMDLINE_OPT_METRICS},
+		{"rates", required_argument, NULL, CMDLINE_OPT_RATES},
+		{"rxcpu", required_argument, NULL, CMDLINE_OPT_RXCPU},
+		{"txcpu", required_argument, NULL, CMDLINE_OPT_TXCPU},
+		{"rtprio", required_argument, NULL, CMDLINE_OPT_RTPRIO},
+		{"mlock", no_argument, NULL, CMDLINE_OPT_MLOCK},
+		{"txbacklog", required_argument, NULL, CMDLINE_OPT_TXBACKLOG},
+		{"txrate", required_argument, NULL, CMDLINE_OPT_TXRATE},
+		{"desttxrate", required_argument, NULL,
+						CMDLINE_OPT_DESTTXRATE},
+		{"txratepolicy", required_argument, NULL,
+						CMDLINE_OPT_TXRATEPOLICY},
+		{"txpace", required_argument, NULL, CMDLINE_OPT_TXPACE},
+		{"txpacemode", required_argument, NULL, CMDLINE_OPT_TXPACEMODE},
+		{"rxbatch", required_argument, NULL, CMDLINE_OPT_RXBATCH},
+		{"rxbatchwait", required_argument, NULL,
+						CMDLINE_OPT_RXBATCHWAIT},
+		{"rxgro", no_argument, NULL, CMDLINE_OPT_RXGRO},
+		{"rxbusypoll", required_argument, NULL, CMDLINE_OPT_RXBUSYPOLL},
+		{"rxbusyidle", required_argument, NULL, CMDLINE_OPT_RXBUSYIDLE},
+		{"rxlatency", no_argument, NULL, CMDLINE_OPT_RXLATENCY},
+		{"rxbuf", required_argument, NULL, CMDLINE_OPT_RXBUF},
+		{"rxbufmax", required_argument, NULL, CMDLINE_OPT_RXBUFMAX},
+		{"txbuf", required_argument, NULL, CMDLINE_OPT_TXBUF},
+		{"xdpif", required_argument, NULL, CMDLINE_OPT_XDPIF},
+		{"xdpqueue", required_argument, NULL, CMDLINE_OPT_XDPQUEUE},
+		{"xdpskb", no_argument, NULL, CMDLINE_OPT_XDPSKB},
+		{"pktringif", required_argument, NULL, CMDLINE_OPT_PKTRINGIF},
+		{"pktringtov", required_argument, NULL,
+						CMDLINE_OPT_PKTRINGTOV},
 		{"4in", required_argument, NULL, CMDLINE_OPT_4IN},
 		{"4mcttl", required_argument, NULL, CMDLINE_OPT_4MCTTL},
 		{"4mcloop", no_argument, NULL, CMDLINE_OPT_4MCLOOP},
 		{"4mcoutif", required_argument, NULL, CMDLINE_OPT_4MCOUTIF},
 		{"4out", required_argument, NULL, CMDLINE_OPT_4DSTS},
+		{"4gso", no_argument, NULL, CMDLINE_OPT_4GSO},
+		{"4zerocopy", no_argument, NULL, CMDLINE_OPT_4ZEROCOPY},
+		{"4connect", no_argument, NULL, CMDLINE_OPT_4CONNECT},
+		{"4txrate", required_argument, NULL, CMDLINE_OPT_4TXRATE},
 		{"6in", required_argument, NULL, CMDLINE_OPT_6IN},
 		{"6mchops", required_argument, NULL, CMDLINE_OPT_6MCHOPS},
 		{"6mcloop", no_argument, NULL, CMDLINE_OPT_6MCLOOP},
 		{"6mcoutif", required_argument, NULL, CMDLINE_OPT_6MCOUTIF},
 		{"6out", required_argument, NULL, CMDLINE_OPT_6DSTS},
+		{"6gso", no_argument, NULL, CMDLINE_OPT_6GSO},
+		{"6zerocopy", no_argument, NULL, CMDLINE_OPT_6ZEROCOPY},
+		{"6connect", no_argument, NULL, CMDLINE_OPT_6CONNECT},
+		{"6txrate", required_argument, NULL, CMDLINE_OPT_6TXRATE},
 		{0, 0, 0, 0}
 	};
 	enum CMDLINE_OPTS ret;
@@ -895,6 +2618,182 @@ void get_prog_opts_cmdline(int argc, char *argv[],
 				"CMDLINE_OPT_NODAEMON\n", __func__);
 			prog_opts->no_daemon_set = 1;
 			break;
+		case CMDLINE_OPT_ENGINE:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_ENGINE\n", __func__);
+			prog_opts->engine_set = 1;
+			prog_opts->engine_str = optarg;
+			break;
+		case CMDLINE_OPT_WORKERS:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_WORKERS\n", __func__);
+			prog_opts->workers_set = 1;
+			prog_opts->workers_str = optarg;
+			break;
+		case CMDLINE_OPT_FLOWS:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_FLOWS\n", __func__);
+			prog_opts->flows_set = 1;
+			prog_opts->flows_str = optarg;
+			break;
+		case CMDLINE_OPT_SHMSTATS:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_SHMSTATS\n", __func__);
+			prog_opts->shm_stats_set = 1;
+			prog_opts->shm_stats_str = optarg;
+			break;
+		case CMDLINE_OPT_METRICS:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_METRICS\n", __func__);
+			prog_opts->metrics_set = 1;
+			prog_opts->metrics_str = optarg;
+			break;
+		case CMDLINE_OPT_RATES:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_RATES\n", __func__);
+			prog_opts->rates_set = 1;
+			prog_opts->rates_str = optarg;
+			break;
+		case CMDLINE_OPT_RXCPU:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_RXCPU\n", __func__);
+			prog_opts->rx_cpus_set = 1;
+			prog_opts->rx_cpus_str = optarg;
+			break;
+		case CMDLINE_OPT_TXCPU:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_TXCPU\n", __func__);
+			prog_opts->tx_cpus_set = 1;
+			prog_opts->tx_cpus_str = optarg;
+			break;
+		case CMDLINE_OPT_RTPRIO:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_RTPRIO\n", __func__);
+			prog_opts->rt_prio_set = 1;
+			prog_opts->rt_prio_str = optarg;
+			break;
+		case CMDLINE_OPT_MLOCK:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_MLOCK\n", __func__);
+			prog_opts->mem_lock_set = 1;
+			break;
+		case CMDLINE_OPT_TXBACKLOG:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_TXBACKLOG\n", __func__);
+			prog_opts->tx_backlog_set = 1;
+			prog_opts->tx_backlog_str = optarg;
+			break;
+		case CMDLINE_OPT_TXRATE:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_TXRATE\n", __func__);
+			prog_opts->tx_rate_set = 1;
+			prog_opts->tx_rate_str = optarg;
+			break;
+		case CMDLINE_OPT_DESTTXRATE:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_DESTTXRATE\n", __func__);
+			prog_opts->tx_dest_rate_set = 1;
+			prog_opts->tx_dest_rate_str = optarg;
+			break;
+		case CMDLINE_OPT_TXRATEPOLICY:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_TXRATEPOLICY\n", __func__);
+			prog_opts->tx_rate_policy_set = 1;
+			prog_opts->tx_rate_policy_str = optarg;
+			break;
+		case CMDLINE_OPT_TXPACE:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_TXPACE\n", __func__);
+			prog_opts->tx_pace_set = 1;
+			prog_opts->tx_pace_str = optarg;
+			break;
+		case CMDLINE_OPT_TXPACEMODE:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_TXPACEMODE\n", __func__);
+			prog_opts->tx_pace_mode_set = 1;
+			prog_opts->tx_pace_mode_str = optarg;
+			break;
+		case CMDLINE_OPT_RXBATCH:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_RXBATCH\n", __func__);
+			prog_opts->rx_batch_size_set = 1;
+			prog_opts->rx_batch_size_str = optarg;
+			break;
+		case CMDLINE_OPT_RXBATCHWAIT:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_RXBATCHWAIT\n", __func__);
+			prog_opts->rx_batch_wait_set = 1;
+			prog_opts->rx_batch_wait_str = optarg;
+			break;
+		case CMDLINE_OPT_RXBUSYPOLL:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_RXBUSYPOLL\n", __func__);
+			prog_opts->rx_busy_poll_set = 1;
+			prog_opts->rx_busy_poll_str = optarg;
+			break;
+		case CMDLINE_OPT_RXBUSYIDLE:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_RXBUSYIDLE\n", __func__);
+			prog_opts->rx_busy_idle_set = 1;
+			prog_opts->rx_busy_idle_str = optarg;
+			break;
+		case CMDLINE_OPT_RXLATENCY:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_RXLATENCY\n", __func__);
+			prog_opts->rx_latency_set = 1;
+			break;
+		case CMDLINE_OPT_RXBUF:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_RXBUF\n", __func__);
+			prog_opts->rx_buf_set = 1;
+			prog_opts->rx_buf_str = optarg;
+			break;
+		case CMDLINE_OPT_RXBUFMAX:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_RXBUFMAX\n", __func__);
+			prog_opts->rx_buf_max_set = 1;
+			prog_opts->rx_buf_max_str = optarg;
+			break;
+		case CMDLINE_OPT_TXBUF:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_TXBUF\n", __func__);
+			prog_opts->tx_buf_set = 1;
+			prog_opts->tx_buf_str = optarg;
+			break;
+		case CMDLINE_OPT_RXGRO:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_RXGRO\n", __func__);
+			prog_opts->rx_udp_gro_set = 1;
+			break;
+		case CMDLINE_OPT_XDPIF:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_XDPIF\n", __func__);
+			prog_opts->rx_xdp_intf_set = 1;
+			prog_opts->rx_xdp_intf_str = optarg;
+			break;
+		case CMDLINE_OPT_XDPQUEUE:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_XDPQUEUE\n", __func__);
+			prog_opts->rx_xdp_queue_set = 1;
+			prog_opts->rx_xdp_queue_str = optarg;
+			break;
+		case CMDLINE_OPT_XDPSKB:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_XDPSKB\n", __func__);
+			prog_opts->rx_xdp_skb_set = 1;
+			break;
+		case CMDLINE_OPT_PKTRINGIF:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_PKTRINGIF\n", __func__);
+			prog_opts->rx_pkt_ring_intf_set = 1;
+			prog_opts->rx_pkt_ring_intf_str = optarg;
+			break;
+		case CMDLINE_OPT_PKTRINGTOV:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_PKTRINGTOV\n", __func__);
+			prog_opts->rx_pkt_ring_tov_set = 1;
+			prog_opts->rx_pkt_ring_tov_str = optarg;
+			break;
 		case CMDLINE_OPT_4IN:
 			log_debug_low("%s: getopt_long_only() = "
 				"CMDLINE_OPT_4IN\n", __func__);
@@ -924,6 +2823,27 @@ void get_prog_opts_cmdline(int argc, char *argv[],
 			prog_opts->inet_tx_sock_dests_set = 1;
 			prog_opts->inet_tx_sock_dests_str = optarg;
 			break;
+		case CMDLINE_OPT_4GSO:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_4GSO\n", __func__);
+			prog_opts->inet_tx_sock_udp_gso_set = 1;
+			break;
+		case CMDLINE_OPT_4ZEROCOPY:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_4ZEROCOPY\n", __func__);
+			prog_opts->inet_tx_sock_zerocopy_set = 1;
+			break;
+		case CMDLINE_OPT_4CONNECT:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_4CONNECT\n", __func__);
+			prog_opts->inet_tx_sock_connect_set = 1;
+			break;
+		case CMDLINE_OPT_4TXRATE:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_4TXRATE\n", __func__);
+			prog_opts->inet_tx_sock_rate_set = 1;
+			prog_opts->inet_tx_sock_rate_str = optarg;
+			break;
 		case CMDLINE_OPT_6IN:
 			log_debug_low("%s: getopt_long_only() = "
 				"CMDLINE_OPT_6IN\n", __func__);
@@ -953,6 +2873,27 @@ void get_prog_opts_cmdline(int argc, char *argv[],
 			prog_opts->inet6_tx_sock_dests_set = 1;
 			prog_opts->inet6_tx_sock_dests_str = optarg;
 			break;
+		case CMDLINE_OPT_6GSO:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_6GSO\n", __func__);
+			prog_opts->inet6_tx_sock_udp_gso_set = 1;
+			break;
+		case CMDLINE_OPT_6ZEROCOPY:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_6ZEROCOPY\n", __func__);
+			prog_opts->inet6_tx_sock_zerocopy_set = 1;
+			break;
+		case CMDLINE_OPT_6CONNECT:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_6CONNECT\n", __func__);
+			prog_opts->inet6_tx_sock_connect_set = 1;
+			break;
+		case CMDLINE_OPT_6TXRATE:
+			log_debug_low("%s: getopt_long_only() = "
+				"CMDLINE_OPT_6TXRATE\n", __func__);
+			prog_opts->inet6_tx_sock_rate_set = 1;
+			prog_opts->inet6_tx_sock_rate_str = optarg;
+			break;
 		default:
 			log_debug_low("%s: getopt_long_only() = "
 				"unknown option\n", __func__);
@@ -996,6 +2937,21 @@ enum VALIDATE_PROG_OPTS validate_prog_opts(
 		return VPO_ERR_UNKNOWN_OPT;
 	}
 
+	if (prog_opts->flows_set) {
+		if (prog_opts->inet_rx_sock_mcgroup_set ||
+		    prog_opts->inet6_rx_sock_mcgroup_set ||
+		    prog_opts->inet_tx_sock_dests_set ||
+		    prog_opts->inet6_tx_sock_dests_set) {
+			log_debug_low("%s() return VPO_ERR_FLOWS_ADDRS\n",
+				__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPO_ERR_FLOWS_ADDRS;
+		}
+		log_debug_low("%s() return VPO_MODE_FLOWS\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		return VPO_MODE_FLOWS;
+	}
+
 	if (!prog_opts->inet_rx_sock_mcgroup_set &&
 				!prog_opts->inet6_rx_sock_mcgroup_set) {
 		log_debug_low("%s() return VPO_ERR_NO_SRC_ADDR\n", __func__);
@@ -1078,6 +3034,24 @@ enum VALIDATE_PROG_OPTS_VALS validate_prog_opts_vals(
 	int tx_ttl;
 	int mc_hops;
 	unsigned int out_intf_idx;
+	int batch_size;
+	int batch_wait;
+	int busy_poll;
+	int busy_idle;
+	int rx_buf;
+	int rx_buf_max;
+	int tx_buf;
+	unsigned int xdp_intf_idx;
+	int xdp_queue;
+	unsigned int pkt_ring_intf_idx;
+	int pkt_ring_tov;
+	int workers_num;
+	int tx_backlog;
+	int tx_rate;
+	int tx_pace;
+	enum TX_PACE_MODE tx_pace_mode = TX_PACE_FQ;
+	int rt_prio;
+	int rates_interval;
 
 
 	log_debug_med("%s() entry\n", __func__);
@@ -1087,973 +3061,9028 @@ enum VALIDATE_PROG_OPTS_VALS validate_prog_opts_vals(
 		prog_parms->become_daemon = 0;
 	}
 
-	if (prog_opts->inet_rx_sock_mcgroup_set) {
-		log_debug_low("%s() prog_opts->inet_rx_sock_mcgroup_set\n",
-								__func__);
-		ret = aip_ptoh_inet(prog_opts->inet_rx_sock_mcgroup_str,
-			&prog_parms->inet_rx_sock_parms.rx_addr,
-			&in_intf_addr,
-			&prog_parms->inet_rx_sock_parms.port,
-			&aip_ptoh_err);
-		if (ret == -1) {
-			switch (aip_ptoh_err) {
-			case INETADDR_ERR_ADDR:
-				log_debug_low("%s() return "
-					"VPOV_ERR_SRC_ADDR\n",
-					__func__);
-				log_debug_med("%s() exit\n", __func__);
-				return VPOV_ERR_SRC_ADDR;
-				break;
-			case INETADDR_ERR_IFADDR:
-				log_debug_low("%s() return "
-					"VPOV_ERR_IF_ADDR\n",
-					__func__);
-				log_debug_med("%s() exit\n", __func__);
-				return VPOV_ERR_IF_ADDR;
-				break;
-			case INETADDR_ERR_PORT:
-				log_debug_low("%s() return "
-					"VPOV_ERR_SRC_PORT\n",
-					__func__);
-				log_debug_med("%s() exit\n", __func__);
-				return VPOV_ERR_SRC_PORT;
-				break;
-			default:
-				log_debug_low("%s() return "
-					"VPOV_ERR_UNKNOWN\n",
-					__func__);
-				log_debug_med("%s() exit\n", __func__);
-				return VPOV_ERR_UNKNOWN;
-				break;
-			}
+	if (prog_opts->rx_batch_size_set) {
+		log_debug_low("%s() prog_opts->rx_batch_size_set\n", __func__);
+		batch_size = atoi(prog_opts->rx_batch_size_str);
+		if ((batch_size < 1) || (batch_size > RX_BATCH_MAX)) {
+			log_debug_low("%s() return "
+				"VPOV_ERR_RX_BATCH_RANGE\n", __func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_RX_BATCH_RANGE;
 		} else {
-			if (in_intf_addr.s_addr != ntohl(INADDR_NONE)) {
-				prog_parms->inet_rx_sock_parms.in_intf_addr =
-					in_intf_addr;
-			}
-			if (prog_parms->inet_rx_sock_parms.port == 0) {
-				log_debug_low("%s() return "
-					"VPOV_ERR_SRC_PORT\n", __func__);
-				log_debug_med("%s() exit\n", __func__);
-				return VPOV_ERR_SRC_PORT;
-			}
+			prog_parms->rx_batch_parms.batch_size = batch_size;
 		}
 	}
 
-	if (prog_opts->inet6_rx_sock_mcgroup_set) {
-		log_debug_low("%s() prog_opts->inet6_rx_sock_mcgroup_set\n",
-								__func__);
-		ret = aip_ptoh_inet6(prog_opts->inet6_rx_sock_mcgroup_str,
-			&prog_parms->inet6_rx_sock_parms.rx_addr,
-			&prog_parms->inet6_rx_sock_parms.in_intf_idx,
-			&prog_parms->inet6_rx_sock_parms.port,
-			&aip_ptoh_err);
-		if (ret == -1) {
-			switch (aip_ptoh_err) {
-			case INETADDR_ERR_ADDR:
-				log_debug_low("%s() return "
-					"VPOV_ERR_SRC_ADDR\n",
-					__func__);
-				log_debug_med("%s() exit\n", __func__);
-				return VPOV_ERR_SRC_ADDR;
-				break;
-			case INETADDR_ERR_PORT:
-				log_debug_low("%s() return "
-					"VPOV_ERR_SRC_PORT\n",
-					__func__);
-				log_debug_med("%s() exit\n", __func__);
-				return VPOV_ERR_SRC_PORT;
-				break;
-			default:
-				log_debug_low("%s() return "
-					"VPOV_ERR_UNKNOWN\n",
-					__func__);
-				log_debug_med("%s() exit\n", __func__);
-				return VPOV_ERR_UNKNOWN;
-				break;
-			}
+	if (prog_opts->rx_batch_wait_set) {
+		log_debug_low("%s() prog_opts->rx_batch_wait_set\n", __func__);
+		batch_wait = atoi(prog_opts->rx_batch_wait_str);
+		if ((batch_wait < 0) || (batch_wait > RX_BATCH_WAIT_MAX)) {
+			log_debug_low("%s() return "
+				"VPOV_ERR_RX_BATCH_WAIT_RANGE\n", __func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_RX_BATCH_WAIT_RANGE;
 		} else {
-			if (prog_parms->inet6_rx_sock_parms.port == 0) {
-				log_debug_low("%s() return "
-					"VPOV_ERR_SRC_PORT\n", __func__);
-				log_debug_med("%s() exit\n", __func__);
-				return VPOV_ERR_SRC_PORT;
-			}
+			prog_parms->rx_batch_parms.batch_wait_usec =
+								batch_wait;
 		}
 	}
 
-	if (prog_opts->inet_tx_sock_dests_set) {
-		log_debug_low("%s() prog_opts->inet_tx_sock_dests_set\n",
-								__func__);
-		ret = ap_pton_inet_csv(
-				prog_opts->inet_tx_sock_dests_str,
-				NULL, 0, 0, 0, &aip_ptoh_err, err_str_parm, 
-				err_str_size);
-		log_debug_low("%s() first ap_pton_inet_csv() call = %d\n",
-			__func__, ret);
-		if (ret == -1) {
-			log_debug_low("%s() return VPOV_ERR_INET_DST_ADDR\n",
-					__func__);
+	if (prog_opts->rx_busy_poll_set) {
+		log_debug_low("%s() prog_opts->rx_busy_poll_set\n", __func__);
+		busy_poll = atoi(prog_opts->rx_busy_poll_str);
+		if ((busy_poll < 1) || (busy_poll > RX_BUSY_POLL_MAX)) {
+			log_debug_low("%s() return "
+				"VPOV_ERR_RX_BUSY_POLL_RANGE\n", __func__);
 			log_debug_med("%s() exit\n", __func__);
-			return VPOV_ERR_INET_DST_ADDR;
+			return VPOV_ERR_RX_BUSY_POLL_RANGE;
 		} else {
-			prog_parms->inet_tx_sock_parms.dests =
-				(struct sockaddr_in *)
-				malloc((ret + 1) * sizeof(struct sockaddr_in));
-			if (prog_parms->inet_tx_sock_parms.dests == NULL) {
-				log_debug_low("%s() return", __func__);
-				log_debug_low(" VPOV_ERR_MEMORY\n");
-				log_debug_med("%s() exit\n", __func__);
-				return VPOV_ERR_MEMORY;
-			}
-			ret = ap_pton_inet_csv(
-				prog_opts->inet_tx_sock_dests_str,
-				prog_parms->inet_tx_sock_parms.dests,
-				0, 1, 1, NULL, NULL, 0);
-			prog_parms->inet_tx_sock_parms.dests_num = ret;
-			prog_parms->inet_tx_sock_parms.mc_dests_num = 
-				num_inet_mcaddrs(
-					prog_parms->inet_tx_sock_parms.dests,
-					prog_parms->
-						inet_tx_sock_parms.dests_num);
-			log_debug_low("%s() num_inet_mcaddrs = %d\n", __func__,
-				prog_parms->inet_tx_sock_parms.mc_dests_num);
+			prog_parms->rx_batch_parms.busy_poll_usec = busy_poll;
 		}
+	}
 
-		if (prog_opts->inet_tx_sock_mc_ttl_set) {
-			log_debug_low("%s() prog_opts->", __func__);
-			log_debug_low("inet_tx_sock_mc_ttl_set\n");
-			tx_ttl = atoi(prog_opts->inet_tx_sock_mc_ttl_str);
-			if ((tx_ttl < 0) || (tx_ttl > 255)) {
-				log_debug_low("%s() return "
-					"VPOV_ERR_INET_TX_MCTTL_RANGE\n",
-						__func__);
-				log_debug_med("%s() exit\n", __func__);
-				return VPOV_ERR_INET_TX_MCTTL_RANGE;
-			} else {
-				prog_parms->inet_tx_sock_parms.mc_ttl =
-									tx_ttl;
-			}
+	if (prog_opts->rx_busy_idle_set) {
+		log_debug_low("%s() prog_opts->rx_busy_idle_set\n", __func__);
+		busy_idle = atoi(prog_opts->rx_busy_idle_str);
+		if ((busy_idle < 1) || (busy_idle > RX_BUSY_IDLE_MAX)) {
+			log_debug_low("%s() return "
+				"VPOV_ERR_RX_BUSY_IDLE_RANGE\n", __func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_RX_BUSY_IDLE_RANGE;
+		} else {
+			prog_parms->rx_batch_parms.busy_idle_msec = busy_idle;
 		}
+	}
 
-		if (prog_opts->inet_tx_sock_mc_loop_set) {
-			log_debug_low("%s() prog_opts->", __func__);
-			log_debug_low("inet_tx_mc_sock_mc_loop_set\n");
-			prog_parms->inet_tx_sock_parms.mc_loop = 1;
+	if (prog_opts->rx_latency_set) {
+		log_debug_low("%s() prog_opts->rx_latency_set\n", __func__);
+		prog_parms->rx_batch_parms.latency = 1;
+		prog_parms->rx_batch_parms.tstamps = 1;
+	}
+
+	if (prog_opts->rx_buf_set) {
+		log_debug_low("%s() prog_opts->rx_buf_set\n", __func__);
+		rx_buf = atoi(prog_opts->rx_buf_str);
+		if ((rx_buf < SOCK_BUF_MIN) || (rx_buf > SOCK_BUF_MAX)) {
+			log_debug_low("%s() return "
+				"VPOV_ERR_SOCK_BUF_RANGE\n", __func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_SOCK_BUF_RANGE;
+		} else {
+			prog_parms->inet_rx_sock_parms.rcvbuf = rx_buf;
+			prog_parms->inet6_rx_sock_parms.rcvbuf = rx_buf;
 		}
+	}
 
-		if (prog_opts->inet_tx_sock_out_intf_set) {
-			log_debug_low("%s() prog_opts->", __func__);
-			log_debug_low("inet_tx_sock_out_intf_set\n");
-			ret = inet_if_addr(prog_opts->inet_tx_sock_out_intf_str,
-				&prog_parms->inet_tx_sock_parms.out_intf_addr);	
-			if (ret == -1) {
-				log_debug_low("%s() return "
-					"VPOV_ERR_INET_OUT_INTF\n",
-						__func__);
-				log_debug_med("%s() exit\n", __func__);
-				return VPOV_ERR_INET_OUT_INTF;
-			}
+	if (prog_opts->rx_buf_max_set) {
+		log_debug_low("%s() prog_opts->rx_buf_max_set\n", __func__);
+		rx_buf_max = atoi(prog_opts->rx_buf_max_str);
+		if ((rx_buf_max < SOCK_BUF_MIN) ||
+		    (rx_buf_max > SOCK_BUF_MAX) ||
+		    (rx_buf_max < prog_parms->inet_rx_sock_parms.rcvbuf)) {
+			log_debug_low("%s() return "
+				"VPOV_ERR_SOCK_BUF_RANGE\n", __func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_SOCK_BUF_RANGE;
+		} else {
+			prog_parms->rx_batch_parms.buf_max = rx_buf_max;
 		}
 	}
 
-	if (prog_opts->inet6_tx_sock_dests_set) {
-		log_debug_low("%s() prog_opts->inet6_tx_sock_dests_set\n",
+	if (prog_opts->tx_buf_set) {
+		log_debug_low("%s() prog_opts->tx_buf_set\n", __func__);
+		tx_buf = atoi(prog_opts->tx_buf_str);
+		if ((tx_buf < SOCK_BUF_MIN) || (tx_buf > SOCK_BUF_MAX)) {
+			log_debug_low("%s() return "
+				"VPOV_ERR_SOCK_BUF_RANGE\n", __func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_SOCK_BUF_RANGE;
+		} else {
+			prog_parms->inet_tx_sock_parms.sndbuf = tx_buf;
+			prog_parms->inet6_tx_sock_parms.sndbuf = tx_buf;
+		}
+	}
+
+	if (prog_opts->rx_udp_gro_set) {
+		log_debug_low("%s() prog_opts->rx_udp_gro_set\n", __func__);
+		prog_parms->inet_rx_sock_parms.udp_gro = 1;
+		prog_parms->inet6_rx_sock_parms.udp_gro = 1;
+	}
+
+	if (prog_opts->rx_xdp_intf_set) {
+		log_debug_low("%s() prog_opts->rx_xdp_intf_set\n", __func__);
+		xdp_intf_idx = if_nametoindex(prog_opts->rx_xdp_intf_str);
+		if (xdp_intf_idx == 0) {
+			log_debug_low("%s() return VPOV_ERR_XDP_INTF\n",
 								__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_XDP_INTF;
+		} else {
+			prog_parms->inet_rx_sock_parms.xdp_intf_idx =
+								xdp_intf_idx;
+			prog_parms->inet6_rx_sock_parms.xdp_intf_idx =
+								xdp_intf_idx;
+		}
+	} else if (prog_opts->rx_xdp_queue_set || prog_opts->rx_xdp_skb_set) {
+		log_debug_low("%s() return VPOV_ERR_XDP_INTF\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		return VPOV_ERR_XDP_INTF;
+	}
 
-		ret = ap_pton_inet6_csv(
-				prog_opts->inet6_tx_sock_dests_str,
-				NULL, 0, 0, 0, &aip_ptoh_err, err_str_parm, 
-				err_str_size);
-		log_debug_low("%s() first ap_pton_inet6_csv() call = %d\n",
-			__func__, ret);
-		if (ret == -1) {
-			log_debug_low("%s() return VPOV_ERR_INET6_DST_ADDR\n",
-					__func__);
+	if (prog_opts->rx_xdp_queue_set) {
+		log_debug_low("%s() prog_opts->rx_xdp_queue_set\n", __func__);
+		xdp_queue = atoi(prog_opts->rx_xdp_queue_str);
+		if ((xdp_queue < 0) || (xdp_queue > XDP_QUEUE_MAX)) {
+			log_debug_low("%s() return "
+				"VPOV_ERR_XDP_QUEUE_RANGE\n", __func__);
 			log_debug_med("%s() exit\n", __func__);
-			return VPOV_ERR_INET6_DST_ADDR;
+			return VPOV_ERR_XDP_QUEUE_RANGE;
 		} else {
-			prog_parms->inet6_tx_sock_parms.dests =
-				(struct sockaddr_in6 *)
-				malloc((ret + 1) * sizeof(struct sockaddr_in6));
-			if (prog_parms->inet6_tx_sock_parms.dests == NULL) {
-				log_debug_low("%s() return", __func__);
-				log_debug_low(" VPOV_ERR_MEMORY\n");
-				log_debug_med("%s() exit\n", __func__);
-				return VPOV_ERR_MEMORY;
-			}
-			ret = ap_pton_inet6_csv(
-				prog_opts->inet6_tx_sock_dests_str,
-				prog_parms->inet6_tx_sock_parms.dests,
-				0, 1, 1, NULL, NULL, 0);
-			prog_parms->inet6_tx_sock_parms.dests_num = ret;
-			prog_parms->inet6_tx_sock_parms.mc_dests_num = 
-				num_inet6_mcaddrs(
-					prog_parms->inet6_tx_sock_parms.dests,
-					prog_parms->
-						inet6_tx_sock_parms.dests_num);
-			log_debug_low("%s() num_inet6_mcaddrs = %d\n", __func__,
-				prog_parms->inet6_tx_sock_parms.mc_dests_num);
+			prog_parms->inet_rx_sock_parms.xdp_queue = xdp_queue;
+			prog_parms->inet6_rx_sock_parms.xdp_queue = xdp_queue;
 		}
+	}
 
-		if (prog_opts->inet6_tx_sock_mc_hops_set) {
-			mc_hops = atoi(prog_opts->inet6_tx_sock_mc_hops_str);
-			if ((mc_hops < 0) || (mc_hops > 255)) {
-				log_debug_low("%s() return "
-					"VPOV_ERR_INET6_TX_HOPS_RANGE\n",
-						__func__);
-				log_debug_med("%s() exit\n", __func__);
-				return VPOV_ERR_INET6_TX_HOPS_RANGE;
-			} else {
-				prog_parms->inet6_tx_sock_parms.mc_hops =
-								mc_hops;
-			}
+	if (prog_opts->rx_xdp_skb_set) {
+		log_debug_low("%s() prog_opts->rx_xdp_skb_set\n", __func__);
+		prog_parms->inet_rx_sock_parms.xdp_skb_mode = 1;
+		prog_parms->inet6_rx_sock_parms.xdp_skb_mode = 1;
+	}
+
+	if (prog_opts->rx_pkt_ring_intf_set) {
+		log_debug_low("%s() prog_opts->rx_pkt_ring_intf_set\n",
+								__func__);
+		pkt_ring_intf_idx = if_nametoindex(
+					prog_opts->rx_pkt_ring_intf_str);
+		if (pkt_ring_intf_idx == 0) {
+			log_debug_low("%s() return VPOV_ERR_PKT_RING_INTF\n",
+								__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_PKT_RING_INTF;
+		} else {
+			prog_parms->inet_rx_sock_parms.pkt_ring_intf_idx =
+							pkt_ring_intf_idx;
+			prog_parms->inet6_rx_sock_parms.pkt_ring_intf_idx =
+							pkt_ring_intf_idx;
 		}
+	} else if (prog_opts->rx_pkt_ring_tov_set) {
+		log_debug_low("%s() return VPOV_ERR_PKT_RING_INTF\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		return VPOV_ERR_PKT_RING_INTF;
+	}
 
-		if (prog_opts->inet6_tx_sock_mc_loop_set) {
-			log_debug_low("%s() prog_opts->", __func__);
-			log_debug_low("inet6_tx_sock_mc_loop_set\n");
-			prog_parms->inet6_tx_sock_parms.mc_loop = 1;
+	if (prog_opts->rx_pkt_ring_tov_set) {
+		log_debug_low("%s() prog_opts->rx_pkt_ring_tov_set\n",
+								__func__);
+		pkt_ring_tov = atoi(prog_opts->rx_pkt_ring_tov_str);
+		if ((pkt_ring_tov < 1) || (pkt_ring_tov > PKT_RING_TOV_MAX)) {
+			log_debug_low("%s() return "
+				"VPOV_ERR_PKT_RING_TOV_RANGE\n", __func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_PKT_RING_TOV_RANGE;
+		} else {
+			prog_parms->inet_rx_sock_parms.pkt_ring_block_tov =
+								pkt_ring_tov;
+			prog_parms->inet6_rx_sock_parms.pkt_ring_block_tov =
+								pkt_ring_tov;
 		}
+	}
 
-		if (prog_opts->inet6_tx_sock_out_intf_set) {
-			out_intf_idx = if_nametoindex(prog_opts->
-						inet6_tx_sock_out_intf_str);
-			if (out_intf_idx == 0) {
-				log_debug_low("%s() return "
-					"VPOV_ERR_INET6_OUT_INTF\n",
-						__func__);
-				log_debug_med("%s() exit\n", __func__);
-				return VPOV_ERR_INET6_OUT_INTF;
-			}
-			prog_parms->inet6_tx_sock_parms.out_intf_idx =
-								 out_intf_idx;
+	if (prog_opts->rx_xdp_intf_set && prog_opts->rx_pkt_ring_intf_set) {
+		log_debug_low("%s() return VPOV_ERR_RX_PATH_OPTS\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		return VPOV_ERR_RX_PATH_OPTS;
+	}
+
+	if (prog_opts->engine_set) {
+		log_debug_low("%s() prog_opts->engine_set\n", __func__);
+		if (strcmp(prog_opts->engine_str, "loop") == 0) {
+			prog_parms->engine = ENGINE_LOOP;
+		} else if (strcmp(prog_opts->engine_str, "uring") == 0) {
+			prog_parms->engine = ENGINE_URING;
+		} else if (strcmp(prog_opts->engine_str, "pipe") == 0) {
+			prog_parms->engine = ENGINE_PIPE;
+		} else {
+			log_debug_low("%s() return VPOV_ERR_ENGINE\n",
+								__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_ENGINE;
 		}
 	}
 
-	log_debug_low("%s() return VPOV_OPTS_VALS_VALID\n", __func__);
-	log_debug_med("%s() exit\n", __func__);
+	/*
+	 * The io_uring engine receives and sends single datagrams from its
+	 * UDP socket, so the receive batching, AF_XDP and AF_PACKET ring
+	 * receive, and the segmentation and zero copy transmit options of
+	 * the loop engine don't apply to it.
+	 */
+	if ((prog_parms->engine == ENGINE_URING) &&
+	    (prog_opts->rx_batch_size_set || prog_opts->rx_batch_wait_set ||
+	     prog_opts->rx_udp_gro_set || prog_opts->rx_xdp_intf_set ||
+	     prog_opts->rx_pkt_ring_intf_set ||
+	     prog_opts->inet_tx_sock_udp_gso_set ||
+	     prog_opts->inet_tx_sock_zerocopy_set ||
+	     prog_opts->inet_tx_sock_connect_set ||
+	     prog_opts->inet6_tx_sock_udp_gso_set ||
+	     prog_opts->inet6_tx_sock_zerocopy_set ||
+	     prog_opts->inet6_tx_sock_connect_set ||
+	     prog_opts->tx_backlog_set)) {
+		log_debug_low("%s() return VPOV_ERR_ENGINE_OPTS\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		return VPOV_ERR_ENGINE_OPTS;
+	}
 
-	return VPOV_OPTS_VALS_VALID;
+	/*
+	 * The pipe engine overlaps IPv4 and IPv6 transmission, so only
+	 * applies when there are both.
+	 */
+	if ((prog_parms->engine == ENGINE_PIPE) &&
+	    (prog_parms->rc_mode != RCMODE_INET_TO_INET_INET6) &&
+	    (prog_parms->rc_mode != RCMODE_INET6_TO_INET_INET6)) {
+		log_debug_low("%s() return VPOV_ERR_ENGINE_MODE\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		return VPOV_ERR_ENGINE_MODE;
+	}
 
-}
+	/*
+	 * Busy polling and receive timestamps apply to the UDP receive socket,
+	 * not to the AF_XDP and AF_PACKET rings or the io_uring engine's
+	 * receive. The pipe engine transmits on other threads, so the
+	 * receive thread can't see when a datagram was sent.
+	 */
+	if ((prog_opts->rx_busy_poll_set || prog_opts->rx_busy_idle_set) &&
+	    (!prog_opts->rx_busy_poll_set || prog_opts->rx_xdp_intf_set ||
+	     prog_opts->rx_pkt_ring_intf_set ||
+	     (prog_parms->engine == ENGINE_URING))) {
+		log_debug_low("%s() return VPOV_ERR_RX_BUSY_POLL_OPTS\n",
+								__func__);
+		log_debug_med("%s() exit\n", __func__);
+		return VPOV_ERR_RX_BUSY_POLL_OPTS;
+	}
 
+	if (prog_opts->rx_latency_set &&
+	    (prog_opts->rx_xdp_intf_set || prog_opts->rx_pkt_ring_intf_set ||
+	     (prog_parms->engine != ENGINE_LOOP))) {
+		log_debug_low("%s() return VPOV_ERR_RX_LATENCY_OPTS\n",
+								__func__);
+		log_debug_med("%s() exit\n", __func__);
+		return VPOV_ERR_RX_LATENCY_OPTS;
+	}
 
-int validate_prog_opts_values(const struct program_options *prog_opts,
-			      struct program_parameters *prog_parms,
-			      char *err_str_parm,
-			      const unsigned int err_str_size)
-{
-	enum VALIDATE_PROG_OPTS_VALS vpov;
-	int ret = -1;
+	/*
+	 * The receive buffer is only grown from the UDP socket receive loop,
+	 * which the io_uring engine and the AF_XDP and AF_PACKET rings don't
+	 * use.
+	 */
+	if (prog_opts->rx_buf_max_set &&
+	    (prog_opts->rx_xdp_intf_set || prog_opts->rx_pkt_ring_intf_set ||
+	     (prog_parms->engine == ENGINE_URING))) {
+		log_debug_low("%s() return VPOV_ERR_RX_BUF_OPTS\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		return VPOV_ERR_RX_BUF_OPTS;
+	}
 
+	/*
+	 * Connected destinations are sent their own batch of datagrams with
+	 * sendmmsg(), which doesn't combine with the GSO super-buffers or the
+	 * zero copy completion tracking of the shared socket.
+	 */
+	if ((prog_opts->inet_tx_sock_connect_set &&
+	     (prog_opts->inet_tx_sock_udp_gso_set ||
+	      prog_opts->inet_tx_sock_zerocopy_set)) ||
+	    (prog_opts->inet6_tx_sock_connect_set &&
+	     (prog_opts->inet6_tx_sock_udp_gso_set ||
+	      prog_opts->inet6_tx_sock_zerocopy_set))) {
+		log_debug_low("%s() return VPOV_ERR_CONNECT_OPTS\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		return VPOV_ERR_CONNECT_OPTS;
+	}
 
-	vpov = validate_prog_opts_vals(prog_opts, prog_parms,
-						err_str_parm, err_str_size);
-	switch (vpov) {
-	case VPOV_ERR_SRC_ADDR:
-		log_opt_error(OE_SRC_GRP_ADDR, NULL);
-		break;
-	case VPOV_ERR_IF_ADDR:
-		log_opt_error(OE_IF_ADDR, NULL);
-		break;
-	case VPOV_ERR_SRC_PORT:
-		log_opt_error(OE_SRC_PORT, NULL);
-		break;
-	case VPOV_ERR_DST_PORT:
-		log_opt_error(OE_DST_PORT, NULL);
-		break;
-	case VPOV_ERR_INET_DST_ADDR:
-		log_opt_error(OE_INET_DST_ADDR, NULL);
-		break;
-	case VPOV_ERR_INET_TX_MCTTL_RANGE:
-		log_opt_error(OE_INET_TX_MCTTL_RANGE, NULL);
-		break;
-	case VPOV_ERR_INET_OUT_INTF:
-		log_opt_error(OE_INET_OUT_INTF, NULL);
-		break;
-	case VPOV_ERR_INET6_OUT_INTF:
-		log_opt_error(OE_INET6_OUT_INTF, NULL);
-		break;
-	case VPOV_ERR_INET6_DST_ADDR:
-		log_opt_error(OE_INET6_DST_ADDR, NULL);
-		break;
-	case VPOV_ERR_INET6_TX_HOPS_RANGE:
-		log_opt_error(OE_INET6_TX_HOPS_RANGE, NULL);
-		break;
-	case VPOV_ERR_MEMORY:
-		log_opt_error(OE_MEMORY_ERROR, NULL);
-		break;
-	case VPOV_ERR_UNKNOWN:
-		log_opt_error(OE_UNKNOWN_ERROR, NULL);
-		break;
-	case VPOV_OPTS_VALS_VALID:
-		ret = 0;
-		break;
-	default:
-		break;
+	if (prog_opts->tx_backlog_set) {
+		log_debug_low("%s() prog_opts->tx_backlog_set\n", __func__);
+		tx_backlog = atoi(prog_opts->tx_backlog_str);
+		if ((tx_backlog < 1) || (tx_backlog > TX_BACKLOG_MAX)) {
+			log_debug_low("%s() return VPOV_ERR_TX_BACKLOG_RANGE\n",
+								__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_TX_BACKLOG_RANGE;
+		} else {
+			prog_parms->inet_tx_sock_parms.backlog = tx_backlog;
+			prog_parms->inet6_tx_sock_parms.backlog = tx_backlog;
+		}
+	}
+
+	/*
+	 * Backlogged datagrams are sent one destination at a time from the
+	 * forwarding loop, rather than as GSO runs or zero copy buffers, and
+	 * the pipe engine's transmit threads have no writable wait.
+	 */
+	if (prog_opts->tx_backlog_set &&
+	    (prog_opts->inet_tx_sock_udp_gso_set ||
+	     prog_opts->inet_tx_sock_zerocopy_set ||
+	     prog_opts->inet6_tx_sock_udp_gso_set ||
+	     prog_opts->inet6_tx_sock_zerocopy_set ||
+	     (prog_parms->engine == ENGINE_PIPE))) {
+		log_debug_low("%s() return VPOV_ERR_TX_BACKLOG_OPTS\n",
+								__func__);
+		log_debug_med("%s() exit\n", __func__);
+		return VPOV_ERR_TX_BACKLOG_OPTS;
+	}
+
+	if (prog_opts->tx_rate_set) {
+		log_debug_low("%s() prog_opts->tx_rate_set\n", __func__);
+		tx_rate = atoi(prog_opts->tx_rate_str);
+		if ((tx_rate < 1) || (tx_rate > TX_RATE_MAX)) {
+			log_debug_low("%s() return VPOV_ERR_TX_RATE_RANGE\n",
+								__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_TX_RATE_RANGE;
+		} else {
+			prog_parms->tx_rate = tx_rate;
+		}
+	}
+
+	if (prog_opts->tx_dest_rate_set) {
+		log_debug_low("%s() prog_opts->tx_dest_rate_set\n", __func__);
+		tx_rate = atoi(prog_opts->tx_dest_rate_str);
+		if ((tx_rate < 1) || (tx_rate > TX_RATE_MAX)) {
+			log_debug_low("%s() return VPOV_ERR_TX_RATE_RANGE\n",
+								__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_TX_RATE_RANGE;
+		} else {
+			prog_parms->inet_tx_sock_parms.dest_rate = tx_rate;
+			prog_parms->inet6_tx_sock_parms.dest_rate = tx_rate;
+		}
+	}
+
+	if (prog_opts->inet_tx_sock_rate_set) {
+		log_debug_low("%s() prog_opts->inet_tx_sock_rate_set\n",
+								__func__);
+		tx_rate = atoi(prog_opts->inet_tx_sock_rate_str);
+		if ((tx_rate < 1) || (tx_rate > TX_RATE_MAX)) {
+			log_debug_low("%s() return VPOV_ERR_TX_RATE_RANGE\n",
+								__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_TX_RATE_RANGE;
+		} else {
+			prog_parms->inet_tx_sock_parms.rate = tx_rate;
+		}
+	}
+
+	if (prog_opts->inet6_tx_sock_rate_set) {
+		log_debug_low("%s() prog_opts->inet6_tx_sock_rate_set\n",
+								__func__);
+		tx_rate = atoi(prog_opts->inet6_tx_sock_rate_str);
+		if ((tx_rate < 1) || (tx_rate > TX_RATE_MAX)) {
+			log_debug_low("%s() return VPOV_ERR_TX_RATE_RANGE\n",
+								__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_TX_RATE_RANGE;
+		} else {
+			prog_parms->inet6_tx_sock_parms.rate = tx_rate;
+		}
+	}
+
+	if (prog_opts->tx_rate_policy_set) {
+		log_debug_low("%s() prog_opts->tx_rate_policy_set\n",
+								__func__);
+		if (strcmp(prog_opts->tx_rate_policy_str, "queue") == 0) {
+			prog_parms->tx_rate_queue = 1;
+			prog_parms->inet_tx_sock_parms.rate_queue = 1;
+			prog_parms->inet6_tx_sock_parms.rate_queue = 1;
+		} else if (strcmp(prog_opts->tx_rate_policy_str,
+							"drop") != 0) {
+			log_debug_low("%s() return VPOV_ERR_TX_RATE_POLICY\n",
+								__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_TX_RATE_POLICY;
+		}
+	}
+
+	/*
+	 * Queued datagrams wait on the destinations' transmit backlogs.
+	 */
+	if (prog_parms->tx_rate_queue && !prog_opts->tx_backlog_set) {
+		log_debug_low("%s() return VPOV_ERR_TX_RATE_QUEUE\n",
+								__func__);
+		log_debug_med("%s() exit\n", __func__);
+		return VPOV_ERR_TX_RATE_QUEUE;
+	}
+
+	/*
+	 * Each datagram is checked against the rate limits for each
+	 * destination, so GSO runs and zero copy buffers don't apply, and
+	 * the shaper's buckets aren't shared between threads.
+	 */
+	if ((prog_opts->tx_rate_set || prog_opts->tx_dest_rate_set ||
+	     prog_opts->inet_tx_sock_rate_set ||
+	     prog_opts->inet6_tx_sock_rate_set) &&
+	    (prog_opts->inet_tx_sock_udp_gso_set ||
+	     prog_opts->inet_tx_sock_zerocopy_set ||
+	     prog_opts->inet6_tx_sock_udp_gso_set ||
+	     prog_opts->inet6_tx_sock_zerocopy_set ||
+	     (prog_parms->engine != ENGINE_LOOP))) {
+		log_debug_low("%s() return VPOV_ERR_TX_RATE_OPTS\n",
+								__func__);
+		log_debug_med("%s() exit\n", __func__);
+		return VPOV_ERR_TX_RATE_OPTS;
+	}
+
+	if (prog_opts->tx_pace_mode_set) {
+		log_debug_low("%s() prog_opts->tx_pace_mode_set\n", __func__);
+		if (strcmp(prog_opts->tx_pace_mode_str, "fq") == 0) {
+			tx_pace_mode = TX_PACE_FQ;
+		} else if (strcmp(prog_opts->tx_pace_mode_str, "etf") == 0) {
+			tx_pace_mode = TX_PACE_ETF;
+		} else if (strcmp(prog_opts->tx_pace_mode_str, "timer") == 0) {
+			tx_pace_mode = TX_PACE_TIMER;
+		} else {
+			log_debug_low("%s() return VPOV_ERR_TX_PACE_MODE\n",
+								__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_TX_PACE_MODE;
+		}
+	}
+
+	if (prog_opts->tx_pace_set) {
+		log_debug_low("%s() prog_opts->tx_pace_set\n", __func__);
+		if (strcmp(prog_opts->tx_pace_str, "input") == 0) {
+			prog_parms->inet_tx_sock_parms.pace_input = 1;
+			prog_parms->inet6_tx_sock_parms.pace_input = 1;
+			prog_parms->rx_batch_parms.tstamps = 1;
+		} else {
+			tx_pace = atoi(prog_opts->tx_pace_str);
+			if ((tx_pace < 1) || (tx_pace > TX_RATE_MAX)) {
+				log_debug_low("%s() return VPOV_ERR_TX_PACE\n",
+								__func__);
+				log_debug_med("%s() exit\n", __func__);
+				return VPOV_ERR_TX_PACE;
+			}
+			prog_parms->inet_tx_sock_parms.pace_rate = tx_pace;
+			prog_parms->inet6_tx_sock_parms.pace_rate = tx_pace;
+		}
+		prog_parms->inet_tx_sock_parms.pace_mode = tx_pace_mode;
+		prog_parms->inet6_tx_sock_parms.pace_mode = tx_pace_mode;
+	}
+
+	/*
+	 * Each datagram is given its own departure time, which GSO runs and
+	 * the backlogs and rate limits, which decide themselves when a
+	 * datagram is sent, don't allow for. Pacing to the input spacing
+	 * needs the UDP receive socket's timestamps.
+	 */
+	if (prog_opts->tx_pace_set &&
+	    ((prog_parms->rx_batch_parms.tstamps &&
+	      (prog_opts->rx_xdp_intf_set ||
+	       prog_opts->rx_pkt_ring_intf_set)) ||
+	     prog_opts->inet_tx_sock_udp_gso_set ||
+	     prog_opts->inet_tx_sock_zerocopy_set ||
+	     prog_opts->inet6_tx_sock_udp_gso_set ||
+	     prog_opts->inet6_tx_sock_zerocopy_set ||
+	     prog_opts->tx_backlog_set || prog_opts->tx_rate_set ||
+	     prog_opts->tx_dest_rate_set ||
+	     prog_opts->inet_tx_sock_rate_set ||
+	     prog_opts->inet6_tx_sock_rate_set ||
+	     (prog_parms->engine != ENGINE_LOOP))) {
+		log_debug_low("%s() return VPOV_ERR_TX_PACE_OPTS\n",
+								__func__);
+		log_debug_med("%s() exit\n", __func__);
+		return VPOV_ERR_TX_PACE_OPTS;
+	}
+
+	if (prog_opts->workers_set) {
+		log_debug_low("%s() prog_opts->workers_set\n", __func__);
+		workers_num = atoi(prog_opts->workers_str);
+		if ((workers_num < 1) || (workers_num > WORKERS_MAX)) {
+			log_debug_low("%s() return VPOV_ERR_WORKERS_RANGE\n",
+								__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_WORKERS_RANGE;
+		} else {
+			prog_parms->workers_num = workers_num;
+			prog_parms->inet_rx_sock_parms.workers_num =
+								workers_num;
+			prog_parms->inet6_rx_sock_parms.workers_num =
+								workers_num;
+		}
+	}
+
+	/*
+	 * AF_XDP and AF_PACKET ring receive are tied to a single interface
+	 * queue or socket, which the workers can't share. The pipe engine is
+	 * an alternative way of using more threads.
+	 */
+	if ((prog_parms->workers_num > 1) &&
+	    (prog_opts->rx_xdp_intf_set || prog_opts->rx_pkt_ring_intf_set ||
+	     (prog_parms->engine == ENGINE_PIPE) ||
+	     prog_opts->tx_rate_set || prog_opts->tx_dest_rate_set ||
+	     prog_opts->inet_tx_sock_rate_set ||
+	     prog_opts->inet6_tx_sock_rate_set)) {
+		log_debug_low("%s() return VPOV_ERR_WORKERS_OPTS\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		return VPOV_ERR_WORKERS_OPTS;
+	}
+
+	if (prog_opts->rx_cpus_set) {
+		log_debug_low("%s() prog_opts->rx_cpus_set\n", __func__);
+		if (parse_cpu_list(prog_opts->rx_cpus_str, prog_parms->rx_cpus,
+					&prog_parms->rx_cpus_num) == -1) {
+			log_debug_low("%s() return VPOV_ERR_CPU_LIST\n",
+								__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_CPU_LIST;
+		}
+	}
+
+	if (prog_opts->tx_cpus_set) {
+		log_debug_low("%s() prog_opts->tx_cpus_set\n", __func__);
+		if (parse_cpu_list(prog_opts->tx_cpus_str, prog_parms->tx_cpus,
+					&prog_parms->tx_cpus_num) == -1) {
+			log_debug_low("%s() return VPOV_ERR_CPU_LIST\n",
+								__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_CPU_LIST;
+		}
+	}
+
+	/*
+	 * Only the pipe engine transmits on threads of its own, the other
+	 * engines transmit from the receiving threads.
+	 */
+	if (prog_opts->tx_cpus_set && (prog_parms->engine != ENGINE_PIPE)) {
+		log_debug_low("%s() return VPOV_ERR_TX_CPU_OPTS\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		return VPOV_ERR_TX_CPU_OPTS;
+	}
+
+	if (prog_opts->rt_prio_set) {
+		log_debug_low("%s() prog_opts->rt_prio_set\n", __func__);
+		rt_prio = atoi(prog_opts->rt_prio_str);
+		if ((rt_prio < 1) || (rt_prio > RT_PRIO_MAX)) {
+			log_debug_low("%s() return VPOV_ERR_RT_PRIO\n",
+								__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_RT_PRIO;
+		} else {
+			prog_parms->rt_prio = rt_prio;
+		}
+	}
+
+	if (prog_opts->mem_lock_set) {
+		log_debug_low("%s() prog_opts->mem_lock_set\n", __func__);
+		prog_parms->mem_lock = 1;
+	}
+
+	if (prog_opts->inet_rx_sock_mcgroup_set) {
+		log_debug_low("%s() prog_opts->inet_rx_sock_mcgroup_set\n",
+								__func__);
+		ret = aip_ptoh_inet(prog_opts->inet_rx_sock_mcgroup_str,
+			&prog_parms->inet_rx_sock_parms.rx_addr,
+			&in_intf_addr,
+			&prog_parms->inet_rx_sock_parms.port,
+			&aip_ptoh_err);
+		if (ret == -1) {
+			switch (aip_ptoh_err) {
+			case INETADDR_ERR_ADDR:
+				log_debug_low("%s() return "
+					"VPOV_ERR_SRC_ADDR\n",
+					__func__);
+				log_debug_med("%s() exit\n", __func__);
+				return VPOV_ERR_SRC_ADDR;
+				break;
+			case INETADDR_ERR_IFADDR:
+				log_debug_low("%s() return "
+					"VPOV_ERR_IF_ADDR\n",
+					__func__);
+				log_debug_med("%s() exit\n", __func__);
+				return VPOV_ERR_IF_ADDR;
+				break;
+			case INETADDR_ERR_PORT:
+				log_debug_low("%s() return "
+					"VPOV_ERR_SRC_PORT\n",
+					__func__);
+				log_debug_med("%s() exit\n", __func__);
+				return VPOV_ERR_SRC_PORT;
+				break;
+			default:
+				log_debug_low("%s() return "
+					"VPOV_ERR_UNKNOWN\n",
+					__func__);
+				log_debug_med("%s() exit\n", __func__);
+				return VPOV_ERR_UNKNOWN;
+				break;
+			}
+		} else {
+			if (in_intf_addr.s_addr != ntohl(INADDR_NONE)) {
+				prog_parms->inet_rx_sock_parms.in_intf_addr =
+					in_intf_addr;
+			}
+			if (prog_parms->inet_rx_sock_parms.port == 0) {
+				log_debug_low("%s() return "
+					"VPOV_ERR_SRC_PORT\n", __func__);
+				log_debug_med("%s() exit\n", __func__);
+				return VPOV_ERR_SRC_PORT;
+			}
+		}
+	}
+
+	if (prog_opts->inet6_rx_sock_mcgroup_set) {
+		log_debug_low("%s() prog_opts->inet6_rx_sock_mcgroup_set\n",
+								__func__);
+		ret = aip_ptoh_inet6(prog_opts->inet6_rx_sock_mcgroup_str,
+			&prog_parms->inet6_rx_sock_parms.rx_addr,
+			&prog_parms->inet6_rx_sock_parms.in_intf_idx,
+			&prog_parms->inet6_rx_sock_parms.port,
+			&aip_ptoh_err);
+		if (ret == -1) {
+			switch (aip_ptoh_err) {
+			case INETADDR_ERR_ADDR:
+				log_debug_low("%s() return "
+					"VPOV_ERR_SRC_ADDR\n",
+					__func__);
+				log_debug_med("%s() exit\n", __func__);
+				return VPOV_ERR_SRC_ADDR;
+				break;
+			case INETADDR_ERR_PORT:
+				log_debug_low("%s() return "
+					"VPOV_ERR_SRC_PORT\n",
+					__func__);
+				log_debug_med("%s() exit\n", __func__);
+				return VPOV_ERR_SRC_PORT;
+				break;
+			default:
+				log_debug_low("%s() return "
+					"VPOV_ERR_UNKNOWN\n",
+					__func__);
+				log_debug_med("%s() exit\n", __func__);
+				return VPOV_ERR_UNKNOWN;
+				break;
+			}
+		} else {
+			if (prog_parms->inet6_rx_sock_parms.port == 0) {
+				log_debug_low("%s() return "
+					"VPOV_ERR_SRC_PORT\n", __func__);
+				log_debug_med("%s() exit\n", __func__);
+				return VPOV_ERR_SRC_PORT;
+			}
+		}
+	}
+
+	if (prog_opts->inet_tx_sock_dests_set) {
+		log_debug_low("%s() prog_opts->inet_tx_sock_dests_set\n",
+								__func__);
+		ret = ap_pton_inet_csv(
+				prog_opts->inet_tx_sock_dests_str,
+				NULL, 0, 0, 0, &aip_ptoh_err, err_str_parm, 
+				err_str_size);
+		log_debug_low("%s() first ap_pton_inet_csv() call = %d\n",
+			__func__, ret);
+		if (ret == -1) {
+			log_debug_low("%s() return VPOV_ERR_INET_DST_ADDR\n",
+					__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_INET_DST_ADDR;
+		} else {
+			prog_parms->inet_tx_sock_parms.dests =
+				(struct sockaddr_in *)
+				malloc((ret + 1) * sizeof(struct sockaddr_in));
+			if (prog_parms->inet_tx_sock_parms.dests == NULL) {
+				log_debug_low("%s() return", __func__);
+				log_debug_low(" VPOV_ERR_MEMORY\n");
+				log_debug_med("%s() exit\n", __func__);
+				return VPOV_ERR_MEMORY;
+			}
+			ret = ap_pton_inet_csv(
+				prog_opts->inet_tx_sock_dests_str,
+				prog_parms->inet_tx_sock_parms.dests,
+				0, 1, 1, NULL, NULL, 0);
+			prog_parms->inet_tx_sock_parms.dests_num = ret;
+			prog_parms->inet_tx_sock_parms.mc_dests_num = 
+				num_inet_mcaddrs(
+					prog_parms->inet_tx_sock_parms.dests,
+					prog_parms->
+						inet_tx_sock_parms.dests_num);
+			log_debug_low("%s() num_inet_mcaddrs = %d\n", __func__,
+				prog_parms->inet_tx_sock_parms.mc_dests_num);
+		}
+
+		if (prog_opts->inet_tx_sock_mc_ttl_set) {
+			log_debug_low("%s() prog_opts->", __func__);
+			log_debug_low("inet_tx_sock_mc_ttl_set\n");
+			tx_ttl = atoi(prog_opts->inet_tx_sock_mc_ttl_str);
+			if ((tx_ttl < 0) || (tx_ttl > 255)) {
+				log_debug_low("%s() return "
+					"VPOV_ERR_INET_TX_MCTTL_RANGE\n",
+						__func__);
+				log_debug_med("%s() exit\n", __func__);
+				return VPOV_ERR_INET_TX_MCTTL_RANGE;
+			} else {
+				prog_parms->inet_tx_sock_parms.mc_ttl =
+									tx_ttl;
+			}
+		}
+
+		if (prog_opts->inet_tx_sock_mc_loop_set) {
+			log_debug_low("%s() prog_opts->", __func__);
+			log_debug_low("inet_tx_mc_sock_mc_loop_set\n");
+			prog_parms->inet_tx_sock_parms.mc_loop = 1;
+		}
+
+		if (prog_opts->inet_tx_sock_udp_gso_set) {
+			log_debug_low("%s() prog_opts->", __func__);
+			log_debug_low("inet_tx_sock_udp_gso_set\n");
+			prog_parms->inet_tx_sock_parms.udp_gso = 1;
+		}
+
+		if (prog_opts->inet_tx_sock_zerocopy_set) {
+			log_debug_low("%s() prog_opts->", __func__);
+			log_debug_low("inet_tx_sock_zerocopy_set\n");
+			prog_parms->inet_tx_sock_parms.zerocopy = 1;
+		}
+
+		if (prog_opts->inet_tx_sock_connect_set) {
+			log_debug_low("%s() prog_opts->", __func__);
+			log_debug_low("inet_tx_sock_connect_set\n");
+			prog_parms->inet_tx_sock_parms.connect = 1;
+		}
+
+		if (prog_opts->inet_tx_sock_out_intf_set) {
+			log_debug_low("%s() prog_opts->", __func__);
+			log_debug_low("inet_tx_sock_out_intf_set\n");
+			ret = inet_if_addr(prog_opts->inet_tx_sock_out_intf_str,
+				&prog_parms->inet_tx_sock_parms.out_intf_addr);	
+			if (ret == -1) {
+				log_debug_low("%s() return "
+					"VPOV_ERR_INET_OUT_INTF\n",
+						__func__);
+				log_debug_med("%s() exit\n", __func__);
+				return VPOV_ERR_INET_OUT_INTF;
+			}
+		}
+	}
+
+	if (prog_opts->inet6_tx_sock_dests_set) {
+		log_debug_low("%s() prog_opts->inet6_tx_sock_dests_set\n",
+								__func__);
+
+		ret = ap_pton_inet6_csv(
+				prog_opts->inet6_tx_sock_dests_str,
+				NULL, 0, 0, 0, &aip_ptoh_err, err_str_parm, 
+				err_str_size);
+		log_debug_low("%s() first ap_pton_inet6_csv() call = %d\n",
+			__func__, ret);
+		if (ret == -1) {
+			log_debug_low("%s() return VPOV_ERR_INET6_DST_ADDR\n",
+					__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_INET6_DST_ADDR;
+		} else {
+			prog_parms->inet6_tx_sock_parms.dests =
+				(struct sockaddr_in6 *)
+				malloc((ret + 1) * sizeof(struct sockaddr_in6));
+			if (prog_parms->inet6_tx_sock_parms.dests == NULL) {
+				log_debug_low("%s() return", __func__);
+				log_debug_low(" VPOV_ERR_MEMORY\n");
+				log_debug_med("%s() exit\n", __func__);
+				return VPOV_ERR_MEMORY;
+			}
+			ret = ap_pton_inet6_csv(
+				prog_opts->inet6_tx_sock_dests_str,
+				prog_parms->inet6_tx_sock_parms.dests,
+				0, 1, 1, NULL, NULL, 0);
+			prog_parms->inet6_tx_sock_parms.dests_num = ret;
+			prog_parms->inet6_tx_sock_parms.mc_dests_num = 
+				num_inet6_mcaddrs(
+					prog_parms->inet6_tx_sock_parms.dests,
+					prog_parms->
+						inet6_tx_sock_parms.dests_num);
+			log_debug_low("%s() num_inet6_mcaddrs = %d\n", __func__,
+				prog_parms->inet6_tx_sock_parms.mc_dests_num);
+		}
+
+		if (prog_opts->inet6_tx_sock_mc_hops_set) {
+			mc_hops = atoi(prog_opts->inet6_tx_sock_mc_hops_str);
+			if ((mc_hops < 0) || (mc_hops > 255)) {
+				log_debug_low("%s() return "
+					"VPOV_ERR_INET6_TX_HOPS_RANGE\n",
+						__func__);
+				log_debug_med("%s() exit\n", __func__);
+				return VPOV_ERR_INET6_TX_HOPS_RANGE;
+			} else {
+				prog_parms->inet6_tx_sock_parms.mc_hops =
+								mc_hops;
+			}
+		}
+
+		if (prog_opts->inet6_tx_sock_mc_loop_set) {
+			log_debug_low("%s() prog_opts->", __func__);
+			log_debug_low("inet6_tx_sock_mc_loop_set\n");
+			prog_parms->inet6_tx_sock_parms.mc_loop = 1;
+		}
+
+		if (prog_opts->inet6_tx_sock_udp_gso_set) {
+			log_debug_low("%s() prog_opts->", __func__);
+			log_debug_low("inet6_tx_sock_udp_gso_set\n");
+			prog_parms->inet6_tx_sock_parms.udp_gso = 1;
+		}
+
+		if (prog_opts->inet6_tx_sock_zerocopy_set) {
+			log_debug_low("%s() prog_opts->", __func__);
+			log_debug_low("inet6_tx_sock_zerocopy_set\n");
+			prog_parms->inet6_tx_sock_parms.zerocopy = 1;
+		}
+
+		if (prog_opts->inet6_tx_sock_connect_set) {
+			log_debug_low("%s() prog_opts->", __func__);
+			log_debug_low("inet6_tx_sock_connect_set\n");
+			prog_parms->inet6_tx_sock_parms.connect = 1;
+		}
+
+		if (prog_opts->inet6_tx_sock_out_intf_set) {
+			out_intf_idx = if_nametoindex(prog_opts->
+						inet6_tx_sock_out_intf_str);
+			if (out_intf_idx == 0) {
+				log_debug_low("%s() return "
+					"VPOV_ERR_INET6_OUT_INTF\n",
+						__func__);
+				log_debug_med("%s() exit\n", __func__);
+				return VPOV_ERR_INET6_OUT_INTF;
+			}
+			prog_parms->inet6_tx_sock_parms.out_intf_idx =
+								 out_intf_idx;
+		}
+	}
+
+	/*
+	 * The kernel counts the multicast datagrams a worker's socket filter
+	 * leaves to the other workers as drops, so they can't be told apart
+	 * from those for a full receive buffer.
+	 */
+	if (prog_opts->rx_buf_max_set && (prog_parms->workers_num > 1) &&
+	    (IN_MULTICAST(ntohl(prog_parms->inet_rx_sock_parms.rx_addr.s_addr)) ||
+	     IN6_IS_ADDR_MULTICAST(&prog_parms->inet6_rx_sock_parms.rx_addr))) {
+		log_debug_low("%s() return VPOV_ERR_RX_BUF_OPTS\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		return VPOV_ERR_RX_BUF_OPTS;
+	}
+
+	if (prog_opts->flows_set) {
+		log_debug_low("%s() prog_opts->flows_set\n", __func__);
+		prog_parms->flows_file = prog_opts->flows_str;
+	}
+
+	if (prog_opts->shm_stats_set) {
+		log_debug_low("%s() prog_opts->shm_stats_set\n", __func__);
+		prog_parms->shm_stats_file = prog_opts->shm_stats_str;
+	}
+
+	if (prog_opts->metrics_set) {
+		log_debug_low("%s() prog_opts->metrics_set\n", __func__);
+		if (parse_metrics_addr(prog_opts->metrics_str,
+				       &prog_parms->metrics_addr,
+				       &prog_parms->metrics_addr_len) == -1) {
+			log_debug_low("%s() return VPOV_ERR_METRICS_ADDR\n",
+								__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_METRICS_ADDR;
+		}
+		prog_parms->metrics_addr_str = prog_opts->metrics_str;
+	}
+
+	if (prog_opts->rates_set) {
+		log_debug_low("%s() prog_opts->rates_set\n", __func__);
+		rates_interval = atoi(prog_opts->rates_str);
+		if ((rates_interval < 1) ||
+		    (rates_interval > RATES_INTERVAL_MAX)) {
+			log_debug_low("%s() return VPOV_ERR_RATES_RANGE\n",
+								__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return VPOV_ERR_RATES_RANGE;
+		}
+		prog_parms->rates_interval = rates_interval;
+	}
+
+	/*
+	 * The flows are all forwarded by the main thread, waiting on their
+	 * receive sockets together, so nothing can block or spin on a single
+	 * socket, and the receive state shared by the flows can't be tuned
+	 * for any one of them.
+	 */
+	if (prog_opts->flows_set &&
+	    ((prog_parms->engine != ENGINE_LOOP) ||
+	     (prog_parms->workers_num > 1) ||
+	     prog_opts->rx_xdp_intf_set || prog_opts->rx_pkt_ring_intf_set ||
+	     prog_opts->rx_batch_wait_set || prog_opts->rx_busy_poll_set ||
+	     prog_opts->rx_latency_set || prog_opts->rx_buf_max_set ||
+	     prog_opts->tx_backlog_set || prog_opts->tx_rate_set ||
+	     prog_opts->tx_dest_rate_set || prog_opts->tx_rate_policy_set ||
+	     prog_opts->tx_pace_set)) {
+		log_debug_low("%s() return VPOV_ERR_FLOWS_OPTS\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		return VPOV_ERR_FLOWS_OPTS;
+	}
+
+	log_debug_low("%s() return VPOV_OPTS_VALS_VALID\n", __func__);
+	log_debug_med("%s() exit\n", __func__);
+
+	return VPOV_OPTS_VALS_VALID;
+
+}
+
+
+int validate_prog_opts_values(const struct program_options *prog_opts,
+			      struct program_parameters *prog_parms,
+			      char *err_str_parm,
+			      const unsigned int err_str_size)
+{
+	enum VALIDATE_PROG_OPTS_VALS vpov;
+	int ret = -1;
+
+
+	vpov = validate_prog_opts_vals(prog_opts, prog_parms,
+						err_str_parm, err_str_size);
+	switch (vpov) {
+	case VPOV_ERR_SRC_ADDR:
+		log_opt_error(OE_SRC_GRP_ADDR, NULL);
+		break;
+	case VPOV_ERR_IF_ADDR:
+		log_opt_error(OE_IF_ADDR, NULL);
+		break;
+	case VPOV_ERR_SRC_PORT:
+		log_opt_error(OE_SRC_PORT, NULL);
+		break;
+	case VPOV_ERR_DST_PORT:
+		log_opt_error(OE_DST_PORT, NULL);
+		break;
+	case VPOV_ERR_INET_DST_ADDR:
+		log_opt_error(OE_INET_DST_ADDR, NULL);
+		break;
+	case VPOV_ERR_INET_TX_MCTTL_RANGE:
+		log_opt_error(OE_INET_TX_MCTTL_RANGE, NULL);
+		break;
+	case VPOV_ERR_INET_OUT_INTF:
+		log_opt_error(OE_INET_OUT_INTF, NULL);
+		break;
+	case VPOV_ERR_INET6_OUT_INTF:
+		log_opt_error(OE_INET6_OUT_INTF, NULL);
+		break;
+	case VPOV_ERR_INET6_DST_ADDR:
+		log_opt_error(OE_INET6_DST_ADDR, NULL);
+		break;
+	case VPOV_ERR_INET6_TX_HOPS_RANGE:
+		log_opt_error(OE_INET6_TX_HOPS_RANGE, NULL);
+		break;
+	case VPOV_ERR_RX_BATCH_RANGE:
+		log_opt_error(OE_RX_BATCH_RANGE, NULL);
+		break;
+	case VPOV_ERR_RX_BATCH_WAIT_RANGE:
+		log_opt_error(OE_RX_BATCH_WAIT_RANGE, NULL);
+		break;
+	case VPOV_ERR_RX_BUSY_POLL_RANGE:
+		log_opt_error(OE_RX_BUSY_POLL_RANGE, NULL);
+		break;
+	case VPOV_ERR_RX_BUSY_IDLE_RANGE:
+		log_opt_error(OE_RX_BUSY_IDLE_RANGE, NULL);
+		break;
+	case VPOV_ERR_RX_BUSY_POLL_OPTS:
+		log_opt_error(OE_RX_BUSY_POLL_OPTS, NULL);
+		break;
+	case VPOV_ERR_RX_LATENCY_OPTS:
+		log_opt_error(OE_RX_LATENCY_OPTS, NULL);
+		break;
+	case VPOV_ERR_SOCK_BUF_RANGE:
+		log_opt_error(OE_SOCK_BUF_RANGE, NULL);
+		break;
+	case VPOV_ERR_RX_BUF_OPTS:
+		log_opt_error(OE_RX_BUF_OPTS, NULL);
+		break;
+	case VPOV_ERR_ENGINE:
+		log_opt_error(OE_ENGINE, NULL);
+		break;
+	case VPOV_ERR_ENGINE_OPTS:
+		log_opt_error(OE_ENGINE_OPTS, NULL);
+		break;
+	case VPOV_ERR_ENGINE_MODE:
+		log_opt_error(OE_ENGINE_MODE, NULL);
+		break;
+	case VPOV_ERR_CONNECT_OPTS:
+		log_opt_error(OE_CONNECT_OPTS, NULL);
+		break;
+	case VPOV_ERR_TX_BACKLOG_RANGE:
+		log_opt_error(OE_TX_BACKLOG_RANGE, NULL);
+		break;
+	case VPOV_ERR_TX_BACKLOG_OPTS:
+		log_opt_error(OE_TX_BACKLOG_OPTS, NULL);
+		break;
+	case VPOV_ERR_TX_RATE_RANGE:
+		log_opt_error(OE_TX_RATE_RANGE, NULL);
+		break;
+	case VPOV_ERR_TX_RATE_POLICY:
+		log_opt_error(OE_TX_RATE_POLICY, NULL);
+		break;
+	case VPOV_ERR_TX_RATE_QUEUE:
+		log_opt_error(OE_TX_RATE_QUEUE, NULL);
+		break;
+	case VPOV_ERR_TX_RATE_OPTS:
+		log_opt_error(OE_TX_RATE_OPTS, NULL);
+		break;
+	case VPOV_ERR_TX_PACE:
+		log_opt_error(OE_TX_PACE, NULL);
+		break;
+	case VPOV_ERR_TX_PACE_MODE:
+		log_opt_error(OE_TX_PACE_MODE, NULL);
+		break;
+	case VPOV_ERR_TX_PACE_OPTS:
+		log_opt_error(OE_TX_PACE_OPTS, NULL);
+		break;
+	case VPOV_ERR_XDP_INTF:
+		log_opt_error(OE_XDP_INTF, NULL);
+		break;
+	case VPOV_ERR_XDP_QUEUE_RANGE:
+		log_opt_error(OE_XDP_QUEUE_RANGE, NULL);
+		break;
+	case VPOV_ERR_PKT_RING_INTF:
+		log_opt_error(OE_PKT_RING_INTF, NULL);
+		break;
+	case VPOV_ERR_PKT_RING_TOV_RANGE:
+		log_opt_error(OE_PKT_RING_TOV_RANGE, NULL);
+		break;
+	case VPOV_ERR_RX_PATH_OPTS:
+		log_opt_error(OE_RX_PATH_OPTS, NULL);
+		break;
+	case VPOV_ERR_WORKERS_RANGE:
+		log_opt_error(OE_WORKERS_RANGE, NULL);
+		break;
+	case VPOV_ERR_WORKERS_OPTS:
+		log_opt_error(OE_WORKERS_OPTS, NULL);
+		break;
+	case VPOV_ERR_CPU_LIST:
+		log_opt_error(OE_CPU_LIST, NULL);
+		break;
+	case VPOV_ERR_RT_PRIO:
+		log_opt_error(OE_RT_PRIO, NULL);
+		break;
+	case VPOV_ERR_TX_CPU_OPTS:
+		log_opt_error(OE_TX_CPU_OPTS, NULL);
+		break;
+	case VPOV_ERR_FLOWS_OPTS:
+		log_opt_error(OE_FLOWS_OPTS, NULL);
+		break;
+	case VPOV_ERR_METRICS_ADDR:
+		log_opt_error(OE_METRICS_ADDR, NULL);
+		break;
+	case VPOV_ERR_RATES_RANGE:
+		log_opt_error(OE_RATES_RANGE, NULL);
+		break;
+	case VPOV_ERR_MEMORY:
+		log_opt_error(OE_MEMORY_ERROR, NULL);
+		break;
+	case VPOV_ERR_UNKNOWN:
+		log_opt_error(OE_UNKNOWN_ERROR, NULL);
+		break;
+	case VPOV_OPTS_VALS_VALID:
+		ret = 0;
+		break;
+	default:
+		break;
+	}
+
+	return ret;
+
+}
+
+
+/*
+ * Each line of the flows file gives a flow the way its addresses and
+ * per-family options would be given on the command line, e.g.
+ *
+ *	-4in 239.1.1.1:5000 -4out 192.0.2.1:5000,192.0.2.2:5000 -4mcttl 8
+ *
+ * Blank lines and anything after a '#' are ignored. The other command line
+ * options apply to every flow.
+ */
+int get_flows(struct program_parameters *prog_parms,
+	      char err_str[],
+	      const unsigned int err_str_size)
+{
+	static char prog_name[] = "replicast";
+	FILE *flows_file;
+	char line[FLOW_LINE_SIZE];
+	char *argv[FLOW_ARGS_MAX + 1];
+	int argc;
+	char *saveptr;
+	char *comment;
+	unsigned int line_num = 0;
+	struct flow_params *flows;
+	int ret = 0;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	flows_file = fopen(prog_parms->flows_file, "r");
+	if (flows_file == NULL) {
+		log_opt_error(OE_FLOWS_FILE, strerror(errno));
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	while ((ret == 0) && (fgets(line, sizeof(line), flows_file) != NULL)) {
+		line_num++;
+
+		if ((strchr(line, '\n') == NULL) && !feof(flows_file)) {
+			log_opt_error(OE_FLOW_LINE, NULL);
+			ret = -1;
+			break;
+		}
+
+		comment = strchr(line, '#');
+		if (comment != NULL) {
+			*comment = '\0';
+		}
+
+		argv[0] = prog_name;
+		argc = 1;
+		argv[argc] = strtok_r(line, " \t\r\n", &saveptr);
+		while ((argv[argc] != NULL) && (argc < FLOW_ARGS_MAX)) {
+			argc++;
+			argv[argc] = strtok_r(NULL, " \t\r\n", &saveptr);
+		}
+
+		if (argc == 1) {
+			continue;
+		}
+
+		if (argv[argc] != NULL) {
+			log_opt_error(OE_FLOW_LINE, NULL);
+			ret = -1;
+			break;
+		}
+
+		flows = realloc(prog_parms->flows, (prog_parms->flows_num + 1) *
+						sizeof(struct flow_params));
+		if (flows == NULL) {
+			log_opt_error(OE_MEMORY_ERROR, NULL);
+			ret = -1;
+			break;
+		}
+		prog_parms->flows = flows;
+
+		ret = get_flow(argc, argv, prog_parms,
+			       &prog_parms->flows[prog_parms->flows_num],
+			       err_str, err_str_size);
+		if (ret == 0) {
+			prog_parms->flows[prog_parms->flows_num].line =
+								line_num;
+			prog_parms->flows_num++;
+		}
+	}
+
+	fclose(flows_file);
+
+	if (ret == -1) {
+		log_msg(LOG_SEV_ERR, "In the flow on line %d of %s.\n",
+			line_num, prog_parms->flows_file);
+	} else if (prog_parms->flows_num == 0) {
+		log_opt_error(OE_NO_FLOWS, NULL);
+		ret = -1;
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return ret;
+
+}
+
+
+/*
+ * Parses a flow's line as if it were the command line, with the other
+ * options already taken from the real command line.
+ */
+int get_flow(int argc, char *argv[],
+	     const struct program_parameters *prog_parms,
+	     struct flow_params *flow_parms,
+	     char err_str[],
+	     const unsigned int err_str_size)
+{
+	struct program_options flow_opts;
+	struct program_parameters flow_prog_parms;
+	enum VALIDATE_PROG_OPTS vpo;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	init_prog_opts(&flow_opts);
+
+	/* start getopt_long_only() again on the new argv */
+	optind = 0;
+
+	get_prog_opts_cmdline(argc, argv, &flow_opts);
+
+	if (!flow_opts_valid(&flow_opts)) {
+		log_opt_error(OE_FLOW_OPTS, NULL);
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	flow_prog_parms = *prog_parms;
+
+	vpo = validate_prog_opts(&flow_opts);
+
+	switch (vpo) {
+	case VPO_MODE_INETINETINET6:
+		flow_prog_parms.rc_mode = RCMODE_INET_TO_INET_INET6;
+		break;
+	case VPO_MODE_INETINET:
+		flow_prog_parms.rc_mode = RCMODE_INET_TO_INET;
+		break;
+	case VPO_MODE_INETINET6:
+		flow_prog_parms.rc_mode = RCMODE_INET_TO_INET6;
+		break;
+	case VPO_MODE_INET6INETINET6:
+		flow_prog_parms.rc_mode = RCMODE_INET6_TO_INET_INET6;
+		break;
+	case VPO_MODE_INET6INET:
+		flow_prog_parms.rc_mode = RCMODE_INET6_TO_INET;
+		break;
+	case VPO_MODE_INET6INET6:
+		flow_prog_parms.rc_mode = RCMODE_INET6_TO_INET6;
+		break;
+	case VPO_ERR_UNKNOWN_OPT:
+		log_opt_error(OE_UNKNOWN_OPT, NULL);
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	case VPO_ERR_NO_SRC_ADDR:
+		log_opt_error(OE_NO_SRC_ADDR, NULL);
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	case VPO_ERR_MULTI_SRC_ADDRS:
+		log_opt_error(OE_MULTI_SRC_ADDRS, NULL);
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	case VPO_ERR_NO_DST_ADDRS:
+		log_opt_error(OE_NO_DST_ADDRS, NULL);
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	default:
+		log_opt_error(OE_UNKNOWN_ERROR, NULL);
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	if (validate_prog_opts_values(&flow_opts, &flow_prog_parms, err_str,
+						err_str_size) == -1) {
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	flow_parms->rc_mode = flow_prog_parms.rc_mode;
+	flow_parms->inet_rx_sock_parms = flow_prog_parms.inet_rx_sock_parms;
+	flow_parms->inet_tx_sock_parms = flow_prog_parms.inet_tx_sock_parms;
+	flow_parms->inet6_rx_sock_parms = flow_prog_parms.inet6_rx_sock_parms;
+	flow_parms->inet6_tx_sock_parms = flow_prog_parms.inet6_tx_sock_parms;
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return 0;
+
+}
+
+
+/*
+ * Only a flow's addresses, per-family options and socket buffer sizes can
+ * be given on its line.
+ */
+int flow_opts_valid(const struct program_options *flow_opts)
+{
+
+
+	return !(flow_opts->help_set || flow_opts->license_set ||
+		 flow_opts->no_daemon_set || flow_opts->engine_set ||
+		 flow_opts->workers_set || flow_opts->flows_set ||
+		 flow_opts->shm_stats_set || flow_opts->metrics_set ||
+		 flow_opts->rates_set ||
+		 flow_opts->rx_cpus_set || flow_opts->tx_cpus_set ||
+		 flow_opts->rt_prio_set || flow_opts->mem_lock_set ||
+		 flow_opts->tx_backlog_set || flow_opts->tx_rate_set ||
+		 flow_opts->tx_dest_rate_set ||
+		 flow_opts->tx_rate_policy_set || flow_opts->tx_pace_set ||
+		 flow_opts->tx_pace_mode_set ||
+		 flow_opts->rx_batch_size_set ||
+		 flow_opts->rx_batch_wait_set || flow_opts->rx_udp_gro_set ||
+		 flow_opts->rx_busy_poll_set || flow_opts->rx_busy_idle_set ||
+		 flow_opts->rx_latency_set || flow_opts->rx_buf_max_set ||
+		 flow_opts->rx_xdp_intf_set || flow_opts->rx_xdp_queue_set ||
+		 flow_opts->rx_xdp_skb_set ||
+		 flow_opts->rx_pkt_ring_intf_set ||
+		 flow_opts->rx_pkt_ring_tov_set ||
+		 flow_opts->inet_tx_sock_rate_set ||
+		 flow_opts->inet6_tx_sock_rate_set);
+
+}
+
+
+void log_prog_banner(void)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	log_msg(LOG_SEV_INFO, "%s v%1.1f\n", program_name, replicast_version);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void log_prog_parms(const struct program_parameters *prog_parms)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (prog_parms->rc_mode == RCMODE_FLOWS) {
+		log_flows_parms(prog_parms);
+	} else {
+		log_sock_parms(prog_parms->rc_mode,
+			       &prog_parms->inet_rx_sock_parms,
+			       &prog_parms->inet_tx_sock_parms,
+			       &prog_parms->inet6_rx_sock_parms,
+			       &prog_parms->inet6_tx_sock_parms);
+	}
+
+	log_rx_batch_parms(&prog_parms->rx_batch_parms);
+
+	log_engine_parms(prog_parms->engine);
+
+	log_workers_parms(prog_parms->workers_num);
+
+	log_shm_stats_parms(prog_parms->shm_stats_file);
+
+	log_metrics_parms(prog_parms->metrics_addr_str);
+
+	log_rates_parms(prog_parms->rates_interval);
+
+	log_tx_rate_parms(prog_parms);
+
+	log_rt_parms(prog_parms);
+
+	log_sock_buf_parms(prog_parms);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void log_sock_parms(const enum REPLICAST_MODE rc_mode,
+		    const struct inet_rx_sock_params *inet_rx_sock_parms,
+		    const struct inet_tx_sock_params *inet_tx_sock_parms,
+		    const struct inet6_rx_sock_params *inet6_rx_sock_parms,
+		    const struct inet6_tx_sock_params *inet6_tx_sock_parms)
+{
+	const struct rcast_mode *mode;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	mode = find_rcast_mode(rc_mode);
+	if (mode == NULL) {
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
+
+	if (mode->rx_family == AF_INET) {
+		log_inet_rx_sock_parms(inet_rx_sock_parms);
+	} else {
+		log_inet6_rx_sock_parms(inet6_rx_sock_parms);
+	}
+
+	if (mode->inet_tx) {
+		log_inet_tx_sock_parms(inet_tx_sock_parms);
+	}
+
+	if (mode->inet6_tx) {
+		log_inet6_tx_sock_parms(inet6_tx_sock_parms);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void log_flows_parms(const struct program_parameters *prog_parms)
+{
+	const struct flow_params *flow_parms;
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	log_msg(LOG_SEV_INFO, "flows: %d, from %s\n", prog_parms->flows_num,
+		prog_parms->flows_file);
+
+	for (i = 0; i < prog_parms->flows_num; i++) {
+		flow_parms = &prog_parms->flows[i];
+		log_msg(LOG_SEV_INFO, "flow %d, line %d:\n", i,
+			flow_parms->line);
+		log_sock_parms(flow_parms->rc_mode,
+			       &flow_parms->inet_rx_sock_parms,
+			       &flow_parms->inet_tx_sock_parms,
+			       &flow_parms->inet6_rx_sock_parms,
+			       &flow_parms->inet6_tx_sock_parms);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void log_rx_batch_parms(const struct rx_batch_params *rx_batch_parms)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (rx_batch_parms->batch_size > 1) {
+		log_msg(LOG_SEV_INFO, "rx batch: %d pkts, wait %d usecs\n",
+			rx_batch_parms->batch_size,
+			rx_batch_parms->batch_wait_usec);
+	}
+
+	if (rx_batch_parms->busy_poll_usec > 0) {
+		log_msg(LOG_SEV_INFO, "rx busy poll: %d usecs, idle %d msecs\n",
+			rx_batch_parms->busy_poll_usec,
+			rx_batch_parms->busy_idle_msec);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void log_engine_parms(const enum RCAST_ENGINE engine)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (engine == ENGINE_URING) {
+		log_msg(LOG_SEV_INFO, "engine: io_uring\n");
+	} else if (engine == ENGINE_PIPE) {
+		log_msg(LOG_SEV_INFO, "engine: pipe, ring %d descs, "
+			"buf %d bytes\n", PIPE_RING_SIZE, PIPE_BUF_SIZE);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void log_tx_rate_parms(const struct program_parameters *prog_parms)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (prog_parms->tx_rate > 0) {
+		log_msg(LOG_SEV_INFO, "tx rate: %d kbps\n", prog_parms->tx_rate);
+	}
+
+	if ((prog_parms->tx_rate > 0) ||
+	    (prog_parms->inet_tx_sock_parms.rate > 0) ||
+	    (prog_parms->inet_tx_sock_parms.dest_rate > 0) ||
+	    (prog_parms->inet6_tx_sock_parms.rate > 0) ||
+	    (prog_parms->inet6_tx_sock_parms.dest_rate > 0)) {
+		log_msg(LOG_SEV_INFO, "tx rate policy: %s\n",
+			prog_parms->tx_rate_queue ? "queue" : "drop");
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void log_cpu_list(const char *name_str,
+		  const int cpus[],
+		  const unsigned int cpus_num)
+{
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	log_msg(LOG_SEV_INFO, "%s: ", name_str);
+	for (i = 0; i < cpus_num; i++) {
+		log_msg(LOG_SEV_INFO, "%s%d", (i > 0) ? "," : "", cpus[i]);
+	}
+	log_msg(LOG_SEV_INFO, "\n");
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void log_sock_buf_parms(const struct program_parameters *prog_parms)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (prog_parms->inet_rx_sock_parms.rcvbuf > 0) {
+		log_msg(LOG_SEV_INFO, "rx buf: %d bytes\n",
+				prog_parms->inet_rx_sock_parms.rcvbuf);
+	}
+
+	if (prog_parms->rx_batch_parms.buf_max > 0) {
+		log_msg(LOG_SEV_INFO, "rx buf max: %d bytes\n",
+				prog_parms->rx_batch_parms.buf_max);
+	}
+
+	if (prog_parms->inet_tx_sock_parms.sndbuf > 0) {
+		log_msg(LOG_SEV_INFO, "tx buf: %d bytes\n",
+				prog_parms->inet_tx_sock_parms.sndbuf);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+/*
+ * The requested settings, then those each thread has actually got so far,
+ * as the pipe engine's transmit threads only start once forwarding does.
+ */
+void log_rt_parms(const struct program_parameters *prog_parms)
+{
+	const struct rt_thread_state *thread;
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (prog_parms->rx_cpus_num > 0) {
+		log_cpu_list("rx cpus", prog_parms->rx_cpus,
+						prog_parms->rx_cpus_num);
+	}
+
+	if (prog_parms->tx_cpus_num > 0) {
+		log_cpu_list("tx cpus", prog_parms->tx_cpus,
+						prog_parms->tx_cpus_num);
+	}
+
+	if (prog_parms->rt_prio > 0) {
+		log_msg(LOG_SEV_INFO, "rt prio: SCHED_FIFO %d\n",
+							prog_parms->rt_prio);
+	}
+
+	if (prog_parms->mem_lock) {
+		log_msg(LOG_SEV_INFO, "mlock: %s\n",
+			rt_state.mem_locked ? "locked" : "not locked");
+	}
+
+	if ((prog_parms->rx_cpus_num == 0) && (prog_parms->tx_cpus_num == 0) &&
+	    (prog_parms->rt_prio == 0)) {
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
+
+	for (i = 0; i < rt_state.threads_num; i++) {
+		thread = &rt_state.threads[i];
+		log_msg(LOG_SEV_INFO, "%s thread: ", thread->name);
+		if (thread->cpu >= 0) {
+			log_msg(LOG_SEV_INFO, "cpu %d, ", thread->cpu);
+		} else {
+			log_msg(LOG_SEV_INFO, "any cpu, ");
+		}
+		if (thread->prio > 0) {
+			log_msg(LOG_SEV_INFO, "SCHED_FIFO %d\n", thread->prio);
+		} else {
+			log_msg(LOG_SEV_INFO, "SCHED_OTHER\n");
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void log_workers_parms(const unsigned int workers_num)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (workers_num > 1) {
+		log_msg(LOG_SEV_INFO, "workers: %d\n", workers_num);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void log_shm_stats_parms(const char *shm_stats_file)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (shm_stats_file != NULL) {
+		log_msg(LOG_SEV_INFO, "shm stats: %s, every %d msecs\n",
+			shm_stats_file, SHM_STATS_PUBLISH_MSECS);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void log_metrics_parms(const char *metrics_addr_str)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (metrics_addr_str != NULL) {
+		log_msg(LOG_SEV_INFO, "metrics: %s\n", metrics_addr_str);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void log_rates_parms(const unsigned int rates_interval)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (rates_interval > 0) {
+		log_msg(LOG_SEV_INFO, "rates: every %u secs\n",
+							rates_interval);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void log_inet_rx_sock_parms(const struct inet_rx_sock_params *inet_rx_parms)
+{
+	char aip_str[AIP_STR_INET_MAX_LEN + 1];
+	const unsigned int aip_str_size = AIP_STR_INET_MAX_LEN + 1;
+	char xdp_intf_name[IFNAMSIZ];
+	char pkt_ring_intf_name[IFNAMSIZ];
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	log_msg(LOG_SEV_INFO, "inet rx src: ");
+
+	aip_htop_inet(&inet_rx_parms->rx_addr, &inet_rx_parms->in_intf_addr,
+		inet_rx_parms->port, aip_str, aip_str_size);
+
+	log_msg(LOG_SEV_INFO, "%s", aip_str);
+
+	if (inet_rx_parms->udp_gro) {
+		log_msg(LOG_SEV_INFO, ", udp gro");
+	}
+
+	if (inet_rx_parms->xdp_intf_idx != 0) {
+		if_indextoname(inet_rx_parms->xdp_intf_idx, xdp_intf_name);
+		log_msg(LOG_SEV_INFO, ", xdp %s queue %d", xdp_intf_name,
+			inet_rx_parms->xdp_queue);
+		if (inet_rx_parms->xdp_skb_mode) {
+			log_msg(LOG_SEV_INFO, " skb mode");
+		}
+	}
+
+	if (inet_rx_parms->pkt_ring_intf_idx != 0) {
+		if_indextoname(inet_rx_parms->pkt_ring_intf_idx, pkt_ring_intf_name);
+		log_msg(LOG_SEV_INFO, ", pkt ring %s", pkt_ring_intf_name);
+		if (inet_rx_parms->pkt_ring_block_tov != 0) {
+			log_msg(LOG_SEV_INFO, " block tov %d msecs",
+				inet_rx_parms->pkt_ring_block_tov);
+		}
+	}
+
+	log_msg(LOG_SEV_INFO, "\n");
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void log_inet6_rx_sock_parms(const struct inet6_rx_sock_params *inet6_rx_parms)
+{
+	char aip_str[AIP_STR_INET6_MAX_LEN + 1];
+	const unsigned int aip_str_size = AIP_STR_INET6_MAX_LEN + 1;
+	char xdp_intf_name[IFNAMSIZ];
+	char pkt_ring_intf_name[IFNAMSIZ];
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	log_msg(LOG_SEV_INFO, "inet6 rx src: ");
+
+	aip_htop_inet6(&inet6_rx_parms->rx_addr, inet6_rx_parms->in_intf_idx,
+		inet6_rx_parms->port, aip_str, aip_str_size);
+
+	log_msg(LOG_SEV_INFO, "%s", aip_str);
+
+	if (inet6_rx_parms->udp_gro) {
+		log_msg(LOG_SEV_INFO, ", udp gro");
+	}
+
+	if (inet6_rx_parms->xdp_intf_idx != 0) {
+		if_indextoname(inet6_rx_parms->xdp_intf_idx, xdp_intf_name);
+		log_msg(LOG_SEV_INFO, ", xdp %s queue %d", xdp_intf_name,
+			inet6_rx_parms->xdp_queue);
+		if (inet6_rx_parms->xdp_skb_mode) {
+			log_msg(LOG_SEV_INFO, " skb mode");
+		}
+	}
+
+	if (inet6_rx_parms->pkt_ring_intf_idx != 0) {
+		if_indextoname(inet6_rx_parms->pkt_ring_intf_idx, pkt_ring_intf_name);
+		log_msg(LOG_SEV_INFO, ", pkt ring %s", pkt_ring_intf_name);
+		if (inet6_rx_parms->pkt_ring_block_tov != 0) {
+			log_msg(LOG_SEV_INFO, " block tov %d msecs",
+				inet6_rx_parms->pkt_ring_block_tov);
+		}
+	}
+
+	log_msg(LOG_SEV_INFO, "\n");
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void log_inet_tx_sock_parms(const struct inet_tx_sock_params *inet_tx_parms)
+{
+	char ap_str[INET_ADDRSTRLEN + 1 + 5 + 1];
+	const unsigned int ap_str_size = INET_ADDRSTRLEN + 1 + 5 + 1;
+	unsigned int dest_num = 0;
+	char out_intf_addr_str[INET_ADDRSTRLEN];
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	log_msg(LOG_SEV_INFO, "inet tx dsts: ");
+
+	for (dest_num = 0; dest_num < (inet_tx_parms->dests_num - 1);
+								dest_num++) {
+
+		ap_htop_inet(&inet_tx_parms->dests[dest_num].sin_addr,
+			ntohs(inet_tx_parms->dests[dest_num].sin_port),
+			ap_str, ap_str_size);
+		log_msg(LOG_SEV_INFO, "%s,", ap_str);
+	}
+
+	ap_htop_inet(&inet_tx_parms->dests[dest_num].sin_addr,
+		ntohs(inet_tx_parms->dests[dest_num].sin_port),
+		ap_str, ap_str_size);
+	log_msg(LOG_SEV_INFO, "%s\n", ap_str);
+
+	log_msg(LOG_SEV_INFO, "inet tx opts: ");
+
+	if (inet_tx_parms->out_intf_addr.s_addr == ntohl(INADDR_ANY)) {
+		log_msg(LOG_SEV_INFO, "out intf rt table");
+	} else {
+		inet_ntop(AF_INET, &inet_tx_parms->out_intf_addr,
+			out_intf_addr_str, INET_ADDRSTRLEN);
+		log_msg(LOG_SEV_INFO, "out intf addr %s", out_intf_addr_str);
+	}
+
+	if (inet_tx_parms->mc_loop) {
+		log_msg(LOG_SEV_INFO, ", tx loop");
+	}
+
+	if (inet_tx_parms->udp_gso) {
+		log_msg(LOG_SEV_INFO, ", udp gso");
+	}
+
+	if (inet_tx_parms->zerocopy) {
+		log_msg(LOG_SEV_INFO, ", zerocopy");
+	}
+
+	if (inet_tx_parms->connect) {
+		log_msg(LOG_SEV_INFO, ", connected");
+	}
+
+	if (inet_tx_parms->backlog > 0) {
+		log_msg(LOG_SEV_INFO, ", backlog %d pkts", inet_tx_parms->backlog);
+	}
+
+	if (inet_tx_parms->rate > 0) {
+		log_msg(LOG_SEV_INFO, ", rate %d kbps", inet_tx_parms->rate);
+	}
+
+	if (inet_tx_parms->dest_rate > 0) {
+		log_msg(LOG_SEV_INFO, ", dest rate %d kbps",
+						inet_tx_parms->dest_rate);
+	}
+
+	if (inet_tx_parms->pace_rate > 0) {
+		log_msg(LOG_SEV_INFO, ", paced %d kbps", inet_tx_parms->pace_rate);
+	} else if (inet_tx_parms->pace_input) {
+		log_msg(LOG_SEV_INFO, ", paced to input");
+	}
+
+	log_msg(LOG_SEV_INFO, ", mc ttl %d\n", inet_tx_parms->mc_ttl);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void log_inet6_tx_sock_parms(const struct inet6_tx_sock_params *inet6_tx_parms)
+{
+	char ap_str[1 + INET6_ADDRSTRLEN + 1 + 1 + 5 + 1];
+	const unsigned int ap_str_size = 1 + INET6_ADDRSTRLEN + 1 + 1 + 5 + 1;
+	unsigned int dest_num = 0;
+	char out_intf_name[IFNAMSIZ];
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	log_msg(LOG_SEV_INFO, "inet6 tx dsts: ");
+
+	for (dest_num = 0; dest_num < (inet6_tx_parms->dests_num - 1);
+								dest_num++) {
+
+		ap_htop_inet6(&inet6_tx_parms->dests[dest_num].sin6_addr,
+			ntohs(inet6_tx_parms->dests[dest_num].sin6_port),
+			ap_str, ap_str_size);
+		log_msg(LOG_SEV_INFO, "%s,", ap_str);
+	}
+
+	ap_htop_inet6(&inet6_tx_parms->dests[dest_num].sin6_addr,
+		ntohs(inet6_tx_parms->dests[dest_num].sin6_port),
+		ap_str, ap_str_size);
+	log_msg(LOG_SEV_INFO, "%s\n", ap_str);
+
+	log_msg(LOG_SEV_INFO, "inet6 tx opts: ");
+
+	if (inet6_tx_parms->out_intf_idx == 0) {
+		log_msg(LOG_SEV_INFO, "out intf rt table");
+	} else {
+		if_indextoname(inet6_tx_parms->out_intf_idx, out_intf_name);
+		log_msg(LOG_SEV_INFO, "out intf %s", out_intf_name);
+	}
+
+	if (inet6_tx_parms->mc_loop) {
+		log_msg(LOG_SEV_INFO, ", tx loop");
+	}
+
+	if (inet6_tx_parms->udp_gso) {
+		log_msg(LOG_SEV_INFO, ", udp gso");
+	}
+
+	if (inet6_tx_parms->zerocopy) {
+		log_msg(LOG_SEV_INFO, ", zerocopy");
+	}
+
+	if (inet6_tx_parms->connect) {
+		log_msg(LOG_SEV_INFO, ", connected");
+	}
+
+	if (inet6_tx_parms->backlog > 0) {
+		log_msg(LOG_SEV_INFO, ", backlog %d pkts", inet6_tx_parms->backlog);
+	}
+
+	if (inet6_tx_parms->rate > 0) {
+		log_msg(LOG_SEV_INFO, ", rate %d kbps", inet6_tx_parms->rate);
+	}
+
+	if (inet6_tx_parms->dest_rate > 0) {
+		log_msg(LOG_SEV_INFO, ", dest rate %d kbps",
+						inet6_tx_parms->dest_rate);
+	}
+
+	if (inet6_tx_parms->pace_rate > 0) {
+		log_msg(LOG_SEV_INFO, ", paced %d kbps", inet6_tx_parms->pace_rate);
+	} else if (inet6_tx_parms->pace_input) {
+		log_msg(LOG_SEV_INFO, ", paced to input");
+	}
+
+	log_msg(LOG_SEV_INFO, ", mc hops %d\n", inet6_tx_parms->mc_hops);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void log_opt_error(enum OPT_ERR option_err,
+		   const char *err_str_parm)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	log_prog_banner();
+
+	switch (option_err) {
+	case OE_UNKNOWN_OPT:
+		log_msg(LOG_SEV_ERR, "Unknown option.\n");
+		break;
+	case OE_NO_SRC_ADDR:
+		log_msg(LOG_SEV_ERR, "No incoming address specified.\n");
+		break;
+	case OE_MULTI_SRC_ADDRS:
+		log_msg(LOG_SEV_ERR, "Too many incoming addresses.\n");
+		break;
+	case OE_NO_DST_ADDRS:
+		log_msg(LOG_SEV_ERR, "No outgoing address(es) specified.\n");
+		break;
+	case OE_SRC_GRP_ADDR:
+		log_msg(LOG_SEV_ERR, "Invalid traffic source.\n");
+		break;	
+	case OE_IF_ADDR:
+		log_msg(LOG_SEV_ERR, "Invalid interface address.\n");
+		break;
+	case OE_SRC_PORT:
+		log_msg(LOG_SEV_ERR, "Invalid or missing source port.\n");
+		break;
+	case OE_DST_PORT:
+		log_msg(LOG_SEV_ERR, "Invalid destination port.\n");
+		break;
+	case OE_INET_DST_ADDR:
+		log_msg(LOG_SEV_ERR, "Invalid IPv4 destination address.\n");
+		break;
+	case OE_INET_TX_MCTTL_RANGE:
+		log_msg(LOG_SEV_ERR, "Invalid multicast IPv4 transmit "
+			"time-to-live.\n");
+		break;
+	case OE_INET_OUT_INTF:
+		log_msg(LOG_SEV_ERR, "Invalid IPv4 multicast output "
+			"interface.\n");
+		break;
+	case OE_INET6_OUT_INTF:
+		log_msg(LOG_SEV_ERR, "Invalid IPv6 multicast output "
+			"interface.\n");
+		break;
+	case OE_INET6_DST_ADDR:
+		log_msg(LOG_SEV_ERR, "Invalid IPv6 destination address.\n");
+		break;
+	case OE_INET6_TX_HOPS_RANGE:
+		log_msg(LOG_SEV_ERR, "Invalid IPv6 transmit hop-count.\n");
+		break;
+	case OE_RX_BATCH_RANGE:
+		log_msg(LOG_SEV_ERR, "Invalid receive batch size.\n");
+		break;
+	case OE_RX_BATCH_WAIT_RANGE:
+		log_msg(LOG_SEV_ERR, "Invalid receive batch wait time.\n");
+		break;
+	case OE_RX_BUSY_POLL_RANGE:
+		log_msg(LOG_SEV_ERR, "Invalid receive busy poll time.\n");
+		break;
+	case OE_RX_BUSY_IDLE_RANGE:
+		log_msg(LOG_SEV_ERR, "Invalid receive busy poll idle time.\n");
+		break;
+	case OE_RX_BUSY_POLL_OPTS:
+		log_msg(LOG_SEV_ERR, "Option not supported with busy poll "
+			"receive.\n");
+		break;
+	case OE_RX_LATENCY_OPTS:
+		log_msg(LOG_SEV_ERR, "Option not supported with receive "
+			"latency.\n");
+		break;
+	case OE_SOCK_BUF_RANGE:
+		log_msg(LOG_SEV_ERR, "Invalid socket buffer size.\n");
+		break;
+	case OE_RX_BUF_OPTS:
+		log_msg(LOG_SEV_ERR, "Option not supported with receive buffer "
+			"auto-tuning.\n");
+		break;
+	case OE_ENGINE:
+		log_msg(LOG_SEV_ERR, "Invalid forwarding engine.\n");
+		break;
+	case OE_ENGINE_OPTS:
+		log_msg(LOG_SEV_ERR, "Option not supported by the io_uring "
+			"engine.\n");
+		break;
+	case OE_ENGINE_MODE:
+		log_msg(LOG_SEV_ERR, "The pipe engine needs both IPv4 and IPv6 "
+			"destinations.\n");
+		break;
+	case OE_CONNECT_OPTS:
+		log_msg(LOG_SEV_ERR, "Connected sockets can't be used with GSO "
+			"or zero copy.\n");
+		break;
+	case OE_TX_BACKLOG_RANGE:
+		log_msg(LOG_SEV_ERR, "Invalid transmit backlog size.\n");
+		break;
+	case OE_TX_BACKLOG_OPTS:
+		log_msg(LOG_SEV_ERR, "Option not supported with the transmit "
+			"backlog.\n");
+		break;
+	case OE_TX_RATE_RANGE:
+		log_msg(LOG_SEV_ERR, "Invalid transmit rate.\n");
+		break;
+	case OE_TX_RATE_POLICY:
+		log_msg(LOG_SEV_ERR, "Invalid transmit rate policy.\n");
+		break;
+	case OE_TX_RATE_QUEUE:
+		log_msg(LOG_SEV_ERR, "The queue transmit rate policy needs "
+			"-txbacklog.\n");
+		break;
+	case OE_TX_RATE_OPTS:
+		log_msg(LOG_SEV_ERR, "Option not supported with transmit rate "
+			"limits.\n");
+		break;
+	case OE_TX_PACE:
+		log_msg(LOG_SEV_ERR, "Invalid transmit pacing rate.\n");
+		break;
+	case OE_TX_PACE_MODE:
+		log_msg(LOG_SEV_ERR, "Invalid transmit pacing mode.\n");
+		break;
+	case OE_TX_PACE_OPTS:
+		log_msg(LOG_SEV_ERR, "Option not supported with transmit "
+			"pacing.\n");
+		break;
+	case OE_XDP_INTF:
+		log_msg(LOG_SEV_ERR, "Invalid or missing AF_XDP interface.\n");
+		break;
+	case OE_XDP_QUEUE_RANGE:
+		log_msg(LOG_SEV_ERR, "Invalid AF_XDP queue.\n");
+		break;
+	case OE_PKT_RING_INTF:
+		log_msg(LOG_SEV_ERR, "Invalid or missing AF_PACKET ring "
+			"interface.\n");
+		break;
+	case OE_PKT_RING_TOV_RANGE:
+		log_msg(LOG_SEV_ERR, "Invalid AF_PACKET ring block "
+			"timeout.\n");
+		break;
+	case OE_RX_PATH_OPTS:
+		log_msg(LOG_SEV_ERR, "AF_XDP and AF_PACKET ring receive "
+			"can't be used together.\n");
+		break;
+	case OE_WORKERS_RANGE:
+		log_msg(LOG_SEV_ERR, "Invalid number of workers.\n");
+		break;
+	case OE_WORKERS_OPTS:
+		log_msg(LOG_SEV_ERR, "Option not supported with multiple "
+			"workers.\n");
+		break;
+	case OE_CPU_LIST:
+		log_msg(LOG_SEV_ERR, "Invalid CPU list.\n");
+		break;
+	case OE_RT_PRIO:
+		log_msg(LOG_SEV_ERR, "Invalid real-time priority.\n");
+		break;
+	case OE_TX_CPU_OPTS:
+		log_msg(LOG_SEV_ERR, "Transmit CPUs need the pipe engine.\n");
+		break;
+	case OE_FLOWS_ADDRS:
+		log_msg(LOG_SEV_ERR, "Incoming and outgoing addresses belong "
+			"in the flows file.\n");
+		break;
+	case OE_FLOWS_OPTS:
+		log_msg(LOG_SEV_ERR, "Option not supported with flows.\n");
+		break;
+	case OE_METRICS_ADDR:
+		log_msg(LOG_SEV_ERR, "Invalid metrics unix socket path or "
+			"address and port.\n");
+		break;
+	case OE_RATES_RANGE:
+		log_msg(LOG_SEV_ERR, "Invalid rates interval.\n");
+		break;
+	case OE_FLOWS_FILE:
+		log_msg(LOG_SEV_ERR, "Couldn't open the flows file (%s).\n",
+			err_str_parm);
+		break;
+	case OE_NO_FLOWS:
+		log_msg(LOG_SEV_ERR, "No flows in the flows file.\n");
+		break;
+	case OE_FLOW_OPTS:
+		log_msg(LOG_SEV_ERR, "Option not supported in a flow.\n");
+		break;
+	case OE_FLOW_LINE:
+		log_msg(LOG_SEV_ERR, "Flow line too long.\n");
+		break;
+	case OE_MEMORY_ERROR:
+		log_msg(LOG_SEV_ERR, "Fatal memory error during option "
+			"parsing.\n");
+		break;
+	case OE_UNKNOWN_ERROR:
+		log_msg(LOG_SEV_ERR, "Unknown option error.\n");
+		break;
+	default:
+		log_msg(LOG_SEV_ERR, "Option error not specified.\n");
+		break;
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void cleanup_prog_parms(struct program_parameters *prog_parms)
+{
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (prog_parms->inet_tx_sock_parms.dests != NULL) {
+		free(prog_parms->inet_tx_sock_parms.dests);
+		prog_parms->inet_tx_sock_parms.dests = NULL;
+	}
+
+	if (prog_parms->inet6_tx_sock_parms.dests != NULL) {
+		free(prog_parms->inet6_tx_sock_parms.dests);
+		prog_parms->inet6_tx_sock_parms.dests = NULL;
+	}
+
+	for (i = 0; i < prog_parms->flows_num; i++) {
+		free(prog_parms->flows[i].inet_tx_sock_parms.dests);
+		free(prog_parms->flows[i].inet6_tx_sock_parms.dests);
+	}
+	free(prog_parms->flows);
+	prog_parms->flows = NULL;
+	prog_parms->flows_num = 0;
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void init_sock_fds(struct socket_fds *sock_fds)
+{
+
+	sock_fds->inet_in_sock_fd = -1;
+	sock_fds->inet6_in_sock_fd = -1;
+	sock_fds->inet_out_sock_fd = -1;
+	sock_fds->inet6_out_sock_fd = -1;
+	sock_fds->xdp_sock_fd = -1;
+
+}
+
+
+
+int parse_cpu_list(const char *cpu_list_str,
+		   int cpus[],
+		   unsigned int *cpus_num)
+{
+	const char *str = cpu_list_str;
+	char *end;
+	long cpu;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	*cpus_num = 0;
+
+	do {
+		errno = 0;
+		cpu = strtol(str, &end, 10);
+		if ((end == str) || (errno != 0) || (cpu < 0) ||
+		    (cpu >= CPU_SETSIZE) || (*cpus_num == RT_CPUS_MAX) ||
+		    ((*end != ',') && (*end != '\0'))) {
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+		cpus[(*cpus_num)++] = cpu;
+		str = end + 1;
+	} while (*end == ',');
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return 0;
+
+}
+
+
+/*
+ * Touches a stack's worth of pages, so the stack doesn't take page faults
+ * as it grows once forwarding has started.
+ */
+void rt_prefault_stack(void)
+{
+	uint8_t stack[RT_PREFAULT_STACK_SIZE];
+	volatile uint8_t *page = stack;
+	unsigned int i;
+
+
+	for (i = 0; i < RT_PREFAULT_STACK_SIZE; i += 4096) {
+		page[i] = 0;
+	}
+
+}
+
+
+/*
+ * Called after daemonise(), which forks, as memory locks and the main
+ * thread's affinity and scheduling aren't inherited by the child. With
+ * MCL_FUTURE, the sockets' buffers and rings allocated afterwards are
+ * faulted in and locked as they are allocated, and malloc() is told to
+ * keep the memory it has rather than hand it back and fault it in again.
+ */
+void rt_setup(const struct program_parameters *prog_parms)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	rt_state.mem_locked = 0;
+	rt_state.threads_num = 0;
+
+	if (prog_parms->mem_lock) {
+		if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+			log_msg(LOG_SEV_WARNING, "Couldn't lock memory (%s).\n",
+							strerror(errno));
+		} else {
+			mallopt(M_TRIM_THRESHOLD, -1);
+			mallopt(M_MMAP_MAX, 0);
+			rt_prefault_stack();
+			rt_state.mem_locked = 1;
+		}
+	}
+
+	rt_thread_setup(pthread_self(), "main",
+		rt_cpu(prog_parms->rx_cpus, prog_parms->rx_cpus_num, 0),
+		prog_parms->rt_prio);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+/*
+ * Threads beyond the end of a CPU list wrap around to its start, and -1 is
+ * any CPU.
+ */
+int rt_cpu(const int cpus[],
+	   const unsigned int cpus_num,
+	   const unsigned int thread_idx)
+{
+
+
+	if (cpus_num == 0) {
+		return -1;
+	}
+
+	return cpus[thread_idx % cpus_num];
+
+}
+
+
+void rt_thread_setup(const pthread_t thread,
+		     const char *name_str,
+		     const int cpu,
+		     const unsigned int prio)
+{
+	struct rt_thread_state *thread_state;
+	struct sched_param sched_param;
+	cpu_set_t cpu_set;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (rt_state.threads_num == RT_THREADS_MAX) {
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
+
+	thread_state = &rt_state.threads[rt_state.threads_num++];
+	strnzcpy(thread_state->name, name_str, sizeof(thread_state->name));
+	thread_state->cpu = -1;
+	thread_state->prio = 0;
+
+	if (cpu >= 0) {
+		CPU_ZERO(&cpu_set);
+		CPU_SET(cpu, &cpu_set);
+		ret = pthread_setaffinity_np(thread, sizeof(cpu_set), &cpu_set);
+		if (ret != 0) {
+			log_msg(LOG_SEV_WARNING, "Couldn't set %s thread to cpu "
+				"%d (%s).\n", name_str, cpu, strerror(ret));
+		} else {
+			thread_state->cpu = cpu;
+		}
+	}
+
+	if (prio > 0) {
+		memset(&sched_param, 0, sizeof(sched_param));
+		sched_param.sched_priority = prio;
+		ret = pthread_setschedparam(thread, SCHED_FIFO, &sched_param);
+		if (ret != 0) {
+			log_msg(LOG_SEV_WARNING, "Couldn't set %s thread to "
+				"SCHED_FIFO %d (%s).\n", name_str, prio,
+				strerror(ret));
+		} else {
+			thread_state->prio = prio;
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void start_workers(const struct program_parameters *prog_parms)
+{
+	sigset_t all_sigs;
+	sigset_t old_sigs;
+	char name_str[16];
+	unsigned int i;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (prog_parms->workers_num <= 1) {
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
+
+	workers = calloc(prog_parms->workers_num - 1, sizeof(struct worker));
+	if (workers == NULL) {
+		exit_errno(__func__, __LINE__, ENOMEM);
+	}
+
+	/*
+	 * Signals are left to the main thread, which logs the counters of
+	 * every worker.
+	 */
+	sigfillset(&all_sigs);
+	pthread_sigmask(SIG_SETMASK, &all_sigs, &old_sigs);
+
+	for (i = 0; i < prog_parms->workers_num - 1; i++) {
+		init_sock_fds(&workers[i].sock_fds);
+		init_packet_counters(&workers[i].pkt_counters);
+		workers[i].inet_rx_sock_parms = prog_parms->inet_rx_sock_parms;
+		workers[i].inet_rx_sock_parms.worker_idx = i + 1;
+		workers[i].inet6_rx_sock_parms =
+					prog_parms->inet6_rx_sock_parms;
+		workers[i].inet6_rx_sock_parms.worker_idx = i + 1;
+
+		ret = pthread_create(&workers[i].thread, NULL, worker_thread,
+								&workers[i]);
+		if (ret != 0) {
+			exit_errno(__func__, __LINE__, ret);
+		}
+
+		snprintf(name_str, sizeof(name_str), "worker %d", i + 1);
+		rt_thread_setup(workers[i].thread, name_str,
+			rt_cpu(prog_parms->rx_cpus, prog_parms->rx_cpus_num,
+								i + 1),
+			prog_parms->rt_prio);
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old_sigs, NULL);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void *worker_thread(void *arg)
+{
+	struct worker *worker = arg;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	rcast(prog_parms.rc_mode, &worker->sock_fds,
+	      &worker->inet_rx_sock_parms,
+	      &worker->inet6_rx_sock_parms,
+	      &worker->pkt_counters);
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return NULL;
+
+}
+
+
+/*
+ * Reading /proc is too slow for the forwarding threads, so the UDP MIB
+ * counters are sampled by a thread of their own. It's started before the
+ * main thread is given its CPU and real-time priority, so that it doesn't
+ * inherit them.
+ */
+void start_udp_mib_sampler(void)
+{
+	sigset_t all_sigs;
+	sigset_t old_sigs;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	udp_mibs.inet_ok = (udp_mib_inet_read(&udp_mibs.inet_start) == 0);
+	udp_mibs.inet = udp_mibs.inet_start;
+	udp_mibs.inet6_ok = (udp_mib_inet6_read(&udp_mibs.inet6_start) == 0);
+	udp_mibs.inet6 = udp_mibs.inet6_start;
+
+	if (!udp_mibs.inet_ok && !udp_mibs.inet6_ok) {
+		log_msg(LOG_SEV_WARNING, "Couldn't read the UDP MIB counters "
+			"(%s).\n", strerror(errno));
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
+
+	sigfillset(&all_sigs);
+	pthread_sigmask(SIG_SETMASK, &all_sigs, &old_sigs);
+
+	ret = pthread_create(&udp_mibs.thread, NULL, udp_mib_sampler_thread,
+									NULL);
+	if (ret != 0) {
+		exit_errno(__func__, __LINE__, ret);
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old_sigs, NULL);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void *udp_mib_sampler_thread(void *arg)
+{
+	struct udp_mib mib;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	for ( ;; ) {
+		sleep(UDP_MIB_SAMPLE_SECS);
+		if (udp_mibs.inet_ok && (udp_mib_inet_read(&mib) == 0)) {
+			udp_mibs.inet = mib;
+		}
+		if (udp_mibs.inet6_ok && (udp_mib_inet6_read(&mib) == 0)) {
+			udp_mibs.inet6 = mib;
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return NULL;
+
+}
+
+
+/*
+ * The counters are published by a thread of their own, which copies them
+ * into the -shmstats file under its sequence lock, so the forwarding
+ * threads just carry on counting. The file is sized for every flow and
+ * destination there can be, while those not yet forwarding are left out.
+ */
+void start_shm_stats(const struct program_parameters *prog_parms)
+{
+	const struct rcast_mode *mode;
+	struct shm_stats_counter *counter;
+	unsigned int counters_max;
+	unsigned int rates_start;
+	unsigned int dests_max = 0;
+	unsigned int i;
+	sigset_t all_sigs;
+	sigset_t old_sigs;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (prog_parms->shm_stats_file == NULL) {
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
+
+	if (prog_parms->rc_mode == RCMODE_FLOWS) {
+		for (i = 0; i < prog_parms->flows_num; i++) {
+			mode = find_rcast_mode(prog_parms->flows[i].rc_mode);
+			if (mode->inet_tx) {
+				dests_max += prog_parms->flows[i].
+						inet_tx_sock_parms.dests_num;
+			}
+			if (mode->inet6_tx) {
+				dests_max += prog_parms->flows[i].
+						inet6_tx_sock_parms.dests_num;
+			}
+		}
+	} else {
+		mode = find_rcast_mode(prog_parms->rc_mode);
+		if (mode->inet_tx) {
+			dests_max += prog_parms->inet_tx_sock_parms.dests_num;
+		}
+		if (mode->inet6_tx) {
+			dests_max += prog_parms->inet6_tx_sock_parms.dests_num;
+		}
+		dests_max *= prog_parms->workers_num;
+	}
+
+	shm_stats_pub.latency_hist = prog_parms->rx_batch_parms.latency;
+
+	shm_stats_pub.rates = (prog_parms->rates_interval > 0);
+
+	counters_max = SHM_STATS_FIELDS_NUM + SHM_STATS_UDP_MIBS_NUM;
+	if (shm_stats_pub.latency_hist) {
+		counters_max += RX_LATENCY_BUCKETS + SHM_STATS_TX_LATENCY_NUM;
+	}
+	rates_start = counters_max;
+	if (shm_stats_pub.rates) {
+		counters_max += SHM_STATS_RATES_NUM;
+	}
+
+	if (shm_stats_create(&shm_stats_pub.stats, prog_parms->shm_stats_file,
+			     counters_max, prog_parms->flows_num, dests_max,
+			     SHM_STATS_PUBLISH_MSECS) == -1) {
+		log_msg(LOG_SEV_ERR, "Couldn't create %s (%s).\n",
+			prog_parms->shm_stats_file, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	/*
+	 * The counters' names don't change, so are published before the
+	 * first of their values.
+	 */
+	for (i = 0; i < counters_max; i++) {
+		counter = shm_stats_counter(shm_stats_pub.stats.header, i);
+		if (i >= rates_start) {
+			snprintf(counter->name, sizeof(counter->name), "%s%s",
+				rate_stat_strs[(i - rates_start) % RATE_STATS],
+				((i - rates_start) < RATE_STATS) ? "" : "_ewma");
+		} else if (i < SHM_STATS_FIELDS_NUM) {
+			snprintf(counter->name, sizeof(counter->name), "%s",
+				shm_stats_fields[i].name);
+		} else if (i < (SHM_STATS_FIELDS_NUM +
+						SHM_STATS_UDP_MIBS_NUM)) {
+			snprintf(counter->name, sizeof(counter->name), "%s",
+				shm_stats_udp_mib_strs[i -
+						SHM_STATS_FIELDS_NUM]);
+		} else if (i < (SHM_STATS_FIELDS_NUM + SHM_STATS_UDP_MIBS_NUM +
+						RX_LATENCY_BUCKETS)) {
+			snprintf(counter->name, sizeof(counter->name),
+				"rx_latency_hist_%llu",
+				rx_latency_bucket_max(i - SHM_STATS_FIELDS_NUM -
+						SHM_STATS_UDP_MIBS_NUM));
+		} else {
+			snprintf(counter->name, sizeof(counter->name), "%s",
+				shm_stats_tx_latency_strs[i -
+					SHM_STATS_FIELDS_NUM -
+					SHM_STATS_UDP_MIBS_NUM -
+					RX_LATENCY_BUCKETS]);
+		}
+	}
+	shm_stats_pub.stats.header->counters_num = counters_max;
+
+	sigfillset(&all_sigs);
+	pthread_sigmask(SIG_SETMASK, &all_sigs, &old_sigs);
+
+	ret = pthread_create(&shm_stats_pub.thread, NULL, shm_stats_thread,
+									NULL);
+	if (ret != 0) {
+		exit_errno(__func__, __LINE__, ret);
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old_sigs, NULL);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void *shm_stats_thread(void *arg)
+{
+	const struct timespec interval = {
+		SHM_STATS_PUBLISH_MSECS / 1000,
+		(SHM_STATS_PUBLISH_MSECS % 1000) * 1000000
+	};
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	for ( ;; ) {
+		publish_shm_stats();
+		nanosleep(&interval, NULL);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return NULL;
+
+}
+
+
+void publish_shm_stats(void)
+{
+	struct shm_stats_header *header = shm_stats_pub.stats.header;
+	struct packet_counters total_counters;
+	struct latency_hist total_hist;
+	struct shm_stats_flow *shm_flow;
+	unsigned long long udp_mib_values[SHM_STATS_UDP_MIBS_NUM];
+	unsigned int counter_num = 0;
+	unsigned int dests_num = 0;
+	char name_str[32];
+	unsigned int i;
+	unsigned int j;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	sum_packet_counters(&total_counters);
+
+	udp_mib_values[0] = udp_mibs.inet.rcvbuf_errors -
+					udp_mibs.inet_start.rcvbuf_errors;
+	udp_mib_values[1] = udp_mibs.inet.sndbuf_errors -
+					udp_mibs.inet_start.sndbuf_errors;
+	udp_mib_values[2] = udp_mibs.inet6.rcvbuf_errors -
+					udp_mibs.inet6_start.rcvbuf_errors;
+	udp_mib_values[3] = udp_mibs.inet6.sndbuf_errors -
+					udp_mibs.inet6_start.sndbuf_errors;
+
+	shm_stats_write_begin(header);
+
+	for (i = 0; i < SHM_STATS_FIELDS_NUM; i++) {
+		shm_stats_counter(header, counter_num++)->value =
+			*(unsigned long long *)((uint8_t *)&total_counters +
+						shm_stats_fields[i].offset);
+	}
+
+	for (i = 0; i < SHM_STATS_UDP_MIBS_NUM; i++) {
+		shm_stats_counter(header, counter_num++)->value =
+							udp_mib_values[i];
+	}
+
+	if (shm_stats_pub.latency_hist) {
+		for (i = 0; i < RX_LATENCY_BUCKETS; i++) {
+			shm_stats_counter(header, counter_num++)->value =
+					total_counters.rx_latency.buckets[i];
+		}
+		for (i = 0; i < 2; i++) {
+			memset(&total_hist, 0, sizeof(total_hist));
+			sum_tx_latency(&total_hist, (i == 0) ?
+				pkt_counters.inet_tx_dests :
+				pkt_counters.inet6_tx_dests);
+			for (j = 0; (workers != NULL) &&
+				    (j < prog_parms.workers_num - 1); j++) {
+				sum_tx_latency(&total_hist, (i == 0) ?
+				workers[j].pkt_counters.inet_tx_dests :
+				workers[j].pkt_counters.inet6_tx_dests);
+			}
+			shm_stats_counter(header, counter_num++)->value =
+							total_hist.pkts;
+			shm_stats_counter(header, counter_num++)->value =
+				latency_hist_percentile(&total_hist, 50.0);
+			shm_stats_counter(header, counter_num++)->value =
+				latency_hist_percentile(&total_hist, 99.0);
+			shm_stats_counter(header, counter_num++)->value =
+				latency_hist_percentile(&total_hist, 99.9);
+			shm_stats_counter(header, counter_num++)->value =
+							total_hist.max;
+		}
+	}
+
+	if (shm_stats_pub.rates) {
+		for (i = 0; i < RATE_STATS; i++) {
+			shm_stats_counter(header, counter_num++)->value =
+							rate_rep.rates[i];
+		}
+		for (i = 0; i < RATE_STATS; i++) {
+			shm_stats_counter(header, counter_num++)->value =
+							rate_rep.ewma_rates[i];
+		}
+	}
+
+	if (flows != NULL) {
+		for (i = 0; i < prog_parms.flows_num; i++) {
+			shm_flow = shm_stats_flow(header, i);
+			snprintf(shm_flow->name, sizeof(shm_flow->name),
+				"flow %d, line %d", i, prog_parms.flows[i].line);
+			shm_flow->in_pkts = flows[i].in_pkts;
+			shm_flow->in_drops = flows[i].in_drops;
+			shm_flow->inet_out_pkts = flows[i].inet_out_pkts;
+			shm_flow->inet6_out_pkts = flows[i].inet6_out_pkts;
+		}
+		header->flows_num = prog_parms.flows_num;
+	}
+
+	publish_shm_stats_dests("inet", pkt_counters.inet_tx_dests,
+								&dests_num);
+	publish_shm_stats_dests("inet6", pkt_counters.inet6_tx_dests,
+								&dests_num);
+
+	if (workers != NULL) {
+		for (i = 0; i < prog_parms.workers_num - 1; i++) {
+			snprintf(name_str, sizeof(name_str), "worker %u inet",
+									i + 1);
+			publish_shm_stats_dests(name_str,
+				workers[i].pkt_counters.inet_tx_dests,
+								&dests_num);
+			snprintf(name_str, sizeof(name_str), "worker %u inet6",
+									i + 1);
+			publish_shm_stats_dests(name_str,
+				workers[i].pkt_counters.inet6_tx_dests,
+								&dests_num);
+		}
+	}
+
+	if (flows != NULL) {
+		for (i = 0; i < prog_parms.flows_num; i++) {
+			snprintf(name_str, sizeof(name_str), "flow %u inet", i);
+			publish_shm_stats_dests(name_str,
+					flows[i].inet_tx_dests, &dests_num);
+			snprintf(name_str, sizeof(name_str), "flow %u inet6",
+									i);
+			publish_shm_stats_dests(name_str,
+					flows[i].inet6_tx_dests, &dests_num);
+		}
+	}
+
+	header->dests_num = dests_num;
+	header->publish_nsecs = shm_stats_nsecs();
+	header->publishes++;
+
+	shm_stats_write_end(header);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void publish_shm_stats_dests(const char *name_str,
+			     const struct tx_dests *tx_dests,
+			     unsigned int *dests_num)
+{
+	const struct tx_dest_stats *dest_stats;
+	const struct latency_hist *dest_latency;
+	struct shm_stats_dest *shm_dest;
+	char dest_str[AIP_STR_INET6_MAX_LEN + 1];
+	unsigned int i;
+	unsigned int j;
+
+
+	if ((tx_dests == NULL) || (tx_dests->dest_stats == NULL)) {
+		return;
+	}
+
+	for (i = 0; (i < (tx_dests->dests_num + tx_dests->conn_dests_num)) &&
+		    (*dests_num < shm_stats_pub.stats.header->dests_max); i++) {
+		dest_stats = &tx_dests->dest_stats[i];
+		shm_dest = shm_stats_dest(shm_stats_pub.stats.header,
+							(*dests_num)++);
+
+		tx_dest_str(tx_dests, i, dest_str, sizeof(dest_str));
+		snprintf(shm_dest->name, sizeof(shm_dest->name), "%s dest %s",
+							name_str, dest_str);
+		shm_dest->pkts = dest_stats->pkts;
+		shm_dest->bytes = dest_stats->bytes;
+		for (j = 0; j < SHM_STATS_DEST_ERRS; j++) {
+			shm_dest->errs[j] = dest_stats->errs[j];
+		}
+
+		if (tx_dests->dest_latency != NULL) {
+			dest_latency = &tx_dests->dest_latency[i];
+			shm_dest->latency_pkts = dest_latency->pkts;
+			shm_dest->latency_p50 = latency_hist_percentile(
+							dest_latency, 50.0);
+			shm_dest->latency_p99 = latency_hist_percentile(
+							dest_latency, 99.0);
+			shm_dest->latency_p999 = latency_hist_percentile(
+							dest_latency, 99.9);
+			shm_dest->latency_max = dest_latency->max;
+		}
+	}
+
+}
+
+
+/*
+ * Readers still mapping the file keep its last counters after it's removed.
+ */
+void close_shm_stats(void)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (prog_parms.shm_stats_file != NULL) {
+		unlink(prog_parms.shm_stats_file);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+/*
+ * A path for a unix socket, otherwise an IPv4 or bracketed IPv6 address and
+ * port.
+ */
+int parse_metrics_addr(const char *addr_str,
+		       struct sockaddr_storage *addr,
+		       socklen_t *addr_len)
+{
+	struct sockaddr_un *sun = (struct sockaddr_un *)addr;
+	struct sockaddr_in *sin = (struct sockaddr_in *)addr;
+	struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)addr;
+	enum inetaddr_errors aip_ptoh_err;
+	struct in_addr if_addr;
+	unsigned int ifidx;
+	unsigned int port;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	memset(addr, 0, sizeof(struct sockaddr_storage));
+
+	if (addr_str[0] == '/') {
+		if (strlen(addr_str) >= sizeof(sun->sun_path)) {
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+		sun->sun_family = AF_UNIX;
+		strcpy(sun->sun_path, addr_str);
+		*addr_len = sizeof(struct sockaddr_un);
+	} else if (addr_str[0] == '[') {
+		if ((aip_ptoh_inet6(addr_str, &sin6->sin6_addr, &ifidx, &port,
+				    &aip_ptoh_err) == -1) || (port == 0)) {
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+		sin6->sin6_family = AF_INET6;
+		sin6->sin6_port = htons(port);
+		sin6->sin6_scope_id = ifidx;
+		*addr_len = sizeof(struct sockaddr_in6);
+	} else {
+		if ((aip_ptoh_inet(addr_str, &sin->sin_addr, &if_addr, &port,
+				   &aip_ptoh_err) == -1) || (port == 0)) {
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+		sin->sin_family = AF_INET;
+		sin->sin_port = htons(port);
+		*addr_len = sizeof(struct sockaddr_in);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return 0;
+
+}
+
+
+/*
+ * The listening socket is opened before the forwarding starts, so that a
+ * bad address is reported at startup, and its thread then serves each
+ * scrape in turn, reading the counters as the -shmstats publisher does.
+ */
+void start_metrics(const struct program_parameters *prog_parms)
+{
+	const int on = 1;
+	sigset_t all_sigs;
+	sigset_t old_sigs;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (prog_parms->metrics_addr_str == NULL) {
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
+
+	metrics_srv.latency_hist = prog_parms->rx_batch_parms.latency;
+	metrics_srv.rates = (prog_parms->rates_interval > 0);
+
+	metrics_srv.listen_fd = socket(prog_parms->metrics_addr.ss_family,
+						SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (metrics_srv.listen_fd == -1) {
+		exit_errno(__func__, __LINE__, errno);
+	}
+
+	/* a socket left by an earlier run would otherwise be in use */
+	if (prog_parms->metrics_addr.ss_family == AF_UNIX) {
+		unlink(prog_parms->metrics_addr_str);
+	} else {
+		setsockopt(metrics_srv.listen_fd, SOL_SOCKET, SO_REUSEADDR,
+							&on, sizeof(on));
+	}
+
+	if ((bind(metrics_srv.listen_fd,
+		  (const struct sockaddr *)&prog_parms->metrics_addr,
+		  prog_parms->metrics_addr_len) == -1) ||
+	    (listen(metrics_srv.listen_fd, SOMAXCONN) == -1)) {
+		log_msg(LOG_SEV_ERR, "Couldn't listen on %s (%s).\n",
+			prog_parms->metrics_addr_str, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	sigfillset(&all_sigs);
+	pthread_sigmask(SIG_SETMASK, &all_sigs, &old_sigs);
+
+	ret = pthread_create(&metrics_srv.thread, NULL, metrics_thread, NULL);
+	if (ret != 0) {
+		exit_errno(__func__, __LINE__, ret);
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old_sigs, NULL);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void *metrics_thread(void *arg)
+{
+	const struct timeval timeout = { METRICS_TIMEOUT_SECS, 0 };
+	int conn_fd;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	for ( ;; ) {
+		conn_fd = accept4(metrics_srv.listen_fd, NULL, NULL,
+								SOCK_CLOEXEC);
+		if (conn_fd == -1) {
+			continue;
+		}
+
+		/* a stalled client only holds up the next scrape */
+		setsockopt(conn_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+							sizeof(timeout));
+		setsockopt(conn_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+							sizeof(timeout));
+
+		serve_metrics(conn_fd);
+
+		close(conn_fd);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return NULL;
+
+}
+
+
+/*
+ * Answers a single HTTP request, for / or /metrics, closing the connection
+ * afterwards.
+ */
+void serve_metrics(const int conn_fd)
+{
+	char request[METRICS_REQUEST_MAX_LEN + 1];
+	char header[128];
+	size_t request_len = 0;
+	char *body = NULL;
+	size_t body_len = 0;
+	const char *status_str;
+	ssize_t ret;
+	FILE *out;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	while (request_len < METRICS_REQUEST_MAX_LEN) {
+		ret = recv(conn_fd, request + request_len,
+			   METRICS_REQUEST_MAX_LEN - request_len, 0);
+		if (ret <= 0) {
+			log_debug_med("%s() exit\n", __func__);
+			return;
+		}
+		request_len += ret;
+		request[request_len] = '\0';
+		if (strstr(request, "\r\n\r\n") != NULL) {
+			break;
+		}
+	}
+
+	if ((strncmp(request, "GET /metrics ", 13) == 0) ||
+	    (strncmp(request, "GET / ", 6) == 0)) {
+		out = open_memstream(&body, &body_len);
+		if (out == NULL) {
+			log_debug_med("%s() exit\n", __func__);
+			return;
+		}
+		write_metrics(out);
+		fclose(out);
+		status_str = "200 OK";
+	} else if (strncmp(request, "GET ", 4) == 0) {
+		status_str = "404 Not Found";
+	} else {
+		status_str = "400 Bad Request";
+	}
+
+	snprintf(header, sizeof(header), "HTTP/1.0 %s\r\n"
+		"Content-Type: text/plain; version=0.0.4\r\n"
+		"Content-Length: %zu\r\n\r\n", status_str, body_len);
+
+	if (metrics_send(conn_fd, header, strlen(header)) == 0) {
+		metrics_send(conn_fd, body, body_len);
+	}
+
+	free(body);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+int metrics_send(const int conn_fd,
+		 const char *buf,
+		 size_t len)
+{
+	ssize_t ret;
+
+
+	while (len > 0) {
+		ret = send(conn_fd, buf, len, MSG_NOSIGNAL);
+		if (ret == -1) {
+			return -1;
+		}
+		buf += ret;
+		len -= ret;
+	}
+
+	return 0;
+
+}
+
+
+/*
+ * The counters named as they are in the -shmstats file, prefixed with
+ * replicast_, and the destination and flow counters labelled with the
+ * thread or flow they belong to. Each counter is read once, without
+ * stopping the thread counting it.
+ */
+void write_metrics(FILE *out)
+{
+	struct packet_counters total_counters;
+	unsigned long long udp_mib_values[SHM_STATS_UDP_MIBS_NUM];
+	unsigned long long value;
+	unsigned long long bucket_pkts = 0;
+	const char *type_str;
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	sum_packet_counters(&total_counters);
+
+	for (i = 0; i < SHM_STATS_FIELDS_NUM; i++) {
+		value = *(unsigned long long *)((uint8_t *)&total_counters +
+						shm_stats_fields[i].offset);
+		type_str = shm_stats_fields[i].gauge ? "gauge" : "counter";
+		fprintf(out, "# TYPE replicast_%s%s %s\n",
+			shm_stats_fields[i].name,
+			shm_stats_fields[i].gauge ? "" : "_total", type_str);
+		fprintf(out, "replicast_%s%s %llu\n", shm_stats_fields[i].name,
+			shm_stats_fields[i].gauge ? "" : "_total", value);
+	}
+
+	udp_mib_values[0] = udp_mibs.inet.rcvbuf_errors -
+					udp_mibs.inet_start.rcvbuf_errors;
+	udp_mib_values[1] = udp_mibs.inet.sndbuf_errors -
+					udp_mibs.inet_start.sndbuf_errors;
+	udp_mib_values[2] = udp_mibs.inet6.rcvbuf_errors -
+					udp_mibs.inet6_start.rcvbuf_errors;
+	udp_mib_values[3] = udp_mibs.inet6.sndbuf_errors -
+					udp_mibs.inet6_start.sndbuf_errors;
+
+	for (i = 0; i < SHM_STATS_UDP_MIBS_NUM; i++) {
+		fprintf(out, "# TYPE replicast_%s_total counter\n",
+			shm_stats_udp_mib_strs[i]);
+		fprintf(out, "replicast_%s_total %llu\n",
+			shm_stats_udp_mib_strs[i], udp_mib_values[i]);
+	}
+
+	/* the latency buckets are cumulative, by their upper bounds */
+	if (metrics_srv.latency_hist) {
+		fprintf(out, "# TYPE replicast_rx_latency_seconds histogram\n");
+		for (i = 0; i < RX_LATENCY_BUCKETS; i++) {
+			bucket_pkts += total_counters.rx_latency.buckets[i];
+			fprintf(out, "replicast_rx_latency_seconds_bucket"
+				"{le=\"%.9f\"} %llu\n",
+				rx_latency_bucket_max(i) / 1e9, bucket_pkts);
+		}
+		fprintf(out, "replicast_rx_latency_seconds_bucket"
+			"{le=\"+Inf\"} %llu\n", total_counters.rx_latency.pkts);
+		fprintf(out, "replicast_rx_latency_seconds_sum %.9f\n",
+			total_counters.rx_latency.sum / 1e9);
+		fprintf(out, "replicast_rx_latency_seconds_count %llu\n",
+			total_counters.rx_latency.pkts);
+	}
+
+	if (flows != NULL) {
+		fprintf(out, "# TYPE replicast_flow_in_pkts_total counter\n");
+		for (i = 0; i < prog_parms.flows_num; i++) {
+			fprintf(out, "replicast_flow_in_pkts_total"
+				"{flow=\"%u\",line=\"%u\"} %llu\n", i,
+				prog_parms.flows[i].line, flows[i].in_pkts);
+		}
+		fprintf(out, "# TYPE replicast_flow_in_drops_total counter\n");
+		for (i = 0; i < prog_parms.flows_num; i++) {
+			fprintf(out, "replicast_flow_in_drops_total"
+				"{flow=\"%u\",line=\"%u\"} %llu\n", i,
+				prog_parms.flows[i].line, flows[i].in_drops);
+		}
+		fprintf(out, "# TYPE replicast_flow_out_pkts_total counter\n");
+		for (i = 0; i < prog_parms.flows_num; i++) {
+			fprintf(out, "replicast_flow_out_pkts_total"
+				"{flow=\"%u\",line=\"%u\",family=\"inet\"} "
+				"%llu\n", i, prog_parms.flows[i].line,
+				flows[i].inet_out_pkts);
+			fprintf(out, "replicast_flow_out_pkts_total"
+				"{flow=\"%u\",line=\"%u\",family=\"inet6\"} "
+				"%llu\n", i, prog_parms.flows[i].line,
+				flows[i].inet6_out_pkts);
+		}
+	}
+
+	fprintf(out, "# TYPE replicast_dest_out_pkts_total counter\n");
+	write_metrics_dests(out, METRICS_DEST_PKTS);
+	fprintf(out, "# TYPE replicast_dest_out_bytes_total counter\n");
+	write_metrics_dests(out, METRICS_DEST_BYTES);
+	fprintf(out, "# TYPE replicast_dest_errors_total counter\n");
+	write_metrics_dests(out, METRICS_DEST_ERRS);
+
+	if (metrics_srv.latency_hist) {
+		write_metrics_tx_latency(out);
+	}
+
+	if (metrics_srv.rates) {
+		write_metrics_rates(out);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+/*
+ * Each family's and each destination's latency, as summaries of the
+ * histograms' percentiles.
+ */
+void write_metrics_tx_latency(FILE *out)
+{
+	struct latency_hist total_hist;
+	unsigned int i;
+	unsigned int j;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	fprintf(out, "# TYPE replicast_tx_latency_seconds summary\n");
+	for (i = 0; i < 2; i++) {
+		memset(&total_hist, 0, sizeof(total_hist));
+		sum_tx_latency(&total_hist, (i == 0) ?
+			pkt_counters.inet_tx_dests :
+			pkt_counters.inet6_tx_dests);
+		for (j = 0; (workers != NULL) &&
+			    (j < prog_parms.workers_num - 1); j++) {
+			sum_tx_latency(&total_hist, (i == 0) ?
+				workers[j].pkt_counters.inet_tx_dests :
+				workers[j].pkt_counters.inet6_tx_dests);
+		}
+		if (total_hist.pkts > 0) {
+			write_metrics_latency(out,
+				"replicast_tx_latency_seconds", (i == 0) ?
+				"family=\"inet\"" : "family=\"inet6\"",
+				&total_hist);
+		}
+	}
+
+	fprintf(out, "# TYPE replicast_dest_latency_seconds summary\n");
+	write_metrics_dests(out, METRICS_DEST_LATENCY);
+	fprintf(out, "# TYPE replicast_dest_latency_max_seconds gauge\n");
+	write_metrics_dests(out, METRICS_DEST_LATENCY_MAX);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+/*
+ * The -rates reporter's last rates, over its interval and smoothed.
+ */
+void write_metrics_rates(FILE *out)
+{
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	/* each tx rate follows the rx one by RATE_TX_PKTS */
+	for (i = RATE_RX_PKTS; i < RATE_TX_PKTS; i++) {
+		if (i == RATE_RX_PKTS) {
+			fprintf(out, "# TYPE replicast_packets_per_second "
+								"gauge\n");
+		} else if (i == RATE_RX_BITS) {
+			fprintf(out, "# TYPE replicast_bits_per_second "
+								"gauge\n");
+		}
+		fprintf(out, "replicast_%s_per_second{direction=\"rx\","
+			"rate=\"interval\"} %llu\n",
+			(i == RATE_RX_PKTS) ? "packets" : "bits",
+			rate_rep.rates[i]);
+		fprintf(out, "replicast_%s_per_second{direction=\"tx\","
+			"rate=\"interval\"} %llu\n",
+			(i == RATE_RX_PKTS) ? "packets" : "bits",
+			rate_rep.rates[i + RATE_TX_PKTS]);
+		fprintf(out, "replicast_%s_per_second{direction=\"rx\","
+			"rate=\"ewma\"} %llu\n",
+			(i == RATE_RX_PKTS) ? "packets" : "bits",
+			rate_rep.ewma_rates[i]);
+		fprintf(out, "replicast_%s_per_second{direction=\"tx\","
+			"rate=\"ewma\"} %llu\n",
+			(i == RATE_RX_PKTS) ? "packets" : "bits",
+			rate_rep.ewma_rates[i + RATE_TX_PKTS]);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void write_metrics_latency(FILE *out,
+			   const char *metric_str,
+			   const char *labels_str,
+			   const struct latency_hist *hist)
+{
+	static const double quantiles[] = { 0.5, 0.99, 0.999 };
+	unsigned int i;
+
+
+	for (i = 0; i < (sizeof(quantiles) / sizeof(quantiles[0])); i++) {
+		fprintf(out, "%s{%s,quantile=\"%g\"} %.9f\n", metric_str,
+			labels_str, quantiles[i],
+			latency_hist_percentile(hist, quantiles[i] * 100.0) /
+									1e9);
+	}
+	fprintf(out, "%s_sum{%s} %.9f\n", metric_str, labels_str,
+							hist->sum / 1e9);
+	fprintf(out, "%s_count{%s} %llu\n", metric_str, labels_str,
+							hist->pkts);
+
+}
+
+
+/*
+ * The main thread is worker 0, with -workers numbering the others from 1.
+ */
+void write_metrics_dests(FILE *out,
+			 const enum METRICS_DEST_STAT stat)
+{
+	char labels_str[64];
+	unsigned int i;
+
+
+	write_metrics_tx_dests(out, stat, "worker=\"0\",family=\"inet\"",
+			       pkt_counters.inet_tx_dests);
+	write_metrics_tx_dests(out, stat, "worker=\"0\",family=\"inet6\"",
+			       pkt_counters.inet6_tx_dests);
+
+	if (workers != NULL) {
+		for (i = 0; i < prog_parms.workers_num - 1; i++) {
+			snprintf(labels_str, sizeof(labels_str),
+				"worker=\"%u\",family=\"inet\"", i + 1);
+			write_metrics_tx_dests(out, stat, labels_str,
+					workers[i].pkt_counters.inet_tx_dests);
+			snprintf(labels_str, sizeof(labels_str),
+				"worker=\"%u\",family=\"inet6\"", i + 1);
+			write_metrics_tx_dests(out, stat, labels_str,
+					workers[i].pkt_counters.inet6_tx_dests);
+		}
+	}
+
+	if (flows != NULL) {
+		for (i = 0; i < prog_parms.flows_num; i++) {
+			snprintf(labels_str, sizeof(labels_str),
+				"flow=\"%u\",family=\"inet\"", i);
+			write_metrics_tx_dests(out, stat, labels_str,
+					       flows[i].inet_tx_dests);
+			snprintf(labels_str, sizeof(labels_str),
+				"flow=\"%u\",family=\"inet6\"", i);
+			write_metrics_tx_dests(out, stat, labels_str,
+					       flows[i].inet6_tx_dests);
+		}
+	}
+
+}
+
+
+void write_metrics_tx_dests(FILE *out,
+			    const enum METRICS_DEST_STAT stat,
+			    const char *labels_str,
+			    const struct tx_dests *tx_dests)
+{
+	const struct tx_dest_stats *dest_stats;
+	char dest_str[AIP_STR_INET6_MAX_LEN + 1];
+	char dest_labels_str[160];
+	unsigned int i;
+	unsigned int j;
+
+
+	if ((tx_dests == NULL) || (tx_dests->dest_stats == NULL)) {
+		return;
+	}
+
+	if (((stat == METRICS_DEST_LATENCY) ||
+	     (stat == METRICS_DEST_LATENCY_MAX)) &&
+	    (tx_dests->dest_latency == NULL)) {
+		return;
+	}
+
+	for (i = 0; i < (tx_dests->dests_num + tx_dests->conn_dests_num);
+									i++) {
+		dest_stats = &tx_dests->dest_stats[i];
+		tx_dest_str(tx_dests, i, dest_str, sizeof(dest_str));
+
+		switch (stat) {
+		case METRICS_DEST_PKTS:
+			fprintf(out, "replicast_dest_out_pkts_total"
+				"{%s,dest=\"%s\"} %llu\n", labels_str,
+				dest_str, dest_stats->pkts);
+			break;
+		case METRICS_DEST_BYTES:
+			fprintf(out, "replicast_dest_out_bytes_total"
+				"{%s,dest=\"%s\"} %llu\n", labels_str,
+				dest_str, dest_stats->bytes);
+			break;
+		case METRICS_DEST_ERRS:
+			for (j = 0; j < TX_DEST_ERRS; j++) {
+				fprintf(out, "replicast_dest_errors_total"
+					"{%s,dest=\"%s\",errno=\"%s\"} "
+					"%llu\n", labels_str, dest_str,
+					tx_dest_err_strs[j],
+					dest_stats->errs[j]);
+			}
+			break;
+		case METRICS_DEST_LATENCY:
+			snprintf(dest_labels_str, sizeof(dest_labels_str),
+				"%s,dest=\"%s\"", labels_str, dest_str);
+			write_metrics_latency(out,
+				"replicast_dest_latency_seconds",
+				dest_labels_str, &tx_dests->dest_latency[i]);
+			break;
+		case METRICS_DEST_LATENCY_MAX:
+			fprintf(out, "replicast_dest_latency_max_seconds"
+				"{%s,dest=\"%s\"} %.9f\n", labels_str,
+				dest_str, tx_dests->dest_latency[i].max / 1e9);
+			break;
+		}
+	}
+
+}
+
+
+void close_metrics(void)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if ((prog_parms.metrics_addr_str != NULL) &&
+	    (prog_parms.metrics_addr.ss_family == AF_UNIX)) {
+		unlink(prog_parms.metrics_addr_str);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+/*
+ * The rates are worked out by a thread of their own, woken by a timer every
+ * -rates interval, from the counters the forwarding threads already keep,
+ * so measuring them adds no work per datagram.
+ */
+void start_rates(const struct program_parameters *prog_parms)
+{
+	struct itimerspec timer;
+	struct timespec now;
+	sigset_t all_sigs;
+	sigset_t old_sigs;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (prog_parms->rates_interval == 0) {
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
+
+	rate_rep.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	if (rate_rep.timer_fd == -1) {
+		exit_errno(__func__, __LINE__, errno);
+	}
+
+	memset(&timer, 0, sizeof(timer));
+	timer.it_interval.tv_sec = prog_parms->rates_interval;
+	timer.it_value.tv_sec = prog_parms->rates_interval;
+	if (timerfd_settime(rate_rep.timer_fd, 0, &timer, NULL) == -1) {
+		exit_errno(__func__, __LINE__, errno);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	rate_rep.tick_nsecs = (now.tv_sec * 1000000000ULL) + now.tv_nsec;
+
+	sigfillset(&all_sigs);
+	pthread_sigmask(SIG_SETMASK, &all_sigs, &old_sigs);
+
+	ret = pthread_create(&rate_rep.thread, NULL, rates_thread, NULL);
+	if (ret != 0) {
+		exit_errno(__func__, __LINE__, ret);
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old_sigs, NULL);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void *rates_thread(void *arg)
+{
+	struct timespec now;
+	uint64_t expirations;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	for ( ;; ) {
+		if (read(rate_rep.timer_fd, &expirations,
+			 sizeof(expirations)) != sizeof(expirations)) {
+			continue;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		update_rates((now.tv_sec * 1000000000ULL) + now.tv_nsec);
+		log_rates();
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return NULL;
+
+}
+
+
+/*
+ * The rates are over the time since the last tick, rather than the
+ * interval, in case the thread was late or missed a tick. The smoothed
+ * rates weight each interval's by 1/RATES_EWMA_WEIGHT.
+ */
+void update_rates(const unsigned long long tick_nsecs)
+{
+	unsigned long long totals[RATE_STATS];
+	unsigned long long elapsed_nsecs;
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	elapsed_nsecs = tick_nsecs - rate_rep.tick_nsecs;
+	if (elapsed_nsecs == 0) {
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
+
+	sum_rate_totals(totals);
+
+	for (i = 0; i < RATE_STATS; i++) {
+		rate_rep.rates[i] = (totals[i] - rate_rep.totals[i]) *
+						1000000000.0 / elapsed_nsecs;
+		if (rate_rep.ticks == 0) {
+			rate_rep.ewma_rates[i] = rate_rep.rates[i];
+		} else {
+			rate_rep.ewma_rates[i] = ((rate_rep.ewma_rates[i] *
+				(RATES_EWMA_WEIGHT - 1)) + rate_rep.rates[i]) /
+							RATES_EWMA_WEIGHT;
+		}
+		rate_rep.totals[i] = totals[i];
+	}
+
+	rate_rep.tick_nsecs = tick_nsecs;
+	rate_rep.ticks++;
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+/*
+ * Datagrams and bits received, over the main thread, the workers and the
+ * flows, and sent, over every destination.
+ */
+void sum_rate_totals(unsigned long long totals[])
+{
+	struct packet_counters total_counters;
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	sum_packet_counters(&total_counters);
+
+	totals[RATE_RX_PKTS] = total_counters.inet_in_pkts +
+						total_counters.inet6_in_pkts;
+	totals[RATE_RX_BITS] = total_counters.rx_bytes * 8;
+	totals[RATE_TX_PKTS] = 0;
+	totals[RATE_TX_BITS] = 0;
+
+	sum_rate_tx_dests(totals, pkt_counters.inet_tx_dests);
+	sum_rate_tx_dests(totals, pkt_counters.inet6_tx_dests);
+
+	if (workers != NULL) {
+		for (i = 0; i < prog_parms.workers_num - 1; i++) {
+			sum_rate_tx_dests(totals,
+				workers[i].pkt_counters.inet_tx_dests);
+			sum_rate_tx_dests(totals,
+				workers[i].pkt_counters.inet6_tx_dests);
+		}
+	}
+
+	if (flows != NULL) {
+		for (i = 0; i < prog_parms.flows_num; i++) {
+			totals[RATE_RX_PKTS] += flows[i].in_pkts;
+			sum_rate_tx_dests(totals, flows[i].inet_tx_dests);
+			sum_rate_tx_dests(totals, flows[i].inet6_tx_dests);
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void sum_rate_tx_dests(unsigned long long totals[],
+		       const struct tx_dests *tx_dests)
+{
+	unsigned int i;
+
+
+	if ((tx_dests == NULL) || (tx_dests->dest_stats == NULL)) {
+		return;
+	}
+
+	for (i = 0; i < (tx_dests->dests_num + tx_dests->conn_dests_num);
+									i++) {
+		totals[RATE_TX_PKTS] += tx_dests->dest_stats[i].pkts;
+		totals[RATE_TX_BITS] += tx_dests->dest_stats[i].bytes * 8;
+	}
+
+}
+
+
+void log_rates(void)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	log_msg(LOG_SEV_INFO, "rx %llu pps, %.3f Mbps (avg %llu pps, %.3f "
+		"Mbps), tx %llu pps, %.3f Mbps (avg %llu pps, %.3f Mbps)\n",
+		rate_rep.rates[RATE_RX_PKTS],
+		rate_rep.rates[RATE_RX_BITS] / 1e6,
+		rate_rep.ewma_rates[RATE_RX_PKTS],
+		rate_rep.ewma_rates[RATE_RX_BITS] / 1e6,
+		rate_rep.rates[RATE_TX_PKTS],
+		rate_rep.rates[RATE_TX_BITS] / 1e6,
+		rate_rep.ewma_rates[RATE_TX_PKTS],
+		rate_rep.ewma_rates[RATE_TX_BITS] / 1e6);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void rcast(const enum REPLICAST_MODE rc_mode,
+	   struct socket_fds *sock_fds,
+	   const struct inet_rx_sock_params *inet_rx_sock_parms,
+	   const struct inet6_rx_sock_params *inet6_rx_sock_parms,
+	   struct packet_counters *pkt_counters)
+{
+	const struct rcast_mode *mode;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	switch (rc_mode) {
+	case RCMODE_FLOWS:
+		log_debug_med("%s() rc_mode = RCMODE_FLOWS\n", __func__);
+		flows_rcast(prog_parms.flows,
+			    prog_parms.flows_num,
+			    &prog_parms.rx_batch_parms,
+			    inet_rx_sock_parms->udp_gro,
+			    pkt_counters);
+		break;
+	default:
+		mode = find_rcast_mode(rc_mode);
+		if (mode != NULL) {
+			log_debug_med("%s() rc_mode = %d\n", __func__, rc_mode);
+			rcast_loop(mode,
+				   sock_fds,
+				   inet_rx_sock_parms,
+				   inet6_rx_sock_parms,
+				   &prog_parms.rx_batch_parms,
+				   prog_parms.engine,
+				   &prog_parms.inet_tx_sock_parms,
+				   &prog_parms.inet6_tx_sock_parms,
+				   pkt_counters);
+		}
+		break;
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+const struct rcast_mode *find_rcast_mode(const enum REPLICAST_MODE rc_mode)
+{
+	unsigned int i;
+
+
+	for (i = 0; i < sizeof(rcast_modes) / sizeof(rcast_modes[0]); i++) {
+		if (rcast_modes[i].rc_mode == rc_mode) {
+			return &rcast_modes[i];
+		}
+	}
+
+	return NULL;
+
+}
+
+
+/*
+ * Forwards from the mode's receive socket to each of its transmit legs in
+ * turn, IPv4 before IPv6, or hands over to the io_uring or pipe engine.
+ */
+void rcast_loop(const struct rcast_mode *mode,
+		struct socket_fds *sock_fds,
+		const struct inet_rx_sock_params *inet_rx_sock_parms,
+		const struct inet6_rx_sock_params *inet6_rx_sock_parms,
+		const struct rx_batch_params *rx_batch_parms,
+		const enum RCAST_ENGINE engine,
+		const struct inet_tx_sock_params *inet_tx_sock_parms,
+		const struct inet6_tx_sock_params *inet6_tx_sock_parms,
+		struct packet_counters *pkt_counters)
+{
+	struct tx_dests tx_dests[TX_LEGS_MAX];
+	struct tx_leg tx_legs[TX_LEGS_MAX];
+	unsigned int tx_legs_num = 0;
+	struct rx_batch rx_batch;
+	struct uring_tx_leg uring_tx_legs[URING_TX_LEGS_MAX];
+	struct pipe_tx_leg pipe_tx_legs[PIPE_TX_LEGS];
+	int *in_sock_fd;
+	unsigned long long *in_pkts;
+	unsigned long long *in_drops;
+	unsigned int udp_gro;
+	int rx_pkts;
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (mode->rx_family == AF_INET) {
+		in_sock_fd = &sock_fds->inet_in_sock_fd;
+		*in_sock_fd = open_inet_rx_sock(inet_rx_sock_parms);
+		in_pkts = &pkt_counters->inet_in_pkts;
+		in_drops = &pkt_counters->inet_in_drops;
+		udp_gro = inet_rx_sock_parms->udp_gro;
+	} else {
+		in_sock_fd = &sock_fds->inet6_in_sock_fd;
+		*in_sock_fd = open_inet6_rx_sock(inet6_rx_sock_parms);
+		in_pkts = &pkt_counters->inet6_in_pkts;
+		in_drops = &pkt_counters->inet6_in_drops;
+		udp_gro = inet6_rx_sock_parms->udp_gro;
+	}
+	if (*in_sock_fd == -1) {
+		exit_errno(__func__, __LINE__, errno);
+	}
+
+	if (mode->inet_tx) {
+		sock_fds->inet_out_sock_fd = open_inet_tx_sock(
+							inet_tx_sock_parms);
+		if (sock_fds->inet_out_sock_fd == -1) {
+			exit_errno(__func__, __LINE__, errno);
+		}
+
+		if (init_inet_tx_dests(&tx_dests[tx_legs_num],
+				       sock_fds->inet_out_sock_fd,
+				       inet_tx_sock_parms) == -1) {
+			exit_errno(__func__, __LINE__, errno);
+		}
+
+		pkt_counters->inet_tx_dests = &tx_dests[tx_legs_num];
+
+		tx_legs[tx_legs_num].family = AF_INET;
+		tx_legs[tx_legs_num].sock_fd = sock_fds->inet_out_sock_fd;
+		tx_legs[tx_legs_num].tx_dests = &tx_dests[tx_legs_num];
+		tx_legs[tx_legs_num].out_pkts = &pkt_counters->inet_out_pkts;
+		tx_legs_num++;
+	}
+
+	if (mode->inet6_tx) {
+		sock_fds->inet6_out_sock_fd = open_inet6_tx_sock(
+							inet6_tx_sock_parms);
+		if (sock_fds->inet6_out_sock_fd == -1) {
+			exit_errno(__func__, __LINE__, errno);
+		}
+
+		if (init_inet6_tx_dests(&tx_dests[tx_legs_num],
+					sock_fds->inet6_out_sock_fd,
+					inet6_tx_sock_parms) == -1) {
+			exit_errno(__func__, __LINE__, errno);
+		}
+
+		pkt_counters->inet6_tx_dests = &tx_dests[tx_legs_num];
+
+		tx_legs[tx_legs_num].family = AF_INET6;
+		tx_legs[tx_legs_num].sock_fd = sock_fds->inet6_out_sock_fd;
+		tx_legs[tx_legs_num].tx_dests = &tx_dests[tx_legs_num];
+		tx_legs[tx_legs_num].out_pkts = &pkt_counters->inet6_out_pkts;
+		tx_legs_num++;
+	}
+
+	if (init_rx_batch(&rx_batch, *in_sock_fd, rx_batch_parms,
+							udp_gro) == -1) {
+		exit_errno(__func__, __LINE__, errno);
+	}
+
+	if (rx_batch_parms->latency) {
+		for (i = 0; i < tx_legs_num; i++) {
+			if (init_tx_latency(tx_legs[i].tx_dests,
+					    rx_batch.rx_nsecs) == -1) {
+				exit_errno(__func__, __LINE__, errno);
+			}
+		}
+	}
+
+	for (i = 0; i < tx_legs_num; i++) {
+		if (tx_legs[i].tx_dests->pace_input) {
+			tx_legs[i].tx_dests->pace_rx_nsecs = rx_batch.rx_nsecs;
+		}
+	}
+
+	if (mode->rx_family == AF_INET) {
+		if (rx_batch_inet_xsk_open(&rx_batch, inet_rx_sock_parms,
+					&sock_fds->xdp_sock_fd) == -1) {
+			exit_errno(__func__, __LINE__, errno);
+		}
+
+		if (rx_batch_inet_pkt_ring_open(&rx_batch, inet_rx_sock_parms,
+						*in_sock_fd) == -1) {
+			exit_errno(__func__, __LINE__, errno);
+		}
+	} else {
+		if (rx_batch_inet6_xsk_open(&rx_batch, inet6_rx_sock_parms,
+					&sock_fds->xdp_sock_fd) == -1) {
+			exit_errno(__func__, __LINE__, errno);
+		}
+
+		if (rx_batch_inet6_pkt_ring_open(&rx_batch,
+				inet6_rx_sock_parms, *in_sock_fd) == -1) {
+			exit_errno(__func__, __LINE__, errno);
+		}
+	}
+
+	if (engine == ENGINE_URING) {
+		for (i = 0; i < tx_legs_num; i++) {
+			uring_tx_legs[i].sock_fd = tx_legs[i].sock_fd;
+			uring_tx_legs[i].tx_dests = tx_legs[i].tx_dests;
+			uring_tx_legs[i].out_pkts = tx_legs[i].out_pkts;
+		}
+		uring_rcast(*in_sock_fd, in_pkts, uring_tx_legs, tx_legs_num,
+			pkt_counters);
+	}
+
+	/* validation only allows the pipe engine with both families */
+	if (engine == ENGINE_PIPE) {
+		for (i = 0; i < PIPE_TX_LEGS; i++) {
+			pipe_tx_legs[i].sock_fd = tx_legs[i].sock_fd;
+			pipe_tx_legs[i].tx_dests = tx_legs[i].tx_dests;
+			pipe_tx_legs[i].pkt_counters = &pipe_tx_counters[i];
+			if (tx_legs[i].family == AF_INET) {
+				pipe_tx_legs[i].out_pkts =
+					&pipe_tx_counters[i].inet_out_pkts;
+			} else {
+				pipe_tx_legs[i].out_pkts =
+					&pipe_tx_counters[i].inet6_out_pkts;
+			}
+		}
+		pipe_rcast(*in_sock_fd, &rx_batch, in_pkts, in_drops,
+			pipe_tx_legs, pkt_counters);
+	}
+
+	for (i = 0; i < tx_legs_num; i++) {
+		if (rx_batch_zc_add(&rx_batch, tx_legs[i].sock_fd,
+				    tx_legs[i].tx_dests) == -1) {
+			exit_errno(__func__, __LINE__, errno);
+		}
+	}
+
+	for ( ;; ) {
+		tx_backlogs_wait(*in_sock_fd, &rx_batch,
+			pkt_counters->inet_tx_dests,
+			pkt_counters->inet6_tx_dests, pkt_counters);
+		rx_pkts = rx_batch_recv(*in_sock_fd, &rx_batch, pkt_counters);
+		*in_pkts += rx_pkts;
+		*in_drops = rx_batch.rx_drops;
+		for (i = 0; i < tx_legs_num; i++) {
+			*tx_legs[i].out_pkts += tx_dests_rcast(
+				tx_legs[i].sock_fd, rx_batch.pkts, rx_pkts,
+				tx_legs[i].tx_dests, pkt_counters);
+		}
+		rx_batch_latency(&rx_batch, rx_pkts, pkt_counters);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+/*
+ * Opens the flow's receive socket, non-blocking so a datagram the kernel
+ * discards after epoll reported it can't stall the other flows, and its
+ * transmit sockets and destinations for the families it sends to.
+ */
+int open_flow(struct flow *flow,
+	      const struct flow_params *flow_parms)
+{
+	struct tx_dests *tx_dests;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (find_rcast_mode(flow_parms->rc_mode)->rx_family == AF_INET) {
+		flow->rx_sock_fd = open_inet_rx_sock(
+					&flow_parms->inet_rx_sock_parms);
+	} else {
+		flow->rx_sock_fd = open_inet6_rx_sock(
+					&flow_parms->inet6_rx_sock_parms);
+	}
+	if ((flow->rx_sock_fd == -1) ||
+	    (fcntl(flow->rx_sock_fd, F_SETFL, O_NONBLOCK) == -1)) {
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	if (flow_parms->inet_tx_sock_parms.dests_num > 0) {
+		flow->inet_out_sock_fd = open_inet_tx_sock(
+					&flow_parms->inet_tx_sock_parms);
+		tx_dests = malloc(sizeof(struct tx_dests));
+		if ((flow->inet_out_sock_fd == -1) || (tx_dests == NULL) ||
+		    (init_inet_tx_dests(tx_dests, flow->inet_out_sock_fd,
+					&flow_parms->inet_tx_sock_parms) == -1)) {
+			free(tx_dests);
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+		/* only once initialised, as the -shmstats thread reads it */
+		flow->inet_tx_dests = tx_dests;
+	}
+
+	if (flow_parms->inet6_tx_sock_parms.dests_num > 0) {
+		flow->inet6_out_sock_fd = open_inet6_tx_sock(
+					&flow_parms->inet6_tx_sock_parms);
+		tx_dests = malloc(sizeof(struct tx_dests));
+		if ((flow->inet6_out_sock_fd == -1) || (tx_dests == NULL) ||
+		    (init_inet6_tx_dests(tx_dests, flow->inet6_out_sock_fd,
+					 &flow_parms->inet6_tx_sock_parms) ==
+									-1)) {
+			free(tx_dests);
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+		flow->inet6_tx_dests = tx_dests;
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return 0;
+
+}
+
+
+/*
+ * Forwards all the flows from the main thread, waiting on their receive
+ * sockets with epoll and then receiving one batch from each readable flow
+ * in turn, so a busy flow can't starve the others. The flows share the
+ * receive batch buffers.
+ */
+void flows_rcast(const struct flow_params flow_parms[],
+		 const unsigned int flows_num,
+		 const struct rx_batch_params *rx_batch_parms,
+		 const unsigned int udp_gro,
+		 struct packet_counters *pkt_counters)
+{
+	struct flow *new_flows;
+	struct flow *flow;
+	struct rx_batch rx_batch;
+	struct epoll_event event;
+	struct epoll_event events[FLOW_EVENTS];
+	int epoll_fd;
+	int events_num;
+	int rx_pkts;
+	unsigned int i;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	ret = posix_memalign((void **)&new_flows, CACHE_LINE,
+					flows_num * sizeof(struct flow));
+	if (ret != 0) {
+		exit_errno(__func__, __LINE__, ret);
+	}
+
+	for (i = 0; i < flows_num; i++) {
+		new_flows[i].rx_sock_fd = -1;
+		new_flows[i].inet_out_sock_fd = -1;
+		new_flows[i].inet6_out_sock_fd = -1;
+		new_flows[i].inet_tx_dests = NULL;
+		new_flows[i].inet6_tx_dests = NULL;
+		new_flows[i].in_pkts = 0;
+		new_flows[i].in_drops = 0;
+		new_flows[i].inet_out_pkts = 0;
+		new_flows[i].inet6_out_pkts = 0;
+	}
+
+	flows = new_flows;
+
+	epoll_fd = epoll_create1(0);
+	if (epoll_fd == -1) {
+		exit_errno(__func__, __LINE__, errno);
+	}
+
+	for (i = 0; i < flows_num; i++) {
+		if (open_flow(&flows[i], &flow_parms[i]) == -1) {
+			ret = errno;
+			log_msg(LOG_SEV_ERR, "Couldn't open the flow on line "
+				"%d.\n", flow_parms[i].line);
+			exit_errno(__func__, __LINE__, ret);
+		}
+
+		event.events = EPOLLIN;
+		event.data.u32 = i;
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, flows[i].rx_sock_fd,
+							&event) == -1) {
+			exit_errno(__func__, __LINE__, errno);
+		}
+	}
+
+	if (init_rx_batch(&rx_batch, flows[0].rx_sock_fd, rx_batch_parms,
+							udp_gro) == -1) {
+		exit_errno(__func__, __LINE__, errno);
+	}
+
+	for (i = 0; i < flows_num; i++) {
+		if (((flows[i].inet_tx_dests != NULL) &&
+		     (rx_batch_zc_add(&rx_batch, flows[i].inet_out_sock_fd,
+				      flows[i].inet_tx_dests) == -1)) ||
+		    ((flows[i].inet6_tx_dests != NULL) &&
+		     (rx_batch_zc_add(&rx_batch, flows[i].inet6_out_sock_fd,
+				      flows[i].inet6_tx_dests) == -1))) {
+			exit_errno(__func__, __LINE__, errno);
+		}
+	}
+
+	for ( ;; ) {
+		events_num = epoll_wait(epoll_fd, events, FLOW_EVENTS, -1);
+		for (i = 0; (int)i < events_num; i++) {
+			flow = &flows[events[i].data.u32];
+			rx_batch.rx_drops = flow->in_drops;
+			rx_pkts = rx_batch_recv(flow->rx_sock_fd, &rx_batch,
+								pkt_counters);
+			flow->in_pkts += rx_pkts;
+			flow->in_drops = rx_batch.rx_drops;
+			if (flow->inet_tx_dests != NULL) {
+				flow->inet_out_pkts += tx_dests_rcast(
+					flow->inet_out_sock_fd, rx_batch.pkts,
+					rx_pkts, flow->inet_tx_dests,
+					pkt_counters);
+			}
+			if (flow->inet6_tx_dests != NULL) {
+				flow->inet6_out_pkts += tx_dests_rcast(
+					flow->inet6_out_sock_fd, rx_batch.pkts,
+					rx_pkts, flow->inet6_tx_dests,
+					pkt_counters);
+			}
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void exit_errno(const char *func_name, const unsigned int linenum, int errnum)
+{
+
+
+	log_debug("%s() entry\n", __func__);
+
+	log_msg(LOG_SEV_ERR, "%s():%d error: %s\n", func_name, linenum,
+		strerror(errnum));
+
+	log_debug("%s() exit\n", __func__);
+
+	exit(EXIT_FAILURE);
+
+}
+
+
+void init_packet_counters(struct packet_counters *pkt_counters)
+{
+	unsigned int i;
+
+
+	pkt_counters->inet_in_pkts = 0;
+	pkt_counters->inet_in_drops = 0;
+	pkt_counters->inet_out_pkts = 0;
+	pkt_counters->inet6_in_pkts = 0;
+	pkt_counters->inet6_in_drops = 0;
+	pkt_counters->inet6_out_pkts = 0;
+	pkt_counters->rx_batches = 0;
+	pkt_counters->rx_batch_pkts = 0;
+	pkt_counters->rx_batches_full = 0;
+	pkt_counters->rx_busy_polls = 0;
+	pkt_counters->rx_busy_empty = 0;
+	pkt_counters->rx_busy_backoffs = 0;
+	pkt_counters->rx_buf_drops = 0;
+	pkt_counters->rx_buf_grows = 0;
+	pkt_counters->rx_bytes = 0;
+	memset(&pkt_counters->rx_latency, 0, sizeof(struct latency_hist));
+	pkt_counters->rx_gro_bufs = 0;
+	pkt_counters->rx_gro_segs = 0;
+	pkt_counters->tx_gso_sends = 0;
+	pkt_counters->tx_gso_segs = 0;
+	pkt_counters->tx_zc_sends = 0;
+	pkt_counters->tx_zc_hits = 0;
+	pkt_counters->tx_zc_fallbacks = 0;
+	pkt_counters->tx_zc_timeouts = 0;
+	pkt_counters->uring_enters = 0;
+	pkt_counters->uring_sqes = 0;
+	pkt_counters->uring_cqes = 0;
+	pkt_counters->uring_recv_errs = 0;
+	pkt_counters->xdp_rx_pkts = 0;
+	pkt_counters->xdp_rx_polls = 0;
+	pkt_counters->xdp_stack_pkts = 0;
+	pkt_counters->xdp_ring_full = 0;
+	pkt_counters->xdp_fill_empty = 0;
+	pkt_counters->xdp_dropped = 0;
+	pkt_counters->pkt_ring_pkts = 0;
+	pkt_counters->pkt_ring_blocks = 0;
+	pkt_counters->pkt_ring_kernel_pkts = 0;
+	pkt_counters->pkt_ring_drops = 0;
+	pkt_counters->pkt_ring_freezes = 0;
+	for (i = 0; i < PIPE_TX_LEGS; i++) {
+		pkt_counters->pipe_ring_hwm[i] = 0;
+		pkt_counters->pipe_ring_full[i] = 0;
+	}
+	pkt_counters->pipe_buf_full = 0;
+	pkt_counters->tx_backlog_queued = 0;
+	pkt_counters->tx_backlog_drops = 0;
+	pkt_counters->tx_paced = 0;
+	pkt_counters->tx_pace_drops = 0;
+	pkt_counters->inet_tx_dests = NULL;
+	pkt_counters->inet6_tx_dests = NULL;
+
+}
+
+
+void daemonise(void)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	create_child_process();
+
+	create_new_session();
+
+	change_to_rootdir();
+
+	open_syslog_log();
+
+	close_stdfiles();
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void create_child_process(void)
+{
+	pid_t pid;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	pid = fork();
+	if (pid < 0) {
+		exit_errno(__func__, __LINE__, errno);
+	} else if (pid > 0) {
+		exit(EXIT_SUCCESS);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void create_new_session(void)
+{
+	pid_t sid;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	sid = setsid();
+	if (sid < 0) {
+		exit_errno(__func__, __LINE__, errno);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void change_to_rootdir(void)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if ((chdir("/")) < 0) {
+		exit_errno(__func__, __LINE__, errno);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void open_syslog_log(void)
+{
+	pid_t daemon_pid;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	daemon_pid = getpid();
+
+	snprintf(syslog_ident, syslog_ident_len, "%s[%d]", program_name,
+		daemon_pid);
+	syslog_ident[syslog_ident_len - 1] = '\0';
+
+	log_open(LOG_DEST_SYSLOG, syslog_ident, LOG_SYSLOG_DAEMON, NULL, NULL,
+		 NULL, NULL);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void close_stdfiles(void)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	close(STDIN_FILENO);
+        close(STDOUT_FILENO);
+        close(STDERR_FILENO);	
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void install_exit_signal_handlers(void)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	install_sigterm_handler(&sigterm_action);
+
+	install_sigint_handler(&sigint_action);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void install_usr_signal_handlers(void)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	install_sigusr1_handler(&sigusr1_action);
+
+	install_sigusr2_handler(&sigusr2_action);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void install_sigterm_handler(struct sigaction *sigterm_action)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	sigterm_action->sa_handler = sigterm_handler;
+
+        sigemptyset(&sigterm_action->sa_mask);
+	sigaddset(&sigterm_action->sa_mask, SIGINT);
+	sigaddset(&sigterm_action->sa_mask, SIGUSR1);
+	sigaddset(&sigterm_action->sa_mask, SIGUSR2);
+
+        sigterm_action->sa_flags = 0;
+
+        sigaction(SIGTERM, sigterm_action, NULL);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void install_sigint_handler(struct sigaction *sigint_action)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	sigint_action->sa_handler = sigint_handler;
+
+        sigemptyset(&sigint_action->sa_mask);
+	sigaddset(&sigint_action->sa_mask, SIGTERM);
+	sigaddset(&sigint_action->sa_mask, SIGUSR1);
+	sigaddset(&sigint_action->sa_mask, SIGUSR2);
+
+        sigint_action->sa_flags = 0;
+
+        sigaction(SIGINT, sigint_action, NULL);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void install_sigusr1_handler(struct sigaction *sigusr1_action)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	sigusr1_action->sa_handler = sigusr1_handler;
+
+        sigemptyset(&sigusr1_action->sa_mask);
+	sigaddset(&sigusr1_action->sa_mask, SIGUSR2);
+
+        sigusr1_action->sa_flags = SA_RESTART;
+
+        sigaction(SIGUSR1, sigusr1_action, NULL);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void install_sigusr2_handler(struct sigaction *sigusr2_action)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	sigusr2_action->sa_handler = sigusr2_handler;
+
+        sigemptyset(&(sigusr2_action->sa_mask));
+	sigaddset(&sigusr2_action->sa_mask, SIGUSR1);
+
+        sigusr2_action->sa_flags = SA_RESTART;
+
+        sigaction(SIGUSR2, sigusr2_action, NULL);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void sigterm_handler(int signum)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	exit_program();
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void sigint_handler(int signum)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	exit_program();
+
+	log_debug_med("%s() exit\n", __func__);
+
+
+}
+
+
+void sigusr1_handler(int signum)
+{
+	struct packet_counters total_counters;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	update_xdp_counters(sock_fds.xdp_sock_fd, &pkt_counters);
+
+	sum_packet_counters(&total_counters);
+
+	log_packet_counters(prog_parms.rc_mode, &total_counters);
+
+	log_tx_backlogs(&pkt_counters);
+
+	log_tx_rates(&pkt_counters);
+
+	log_tx_dests_stats(&pkt_counters);
+
+	log_tx_latency(&pkt_counters);
+
+	log_debug_med("%s() exit\n", __func__);
+
+
+}
+
+
+void sigusr2_handler(int signum)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	log_prog_banner();
+
+	log_prog_parms(&prog_parms);
+
+	log_debug_med("%s() exit\n", __func__);
+
+
+}
+
+
+int open_inet_rx_sock(const struct inet_rx_sock_params *sock_parms)
+{
+	int ret;
+	int sock_fd;
+	int one = 1;
+	struct sockaddr_in sa_in_rxaddr;
+	struct ip_mreq ip_mcast_req;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock_fd == -1) {
+		return -1;
+	}
+
+	ret = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &one,
+		sizeof(one));
+	if (ret == -1) {
+		return -1;
+	}
+
+	if (sock_parms->rcvbuf > 0) {
+		ret = sock_buf_set(sock_fd, SO_RCVBUF, sock_parms->rcvbuf,
+			"inet rx socket", "-rxbuf");
+		if (ret == -1) {
+			return -1;
+		}
+	}
+
+	ret = setsockopt(sock_fd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one));
+	if (ret == -1) {
+		return -1;
+	}
+
+	if (sock_parms->workers_num > 1) {
+		ret = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, &one,
+			sizeof(one));
+		if (ret == -1) {
+			return -1;
+		}
+	}
+
+	/* before bind(), so no worker sees another's datagrams meanwhile */
+	if (IN_MULTICAST(ntohl(sock_parms->rx_addr.s_addr)) &&
+	    (sock_parms->workers_num > 1)) {
+		ret = rx_sock_worker_filter(sock_fd, AF_INET,
+			sock_parms->worker_idx, sock_parms->workers_num);
+		if (ret == -1) {
+			return -1;
+		}
+	}
+
+	memset(&sa_in_rxaddr, 0, sizeof(sa_in_rxaddr));
+	sa_in_rxaddr.sin_family = AF_INET;
+	sa_in_rxaddr.sin_addr =  sock_parms->rx_addr;
+	sa_in_rxaddr.sin_port = htons(sock_parms->port);
+	ret = bind(sock_fd, (struct sockaddr *) &sa_in_rxaddr,
+		sizeof(sa_in_rxaddr));
+	if (ret == -1) {
+		return -1;
+	}
+
+	if (sock_parms->udp_gro) {
+		ret = setsockopt(sock_fd, SOL_UDP, UDP_GRO, &one, sizeof(one));
+		if (ret == -1) {
+			return -1;
+		}
+	}
+
+	if (IN_MULTICAST(ntohl(sock_parms->rx_addr.s_addr))) {
+		ip_mcast_req.imr_multiaddr = sock_parms->rx_addr;
+		ip_mcast_req.imr_interface = sock_parms->in_intf_addr;
+		ret = setsockopt(sock_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+			&ip_mcast_req, sizeof(ip_mcast_req));
+		if (ret == -1) {
+			return -1;
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return sock_fd;
+
+}
+
+
+void close_inet_rx_sock(const int sock_fd)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (sock_fd != -1) {
+		close(sock_fd);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+int open_inet6_rx_sock(const struct inet6_rx_sock_params *sock_parms)
+{
+	int ret;
+	int sock_fd;
+	const int one = 1;
+	struct sockaddr_in6 sa_in6_rxaddr;
+	struct ipv6_mreq ipv6_mcast_req;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	sock_fd = socket(AF_INET6, SOCK_DGRAM, 0);
+	if (sock_fd == -1) {
+		log_debug_low("%s(): socket() == %d\n", __func__, sock_fd);
+		log_debug_low("%s(): errno == %d\n", __func__, errno);
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	ret = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &one,
+		sizeof(one));
+	if (ret == -1) {
+		log_debug_low("%s(): setsockopt(SO_REUSEADDR) == %d\n",
+			__func__, ret);
+		log_debug_low("%s(): errno == %d\n", __func__, errno);
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	if (sock_parms->rcvbuf > 0) {
+		ret = sock_buf_set(sock_fd, SO_RCVBUF, sock_parms->rcvbuf,
+			"inet6 rx socket", "-rxbuf");
+		if (ret == -1) {
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+	}
+
+	ret = setsockopt(sock_fd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one));
+	if (ret == -1) {
+		log_debug_low("%s(): setsockopt(SO_RXQ_OVFL) == %d\n",
+			__func__, ret);
+		log_debug_low("%s(): errno == %d\n", __func__, errno);
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	if (sock_parms->workers_num > 1) {
+		ret = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, &one,
+			sizeof(one));
+		if (ret == -1) {
+			log_debug_low("%s(): setsockopt(SO_REUSEPORT) == %d\n",
+				__func__, ret);
+			log_debug_low("%s(): errno == %d\n", __func__, errno);
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+	}
+
+	ret = setsockopt(sock_fd, IPPROTO_IPV6, IPV6_V6ONLY, &one,
+		sizeof(one));
+	if (ret == -1) {
+		log_debug_low("%s(): setsockopt(IPV6_V6ONLY) == %d\n",
+			__func__, ret);
+		log_debug_low("%s(): errno == %d\n", __func__, errno);
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	/* before bind(), so no worker sees another's datagrams meanwhile */
+	if (IN6_IS_ADDR_MULTICAST(&sock_parms->rx_addr) &&
+	    (sock_parms->workers_num > 1)) {
+		ret = rx_sock_worker_filter(sock_fd, AF_INET6,
+			sock_parms->worker_idx, sock_parms->workers_num);
+		if (ret == -1) {
+			log_debug_low("%s(): rx_sock_worker_filter() == %d\n",
+				__func__, ret);
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+	}
+
+	memset(&sa_in6_rxaddr, 0, sizeof(sa_in6_rxaddr));
+	sa_in6_rxaddr.sin6_family = AF_INET6;
+	sa_in6_rxaddr.sin6_addr = sock_parms->rx_addr;
+	sa_in6_rxaddr.sin6_port = htons(sock_parms->port);
+	if (IN6_IS_ADDR_MC_LINKLOCAL(&sa_in6_rxaddr.sin6_addr) ||
+	    IN6_IS_ADDR_LINKLOCAL(&sa_in6_rxaddr.sin6_addr) ) {
+		sa_in6_rxaddr.sin6_scope_id = sock_parms->in_intf_idx;
+	}
+	ret = bind(sock_fd, (struct sockaddr *) &sa_in6_rxaddr,
+		sizeof(sa_in6_rxaddr));
+	if (ret == -1) {
+		log_debug_low("%s(): bind() == %d\n", __func__, ret);
+		log_debug_low("%s(): errno == %d\n", __func__, errno);
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	if (sock_parms->udp_gro) {
+		ret = setsockopt(sock_fd, SOL_UDP, UDP_GRO, &one, sizeof(one));
+		if (ret == -1) {
+			log_debug_low("%s(): setsockopt(UDP_GRO) == %d\n",
+				__func__, ret);
+			log_debug_low("%s(): errno == %d\n", __func__, errno);
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+	}
+
+	if (IN6_IS_ADDR_MULTICAST(&sock_parms->rx_addr)) {
+		ipv6_mcast_req.ipv6mr_multiaddr = sock_parms->rx_addr;
+		ipv6_mcast_req.ipv6mr_interface = sock_parms->in_intf_idx;
+		ret = setsockopt(sock_fd, IPPROTO_IPV6, IPV6_ADD_MEMBERSHIP,
+			&ipv6_mcast_req, sizeof(ipv6_mcast_req));
+		if (ret == -1) {
+			log_debug_low("%s(): setsockopt(IPV6_ADD_MEMBERSHIP)",
+				__func__);
+			log_debug_low(" == %d\n", ret);
+			log_debug_low("%s(): errno == %d\n", __func__, errno);
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return sock_fd;
+
+}
+
+
+void close_inet6_rx_sock(const int sock_fd)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (sock_fd != -1) {
+		close(sock_fd);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+
+/*
+ * SO_REUSEPORT only spreads unicast datagrams across its sockets, every
+ * socket receives a copy of a multicast datagram. So that multicast is also
+ * shared, each worker's socket filters out datagrams from sources it isn't
+ * responsible for, using a hash of the source address and port. That keeps
+ * each source's datagrams in order, but leaves a single source's to one
+ * worker.
+ */
+int rx_sock_worker_filter(const int sock_fd,
+			  const int family,
+			  const unsigned int worker_idx,
+			  const unsigned int workers_num)
+{
+	struct sock_filter filter[] = {
+		/* A = low word of the source address */
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + 12),
+		BPF_STMT(BPF_MISC | BPF_TAX, 0),
+		/* A = source port, the UDP socket filter starts at UDP */
+		BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 0),
+		BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+		BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, workers_num),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, worker_idx, 0, 1),
+		BPF_STMT(BPF_RET | BPF_K, 0xffffffff),
+		BPF_STMT(BPF_RET | BPF_K, 0),
+	};
+	struct sock_fprog prog;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (family == AF_INET6) {
+		filter[0].k = SKF_NET_OFF + 20;
+	}
+
+	prog.len = sizeof(filter) / sizeof(filter[0]);
+	prog.filter = filter;
+
+	if (setsockopt(sock_fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog,
+						sizeof(prog)) == -1) {
+		log_debug_low("%s(): setsockopt(SO_ATTACH_FILTER) failed\n",
+								__func__);
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return 0;
+
+}
+
+
+int sock_buf_get(const int sock_fd,
+		 const int optname)
+{
+	int size;
+	socklen_t size_len = sizeof(size);
+
+
+	if (getsockopt(sock_fd, SOL_SOCKET, optname, &size, &size_len) == -1) {
+		return -1;
+	}
+
+	return size;
+
+}
+
+
+/*
+ * SO_RCVBUFFORCE and SO_SNDBUFFORCE need CAP_NET_ADMIN and aren't limited by
+ * net.core.rmem_max and wmem_max, so they're tried first. The kernel doubles
+ * the requested size to allow for its own overheads, and the doubled size
+ * is what's logged, along with the reason for the change.
+ */
+int sock_buf_set(const int sock_fd,
+		 const int optname,
+		 const unsigned int size,
+		 const char *sock_str,
+		 const char *reason_str)
+{
+	const int force_optname = (optname == SO_RCVBUF) ? SO_RCVBUFFORCE :
+								SO_SNDBUFFORCE;
+	const int val = size;
+	int old_size;
+	int new_size;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	old_size = sock_buf_get(sock_fd, optname);
+
+	ret = setsockopt(sock_fd, SOL_SOCKET, force_optname, &val, sizeof(val));
+	log_debug_low("%s(): setsockopt(%s) == %d\n", __func__,
+		(optname == SO_RCVBUF) ? "SO_RCVBUFFORCE" : "SO_SNDBUFFORCE",
+		ret);
+	if (ret == -1) {
+		ret = setsockopt(sock_fd, SOL_SOCKET, optname, &val,
+							sizeof(val));
+		log_debug_low("%s(): setsockopt(%s) == %d\n", __func__,
+			(optname == SO_RCVBUF) ? "SO_RCVBUF" : "SO_SNDBUF",
+			ret);
+		if (ret == -1) {
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+	}
+
+	new_size = sock_buf_get(sock_fd, optname);
+
+	log_msg(LOG_SEV_INFO, "%s %s buffer %d -> %d bytes, %s%s\n",
+		sock_str, (optname == SO_RCVBUF) ? "receive" : "send",
+		old_size, new_size, reason_str,
+		(new_size < (2 * val)) ? ((optname == SO_RCVBUF) ?
+			", limited by net.core.rmem_max" :
+			", limited by net.core.wmem_max") : "");
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return new_size;
+
+}
+
+
+int open_inet_tx_sock(const struct inet_tx_sock_params *sock_parms)
+{
+	int sock_fd;
+	uint8_t ttl;
+	uint8_t loop;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock_fd == -1) {
+		return -1;
+	}
+
+	if (sock_parms->sndbuf > 0) {
+		ret = sock_buf_set(sock_fd, SO_SNDBUF, sock_parms->sndbuf,
+			"inet tx socket", "-txbuf");
+		if (ret == -1) {
+			return -1;
+		}
+	}
+
+	if (sock_parms->mc_dests_num > 0) {
+
+		log_debug_low("%s() sock_parms->mc_dests_num = %d\n", __func__,
+			sock_parms->mc_dests_num);
+
+		if (sock_parms->mc_ttl > 0) {
+			ttl = sock_parms->mc_ttl & 0xff;
+			ret = setsockopt(sock_fd, IPPROTO_IP, IP_MULTICAST_TTL,
+				&ttl, sizeof(ttl));	
+			if (ret == -1) {
+				return -1;
+			}
+		}
+
+		if (sock_parms->mc_loop == 1) {
+			loop = 1;
+		} else {
+			loop = 0;
+		}
+		ret = setsockopt(sock_fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop,
+			sizeof(loop));
+		if (ret == -1) {
+			return -1;
+		}
+
+		ret = setsockopt(sock_fd, IPPROTO_IP, IP_MULTICAST_IF,
+			&sock_parms->out_intf_addr,
+			sizeof(sock_parms->out_intf_addr));
+		if (ret == -1) {
+			return -1;
+		}
+ 
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return sock_fd;
+
+}
+
+
+void close_inet_tx_sock(int sock_fd)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (sock_fd != -1) {
+		close(sock_fd);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+int open_inet6_tx_sock(const struct inet6_tx_sock_params *sock_parms)
+{
+	int sock_fd;
+	int ret;
+	const int one = 1;
+	int32_t hops;
+	uint32_t loop;
+	uint32_t out_ifidx;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	sock_fd = socket(AF_INET6, SOCK_DGRAM, 0);
+	if (sock_fd == -1) {
+		return -1;
+	}
+
+	ret = setsockopt(sock_fd, IPPROTO_IPV6, IPV6_V6ONLY, &one,
+		sizeof(one));
+	if (ret == -1) {
+		log_debug_low("%s(): setsockopt(IPV6_V6ONLY) == %d\n",
+			__func__, ret);
+		log_debug_low("%s(): errno == %d\n", __func__, errno);
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	if (sock_parms->sndbuf > 0) {
+		ret = sock_buf_set(sock_fd, SO_SNDBUF, sock_parms->sndbuf,
+			"inet6 tx socket", "-txbuf");
+		if (ret == -1) {
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+	}
+
+	if (sock_parms->mc_dests_num > 0) {
+
+		log_debug_low("%s() sock_parms->mc_dests_num = %d\n", __func__,
+			sock_parms->mc_dests_num);
+
+		if (sock_parms->mc_hops > 0) {
+			hops = sock_parms->mc_hops & 0xff;
+			ret = setsockopt(sock_fd, IPPROTO_IPV6,
+				IPV6_MULTICAST_HOPS, &hops, sizeof(hops));	
+			if (ret == -1) {
+				return -1;
+			}
+		}
+
+		if (sock_parms->mc_loop == 1) {
+			loop = 1;
+		} else {
+			loop = 0;
+		}
+		ret = setsockopt(sock_fd, IPPROTO_IPV6, IPV6_MULTICAST_LOOP,
+			&loop, sizeof(loop));
+		if (ret == -1) {
+			return -1;
+		}
+
+		if (sock_parms->out_intf_idx) {
+			out_ifidx = sock_parms->out_intf_idx;
+			ret = setsockopt(sock_fd, IPPROTO_IPV6,
+				IPV6_MULTICAST_IF, &out_ifidx,
+				sizeof(out_ifidx));
+			if (ret == -1) {
+				return -1;
+			}
+		}
+
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return sock_fd;
+			
+}
+
+
+void close_inet6_tx_sock(int sock_fd)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (sock_fd != -1) {
+		close(sock_fd);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+
+/*
+ * Opens a socket connected to each unicast destination, with the same
+ * options as the shared transmit socket. Multicast destinations stay on the
+ * shared socket and get -1.
+ */
+int open_inet_tx_conn_socks(const struct inet_tx_sock_params *sock_parms,
+			    int conn_fds[])
+{
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	for (i = 0; i < sock_parms->dests_num; i++) {
+		if (IN_MULTICAST(ntohl(sock_parms->dests[i].sin_addr.s_addr))) {
+			conn_fds[i] = -1;
+			continue;
+		}
+
+		conn_fds[i] = open_inet_tx_sock(sock_parms);
+		if (conn_fds[i] == -1) {
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+
+		if (connect(conn_fds[i],
+			    (const struct sockaddr *)&sock_parms->dests[i],
+			    sizeof(struct sockaddr_in)) == -1) {
+			log_debug_low("%s(): connect() failed\n", __func__);
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return 0;
+
+}
+
+
+int open_inet6_tx_conn_socks(const struct inet6_tx_sock_params *sock_parms,
+			     int conn_fds[])
+{
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	for (i = 0; i < sock_parms->dests_num; i++) {
+		if (IN6_IS_ADDR_MULTICAST(&sock_parms->dests[i].sin6_addr)) {
+			conn_fds[i] = -1;
+			continue;
+		}
+
+		conn_fds[i] = open_inet6_tx_sock(sock_parms);
+		if (conn_fds[i] == -1) {
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+
+		if (connect(conn_fds[i],
+			    (const struct sockaddr *)&sock_parms->dests[i],
+			    sizeof(struct sockaddr_in6)) == -1) {
+			log_debug_low("%s(): connect() failed\n", __func__);
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return 0;
+
+}
+
+
+void close_xdp_sock(const int sock_fd)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (sock_fd != -1) {
+		close(sock_fd);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+int udp_gso_probe(const int sock_fd)
+{
+	int gso_size;
+	socklen_t gso_size_len = sizeof(gso_size);
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	ret = getsockopt(sock_fd, SOL_UDP, UDP_SEGMENT, &gso_size,
+		&gso_size_len);
+	log_debug_low("%s(): getsockopt(UDP_SEGMENT) == %d\n", __func__, ret);
+	log_debug_low("%s(): errno == %d\n", __func__, errno);
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return (ret == -1) ? 0 : 1;
+
+}
+
+
+int tx_zerocopy_enable(const int sock_fd)
+{
+	const int one = 1;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	ret = setsockopt(sock_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+	log_debug_low("%s(): setsockopt(SO_ZEROCOPY) == %d\n", __func__, ret);
+	log_debug_low("%s(): errno == %d\n", __func__, errno);
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return (ret == -1) ? 0 : 1;
+
+}
+
+
+/*
+ * fq compares departure times with CLOCK_MONOTONIC and etf with CLOCK_TAI.
+ * Connected sockets are -1 for multicast destinations, which are sent on
+ * the shared socket.
+ */
+int tx_txtime_enable(const int sock_fd,
+		     const int conn_fds[],
+		     const unsigned int conn_fds_num,
+		     const enum TX_PACE_MODE pace_mode)
+{
+	struct sock_txtime txtime;
+	unsigned int i;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	memset(&txtime, 0, sizeof(txtime));
+	txtime.clockid = (pace_mode == TX_PACE_ETF) ? CLOCK_TAI :
+							CLOCK_MONOTONIC;
+
+	ret = setsockopt(sock_fd, SOL_SOCKET, SO_TXTIME, &txtime,
+							sizeof(txtime));
+	log_debug_low("%s(): setsockopt(SO_TXTIME) == %d\n", __func__, ret);
+
+	for (i = 0; (i < conn_fds_num) && (conn_fds != NULL) && (ret != -1);
+									i++) {
+		if (conn_fds[i] != -1) {
+			ret = setsockopt(conn_fds[i], SOL_SOCKET, SO_TXTIME,
+						&txtime, sizeof(txtime));
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return (ret == -1) ? 0 : 1;
+
+}
+
+
+int init_tx_dests(struct tx_dests *tx_dests,
+		  const void *dests,
+		  const socklen_t dest_len,
+		  const unsigned int dests_num,
+		  const unsigned int udp_gso,
+		  const unsigned int zerocopy,
+		  int *conn_fds)
+{
+	const uint8_t *dest = dests;
+	const struct sockaddr *sa_dest;
+	struct mmsghdr *dest_mmsg;
+	struct cmsghdr *cmsg;
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	tx_dests->dests_num = 0;
+	tx_dests->pkt_iov.iov_base = NULL;
+	tx_dests->pkt_iov.iov_len = 0;
+	tx_dests->udp_gso = udp_gso;
+	tx_dests->zerocopy = zerocopy;
+	tx_dests->zc_issued = 0;
+	tx_dests->zc_completed = 0;
+	memset(tx_dests->zc_marks, 0, sizeof(tx_dests->zc_marks));
+	tx_dests->zc_rotated = 0;
+	tx_dests->gso_mmsgs = NULL;
+	tx_dests->gso_dests = NULL;
+	tx_dests->gso_dests_num = 0;
+	tx_dests->mc_mmsgs = NULL;
+	tx_dests->mc_dests = NULL;
+	tx_dests->mc_dests_num = 0;
+	tx_dests->dest_stats = NULL;
+	tx_dests->rx_nsecs = NULL;
+	tx_dests->pkt_rx_nsecs = NULL;
+	tx_dests->sent_nsecs = 0;
+	tx_dests->latency = NULL;
+	tx_dests->dest_latency = NULL;
+	tx_dests->conn_fds = conn_fds;
+	tx_dests->conn_dests = NULL;
+	tx_dests->conn_dests_num = 0;
+	memset(tx_dests->conn_mmsgs, 0, sizeof(tx_dests->conn_mmsgs));
+	tx_dests->backlog_size = 0;
+	tx_dests->backlogs = NULL;
+	tx_dests->backlogs_pending = 0;
+	tx_dests->sock_blocked = 0;
+	tx_dests->epoll_fd = -1;
+	tx_dests->rate_limited = 0;
+	tx_dests->rate_queue = 0;
+	tx_dests->rate_nsecs = 0;
+	tx_dests->rate_dests = NULL;
+	init_tx_rate_bucket(&tx_dests->rate_intf, 0);
+	tx_dests->rate_global = NULL;
+	tx_dests->rate_timer_fd = -1;
+	tx_dests->rate_timer_armed = 0;
+	tx_dests->paced = 0;
+
+	if (conn_fds != NULL) {
+		tx_dests->conn_dests = calloc(dests_num,
+			sizeof(struct sockaddr *));
+		if (tx_dests->conn_dests == NULL) {
+			log_debug_med("%s() exit\n", __func__);
+			errno = ENOMEM;
+			return -1;
+		}
+	}
+
+	tx_dests->mmsgs = calloc(dests_num, sizeof(struct mmsghdr));
+	tx_dests->send_mmsgs = calloc(dests_num, sizeof(struct mmsghdr));
+	tx_dests->send_dests = calloc(dests_num, sizeof(unsigned int));
+	if ((tx_dests->mmsgs == NULL) || (tx_dests->send_mmsgs == NULL) ||
+	    (tx_dests->send_dests == NULL)) {
+		log_debug_low("%s(): calloc() failed\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	/*
+	 * The destinations' counters are indexed like their backlogs and rate
+	 * buckets, the shared socket's destinations first, then the
+	 * connected ones.
+	 */
+	if (posix_memalign((void **)&tx_dests->dest_stats, CACHE_LINE,
+			   dests_num * sizeof(struct tx_dest_stats)) != 0) {
+		tx_dests->dest_stats = NULL;
+		log_debug_low("%s(): posix_memalign() failed\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		errno = ENOMEM;
+		return -1;
+	}
+	memset(tx_dests->dest_stats, 0,
+		dests_num * sizeof(struct tx_dest_stats));
+
+	if (udp_gso) {
+		tx_dests->gso_mmsgs = calloc(dests_num,
+			sizeof(struct mmsghdr));
+		tx_dests->gso_dests = calloc(dests_num, sizeof(unsigned int));
+		tx_dests->mc_mmsgs = calloc(dests_num, sizeof(struct mmsghdr));
+		tx_dests->mc_dests = calloc(dests_num, sizeof(unsigned int));
+		if ((tx_dests->gso_mmsgs == NULL) ||
+		    (tx_dests->gso_dests == NULL) ||
+		    (tx_dests->mc_mmsgs == NULL) || (tx_dests->mc_dests == NULL)) {
+			log_debug_low("%s(): calloc() failed\n", __func__);
+			log_debug_med("%s() exit\n", __func__);
+			errno = ENOMEM;
+			return -1;
+		}
+	}
+
+	memset(&tx_dests->gso_cmsg, 0, sizeof(tx_dests->gso_cmsg));
+	cmsg = (struct cmsghdr *)tx_dests->gso_cmsg.buf;
+	cmsg->cmsg_level = SOL_UDP;
+	cmsg->cmsg_type = UDP_SEGMENT;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+
+	/*
+	 * Every destination's message shares the one payload iovec, so only
+	 * it needs to be updated for each packet. With UDP GSO, unicast
+	 * destinations also get a message carrying a run of datagrams, while
+	 * multicast destinations are kept to single datagram sends.
+	 * Destinations with their own connected socket are sent to separately,
+	 * and have their sockets packed to the front of conn_fds.
+	 */
+	for (i = 0; i < dests_num; i++) {
+		sa_dest = (const struct sockaddr *)dest;
+
+		if ((conn_fds != NULL) && (conn_fds[i] != -1)) {
+			tx_dests->conn_dests[tx_dests->conn_dests_num] = sa_dest;
+			conn_fds[tx_dests->conn_dests_num++] = conn_fds[i];
+			dest += dest_len;
+			continue;
+		}
+
+		dest_mmsg = &tx_dests->mmsgs[tx_dests->dests_num++];
+		dest_mmsg->msg_hdr.msg_name = (void *)dest;
+		dest_mmsg->msg_hdr.msg_namelen = dest_len;
+		dest_mmsg->msg_hdr.msg_iov = &tx_dests->pkt_iov;
+		dest_mmsg->msg_hdr.msg_iovlen = 1;
+
+		if (udp_gso) {
+			if (((sa_dest->sa_family == AF_INET) &&
+			     IN_MULTICAST(ntohl(((const struct sockaddr_in *)
+					dest)->sin_addr.s_addr))) ||
+			    ((sa_dest->sa_family == AF_INET6) &&
+			     IN6_IS_ADDR_MULTICAST(&((const struct sockaddr_in6 *)
+					dest)->sin6_addr))) {
+				tx_dests->mc_dests[tx_dests->mc_dests_num] =
+						tx_dests->dests_num - 1;
+				dest_mmsg = &tx_dests->mc_mmsgs[
+						tx_dests->mc_dests_num++];
+				dest_mmsg->msg_hdr.msg_iov = &tx_dests->pkt_iov;
+				dest_mmsg->msg_hdr.msg_iovlen = 1;
+			} else {
+				tx_dests->gso_dests[tx_dests->gso_dests_num] =
+						tx_dests->dests_num - 1;
+				dest_mmsg = &tx_dests->gso_mmsgs[
+						tx_dests->gso_dests_num++];
+				dest_mmsg->msg_hdr.msg_control =
+						tx_dests->gso_cmsg.buf;
+				dest_mmsg->msg_hdr.msg_controllen =
+						sizeof(tx_dests->gso_cmsg.buf);
+			}
+			dest_mmsg->msg_hdr.msg_name = (void *)dest;
+			dest_mmsg->msg_hdr.msg_namelen = dest_len;
+		}
+
+		dest += dest_len;
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return 0;
+
+}
+
+
+int init_inet_tx_dests(struct tx_dests *tx_dests,
+		       const int sock_fd,
+		       const struct inet_tx_sock_params *sock_parms)
+{
+	unsigned int udp_gso = 0;
+	unsigned int zerocopy = 0;
+	enum TX_PACE_MODE pace_mode;
+	int *conn_fds = NULL;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (sock_parms->connect) {
+		conn_fds = calloc(sock_parms->dests_num, sizeof(int));
+		if (conn_fds == NULL) {
+			log_debug_med("%s() exit\n", __func__);
+			errno = ENOMEM;
+			return -1;
+		}
+		if (open_inet_tx_conn_socks(sock_parms, conn_fds) == -1) {
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+	}
+
+	if (sock_parms->udp_gso) {
+		udp_gso = udp_gso_probe(sock_fd);
+		if (!udp_gso) {
+			log_msg(LOG_SEV_WARNING, "inet udp gso not supported, "
+				"using separate sends\n");
+		}
+	}
+
+	if (sock_parms->zerocopy) {
+		zerocopy = tx_zerocopy_enable(sock_fd);
+		if (!zerocopy) {
+			log_msg(LOG_SEV_WARNING, "inet zerocopy not supported, "
+				"using copied sends\n");
+		}
+	}
+
+	pace_mode = sock_parms->pace_mode;
+	if (((sock_parms->pace_rate > 0) || sock_parms->pace_input) &&
+	    (pace_mode != TX_PACE_TIMER)) {
+		if (!tx_txtime_enable(sock_fd, conn_fds, sock_parms->dests_num,
+							pace_mode)) {
+			log_msg(LOG_SEV_WARNING, "inet SO_TXTIME not supported, "
+				"pacing with a timer\n");
+			pace_mode = TX_PACE_TIMER;
+		}
+	}
+
+	if (init_tx_dests(tx_dests, sock_parms->dests,
+			  sizeof(struct sockaddr_in), sock_parms->dests_num,
+			  udp_gso, zerocopy, conn_fds) == -1) {
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	if (init_tx_backlogs(tx_dests, sock_fd, sock_parms->backlog) == -1) {
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	if (init_tx_rate(tx_dests, sock_parms->rate, sock_parms->dest_rate,
+			 sock_parms->rate_queue) == -1) {
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	init_tx_pace(tx_dests, sock_parms->pace_rate, sock_parms->pace_input,
+		pace_mode);
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return 0;
+
+}
+
+
+int init_inet6_tx_dests(struct tx_dests *tx_dests,
+			const int sock_fd,
+			const struct inet6_tx_sock_params *sock_parms)
+{
+	unsigned int udp_gso = 0;
+	unsigned int zerocopy = 0;
+	enum TX_PACE_MODE pace_mode;
+	int *conn_fds = NULL;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (sock_parms->connect) {
+		conn_fds = calloc(sock_parms->dests_num, sizeof(int));
+		if (conn_fds == NULL) {
+			log_debug_med("%s() exit\n", __func__);
+			errno = ENOMEM;
+			return -1;
+		}
+		if (open_inet6_tx_conn_socks(sock_parms, conn_fds) == -1) {
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+	}
+
+	if (sock_parms->udp_gso) {
+		udp_gso = udp_gso_probe(sock_fd);
+		if (!udp_gso) {
+			log_msg(LOG_SEV_WARNING, "inet6 udp gso not supported, "
+				"using separate sends\n");
+		}
+	}
+
+	if (sock_parms->zerocopy) {
+		zerocopy = tx_zerocopy_enable(sock_fd);
+		if (!zerocopy) {
+			log_msg(LOG_SEV_WARNING, "inet6 zerocopy not supported, "
+				"using copied sends\n");
+		}
+	}
+
+	pace_mode = sock_parms->pace_mode;
+	if (((sock_parms->pace_rate > 0) || sock_parms->pace_input) &&
+	    (pace_mode != TX_PACE_TIMER)) {
+		if (!tx_txtime_enable(sock_fd, conn_fds, sock_parms->dests_num,
+							pace_mode)) {
+			log_msg(LOG_SEV_WARNING, "inet6 SO_TXTIME not supported, "
+				"pacing with a timer\n");
+			pace_mode = TX_PACE_TIMER;
+		}
+	}
+
+	if (init_tx_dests(tx_dests, sock_parms->dests,
+			  sizeof(struct sockaddr_in6), sock_parms->dests_num,
+			  udp_gso, zerocopy, conn_fds) == -1) {
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	if (init_tx_backlogs(tx_dests, sock_fd, sock_parms->backlog) == -1) {
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	if (init_tx_rate(tx_dests, sock_parms->rate, sock_parms->dest_rate,
+			 sock_parms->rate_queue) == -1) {
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	init_tx_pace(tx_dests, sock_parms->pace_rate, sock_parms->pace_input,
+		pace_mode);
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return 0;
+
+}
+
+
+int tx_sendmmsg(const int sock_fd,
+		struct mmsghdr mmsgs[],
+		const unsigned int mmsgs_num,
+		const int flags,
+		struct tx_dests *tx_dests,
+		struct packet_counters *pkt_counters)
+{
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	ret = sendmmsg(sock_fd, mmsgs, mmsgs_num, flags);
+	log_debug_low("%s(): sendmmsg() == %d\n", __func__, ret);
+	log_debug_low("%s(): errno == %d\n", __func__, errno);
+
+	if (flags & MSG_ZEROCOPY) {
+		if (ret > 0) {
+			tx_dests->zc_issued += ret;
+			pkt_counters->tx_zc_sends += ret;
+		} else if ((ret == -1) && (errno == ENOBUFS)) {
+			/*
+			 * Out of memory for zerocopy completion notifications,
+			 * so copy instead.
+			 */
+			ret = sendmmsg(sock_fd, mmsgs, mmsgs_num,
+				flags & ~MSG_ZEROCOPY);
+			log_debug_low("%s(): sendmmsg() == %d\n", __func__,
+				ret);
+			log_debug_low("%s(): errno == %d\n", __func__, errno);
+			if (ret > 0) {
+				pkt_counters->tx_zc_fallbacks += ret;
+			}
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return ret;
+
+}
+
+
+/*
+ * dest_nums gives the destination number of each message, or is NULL if
+ * they are the shared socket's destinations in order.
+ */
+unsigned int tx_mmsgs_send(const int sock_fd,
+			   struct mmsghdr mmsgs[],
+			   const unsigned int dest_nums[],
+			   const unsigned int mmsgs_num,
+			   const int flags,
+			   struct tx_dests *tx_dests,
+			   struct packet_counters *pkt_counters)
+{
+	unsigned int tx_success = 0;
+	unsigned int mmsg_num = 0;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	/*
+	 * sendmmsg() stops at the first destination it fails to send to,
+	 * returning the number sent before it. Resending from that
+	 * destination then fails with its errno, after which it is skipped.
+	 */
+	while (mmsg_num < mmsgs_num) {
+		ret = tx_sendmmsg(sock_fd, &mmsgs[mmsg_num],
+			mmsgs_num - mmsg_num, flags, tx_dests, pkt_counters);
+		if (ret > 0) {
+			tx_mmsgs_sent(tx_dests, mmsgs, dest_nums, mmsg_num,
+				ret, 1);
+			tx_success += ret;
+			mmsg_num += ret;
+		} else if ((ret == -1) && (errno == EINTR)) {
+			continue;
+		} else {
+			if (ret == -1) {
+				tx_dest_failed(tx_dests, (dest_nums != NULL) ?
+					dest_nums[mmsg_num] : mmsg_num, errno);
+			}
+			mmsg_num++;
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return tx_success;
+
+}
+
+
+/*
+ * Counts the sent_num messages from mmsg_num on as sent, each of pkts
+ * datagrams, to their destinations, using the lengths sendmmsg() set.
+ */
+void tx_mmsgs_sent(struct tx_dests *tx_dests,
+		   const struct mmsghdr mmsgs[],
+		   const unsigned int dest_nums[],
+		   const unsigned int mmsg_num,
+		   const unsigned int sent_num,
+		   const unsigned int pkts)
+{
+	struct tx_dest_stats *dest_stats;
+	unsigned int i;
+
+
+	for (i = mmsg_num; i < (mmsg_num + sent_num); i++) {
+		dest_stats = &tx_dests->dest_stats[(dest_nums != NULL) ?
+							dest_nums[i] : i];
+		dest_stats->pkts += pkts;
+		dest_stats->bytes += mmsgs[i].msg_len;
+	}
+
+	if (tx_dests->pkt_rx_nsecs != NULL) {
+		tx_dests_latency(tx_dests, dest_nums, mmsg_num, sent_num,
+				 tx_dests->pkt_rx_nsecs, pkts);
+	}
+
+}
+
+
+void tx_dest_sent(struct tx_dests *tx_dests,
+		  const unsigned int dest_num,
+		  const unsigned int pkts,
+		  const unsigned long long bytes)
+{
+
+
+	tx_dests->dest_stats[dest_num].pkts += pkts;
+	tx_dests->dest_stats[dest_num].bytes += bytes;
+
+	if (tx_dests->pkt_rx_nsecs != NULL) {
+		tx_dests_latency(tx_dests, NULL, dest_num, 1,
+				 tx_dests->pkt_rx_nsecs, pkts);
+	}
+
+}
+
+
+void tx_dest_failed(struct tx_dests *tx_dests,
+		    const unsigned int dest_num,
+		    const int err)
+{
+	unsigned int i;
+
+
+	for (i = 0; i < TX_DEST_ERR_OTHER; i++) {
+		if (err == tx_dest_errnos[i]) {
+			break;
+		}
+	}
+
+	tx_dests->dest_stats[dest_num].errs[i]++;
+
+}
+
+
+unsigned long long mmsgs_len(const struct mmsghdr mmsgs[],
+			     const unsigned int mmsgs_num)
+{
+	unsigned long long len = 0;
+	unsigned int i;
+
+
+	for (i = 0; i < mmsgs_num; i++) {
+		len += mmsgs[i].msg_len;
+	}
+
+	return len;
+
+}
+
+
+void tx_zerocopy_reap(const int sock_fd,
+		      struct tx_dests *tx_dests,
+		      struct packet_counters *pkt_counters)
+{
+	union {
+		uint8_t buf[TX_ZEROCOPY_CMSG_BUF_SIZE];
+		struct cmsghdr align;
+	} cmsg_buf;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct sock_extended_err serr;
+	unsigned int completed;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	/*
+	 * The kernel references the sent packet buffers until it posts their
+	 * completion notifications to the socket's error queue. Each
+	 * notification covers a range of sends, and says whether the kernel
+	 * fell back to copying them. Reading the error queue never blocks,
+	 * so this only takes the notifications already posted.
+	 */
+	while (tx_dests->zc_completed < tx_dests->zc_issued) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = cmsg_buf.buf;
+		msg.msg_controllen = sizeof(cmsg_buf.buf);
+
+		ret = recvmsg(sock_fd, &msg, MSG_ERRQUEUE);
+		if (ret == -1) {
+			log_debug_low("%s(): recvmsg() == %d\n", __func__,
+				ret);
+			log_debug_low("%s(): errno == %d\n", __func__, errno);
+			break;
+		}
+
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+					cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (!(((cmsg->cmsg_level == SOL_IP) &&
+			       (cmsg->cmsg_type == IP_RECVERR)) ||
+			      ((cmsg->cmsg_level == SOL_IPV6) &&
+			       (cmsg->cmsg_type == IPV6_RECVERR)))) {
+				continue;
+			}
+			memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
+			if ((serr.ee_errno != 0) ||
+			    (serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY)) {
+				continue;
+			}
+			completed = serr.ee_data - serr.ee_info + 1;
+			tx_dests->zc_completed += completed;
+			if (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+				pkt_counters->tx_zc_fallbacks += completed;
+			} else {
+				pkt_counters->tx_zc_hits += completed;
+			}
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+/*
+ * Waits for the sends up to zc_mark to complete, but for no longer than
+ * TX_ZEROCOPY_WAIT_MSECS without a notification, so a destination whose
+ * datagrams are held, e.g. queued on a link without carrier, can't stop
+ * forwarding. The buffer is then reused anyway, and the timeout counted.
+ */
+void tx_zerocopy_wait(const int sock_fd,
+		      struct tx_dests *tx_dests,
+		      const unsigned long long zc_mark,
+		      struct packet_counters *pkt_counters)
+{
+	struct pollfd pfd;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	tx_zerocopy_reap(sock_fd, tx_dests, pkt_counters);
+
+	while (tx_dests->zc_completed < zc_mark) {
+		pfd.fd = sock_fd;
+		pfd.events = 0;
+		ret = poll(&pfd, 1, TX_ZEROCOPY_WAIT_MSECS);
+		if (ret == 0) {
+			pkt_counters->tx_zc_timeouts++;
+			break;
+		} else if ((ret == -1) && (errno != EINTR)) {
+			log_debug_low("%s(): poll() == %d\n", __func__, ret);
+			log_debug_low("%s(): errno == %d\n", __func__, errno);
+			break;
+		}
+		tx_zerocopy_reap(sock_fd, tx_dests, pkt_counters);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+unsigned int tx_dest_pkts_send(const int sock_fd,
+			       const struct msghdr *dest_msg,
+			       const struct iovec pkts[],
+			       const unsigned int pkts_num,
+			       struct tx_dests *tx_dests,
+			       const unsigned int dest_num)
+{
+	const unsigned long long *run_rx_nsecs = tx_dests->pkt_rx_nsecs;
+	unsigned int tx_success = 0;
+	unsigned int pkt_num;
+	ssize_t ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	for (pkt_num = 0; pkt_num < pkts_num; pkt_num++) {
+		if (run_rx_nsecs != NULL) {
+			tx_dests->pkt_rx_nsecs = &run_rx_nsecs[pkt_num];
+		}
+		ret = sendto(sock_fd, pkts[pkt_num].iov_base,
+			pkts[pkt_num].iov_len, 0, dest_msg->msg_name,
+			dest_msg->msg_namelen);
+		if (ret != -1) {
+			tx_dest_sent(tx_dests, dest_num, 1, ret);
+			tx_success++;
+		} else {
+			tx_dest_failed(tx_dests, dest_num, errno);
+		}
+		log_debug_low("%s(): sendto() == %d\n", __func__, ret);
+		log_debug_low("%s(): errno == %d\n", __func__, errno);
+	}
+
+	tx_dests->pkt_rx_nsecs = run_rx_nsecs;
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return tx_success;
+
+}
+
+
+
+/*
+ * Each connected destination is sent the whole batch of datagrams through
+ * its own socket, which holds the route to the destination, so the kernel
+ * doesn't look it up for every datagram.
+ */
+unsigned int tx_conn_dests_rcast(struct iovec pkts[],
+				 const unsigned int pkts_num,
+				 struct tx_dests *tx_dests)
+{
+	unsigned int tx_success = 0;
+	unsigned int dest_num;
+	unsigned int pkt_num;
+	unsigned int mmsgs_num;
+	unsigned int sent_num;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	for (dest_num = 0; dest_num < tx_dests->conn_dests_num; dest_num++) {
+		if (pkts_num == 1) {
+			if (tx_dests->rate_limited &&
+			    !tx_rate_conforms(tx_dests,
+					tx_dests->dests_num + dest_num,
+					pkts[0].iov_len, 1)) {
+				continue;
+			}
+			do {
+				ret = send(tx_dests->conn_fds[dest_num],
+					pkts[0].iov_base, pkts[0].iov_len, 0);
+				log_debug_low("%s(): send() == %d\n", __func__,
+									ret);
+			} while ((ret == -1) && (errno == EINTR));
+			if (ret != -1) {
+				tx_dest_sent(tx_dests,
+					tx_dests->dests_num + dest_num, 1, ret);
+				if ((tx_dests->rx_nsecs != NULL) &&
+				    (tx_dests->rx_nsecs[0] != 0)) {
+					tx_dests_latency(tx_dests, NULL,
+						tx_dests->dests_num + dest_num,
+						1, tx_dests->rx_nsecs, 1);
+				}
+				tx_success++;
+			} else {
+				tx_dest_failed(tx_dests,
+					tx_dests->dests_num + dest_num, errno);
+			}
+			continue;
+		}
+
+		pkt_num = 0;
+		while (pkt_num < pkts_num) {
+			mmsgs_num = 0;
+			while ((mmsgs_num < TX_CONN_BATCH) &&
+			       (pkt_num < pkts_num)) {
+				if (tx_dests->rate_limited &&
+				    !tx_rate_conforms(tx_dests,
+						tx_dests->dests_num + dest_num,
+						pkts[pkt_num].iov_len, 1)) {
+					pkt_num++;
+					continue;
+				}
+				tx_dests->conn_mmsgs[mmsgs_num].msg_hdr.msg_iov =
+							&pkts[pkt_num++];
+				tx_dests->conn_mmsgs[mmsgs_num++].msg_hdr.msg_iovlen
+									= 1;
+			}
+
+			sent_num = 0;
+			while (sent_num < mmsgs_num) {
+				ret = sendmmsg(tx_dests->conn_fds[dest_num],
+					&tx_dests->conn_mmsgs[sent_num],
+					mmsgs_num - sent_num, 0);
+				log_debug_low("%s(): sendmmsg() == %d\n",
+								__func__, ret);
+				if (ret > 0) {
+					tx_dest_sent(tx_dests,
+						tx_dests->dests_num + dest_num,
+						ret, mmsgs_len(
+						&tx_dests->conn_mmsgs[sent_num],
+						ret));
+					if (tx_dests->rx_nsecs != NULL) {
+						tx_conn_dest_latency(tx_dests,
+						tx_dests->dests_num + dest_num,
+						pkts,
+						&tx_dests->conn_mmsgs[sent_num],
+						ret);
+					}
+					tx_success += ret;
+					sent_num += ret;
+				} else if ((ret == -1) && (errno == EINTR)) {
+					continue;
+				} else {
+					if (ret == -1) {
+						tx_dest_failed(tx_dests,
+							tx_dests->dests_num +
+							dest_num, errno);
+					}
+					sent_num++;
+				}
+			}
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return tx_success;
+
+}
+
+
+
+/*
+ * With a backlog, the shared socket is registered with the epoll instance
+ * as index 0, and each connected destination's socket as its index plus
+ * one, with no events until its destinations are blocked.
+ */
+int init_tx_backlogs(struct tx_dests *tx_dests,
+		     const int sock_fd,
+		     const unsigned int backlog_size)
+{
+	struct tx_backlog *backlog;
+	struct epoll_event event;
+	unsigned int backlogs_num;
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (backlog_size == 0) {
+		log_debug_med("%s() exit\n", __func__);
+		return 0;
+	}
+
+	backlogs_num = tx_dests->dests_num + tx_dests->conn_dests_num;
+
+	tx_dests->backlogs = calloc(backlogs_num, sizeof(struct tx_backlog));
+	if (tx_dests->backlogs == NULL) {
+		log_debug_low("%s(): calloc() failed\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	tx_dests->epoll_fd = epoll_create1(0);
+	if (tx_dests->epoll_fd == -1) {
+		log_debug_low("%s(): epoll_create1() failed\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	for (i = 0; i < backlogs_num; i++) {
+		backlog = &tx_dests->backlogs[i];
+
+		backlog->pkts = calloc(backlog_size, sizeof(struct iovec));
+		if (backlog->pkts == NULL) {
+			log_debug_low("%s(): calloc() failed\n", __func__);
+			log_debug_med("%s() exit\n", __func__);
+			errno = ENOMEM;
+			return -1;
+		}
+
+		if (i < tx_dests->dests_num) {
+			backlog->sock_fd = sock_fd;
+			backlog->dest = tx_dests->mmsgs[i].msg_hdr.msg_name;
+			backlog->msg.msg_name = tx_dests->mmsgs[i].msg_hdr.msg_name;
+			backlog->msg.msg_namelen =
+					tx_dests->mmsgs[i].msg_hdr.msg_namelen;
+		} else {
+			backlog->sock_fd =
+				tx_dests->conn_fds[i - tx_dests->dests_num];
+			backlog->dest =
+				tx_dests->conn_dests[i - tx_dests->dests_num];
+		}
+		backlog->msg.msg_iovlen = 1;
+	}
+
+	memset(&event, 0, sizeof(event));
+	event.data.u32 = 0;
+	if (epoll_ctl(tx_dests->epoll_fd, EPOLL_CTL_ADD, sock_fd,
+							&event) == -1) {
+		log_debug_low("%s(): epoll_ctl() failed\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	for (i = 0; i < tx_dests->conn_dests_num; i++) {
+		event.data.u32 = i + 1;
+		if (epoll_ctl(tx_dests->epoll_fd, EPOLL_CTL_ADD,
+			      tx_dests->conn_fds[i], &event) == -1) {
+			log_debug_low("%s(): epoll_ctl() failed\n", __func__);
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+	}
+
+	tx_dests->backlog_size = backlog_size;
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return 0;
+
+}
+
+
+void tx_backlog_arm(const struct tx_dests *tx_dests,
+		    const int sock_fd,
+		    const uint32_t sock_idx,
+		    const uint32_t events)
+{
+	struct epoll_event event;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	memset(&event, 0, sizeof(event));
+	event.events = events;
+	event.data.u32 = sock_idx;
+	if (epoll_ctl(tx_dests->epoll_fd, EPOLL_CTL_MOD, sock_fd,
+							&event) == -1) {
+		log_debug_low("%s(): epoll_ctl() failed\n", __func__);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+/*
+ * Queues a copy of the datagram on the destination's backlog, or drops it
+ * if the backlog is full. The destination is blocked from the first
+ * datagram queued until its backlog is empty again.
+ */
+void tx_backlog_park(struct tx_dests *tx_dests,
+		     struct tx_backlog *backlog,
+		     const struct iovec *pkt,
+		     struct packet_counters *pkt_counters)
+{
+	struct iovec *tail;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (backlog->depth == tx_dests->backlog_size) {
+		backlog->drops++;
+		pkt_counters->tx_backlog_drops++;
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
+
+	tail = &backlog->pkts[(backlog->head + backlog->depth) %
+						tx_dests->backlog_size];
+	tail->iov_base = malloc(pkt->iov_len);
+	if (tail->iov_base == NULL) {
+		backlog->drops++;
+		pkt_counters->tx_backlog_drops++;
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
+	memcpy(tail->iov_base, pkt->iov_base, pkt->iov_len);
+	tail->iov_len = pkt->iov_len;
+
+	if (backlog->depth == 0) {
+		clock_gettime(CLOCK_MONOTONIC, &backlog->blocked_start);
+		tx_dests->backlogs_pending++;
+	}
+
+	backlog->depth++;
+	if (backlog->depth > backlog->hwm) {
+		backlog->hwm = backlog->depth;
+	}
+	backlog->queued++;
+	pkt_counters->tx_backlog_queued++;
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+/*
+ * Sends up to pkts_max datagrams from the head of the backlog, setting
+ * blocked if its socket became unwritable again. A datagram that fails for
+ * any other reason is dropped, as it is without a backlog.
+ */
+unsigned int tx_backlog_send(struct tx_dests *tx_dests,
+			     struct tx_backlog *backlog,
+			     const unsigned int pkts_max,
+			     unsigned int *blocked,
+			     struct packet_counters *pkt_counters)
+{
+	struct timespec now;
+	unsigned int tx_success = 0;
+	unsigned int pkts_num = 0;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	*blocked = 0;
+
+	while ((backlog->depth > 0) && (pkts_num < pkts_max)) {
+		backlog->msg.msg_iov = &backlog->pkts[backlog->head];
+		if (tx_dests->rate_limited &&
+		    !tx_rate_conforms(tx_dests, backlog - tx_dests->backlogs,
+					backlog->msg.msg_iov->iov_len, 0)) {
+			break;
+		}
+		ret = sendmsg(backlog->sock_fd, &backlog->msg, MSG_DONTWAIT);
+		log_debug_low("%s(): sendmsg() == %d\n", __func__, ret);
+		if (ret == -1) {
+			if (errno == EINTR) {
+				continue;
+			} else if ((errno == EAGAIN) ||
+				   (errno == EWOULDBLOCK)) {
+				*blocked = 1;
+				break;
+			}
+			tx_dest_failed(tx_dests, backlog - tx_dests->backlogs,
+									errno);
+			backlog->drops++;
+			pkt_counters->tx_backlog_drops++;
+		} else {
+			tx_dest_sent(tx_dests, backlog - tx_dests->backlogs, 1,
+									ret);
+			tx_success++;
+		}
+
+		free(backlog->msg.msg_iov->iov_base);
+		backlog->head = (backlog->head + 1) % tx_dests->backlog_size;
+		backlog->depth--;
+		pkts_num++;
+	}
+
+	if ((backlog->depth == 0) && (pkts_num > 0)) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		backlog->blocked_usecs +=
+			((now.tv_sec - backlog->blocked_start.tv_sec) *
+								1000000) +
+			((now.tv_nsec - backlog->blocked_start.tv_nsec) / 1000);
+		tx_dests->backlogs_pending--;
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return tx_success;
+
+}
+
+
+/*
+ * Non-blocking version of tx_dests_rcast(). A destination whose send
+ * would block has the datagram parked on its backlog, as do any later
+ * datagrams until the backlog has been drained, keeping them in order,
+ * while the other destinations carry on being sent to. The shared
+ * socket's send buffer is common to all of its destinations, so they are
+ * all blocked when it is full.
+ */
+unsigned int tx_backlog_rcast(const int sock_fd,
+			      struct iovec pkts[],
+			      const unsigned int pkts_num,
+			      struct tx_dests *tx_dests,
+			      struct packet_counters *pkt_counters)
+{
+	struct tx_backlog *backlog;
+	unsigned int tx_success = 0;
+	unsigned int pkt_num;
+	unsigned int dest_num;
+	unsigned int mmsgs_num;
+	unsigned int sent_num;
+	unsigned int held;
+	unsigned int i;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (tx_dests->rate_limited) {
+		tx_rate_clock(tx_dests);
+	}
+
+	if (tx_dests->backlogs_pending > 0) {
+		tx_success += tx_backlogs_drain(tx_dests, pkt_counters);
+	}
+
+	for (pkt_num = 0; pkt_num < pkts_num; pkt_num++) {
+		tx_dests->pkt_iov = pkts[pkt_num];
+		mmsgs_num = 0;
+		for (dest_num = 0; dest_num < tx_dests->dests_num; dest_num++) {
+			backlog = &tx_dests->backlogs[dest_num];
+			if (tx_dests->sock_blocked || (backlog->depth > 0)) {
+				tx_backlog_park(tx_dests, backlog,
+					&pkts[pkt_num], pkt_counters);
+				continue;
+			}
+			if (tx_dests->rate_limited &&
+			    !tx_rate_conforms(tx_dests, dest_num,
+					pkts[pkt_num].iov_len, 1)) {
+				if (tx_dests->rate_queue) {
+					tx_backlog_park(tx_dests, backlog,
+						&pkts[pkt_num], pkt_counters);
+				}
+				continue;
+			}
+			tx_dests->send_mmsgs[mmsgs_num] =
+						tx_dests->mmsgs[dest_num];
+			tx_dests->send_dests[mmsgs_num++] = dest_num;
+		}
+
+		sent_num = 0;
+		while (sent_num < mmsgs_num) {
+			ret = sendmmsg(sock_fd, &tx_dests->send_mmsgs[sent_num],
+				mmsgs_num - sent_num, MSG_DONTWAIT);
+			log_debug_low("%s(): sendmmsg() == %d\n", __func__,
+									ret);
+			if (ret > 0) {
+				tx_mmsgs_sent(tx_dests, tx_dests->send_mmsgs,
+					tx_dests->send_dests, sent_num, ret, 1);
+				tx_success += ret;
+				sent_num += ret;
+			} else if ((ret == -1) && (errno == EINTR)) {
+				continue;
+			} else if ((ret == -1) && ((errno == EAGAIN) ||
+						   (errno == EWOULDBLOCK))) {
+				tx_dests->sock_blocked = 1;
+				tx_backlog_arm(tx_dests, sock_fd, 0, EPOLLOUT);
+				break;
+			} else {
+				if (ret == -1) {
+					tx_dest_failed(tx_dests,
+						tx_dests->send_dests[sent_num],
+						errno);
+				}
+				sent_num++;
+			}
+		}
+		for ( ; sent_num < mmsgs_num; sent_num++) {
+			tx_backlog_park(tx_dests, &tx_dests->backlogs[
+					tx_dests->send_dests[sent_num]],
+				&pkts[pkt_num], pkt_counters);
+		}
+	}
+
+	/*
+	 * A connected destination is sent runs of conforming datagrams until
+	 * its socket would block or, with the queue policy, a datagram is
+	 * over the rate, after which the rest of the batch is queued behind
+	 * it.
+	 */
+	for (i = 0; i < tx_dests->conn_dests_num; i++) {
+		dest_num = tx_dests->dests_num + i;
+		backlog = &tx_dests->backlogs[dest_num];
+		pkt_num = 0;
+		while ((backlog->depth == 0) && (pkt_num < pkts_num)) {
+			mmsgs_num = 0;
+			held = 0;
+			while ((mmsgs_num < TX_CONN_BATCH) &&
+			       (pkt_num < pkts_num)) {
+				if (tx_dests->rate_limited &&
+				    !tx_rate_conforms(tx_dests, dest_num,
+						pkts[pkt_num].iov_len, 1)) {
+					if (tx_dests->rate_queue) {
+						held = 1;
+						break;
+					}
+					pkt_num++;
+					continue;
+				}
+				tx_dests->conn_mmsgs[mmsgs_num].msg_hdr.msg_iov =
+							&pkts[pkt_num++];
+				tx_dests->conn_mmsgs[mmsgs_num++].msg_hdr.msg_iovlen
+									= 1;
+			}
+
+			sent_num = 0;
+			while (sent_num < mmsgs_num) {
+				ret = sendmmsg(backlog->sock_fd,
+					&tx_dests->conn_mmsgs[sent_num],
+					mmsgs_num - sent_num, MSG_DONTWAIT);
+				log_debug_low("%s(): sendmmsg() == %d\n",
+								__func__, ret);
+				if (ret > 0) {
+					tx_dest_sent(tx_dests, dest_num, ret,
+						mmsgs_len(&tx_dests->conn_mmsgs[
+							sent_num], ret));
+					tx_success += ret;
+					sent_num += ret;
+				} else if ((ret == -1) && (errno == EINTR)) {
+					continue;
+				} else if ((ret == -1) &&
+					   ((errno == EAGAIN) ||
+					    (errno == EWOULDBLOCK))) {
+					tx_backlog_arm(tx_dests,
+						backlog->sock_fd, i + 1,
+						EPOLLOUT);
+					break;
+				} else {
+					if (ret == -1) {
+						tx_dest_failed(tx_dests,
+							dest_num, errno);
+					}
+					sent_num++;
+				}
+			}
+			for ( ; sent_num < mmsgs_num; sent_num++) {
+				tx_backlog_park(tx_dests, backlog,
+				tx_dests->conn_mmsgs[sent_num].msg_hdr.msg_iov,
+					pkt_counters);
+			}
+
+			if (held) {
+				tx_backlog_park(tx_dests, backlog,
+					&pkts[pkt_num++], pkt_counters);
+			}
+		}
+		for ( ; pkt_num < pkts_num; pkt_num++) {
+			tx_backlog_park(tx_dests, backlog, &pkts[pkt_num],
+								pkt_counters);
+		}
+	}
+
+	if (tx_dests->rate_queue && (tx_dests->backlogs_pending > 0)) {
+		tx_rate_timer_arm(tx_dests);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return tx_success;
+
+}
+
+
+/*
+ * Sends the backlogs of the sockets epoll reports as writable, without
+ * waiting. The shared socket's destinations take turns a datagram at a
+ * time, so that none of them is starved when it fills again.
+ */
+unsigned int tx_backlogs_drain(struct tx_dests *tx_dests,
+			       struct packet_counters *pkt_counters)
+{
+	struct epoll_event events[TX_BACKLOG_EVENTS];
+	struct tx_backlog *backlog;
+	unsigned int tx_success = 0;
+	unsigned int blocked = 0;
+	unsigned int sock_idx;
+	unsigned int dest_num;
+	unsigned int depth;
+	unsigned int progress;
+	unsigned long long expirations;
+	int events_num;
+	int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	events_num = epoll_wait(tx_dests->epoll_fd, events, TX_BACKLOG_EVENTS,
+									0);
+	log_debug_low("%s(): epoll_wait() == %d\n", __func__, events_num);
+
+	if (tx_dests->rate_limited) {
+		tx_rate_clock(tx_dests);
+	}
+
+	for (i = 0; i < events_num; i++) {
+		sock_idx = events[i].data.u32;
+
+		/*
+		 * The rate timer retries every backlog, as there may be
+		 * tokens for any of them.
+		 */
+		if (sock_idx == (tx_dests->conn_dests_num + 1)) {
+			if (read(tx_dests->rate_timer_fd, &expirations,
+					sizeof(expirations)) == -1) {
+				log_debug_low("%s(): read() failed\n",
+								__func__);
+			}
+			tx_dests->rate_timer_armed = 0;
+			for (dest_num = tx_dests->dests_num;
+			     dest_num < (tx_dests->dests_num +
+					tx_dests->conn_dests_num); dest_num++) {
+				tx_success += tx_backlog_send(tx_dests,
+					&tx_dests->backlogs[dest_num],
+					tx_dests->backlog_size, &blocked,
+					pkt_counters);
+			}
+			sock_idx = 0;
+		} else if (sock_idx > 0) {
+			backlog = &tx_dests->backlogs[tx_dests->dests_num +
+							sock_idx - 1];
+			tx_success += tx_backlog_send(tx_dests, backlog,
+				backlog->depth, &blocked, pkt_counters);
+			if (!blocked) {
+				tx_backlog_arm(tx_dests, backlog->sock_fd,
+					sock_idx, 0);
+			}
+			continue;
+		}
+
+		do {
+			progress = 0;
+			for (dest_num = 0; (dest_num < tx_dests->dests_num) &&
+						!blocked; dest_num++) {
+				backlog = &tx_dests->backlogs[dest_num];
+				depth = backlog->depth;
+				tx_success += tx_backlog_send(tx_dests,
+					backlog, 1, &blocked, pkt_counters);
+				if (backlog->depth < depth) {
+					progress = 1;
+				}
+			}
+		} while (progress && !blocked);
+
+		if (!blocked && tx_dests->sock_blocked) {
+			tx_dests->sock_blocked = 0;
+			tx_backlog_arm(tx_dests, tx_dests->backlogs[0].sock_fd,
+				0, 0);
+		}
+		blocked = 0;
+	}
+
+	if (tx_dests->rate_queue && (tx_dests->backlogs_pending > 0)) {
+		tx_rate_timer_arm(tx_dests);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return tx_success;
+
+}
+
+
+/*
+ * Called before receiving, so that while any destination is blocked the
+ * forwarding loop also waits for its socket to become writable, rather
+ * than only draining its backlog when the next datagrams arrive.
+ */
+void tx_backlogs_wait(const int sock_fd,
+		      const struct rx_batch *rx_batch,
+		      struct tx_dests *inet_tx_dests,
+		      struct tx_dests *inet6_tx_dests,
+		      struct packet_counters *pkt_counters)
+{
+	struct pollfd fds[4];
+	unsigned int rx_fds_num;
+	unsigned int fds_num;
+	unsigned int i;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	fds[0].fd = sock_fd;
+	fds[0].events = POLLIN;
+	rx_fds_num = 1;
+	if (rx_batch->xsk != NULL) {
+		fds[rx_fds_num].fd = rx_batch->xsk->sock_fd;
+		fds[rx_fds_num++].events = POLLIN;
+	} else if (rx_batch->pkt_ring != NULL) {
+		fds[rx_fds_num].fd = rx_batch->pkt_ring->sock_fd;
+		fds[rx_fds_num++].events = POLLIN;
+	}
+
+	for ( ;; ) {
+		fds_num = rx_fds_num;
+		if ((inet_tx_dests != NULL) &&
+		    (inet_tx_dests->backlogs_pending > 0)) {
+			fds[fds_num].fd = inet_tx_dests->epoll_fd;
+			fds[fds_num++].events = POLLIN;
+		}
+		if ((inet6_tx_dests != NULL) &&
+		    (inet6_tx_dests->backlogs_pending > 0)) {
+			fds[fds_num].fd = inet6_tx_dests->epoll_fd;
+			fds[fds_num++].events = POLLIN;
+		}
+		if (fds_num == rx_fds_num) {
+			break;
+		}
+
+		ret = poll(fds, fds_num, -1);
+		log_debug_low("%s(): poll() == %d\n", __func__, ret);
+		if (ret <= 0) {
+			continue;
+		}
+
+		for (i = rx_fds_num; i < fds_num; i++) {
+			if (!(fds[i].revents & POLLIN)) {
+				continue;
+			}
+			if ((inet_tx_dests != NULL) &&
+			    (fds[i].fd == inet_tx_dests->epoll_fd)) {
+				pkt_counters->inet_out_pkts +=
+					tx_backlogs_drain(inet_tx_dests,
+								pkt_counters);
+			} else {
+				pkt_counters->inet6_out_pkts +=
+					tx_backlogs_drain(inet6_tx_dests,
+								pkt_counters);
+			}
+		}
+
+		for (i = 0; i < rx_fds_num; i++) {
+			if (fds[i].revents & POLLIN) {
+				break;
+			}
+		}
+		if (i < rx_fds_num) {
+			break;
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+
+void init_tx_rate_bucket(struct tx_rate_bucket *bucket,
+			 const unsigned int rate_kbps)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	bucket->rate = (rate_kbps * 1000ULL) / 8;
+	bucket->burst = (bucket->rate * TX_RATE_BURST_MSECS) / 1000;
+	if (bucket->burst < TX_RATE_BURST_MIN) {
+		bucket->burst = TX_RATE_BURST_MIN;
+	}
+	bucket->tokens = bucket->burst;
+	bucket->last_nsecs = 0;
+	bucket->conform_pkts = 0;
+	bucket->conform_bytes = 0;
+	bucket->exceed_pkts = 0;
+	bucket->exceed_bytes = 0;
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+/*
+ * The shaper is a hierarchy of token buckets, a datagram to a unicast
+ * destination passing through the destination's bucket, then the output
+ * interface's, then the global one shared by both families. Destination
+ * buckets are in the same order as the backlogs.
+ */
+int init_tx_rate(struct tx_dests *tx_dests,
+		 const unsigned int intf_rate,
+		 const unsigned int dest_rate,
+		 const unsigned int rate_queue)
+{
+	struct epoll_event event;
+	const struct sockaddr *dest;
+	unsigned int dests_num;
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (tx_rate_global.rate > 0) {
+		tx_dests->rate_global = &tx_rate_global;
+	}
+
+	init_tx_rate_bucket(&tx_dests->rate_intf, intf_rate);
+
+	dests_num = tx_dests->dests_num + tx_dests->conn_dests_num;
+
+	if (dest_rate > 0) {
+		tx_dests->rate_dests = calloc(dests_num,
+					sizeof(struct tx_rate_bucket));
+		if (tx_dests->rate_dests == NULL) {
+			log_debug_low("%s(): calloc() failed\n", __func__);
+			log_debug_med("%s() exit\n", __func__);
+			errno = ENOMEM;
+			return -1;
+		}
+
+		for (i = 0; i < dests_num; i++) {
+			if (i < tx_dests->dests_num) {
+				dest = tx_dests->mmsgs[i].msg_hdr.msg_name;
+			} else {
+				dest = tx_dests->conn_dests[i -
+							tx_dests->dests_num];
+			}
+			if (((dest->sa_family == AF_INET) &&
+			     IN_MULTICAST(ntohl(((const struct sockaddr_in *)
+					dest)->sin_addr.s_addr))) ||
+			    ((dest->sa_family == AF_INET6) &&
+			     IN6_IS_ADDR_MULTICAST(&((const struct sockaddr_in6 *)
+					dest)->sin6_addr))) {
+				init_tx_rate_bucket(&tx_dests->rate_dests[i], 0);
+			} else {
+				init_tx_rate_bucket(&tx_dests->rate_dests[i],
+								dest_rate);
+			}
+		}
+	}
+
+	tx_dests->rate_limited = (tx_dests->rate_global != NULL) ||
+		(tx_dests->rate_intf.rate > 0) || (tx_dests->rate_dests != NULL);
+
+	if (tx_dests->rate_limited && rate_queue) {
+		tx_dests->rate_queue = 1;
+
+		tx_dests->rate_timer_fd = timerfd_create(CLOCK_MONOTONIC,
+							TFD_NONBLOCK);
+		if (tx_dests->rate_timer_fd == -1) {
+			log_debug_low("%s(): timerfd_create() failed\n",
+								__func__);
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.u32 = tx_dests->conn_dests_num + 1;
+		if (epoll_ctl(tx_dests->epoll_fd, EPOLL_CTL_ADD,
+			      tx_dests->rate_timer_fd, &event) == -1) {
+			log_debug_low("%s(): epoll_ctl() failed\n", __func__);
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return 0;
+
+}
+
+
+/*
+ * A bucket's tokens may go negative, so that a datagram larger than the
+ * burst still conforms once the bucket has refilled to above zero.
+ */
+void tx_rate_bucket_refill(struct tx_rate_bucket *bucket,
+			   const unsigned long long now_nsecs)
+{
+	unsigned long long elapsed_nsecs;
+
+
+	if (now_nsecs <= bucket->last_nsecs) {
+		return;
+	}
+
+	elapsed_nsecs = now_nsecs - bucket->last_nsecs;
+	bucket->last_nsecs = now_nsecs;
+	if (elapsed_nsecs > 1000000000ULL) {
+		elapsed_nsecs = 1000000000ULL;
+	}
+
+	bucket->tokens += ((double)elapsed_nsecs * bucket->rate) / 1e9;
+	if (bucket->tokens > bucket->burst) {
+		bucket->tokens = bucket->burst;
+	}
+
+}
+
+
+void tx_rate_clock(struct tx_dests *tx_dests)
+{
+	struct timespec now;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	tx_dests->rate_nsecs = (now.tv_sec * 1000000000ULL) + now.tv_nsec;
+
+}
+
+
+/*
+ * Returns whether a datagram of pkt_len to the destination conforms to
+ * every bucket on its path, taking its bytes from them if it does. A
+ * conforming datagram is counted at each bucket. A non-conforming one is
+ * counted only at the buckets that were out of tokens, and only when it
+ * first arrives, not each time a queued datagram is retried.
+ */
+unsigned int tx_rate_conforms(struct tx_dests *tx_dests,
+			      const unsigned int dest_idx,
+			      const size_t pkt_len,
+			      const unsigned int count_exceed)
+{
+	struct tx_rate_bucket *buckets[3];
+	unsigned int buckets_num = 0;
+	unsigned int conforms = 1;
+	unsigned int i;
+
+
+	if ((tx_dests->rate_dests != NULL) &&
+	    (tx_dests->rate_dests[dest_idx].rate > 0)) {
+		buckets[buckets_num++] = &tx_dests->rate_dests[dest_idx];
+	}
+	if (tx_dests->rate_intf.rate > 0) {
+		buckets[buckets_num++] = &tx_dests->rate_intf;
+	}
+	if (tx_dests->rate_global != NULL) {
+		buckets[buckets_num++] = tx_dests->rate_global;
+	}
+
+	for (i = 0; i < buckets_num; i++) {
+		tx_rate_bucket_refill(buckets[i], tx_dests->rate_nsecs);
+		if (buckets[i]->tokens <= 0) {
+			conforms = 0;
+			if (count_exceed) {
+				buckets[i]->exceed_pkts++;
+				buckets[i]->exceed_bytes += pkt_len;
+			}
+		}
+	}
+
+	if (conforms) {
+		for (i = 0; i < buckets_num; i++) {
+			buckets[i]->tokens -= pkt_len;
+			buckets[i]->conform_pkts++;
+			buckets[i]->conform_bytes += pkt_len;
+		}
+	}
+
+	return conforms;
+
+}
+
+
+/*
+ * Fills send_mmsgs with the destinations on the shared socket the datagram
+ * conforms for, returning how many there are.
+ */
+unsigned int tx_rate_dests(struct tx_dests *tx_dests,
+			   const struct iovec *pkt)
+{
+	unsigned int mmsgs_num = 0;
+	unsigned int dest_num;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	for (dest_num = 0; dest_num < tx_dests->dests_num; dest_num++) {
+		if (tx_rate_conforms(tx_dests, dest_num, pkt->iov_len, 1)) {
+			tx_dests->send_mmsgs[mmsgs_num] =
+						tx_dests->mmsgs[dest_num];
+			tx_dests->send_dests[mmsgs_num++] = dest_num;
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return mmsgs_num;
+
+}
+
+
+void tx_rate_timer_arm(struct tx_dests *tx_dests)
+{
+	struct itimerspec timer;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (!tx_dests->rate_timer_armed) {
+		memset(&timer, 0, sizeof(timer));
+		timer.it_value.tv_nsec = TX_RATE_TIMER_USECS * 1000;
+		if (timerfd_settime(tx_dests->rate_timer_fd, 0, &timer,
+							NULL) == -1) {
+			log_debug_low("%s(): timerfd_settime() failed\n",
+								__func__);
+		} else {
+			tx_dests->rate_timer_armed = 1;
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+
+/*
+ * The departure time of each datagram is kept in the one control message
+ * shared by all the destinations, as every destination is sent the
+ * datagram at the same time.
+ */
+void init_tx_pace(struct tx_dests *tx_dests,
+		  const unsigned int pace_rate,
+		  const unsigned int pace_input,
+		  const enum TX_PACE_MODE pace_mode)
+{
+	struct cmsghdr *cmsg;
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	tx_dests->paced = (pace_rate > 0) || pace_input;
+	tx_dests->pace_rate = pace_rate;
+	tx_dests->pace_input = pace_input;
+	tx_dests->pace_mode = pace_mode;
+	tx_dests->pace_clock = (pace_mode == TX_PACE_ETF) ? CLOCK_TAI :
+							CLOCK_MONOTONIC;
+	tx_dests->pace_next_nsecs = 0;
+	tx_dests->pace_rx_nsecs = NULL;
+	tx_dests->pace_last_arrival_nsecs = 0;
+	tx_dests->pace_gap_nsecs = 0;
+
+	if (!tx_dests->paced || (pace_mode == TX_PACE_TIMER)) {
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
+
+	memset(&tx_dests->pace_cmsg, 0, sizeof(tx_dests->pace_cmsg));
+	cmsg = (struct cmsghdr *)tx_dests->pace_cmsg.buf;
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_TXTIME;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+
+	for (i = 0; i < tx_dests->dests_num; i++) {
+		tx_dests->mmsgs[i].msg_hdr.msg_control = tx_dests->pace_cmsg.buf;
+		tx_dests->mmsgs[i].msg_hdr.msg_controllen =
+						sizeof(tx_dests->pace_cmsg.buf);
+	}
+
+	tx_dests->conn_mmsgs[0].msg_hdr.msg_control = tx_dests->pace_cmsg.buf;
+	tx_dests->conn_mmsgs[0].msg_hdr.msg_controllen =
+						sizeof(tx_dests->pace_cmsg.buf);
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+/*
+ * Datagrams depart a fixed rate's serialisation time apart, or the
+ * average time apart that they arrived, smoothing out the input's
+ * bursts. A datagram that would depart more than TX_PACE_HORIZON_MSECS
+ * from now is dropped rather than queued any further.
+ *
+ * The arrival times are the kernel's receive timestamps, rx_nsecs, as
+ * the time a datagram is got to here depends on the pacing itself and
+ * on how it was batched. A datagram without one leaves the average as
+ * it is.
+ */
+unsigned int tx_pace_departure(struct tx_dests *tx_dests,
+			       const struct iovec *pkt,
+			       const unsigned long long rx_nsecs,
+			       unsigned long long *departure_nsecs)
+{
+	struct timespec now;
+	unsigned long long now_nsecs;
+	long long arrival_gap_nsecs;
+
+
+	clock_gettime(tx_dests->pace_clock, &now);
+	now_nsecs = (now.tv_sec * 1000000000ULL) + now.tv_nsec;
+
+	if (tx_dests->pace_next_nsecs < now_nsecs) {
+		tx_dests->pace_next_nsecs = now_nsecs;
+	}
+
+	if (tx_dests->pace_input && (rx_nsecs != 0)) {
+		if ((tx_dests->pace_last_arrival_nsecs > 0) &&
+		    (rx_nsecs > tx_dests->pace_last_arrival_nsecs)) {
+			arrival_gap_nsecs = rx_nsecs -
+					tx_dests->pace_last_arrival_nsecs;
+			tx_dests->pace_gap_nsecs += (arrival_gap_nsecs -
+				tx_dests->pace_gap_nsecs) / TX_PACE_EWMA_WEIGHT;
+		}
+		tx_dests->pace_last_arrival_nsecs = rx_nsecs;
+	}
+
+	if ((tx_dests->pace_next_nsecs - now_nsecs) >
+				(TX_PACE_HORIZON_MSECS * 1000000ULL)) {
+		return 0;
+	}
+
+	*departure_nsecs = tx_dests->pace_next_nsecs;
+
+	if (tx_dests->pace_input) {
+		tx_dests->pace_next_nsecs += tx_dests->pace_gap_nsecs;
+	} else {
+		tx_dests->pace_next_nsecs += (pkt->iov_len * 8000000ULL) /
+							tx_dests->pace_rate;
+	}
+
+	return 1;
+
+}
+
+
+/*
+ * Sends each datagram to every destination, either stamped with its
+ * departure time for the qdisc to hold it until then, or after sleeping
+ * until then, which holds up the receive socket too.
+ */
+unsigned int tx_pace_rcast(const int sock_fd,
+			   struct iovec pkts[],
+			   const unsigned int pkts_num,
+			   struct tx_dests *tx_dests,
+			   struct packet_counters *pkt_counters)
+{
+	struct msghdr *conn_msg = &tx_dests->conn_mmsgs[0].msg_hdr;
+	unsigned long long departure_nsecs;
+	unsigned long long rx_nsecs = 0;
+	struct timespec departure;
+	unsigned int tx_success = 0;
+	unsigned int pkt_num;
+	unsigned int dest_num;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	for (pkt_num = 0; pkt_num < pkts_num; pkt_num++) {
+		if (tx_dests->pace_rx_nsecs != NULL) {
+			rx_nsecs = tx_dests->pace_rx_nsecs[pkt_num];
+		}
+
+		if (!tx_pace_departure(tx_dests, &pkts[pkt_num], rx_nsecs,
+						&departure_nsecs)) {
+			pkt_counters->tx_pace_drops++;
+			continue;
+		}
+
+		if (tx_dests->pace_mode == TX_PACE_TIMER) {
+			departure.tv_sec = departure_nsecs / 1000000000ULL;
+			departure.tv_nsec = departure_nsecs % 1000000000ULL;
+			while (clock_nanosleep(tx_dests->pace_clock,
+					TIMER_ABSTIME, &departure, NULL) ==
+									EINTR)
+				;
+		} else {
+			memcpy(CMSG_DATA((struct cmsghdr *)
+						tx_dests->pace_cmsg.buf),
+				&departure_nsecs, sizeof(uint64_t));
+		}
+
+		pkt_counters->tx_paced++;
+
+		if (tx_dests->dests_num > 0) {
+			tx_dests->pkt_iov = pkts[pkt_num];
+			tx_success += tx_mmsgs_send(sock_fd, tx_dests->mmsgs,
+				NULL, tx_dests->dests_num, 0, tx_dests,
+				pkt_counters);
+		}
+
+		conn_msg->msg_iov = &pkts[pkt_num];
+		conn_msg->msg_iovlen = 1;
+		for (dest_num = 0; dest_num < tx_dests->conn_dests_num;
+								dest_num++) {
+			do {
+				ret = sendmsg(tx_dests->conn_fds[dest_num],
+							conn_msg, 0);
+				log_debug_low("%s(): sendmsg() == %d\n",
+								__func__, ret);
+			} while ((ret == -1) && (errno == EINTR));
+			if (ret != -1) {
+				tx_dest_sent(tx_dests,
+					tx_dests->dests_num + dest_num, 1, ret);
+				tx_success++;
+			} else {
+				tx_dest_failed(tx_dests,
+					tx_dests->dests_num + dest_num, errno);
+			}
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return tx_success;
+
+}
+
+
+int tx_pkt_send_flags(const struct tx_dests *tx_dests,
+		      const struct iovec *pkt)
+{
+
+
+	if (tx_dests->zerocopy && (pkt->iov_len >= TX_ZEROCOPY_MIN_LEN)) {
+		return MSG_ZEROCOPY;
+	} else {
+		return 0;
+	}
+
+}
+
+
+unsigned int udp_gso_run_len(const struct iovec pkts[],
+			     const unsigned int pkts_num)
+{
+	const size_t seg_size = pkts[0].iov_len;
+	size_t run_size = seg_size;
+	unsigned int run_len = 1;
+
+
+	/*
+	 * A run is a sequence of datagrams all of the first's size, apart from
+	 * possibly a shorter final one, which the kernel can segment back
+	 * into the original datagrams.
+	 */
+	while ((run_len < pkts_num) && (run_len < UDP_GSO_MAX_SEGS) &&
+	       (pkts[run_len].iov_len <= seg_size) &&
+	       ((run_size + pkts[run_len].iov_len) <= UDP_GSO_MAX_PAYLOAD)) {
+		run_size += pkts[run_len].iov_len;
+		run_len++;
+		if (pkts[run_len - 1].iov_len < seg_size) {
+			break;
+		}
+	}
+
+	return run_len;
+
+}
+
+
+unsigned int tx_dests_gso_rcast(const int sock_fd,
+				struct iovec pkts[],
+				const unsigned int pkts_num,
+				struct tx_dests *tx_dests,
+				struct packet_counters *pkt_counters)
+{
+	const unsigned long long *run_rx_nsecs;
+	struct cmsghdr *cmsg;
+	uint16_t seg_size;
+	unsigned int tx_success = 0;
+	unsigned int gso_sends = 0;
+	unsigned int dest_num;
+	unsigned int pkt_num;
+	int flags = 0;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	seg_size = pkts[0].iov_len;
+	cmsg = (struct cmsghdr *)tx_dests->gso_cmsg.buf;
+	memcpy(CMSG_DATA(cmsg), &seg_size, sizeof(seg_size));
+
+	for (dest_num = 0; dest_num < tx_dests->gso_dests_num; dest_num++) {
+		tx_dests->gso_mmsgs[dest_num].msg_hdr.msg_iov = pkts;
+		tx_dests->gso_mmsgs[dest_num].msg_hdr.msg_iovlen = pkts_num;
+	}
+
+	if (tx_dests->zerocopy &&
+	    ((seg_size * (pkts_num - 1)) + pkts[pkts_num - 1].iov_len >=
+						TX_ZEROCOPY_MIN_LEN)) {
+		flags = MSG_ZEROCOPY;
+	}
+
+	/*
+	 * A destination whose super-buffer send fails, e.g. because the
+	 * segment size exceeds its path MTU, is sent the datagrams separately.
+	 */
+	dest_num = 0;
+	while (dest_num < tx_dests->gso_dests_num) {
+		ret = tx_sendmmsg(sock_fd, &tx_dests->gso_mmsgs[dest_num],
+			tx_dests->gso_dests_num - dest_num, flags, tx_dests,
+			pkt_counters);
+		if (ret > 0) {
+			tx_mmsgs_sent(tx_dests, tx_dests->gso_mmsgs,
+				tx_dests->gso_dests, dest_num, ret, pkts_num);
+			gso_sends += ret;
+			dest_num += ret;
+		} else if ((ret == -1) && (errno == EINTR)) {
+			continue;
+		} else {
+			tx_success += tx_dest_pkts_send(sock_fd,
+				&tx_dests->gso_mmsgs[dest_num].msg_hdr, pkts,
+				pkts_num, tx_dests,
+				tx_dests->gso_dests[dest_num]);
+			dest_num++;
+		}
+	}
+
+	tx_success += gso_sends * pkts_num;
+	pkt_counters->tx_gso_sends += gso_sends;
+	pkt_counters->tx_gso_segs += gso_sends * pkts_num;
+
+	run_rx_nsecs = tx_dests->pkt_rx_nsecs;
+	for (pkt_num = 0; pkt_num < pkts_num; pkt_num++) {
+		if (run_rx_nsecs != NULL) {
+			tx_dests->pkt_rx_nsecs = &run_rx_nsecs[pkt_num];
+		}
+		tx_dests->pkt_iov = pkts[pkt_num];
+		tx_success += tx_mmsgs_send(sock_fd, tx_dests->mc_mmsgs,
+			tx_dests->mc_dests, tx_dests->mc_dests_num,
+			tx_pkt_send_flags(tx_dests, &pkts[pkt_num]), tx_dests,
+			pkt_counters);
+	}
+	tx_dests->pkt_rx_nsecs = run_rx_nsecs;
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return tx_success;
+
+}
+
+
+int tx_dests_rcast(const int sock_fd,
+		   struct iovec pkts[],
+		   const unsigned int pkts_num,
+		   struct tx_dests *tx_dests,
+		   struct packet_counters *pkt_counters)
+{
+	unsigned int tx_success = 0;
+	unsigned int pkt_success = 0;
+	unsigned int pkt_num = 0;
+	unsigned int run_len;
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (tx_dests->backlog_size > 0) {
+		log_debug_med("%s() exit\n", __func__);
+		return tx_backlog_rcast(sock_fd, pkts, pkts_num, tx_dests,
+			pkt_counters);
+	}
+
+	if (tx_dests->paced) {
+		log_debug_med("%s() exit\n", __func__);
+		return tx_pace_rcast(sock_fd, pkts, pkts_num, tx_dests,
+			pkt_counters);
+	}
+
+	if (tx_dests->rate_limited) {
+		tx_rate_clock(tx_dests);
+	}
+
+	if (tx_dests->conn_dests_num > 0) {
+		tx_success += tx_conn_dests_rcast(pkts, pkts_num, tx_dests);
+
+		/* a datagram is then sent once the last of them has it */
+		if ((tx_dests->rx_nsecs != NULL) && (tx_dests->dests_num == 0) &&
+		    (tx_success > 0)) {
+			for (i = 0; i < pkts_num; i++) {
+				if (tx_dests->rx_nsecs[i] != 0) {
+					tx_family_latency(tx_dests,
+						tx_dests->rx_nsecs[i], 1);
+				}
+			}
+		}
+	}
+
+	while ((pkt_num < pkts_num) && (tx_dests->dests_num > 0)) {
+		if (tx_dests->udp_gso) {
+			run_len = udp_gso_run_len(&pkts[pkt_num],
+				pkts_num - pkt_num);
+		} else {
+			run_len = 1;
+		}
+
+		/*
+		 * A GSO run can join datagrams received separately, so each is
+		 * timed from its own receive time.
+		 */
+		if (tx_dests->rx_nsecs != NULL) {
+			tx_dests->pkt_rx_nsecs = &tx_dests->rx_nsecs[pkt_num];
+			pkt_success = tx_success;
+		}
+
+		if (run_len > 1) {
+			tx_success += tx_dests_gso_rcast(sock_fd,
+				&pkts[pkt_num], run_len, tx_dests,
+				pkt_counters);
+		} else if (tx_dests->rate_limited) {
+			tx_dests->pkt_iov = pkts[pkt_num];
+			tx_success += tx_mmsgs_send(sock_fd,
+				tx_dests->send_mmsgs, tx_dests->send_dests,
+				tx_rate_dests(tx_dests, &pkts[pkt_num]),
+				tx_pkt_send_flags(tx_dests, &pkts[pkt_num]),
+				tx_dests, pkt_counters);
+		} else {
+			tx_dests->pkt_iov = pkts[pkt_num];
+			tx_success += tx_mmsgs_send(sock_fd, tx_dests->mmsgs,
+				NULL, tx_dests->dests_num,
+				tx_pkt_send_flags(tx_dests, &pkts[pkt_num]),
+				tx_dests, pkt_counters);
+		}
+
+		if ((tx_dests->pkt_rx_nsecs != NULL) &&
+		    (tx_success > pkt_success)) {
+			for (i = pkt_num; i < (pkt_num + run_len); i++) {
+				if (tx_dests->rx_nsecs[i] != 0) {
+					tx_family_latency(tx_dests,
+						tx_dests->rx_nsecs[i], 1);
+				}
+			}
+		}
+
+		pkt_num += run_len;
+	}
+
+	/* backlogged and paced sends aren't timed */
+	tx_dests->pkt_rx_nsecs = NULL;
+
+	/*
+	 * A receive batch rotating its buffers waits for their sends itself
+	 * before reusing them, while the pipe engine's ring has no such point.
+	 */
+	if (tx_dests->zc_rotated) {
+		tx_zerocopy_reap(sock_fd, tx_dests, pkt_counters);
+	} else if (tx_dests->zc_completed < tx_dests->zc_issued) {
+		tx_zerocopy_wait(sock_fd, tx_dests, tx_dests->zc_issued,
+							pkt_counters);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return tx_success;
+
+}
+
+
+int init_rx_batch(struct rx_batch *rx_batch,
+		  const int sock_fd,
+		  const struct rx_batch_params *rx_batch_parms,
+		  const unsigned int udp_gro)
+{
+	unsigned int pkts_max;
+	unsigned int i;
+	struct timeval rcv_timeo;
+	const int one = 1;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	rx_batch->size = rx_batch_parms->batch_size;
+	rx_batch->wait_usec = rx_batch_parms->batch_wait_usec;
+	rx_batch->udp_gro = udp_gro;
+	rx_batch->xsk = NULL;
+	rx_batch->xsk_frames = NULL;
+	rx_batch->pkt_ring = NULL;
+	rx_batch->ring_pkts = NULL;
+	rx_batch->busy_poll = (rx_batch_parms->busy_poll_usec > 0);
+	rx_batch->busy_spinning = rx_batch->busy_poll;
+	rx_batch->busy_idle_nsecs = rx_batch_parms->busy_idle_msec *
+								1000000ULL;
+	rx_batch->busy_idle_start = 0;
+	rx_batch->latency = rx_batch_parms->latency;
+	rx_batch->tstamps = rx_batch_parms->tstamps;
+	rx_batch->rx_tstamps = NULL;
+	rx_batch->rx_nsecs = NULL;
+	rx_batch->rx_drops = 0;
+	rx_batch->buf_max = rx_batch_parms->buf_max;
+	rx_batch->buf_size = 0;
+	rx_batch->buf_maxed = 0;
+	rx_batch->buf_recvs = 0;
+	rx_batch->buf_check_nsecs = 0;
+	rx_batch->buf_drops = 0;
+	rx_batch->buf_set = 0;
+	rx_batch->buf_sets = 1;
+	rx_batch->zc_dests = NULL;
+	rx_batch->zc_sock_fds = NULL;
+	rx_batch->zc_dests_num = 0;
+
+	/*
+	 * Each coalesced GRO buffer can hold up to UDP_GRO_MAX_SEGS datagrams
+	 * once split.
+	 */
+	if (udp_gro) {
+		pkts_max = rx_batch->size * UDP_GRO_MAX_SEGS;
+	} else {
+		pkts_max = rx_batch->size;
+	}
+
+	rx_batch->mmsgs = calloc(rx_batch->size, sizeof(struct mmsghdr));
+	rx_batch->iovs = calloc(rx_batch->size, sizeof(struct iovec));
+	rx_batch->pkts = calloc(pkts_max, sizeof(struct iovec));
+	rx_batch->bufs = malloc(rx_batch->size * PKT_BUF_SIZE);
+	rx_batch->cmsg_bufs = calloc(rx_batch->size, RX_CMSG_BUF_SIZE);
+	if ((rx_batch->mmsgs == NULL) || (rx_batch->iovs == NULL) ||
+	    (rx_batch->pkts == NULL) || (rx_batch->bufs == NULL) ||
+	    (rx_batch->cmsg_bufs == NULL)) {
+		log_debug_low("%s(): malloc() failed\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	for (i = 0; i < rx_batch->size; i++) {
+		rx_batch->iovs[i].iov_base = rx_batch->bufs +
+							(i * PKT_BUF_SIZE);
+		rx_batch->iovs[i].iov_len = PKT_BUF_SIZE;
+		rx_batch->mmsgs[i].msg_hdr.msg_iov = &rx_batch->iovs[i];
+		rx_batch->mmsgs[i].msg_hdr.msg_iovlen = 1;
+		rx_batch->mmsgs[i].msg_hdr.msg_control = rx_batch->cmsg_bufs +
+							(i * RX_CMSG_BUF_SIZE);
+	}
+
+	/*
+	 * recvmmsg() only checks its timeout after each datagram arrives, so
+	 * a socket receive timeout is also needed to stop a partially filled
+	 * batch waiting indefinitely for the next datagram.
+	 */
+	if ((rx_batch->size > 1) && (rx_batch->wait_usec > 0)) {
+		rcv_timeo.tv_sec = rx_batch->wait_usec / 1000000;
+		rcv_timeo.tv_usec = rx_batch->wait_usec % 1000000;
+		ret = setsockopt(sock_fd, SOL_SOCKET, SO_RCVTIMEO, &rcv_timeo,
+			sizeof(rcv_timeo));
+		if (ret == -1) {
+			log_debug_low("%s(): setsockopt(SO_RCVTIMEO) == %d\n",
+				__func__, ret);
+			log_debug_low("%s(): errno == %d\n", __func__, errno);
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+	}
+
+	if (rx_batch->busy_poll &&
+	    (rx_busy_poll_enable(sock_fd, rx_batch_parms->busy_poll_usec) ==
+									-1)) {
+		log_msg(LOG_SEV_WARNING, "Couldn't set SO_BUSY_POLL (%s), "
+			"spinning without it.\n", strerror(errno));
+	}
+
+	if (rx_batch->tstamps) {
+		rx_batch->rx_tstamps = calloc(rx_batch->size,
+						sizeof(struct timespec));
+		rx_batch->rx_nsecs = calloc(pkts_max,
+						sizeof(unsigned long long));
+		if ((rx_batch->rx_tstamps == NULL) ||
+		    (rx_batch->rx_nsecs == NULL)) {
+			log_debug_low("%s(): calloc() failed\n", __func__);
+			log_debug_med("%s() exit\n", __func__);
+			errno = ENOMEM;
+			return -1;
+		}
+		ret = setsockopt(sock_fd, SOL_SOCKET, SO_TIMESTAMPNS, &one,
+							sizeof(one));
+		if (ret == -1) {
+			log_debug_low("%s(): setsockopt(SO_TIMESTAMPNS) == %d\n",
+				__func__, ret);
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+	}
+
+	/*
+	 * Growing starts from the size the socket has now, which the kernel
+	 * reports doubled, and from the drops it has already counted.
+	 */
+	if (rx_batch->buf_max > 0) {
+		ret = sock_buf_get(sock_fd, SO_RCVBUF);
+		if ((ret == -1) ||
+		    (rx_sock_drops(sock_fd, &rx_batch->buf_drops) == -1)) {
+			log_debug_med("%s() exit\n", __func__);
+			return -1;
+		}
+		rx_batch->buf_size = ret / 2;
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return 0;
+
+}
+
+
+int rx_batch_inet_xsk_open(struct rx_batch *rx_batch,
+			   const struct inet_rx_sock_params *sock_parms,
+			   int *xdp_sock_fd)
+{
+	const struct in_addr *dst_addr = NULL;
+
+
+	if (sock_parms->xdp_intf_idx == 0) {
+		return 0;
+	}
+
+	if (sock_parms->rx_addr.s_addr != htonl(INADDR_ANY)) {
+		dst_addr = &sock_parms->rx_addr;
+	}
+
+	return rx_batch_xsk_open(rx_batch, sock_parms->xdp_intf_idx,
+		sock_parms->xdp_queue, sock_parms->xdp_skb_mode, AF_INET,
+		dst_addr, sock_parms->port, xdp_sock_fd);
+
+}
+
+
+int rx_batch_inet6_xsk_open(struct rx_batch *rx_batch,
+			    const struct inet6_rx_sock_params *sock_parms,
+			    int *xdp_sock_fd)
+{
+	const struct in6_addr *dst_addr = NULL;
+
+
+	if (sock_parms->xdp_intf_idx == 0) {
+		return 0;
+	}
+
+	if (!IN6_IS_ADDR_UNSPECIFIED(&sock_parms->rx_addr)) {
+		dst_addr = &sock_parms->rx_addr;
+	}
+
+	return rx_batch_xsk_open(rx_batch, sock_parms->xdp_intf_idx,
+		sock_parms->xdp_queue, sock_parms->xdp_skb_mode, AF_INET6,
+		dst_addr, sock_parms->port, xdp_sock_fd);
+
+}
+
+
+int rx_batch_xsk_open(struct rx_batch *rx_batch,
+		      const unsigned int xdp_intf_idx,
+		      const unsigned int xdp_queue,
+		      const unsigned int xdp_skb_mode,
+		      const int family,
+		      const void *dst_addr,
+		      const unsigned int dst_port,
+		      int *xdp_sock_fd)
+{
+	struct xsk *xsk;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	xsk = malloc(sizeof(struct xsk));
+	rx_batch->xsk_frames = calloc(XDP_RX_BATCH, sizeof(struct iovec));
+	if ((xsk == NULL) || (rx_batch->xsk_frames == NULL)) {
+		log_debug_low("%s(): malloc() failed\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if (rx_batch_pkts_resize(rx_batch, XDP_RX_BATCH) == -1) {
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	/*
+	 * The UDP socket stays open to hold the multicast group membership,
+	 * and to receive anything the XDP program passes to the stack, such
+	 * as datagrams arriving on other queues. So if AF_XDP can't be used,
+	 * replicast just carries on with the socket alone.
+	 */
+	if ((xsk_open(xsk, xdp_intf_idx, xdp_queue, xdp_skb_mode) == -1) ||
+	    (xsk_udp_redirect_attach(xsk, xdp_intf_idx, xdp_queue,
+			xdp_skb_mode, family, dst_addr, dst_port) == -1)) {
+		log_msg(LOG_SEV_WARNING, "AF_XDP receive unavailable (%s), "
+			"using UDP socket.\n", strerror(errno));
+		xsk_close(xsk);
+		free(xsk);
+		log_debug_med("%s() exit\n", __func__);
+		return 0;
+	}
+
+	rx_batch->xsk = xsk;
+	*xdp_sock_fd = xsk->sock_fd;
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return 0;
+
+}
+
+
+int rx_batch_inet_pkt_ring_open(struct rx_batch *rx_batch,
+				const struct inet_rx_sock_params *sock_parms,
+				const int sock_fd)
+{
+	const struct in_addr *dst_addr = NULL;
+
+
+	if (sock_parms->pkt_ring_intf_idx == 0) {
+		return 0;
+	}
+
+	if (sock_parms->rx_addr.s_addr != htonl(INADDR_ANY)) {
+		dst_addr = &sock_parms->rx_addr;
+	}
+
+	return rx_batch_pkt_ring_open(rx_batch, sock_parms->pkt_ring_intf_idx,
+		sock_parms->pkt_ring_block_tov, AF_INET, dst_addr,
+		sock_parms->port, sock_fd);
+
+}
+
+
+int rx_batch_inet6_pkt_ring_open(struct rx_batch *rx_batch,
+				 const struct inet6_rx_sock_params *sock_parms,
+				 const int sock_fd)
+{
+	const struct in6_addr *dst_addr = NULL;
+
+
+	if (sock_parms->pkt_ring_intf_idx == 0) {
+		return 0;
+	}
+
+	if (!IN6_IS_ADDR_UNSPECIFIED(&sock_parms->rx_addr)) {
+		dst_addr = &sock_parms->rx_addr;
+	}
+
+	return rx_batch_pkt_ring_open(rx_batch, sock_parms->pkt_ring_intf_idx,
+		sock_parms->pkt_ring_block_tov, AF_INET6, dst_addr,
+		sock_parms->port, sock_fd);
+
+}
+
+
+int rx_batch_pkt_ring_open(struct rx_batch *rx_batch,
+			   const unsigned int pkt_ring_intf_idx,
+			   const unsigned int pkt_ring_block_tov,
+			   const int family,
+			   const void *dst_addr,
+			   const unsigned int dst_port,
+			   const int sock_fd)
+{
+	struct pktring *pkt_ring;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	pkt_ring = malloc(sizeof(struct pktring));
+	rx_batch->ring_pkts = calloc(PKT_RING_RX_BATCH, sizeof(struct iovec));
+	if ((pkt_ring == NULL) || (rx_batch->ring_pkts == NULL)) {
+		log_debug_low("%s(): malloc() failed\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if (rx_batch_pkts_resize(rx_batch, PKT_RING_RX_BATCH) == -1) {
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	if (pktring_open(pkt_ring, pkt_ring_intf_idx, family, dst_addr,
+				dst_port, pkt_ring_block_tov) == -1) {
+		log_msg(LOG_SEV_WARNING, "AF_PACKET ring receive unavailable "
+			"(%s), using UDP socket.\n", strerror(errno));
+		free(pkt_ring);
+		log_debug_med("%s() exit\n", __func__);
+		return 0;
+	}
+
+	/*
+	 * The UDP socket stays open to hold any multicast group membership
+	 * and to stop ICMP port unreachables being sent, but would otherwise
+	 * queue its own copy of every datagram the ring receives.
+	 */
+	if (pktring_drop_all_filter(sock_fd) == -1) {
+		log_msg(LOG_SEV_WARNING, "Couldn't filter UDP socket (%s), "
+			"its receive queue will overflow.\n",
+			strerror(errno));
+	}
+
+	rx_batch->pkt_ring = pkt_ring;
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return 0;
+
+}
+
+
+int rx_batch_pkts_resize(struct rx_batch *rx_batch,
+			 const unsigned int pkts_num)
+{
+	struct iovec *pkts;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	/*
+	 * Without GRO the packet list is only as long as the receive batch,
+	 * which can be shorter than an AF_XDP or AF_PACKET ring batch.
+	 */
+	if (!rx_batch->udp_gro && (rx_batch->size < pkts_num)) {
+		pkts = realloc(rx_batch->pkts, pkts_num *
+							sizeof(struct iovec));
+		if (pkts == NULL) {
+			log_debug_low("%s(): realloc() failed\n", __func__);
+			log_debug_med("%s() exit\n", __func__);
+			errno = ENOMEM;
+			return -1;
+		}
+		rx_batch->pkts = pkts;
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return 0;
+
+}
+
+
+int rx_batch_recv(const int sock_fd,
+		  struct rx_batch *rx_batch,
+		  struct packet_counters *pkt_counters)
+{
+	int rx_pkts;
+	int i;
+
+
+	if (rx_batch->zc_dests_num > 0) {
+		rx_batch_zc_rotate(rx_batch, pkt_counters);
+	}
+
+	if (rx_batch->xsk != NULL) {
+		rx_pkts = rx_batch_xsk_recv(sock_fd, rx_batch, pkt_counters);
+	} else if (rx_batch->pkt_ring != NULL) {
+		rx_pkts = rx_batch_pkt_ring_recv(rx_batch, pkt_counters);
+	} else {
+		rx_pkts = rx_batch_sock_recv(sock_fd, rx_batch, pkt_counters);
+		if ((rx_batch->buf_max > 0) &&
+		    (++rx_batch->buf_recvs >= RX_BUF_TUNE_RECVS)) {
+			rx_batch_buf_tune(sock_fd, rx_batch, pkt_counters);
+		}
+	}
+
+	for (i = 0; i < rx_pkts; i++) {
+		pkt_counters->rx_bytes += rx_batch->pkts[i].iov_len;
+	}
+
+	return rx_pkts;
+
+}
+
+
+/*
+ * Zero copy sends from the batch's buffers are waited for before they are
+ * received into again. The socket receive buffers are rotated through
+ * RX_ZC_BUF_SETS batches' worth, so the wait is normally for sends long
+ * since completed, rather than for those of the batch just sent.
+ */
+int rx_batch_zc_add(struct rx_batch *rx_batch,
+		    const int sock_fd,
+		    struct tx_dests *tx_dests)
+{
+	struct tx_dests **zc_dests;
+	int *zc_sock_fds;
+	uint8_t *bufs;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (!tx_dests->zerocopy) {
+		log_debug_med("%s() exit\n", __func__);
+		return 0;
+	}
+
+	zc_dests = realloc(rx_batch->zc_dests, (rx_batch->zc_dests_num + 1) *
+						sizeof(struct tx_dests *));
+	if (zc_dests == NULL) {
+		log_debug_low("%s(): realloc() failed\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		errno = ENOMEM;
+		return -1;
+	}
+	rx_batch->zc_dests = zc_dests;
+
+	zc_sock_fds = realloc(rx_batch->zc_sock_fds,
+				(rx_batch->zc_dests_num + 1) * sizeof(int));
+	if (zc_sock_fds == NULL) {
+		log_debug_low("%s(): realloc() failed\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		errno = ENOMEM;
+		return -1;
+	}
+	rx_batch->zc_sock_fds = zc_sock_fds;
+
+	/* AF_XDP and AF_PACKET ring frames are the kernel's to hand out */
+	if ((rx_batch->buf_sets == 1) && (rx_batch->xsk == NULL) &&
+	    (rx_batch->pkt_ring == NULL)) {
+		bufs = malloc(RX_ZC_BUF_SETS * rx_batch->size * PKT_BUF_SIZE);
+		if (bufs == NULL) {
+			log_debug_low("%s(): malloc() failed\n", __func__);
+			log_debug_med("%s() exit\n", __func__);
+			errno = ENOMEM;
+			return -1;
+		}
+		free(rx_batch->bufs);
+		rx_batch->bufs = bufs;
+		rx_batch->buf_sets = RX_ZC_BUF_SETS;
+		rx_batch->buf_set = RX_ZC_BUF_SETS - 1;
+	}
+
+	rx_batch->zc_dests[rx_batch->zc_dests_num] = tx_dests;
+	rx_batch->zc_sock_fds[rx_batch->zc_dests_num] = sock_fd;
+	rx_batch->zc_dests_num++;
+	tx_dests->zc_rotated = 1;
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return 0;
+
+}
+
+
+/*
+ * Called before each receive, marking the sends of the batch just
+ * forwarded on its buffers, then moving to the next buffers and waiting
+ * for any of their sends still outstanding.
+ */
+void rx_batch_zc_rotate(struct rx_batch *rx_batch,
+			struct packet_counters *pkt_counters)
+{
+	struct tx_dests *tx_dests;
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	for (i = 0; i < rx_batch->zc_dests_num; i++) {
+		tx_dests = rx_batch->zc_dests[i];
+		tx_dests->zc_marks[rx_batch->buf_set] = tx_dests->zc_issued;
+	}
+
+	if (rx_batch->buf_sets > 1) {
+		rx_batch->buf_set = (rx_batch->buf_set + 1) %
+							rx_batch->buf_sets;
+		for (i = 0; i < rx_batch->size; i++) {
+			rx_batch->iovs[i].iov_base = rx_batch->bufs +
+				(((rx_batch->buf_set * rx_batch->size) + i) *
+								PKT_BUF_SIZE);
+		}
+	}
+
+	for (i = 0; i < rx_batch->zc_dests_num; i++) {
+		tx_dests = rx_batch->zc_dests[i];
+		if (tx_dests->zc_completed <
+				tx_dests->zc_marks[rx_batch->buf_set]) {
+			tx_zerocopy_wait(rx_batch->zc_sock_fds[i], tx_dests,
+				tx_dests->zc_marks[rx_batch->buf_set],
+				pkt_counters);
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+int rx_batch_sock_recv(const int sock_fd,
+		       struct rx_batch *rx_batch,
+		       struct packet_counters *pkt_counters)
+{
+	struct timespec timeout;
+	ssize_t rx_pkt_len;
+	int rx_msgs;
+	int recv_flags = 0;
+	unsigned int pkts_num = 0;
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	for (i = 0; i < rx_batch->size; i++) {
+		rx_batch->mmsgs[i].msg_hdr.msg_controllen = RX_CMSG_BUF_SIZE;
+	}
+
+	if (rx_batch->busy_spinning) {
+		recv_flags = MSG_DONTWAIT;
+		pkt_counters->rx_busy_polls++;
+	}
+
+	if (rx_batch->size == 1) {
+		rx_pkt_len = recvmsg(sock_fd, &rx_batch->mmsgs[0].msg_hdr,
+								recv_flags);
+		log_debug_low("%s(): recvmsg() == %d\n", __func__, rx_pkt_len);
+		log_debug_low("%s(): errno == %d, %s\n", __func__, errno,
+							strerror(errno));
+		if (rx_batch->busy_poll) {
+			rx_batch_busy_update(rx_batch, rx_pkt_len > 0,
+								pkt_counters);
+		}
+		if (rx_pkt_len <= 0) {
+			log_debug_med("%s() exit\n", __func__);
+			return 0;
+		}
+		rx_batch->mmsgs[0].msg_len = rx_pkt_len;
+		rx_msgs = 1;
+	} else {
+		if (rx_batch->busy_spinning) {
+			rx_msgs = recvmmsg(sock_fd, rx_batch->mmsgs,
+				rx_batch->size, MSG_DONTWAIT, NULL);
+		} else if (rx_batch->wait_usec > 0) {
+			timeout.tv_sec = rx_batch->wait_usec / 1000000;
+			timeout.tv_nsec = (rx_batch->wait_usec % 1000000) *
+									1000;
+			rx_msgs = recvmmsg(sock_fd, rx_batch->mmsgs,
+				rx_batch->size, 0, &timeout);
+		} else {
+			rx_msgs = recvmmsg(sock_fd, rx_batch->mmsgs,
+				rx_batch->size, MSG_WAITFORONE, NULL);
+		}
+		log_debug_low("%s(): recvmmsg() == %d\n", __func__, rx_msgs);
+		log_debug_low("%s(): errno == %d, %s\n", __func__, errno,
+							strerror(errno));
+		if (rx_batch->busy_poll) {
+			rx_batch_busy_update(rx_batch, rx_msgs > 0,
+								pkt_counters);
+		}
+		if (rx_msgs <= 0) {
+			log_debug_med("%s() exit\n", __func__);
+			return 0;
+		}
+
+		pkt_counters->rx_batches++;
+		pkt_counters->rx_batch_pkts += rx_msgs;
+		if (rx_msgs == rx_batch->size) {
+			pkt_counters->rx_batches_full++;
+		}
 	}
 
-	return ret;
+	rx_batch_drops(rx_batch, rx_msgs);
+
+	if (rx_batch->tstamps) {
+		rx_batch_tstamps(rx_batch, rx_msgs);
+	}
+
+	if (rx_batch->udp_gro) {
+		log_debug_med("%s() exit\n", __func__);
+		return rx_batch_split_gro(rx_batch, rx_msgs, pkt_counters);
+	}
+
+	/* empty datagrams are dropped, as a single recvmsg() drops them */
+	for (i = 0; i < rx_msgs; i++) {
+		if (rx_batch->mmsgs[i].msg_len == 0) {
+			continue;
+		}
+		rx_batch->pkts[pkts_num].iov_base = rx_batch->iovs[i].iov_base;
+		rx_batch->pkts[pkts_num].iov_len = rx_batch->mmsgs[i].msg_len;
+		if (rx_batch->tstamps) {
+			rx_batch->rx_nsecs[pkts_num] = rx_tstamp_nsecs(
+						&rx_batch->rx_tstamps[i]);
+		}
+		pkts_num++;
+	}
+
+	log_debug_med("%s() exit\n", __func__);
+
+	return pkts_num;
 
 }
 
 
-void log_prog_banner(void)
+
+/*
+ * SO_BUSY_POLL makes a receive on an empty socket poll the device queue
+ * for up to busy_poll_usec, and SO_PREFER_BUSY_POLL keeps the device's
+ * interrupts masked while the application is polling it. Raising the busy
+ * poll time above net.core.busy_read needs CAP_NET_ADMIN.
+ */
+int rx_busy_poll_enable(const int sock_fd,
+			const unsigned int busy_poll_usec)
 {
+	const int usecs = busy_poll_usec;
+	const int one = 1;
+	int ret;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	log_msg(LOG_SEV_INFO, "%s v%1.1f\n", program_name, replicast_version);
+	ret = setsockopt(sock_fd, SOL_SOCKET, SO_BUSY_POLL, &usecs,
+							sizeof(usecs));
+	log_debug_low("%s(): setsockopt(SO_BUSY_POLL) == %d\n", __func__, ret);
+	if (ret == -1) {
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
+	}
+
+	ret = setsockopt(sock_fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &one,
+							sizeof(one));
+	log_debug_low("%s(): setsockopt(SO_PREFER_BUSY_POLL) == %d\n",
+							__func__, ret);
 
 	log_debug_med("%s() exit\n", __func__);
 
+	return ret;
+
 }
 
 
-void log_prog_parms(const struct program_parameters *prog_parms)
+/*
+ * While spinning, a receive finding nothing starts or continues the idle
+ * period, and once it reaches busy_idle_nsecs the receives go back to
+ * sleeping until a datagram arrives, which starts the spinning again.
+ */
+void rx_batch_busy_update(struct rx_batch *rx_batch,
+			  const unsigned int rx_ok,
+			  struct packet_counters *pkt_counters)
 {
+	struct timespec now;
+	unsigned long long now_nsecs;
 
 
-	log_debug_med("%s() entry\n", __func__);
+	if (rx_ok) {
+		rx_batch->busy_idle_start = 0;
+		rx_batch->busy_spinning = 1;
+		return;
+	}
 
-	switch(prog_parms->rc_mode) {
-	case RCMODE_INET_TO_INET:
-		log_inet_rx_sock_parms(&prog_parms->inet_rx_sock_parms);
-		log_inet_tx_sock_parms(&prog_parms->inet_tx_sock_parms);
-		break;
-	case RCMODE_INET_TO_INET6:
-		log_inet_rx_sock_parms(&prog_parms->inet_rx_sock_parms);
-		log_inet6_tx_sock_parms(&prog_parms->inet6_tx_sock_parms);
-		break;
-	case RCMODE_INET_TO_INET_INET6:
-		log_inet_rx_sock_parms(&prog_parms->inet_rx_sock_parms);
-		log_inet_tx_sock_parms(&prog_parms->inet_tx_sock_parms);
-		log_inet6_tx_sock_parms(&prog_parms->inet6_tx_sock_parms);
-		break;
-	case RCMODE_INET6_TO_INET6:
-		log_inet6_rx_sock_parms(&prog_parms->inet6_rx_sock_parms);
-		log_inet6_tx_sock_parms(&prog_parms->inet6_tx_sock_parms);
-		break;
-	case RCMODE_INET6_TO_INET:
-		log_inet6_rx_sock_parms(&prog_parms->inet6_rx_sock_parms);
-		log_inet_tx_sock_parms(&prog_parms->inet_tx_sock_parms);
-		break;
-	case RCMODE_INET6_TO_INET_INET6:
-		log_inet6_rx_sock_parms(&prog_parms->inet6_rx_sock_parms);
-		log_inet_tx_sock_parms(&prog_parms->inet_tx_sock_parms);
-		log_inet6_tx_sock_parms(&prog_parms->inet6_tx_sock_parms);
-		break;
-	default:
-		break;
+	if (!rx_batch->busy_spinning) {
+		return;
 	}
 
+	pkt_counters->rx_busy_empty++;
 
-	log_debug_med("%s() exit\n", __func__);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	now_nsecs = (now.tv_sec * 1000000000ULL) + now.tv_nsec;
+
+	if (rx_batch->busy_idle_start == 0) {
+		rx_batch->busy_idle_start = now_nsecs;
+	} else if ((now_nsecs - rx_batch->busy_idle_start) >=
+						rx_batch->busy_idle_nsecs) {
+		rx_batch->busy_spinning = 0;
+		pkt_counters->rx_busy_backoffs++;
+	}
 
 }
 
 
-void log_inet_rx_sock_parms(const struct inet_rx_sock_params *inet_rx_parms)
+/*
+ * The number of datagrams the kernel has dropped on arrival at the socket,
+ * nearly always because its receive buffer was full.
+ */
+int rx_sock_drops(const int sock_fd,
+		  uint32_t *drops)
 {
-	char aip_str[AIP_STR_INET_MAX_LEN + 1];
-	const unsigned int aip_str_size = AIP_STR_INET_MAX_LEN + 1;
-
-
-	log_debug_med("%s() entry\n", __func__);
+	uint32_t meminfo[SK_MEMINFO_VARS];
+	socklen_t meminfo_len = sizeof(meminfo);
+	int ret;
 
-	log_msg(LOG_SEV_INFO, "inet rx src: ");
 
-	aip_htop_inet(&inet_rx_parms->rx_addr, &inet_rx_parms->in_intf_addr,
-		inet_rx_parms->port, aip_str, aip_str_size);
+	ret = getsockopt(sock_fd, SOL_SOCKET, SO_MEMINFO, meminfo,
+							&meminfo_len);
+	if (ret == -1) {
+		log_debug_low("%s(): getsockopt(SO_MEMINFO) == %d\n",
+							__func__, ret);
+		return -1;
+	}
 
-	log_msg(LOG_SEV_INFO, "%s\n", aip_str);
+	*drops = meminfo[SK_MEMINFO_DROPS];
 
-	log_debug_med("%s() exit\n", __func__);
+	return 0;
 
 }
 
 
-void log_inet6_rx_sock_parms(const struct inet6_rx_sock_params *inet6_rx_parms)
+/*
+ * Checked every RX_BUF_TUNE_RECVS receives, so the clock is only read
+ * occasionally, and at most every RX_BUF_TUNE_MSECS the receive buffer is
+ * doubled, up to buf_max, if the kernel has dropped datagrams since the
+ * last check.
+ */
+void rx_batch_buf_tune(const int sock_fd,
+		       struct rx_batch *rx_batch,
+		       struct packet_counters *pkt_counters)
 {
-	char aip_str[AIP_STR_INET6_MAX_LEN + 1];
-	const unsigned int aip_str_size = AIP_STR_INET6_MAX_LEN + 1;
+	struct timespec now;
+	unsigned long long now_nsecs;
+	uint32_t drops;
+	uint32_t new_drops;
+	unsigned int size;
+	char reason_str[64];
 
 
-	log_debug_med("%s() entry\n", __func__);
+	rx_batch->buf_recvs = 0;
 
-	log_msg(LOG_SEV_INFO, "inet6 rx src: ");
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	now_nsecs = (now.tv_sec * 1000000000ULL) + now.tv_nsec;
+	if (now_nsecs < rx_batch->buf_check_nsecs) {
+		return;
+	}
+	rx_batch->buf_check_nsecs = now_nsecs +
+					(RX_BUF_TUNE_MSECS * 1000000ULL);
 
-	aip_htop_inet6(&inet6_rx_parms->rx_addr, inet6_rx_parms->in_intf_idx,
-		inet6_rx_parms->port, aip_str, aip_str_size);
+	if (rx_sock_drops(sock_fd, &drops) == -1) {
+		return;
+	}
+	new_drops = drops - rx_batch->buf_drops;
+	rx_batch->buf_drops = drops;
+	if (new_drops == 0) {
+		return;
+	}
+	pkt_counters->rx_buf_drops += new_drops;
+
+	if (rx_batch->buf_size >= rx_batch->buf_max) {
+		if (!rx_batch->buf_maxed) {
+			log_msg(LOG_SEV_WARNING, "rx socket receive buffer at "
+				"-rxbufmax %d bytes, %u datagrams dropped.\n",
+				rx_batch->buf_max, new_drops);
+			rx_batch->buf_maxed = 1;
+		}
+		return;
+	}
 
-	log_msg(LOG_SEV_INFO, "%s\n", aip_str);
+	if (rx_batch->buf_size > (rx_batch->buf_max / 2)) {
+		size = rx_batch->buf_max;
+	} else {
+		size = rx_batch->buf_size * 2;
+	}
 
-	log_debug_med("%s() exit\n", __func__);
+	snprintf(reason_str, sizeof(reason_str), "%u datagrams dropped",
+								new_drops);
+	if (sock_buf_set(sock_fd, SO_RCVBUF, size, "rx socket",
+						reason_str) == -1) {
+		log_msg(LOG_SEV_WARNING, "Couldn't grow the rx socket receive "
+			"buffer (%s).\n", strerror(errno));
+		return;
+	}
+
+	rx_batch->buf_size = size;
+	pkt_counters->rx_buf_grows++;
 
 }
 
 
-void log_inet_tx_sock_parms(const struct inet_tx_sock_params *inet_tx_parms)
+/*
+ * SO_RXQ_OVFL has the kernel attach the number of datagrams it has dropped
+ * on arrival at the socket so far to each received datagram, once there
+ * have been any, so only the last message received needs looking at.
+ */
+void rx_batch_drops(struct rx_batch *rx_batch,
+		    const unsigned int rx_msgs)
 {
-	char ap_str[INET_ADDRSTRLEN + 1 + 5 + 1];
-	const unsigned int ap_str_size = INET_ADDRSTRLEN + 1 + 5 + 1;
-	unsigned int dest_num = 0;
-	char out_intf_addr_str[INET_ADDRSTRLEN];
+	struct msghdr *msg_hdr = &rx_batch->mmsgs[rx_msgs - 1].msg_hdr;
+	struct cmsghdr *cmsg;
 
 
-	log_debug_med("%s() entry\n", __func__);
+	for (cmsg = CMSG_FIRSTHDR(msg_hdr); cmsg != NULL;
+				cmsg = CMSG_NXTHDR(msg_hdr, cmsg)) {
+		if ((cmsg->cmsg_level == SOL_SOCKET) &&
+		    (cmsg->cmsg_type == SO_RXQ_OVFL)) {
+			memcpy(&rx_batch->rx_drops, CMSG_DATA(cmsg),
+						sizeof(rx_batch->rx_drops));
+			break;
+		}
+	}
 
-	log_msg(LOG_SEV_INFO, "inet tx dsts: ");
+}
 
-	for (dest_num = 0; dest_num < (inet_tx_parms->dests_num - 1);
-								dest_num++) {
 
-		ap_htop_inet(&inet_tx_parms->dests[dest_num].sin_addr,
-			ntohs(inet_tx_parms->dests[dest_num].sin_port),
-			ap_str, ap_str_size);
-		log_msg(LOG_SEV_INFO, "%s,", ap_str);
+/*
+ * Keeps the kernel's receive timestamp of each received message, one for
+ * all the datagrams of a GRO buffer.
+ */
+void rx_batch_tstamps(struct rx_batch *rx_batch,
+		      const unsigned int rx_msgs)
+{
+	struct cmsghdr *cmsg;
+	unsigned int i;
+
+
+	for (i = 0; i < rx_msgs; i++) {
+		rx_batch->rx_tstamps[i].tv_sec = 0;
+		rx_batch->rx_tstamps[i].tv_nsec = 0;
+
+		for (cmsg = CMSG_FIRSTHDR(&rx_batch->mmsgs[i].msg_hdr);
+		     cmsg != NULL;
+		     cmsg = CMSG_NXTHDR(&rx_batch->mmsgs[i].msg_hdr, cmsg)) {
+			if ((cmsg->cmsg_level == SOL_SOCKET) &&
+			    (cmsg->cmsg_type == SCM_TIMESTAMPNS)) {
+				memcpy(&rx_batch->rx_tstamps[i],
+					CMSG_DATA(cmsg),
+					sizeof(struct timespec));
+			}
+		}
 	}
 
-	ap_htop_inet(&inet_tx_parms->dests[dest_num].sin_addr,
-		ntohs(inet_tx_parms->dests[dest_num].sin_port),
-		ap_str, ap_str_size);
-	log_msg(LOG_SEV_INFO, "%s\n", ap_str);
+}
 
-	log_msg(LOG_SEV_INFO, "inet tx opts: ");
 
-	if (inet_tx_parms->out_intf_addr.s_addr == ntohl(INADDR_ANY)) {
-		log_msg(LOG_SEV_INFO, "out intf rt table");
-	} else {
-		inet_ntop(AF_INET, &inet_tx_parms->out_intf_addr,
-			out_intf_addr_str, INET_ADDRSTRLEN);
-		log_msg(LOG_SEV_INFO, "out intf addr %s", out_intf_addr_str);
-	}
+/*
+ * 0 for a datagram without a receive timestamp.
+ */
+unsigned long long rx_tstamp_nsecs(const struct timespec *rx_tstamp)
+{
 
-	if (inet_tx_parms->mc_loop) {
-		log_msg(LOG_SEV_INFO, ", tx loop");
+
+	return (rx_tstamp->tv_sec * 1000000000ULL) + rx_tstamp->tv_nsec;
+
+}
+
+
+/*
+ * The latency histogram has four buckets for each power of two
+ * nanoseconds, so a percentile read from it is within 25% of the true
+ * value.
+ */
+unsigned int rx_latency_bucket(const unsigned long long nsecs)
+{
+	unsigned int msb;
+	unsigned int bucket;
+
+
+	if (nsecs < 4) {
+		return nsecs;
 	}
 
-	log_msg(LOG_SEV_INFO, ", mc ttl %d\n", inet_tx_parms->mc_ttl);
+	msb = 63 - __builtin_clzll(nsecs);
+	bucket = ((msb - 1) * 4) + ((nsecs >> (msb - 2)) & 3);
+	if (bucket >= RX_LATENCY_BUCKETS) {
+		bucket = RX_LATENCY_BUCKETS - 1;
+	}
 
-	log_debug_med("%s() exit\n", __func__);
+	return bucket;
 
 }
 
 
-void log_inet6_tx_sock_parms(const struct inet6_tx_sock_params *inet6_tx_parms)
+unsigned long long rx_latency_bucket_max(const unsigned int bucket)
 {
-	char ap_str[1 + INET6_ADDRSTRLEN + 1 + 1 + 5 + 1];
-	const unsigned int ap_str_size = 1 + INET6_ADDRSTRLEN + 1 + 1 + 5 + 1;
-	unsigned int dest_num = 0;
-	char out_intf_name[IFNAMSIZ];
+	unsigned int shift;
 
 
-	log_debug_med("%s() entry\n", __func__);
+	if (bucket < 4) {
+		return bucket;
+	}
 
-	log_msg(LOG_SEV_INFO, "inet6 tx dsts: ");
+	shift = (bucket / 4) - 1;
 
-	for (dest_num = 0; dest_num < (inet6_tx_parms->dests_num - 1);
-								dest_num++) {
+	return ((4ULL + (bucket % 4) + 1) << shift) - 1;
 
-		ap_htop_inet6(&inet6_tx_parms->dests[dest_num].sin6_addr,
-			ntohs(inet6_tx_parms->dests[dest_num].sin6_port),
-			ap_str, ap_str_size);
-		log_msg(LOG_SEV_INFO, "%s,", ap_str);
-	}
+}
 
-	ap_htop_inet6(&inet6_tx_parms->dests[dest_num].sin6_addr,
-		ntohs(inet6_tx_parms->dests[dest_num].sin6_port),
-		ap_str, ap_str_size);
-	log_msg(LOG_SEV_INFO, "%s\n", ap_str);
 
-	log_msg(LOG_SEV_INFO, "inet6 tx opts: ");
+void latency_hist_add(struct latency_hist *hist,
+		      const unsigned long long nsecs,
+		      const unsigned int pkts)
+{
 
-	if (inet6_tx_parms->out_intf_idx == 0) {
-		log_msg(LOG_SEV_INFO, "out intf rt table");
-	} else {
-		if_indextoname(inet6_tx_parms->out_intf_idx, out_intf_name);
-		log_msg(LOG_SEV_INFO, "out intf %s", out_intf_name);
-	}
 
-	if (inet6_tx_parms->mc_loop) {
-		log_msg(LOG_SEV_INFO, ", tx loop");
+	hist->buckets[rx_latency_bucket(nsecs)] += pkts;
+	hist->pkts += pkts;
+	hist->sum += nsecs * pkts;
+	if (nsecs > hist->max) {
+		hist->max = nsecs;
 	}
 
-	log_msg(LOG_SEV_INFO, ", mc hops %d\n", inet6_tx_parms->mc_hops);
+}
+
+
+void latency_hist_sum(struct latency_hist *total_hist,
+		      const struct latency_hist *hist)
+{
+	unsigned int i;
 
-	log_debug_med("%s() exit\n", __func__);
+
+	total_hist->pkts += hist->pkts;
+	total_hist->sum += hist->sum;
+	if (hist->max > total_hist->max) {
+		total_hist->max = hist->max;
+	}
+	for (i = 0; i < RX_LATENCY_BUCKETS; i++) {
+		total_hist->buckets[i] += hist->buckets[i];
+	}
 
 }
 
 
-void log_opt_error(enum OPT_ERR option_err,
-		   const char *err_str_parm)
+/*
+ * Percentiles are the top of the histogram bucket they fall in, which can
+ * overstate them by up to 25%, though never beyond the maximum.
+ */
+unsigned long long latency_hist_percentile(const struct latency_hist *hist,
+					   const double percentile)
 {
+	unsigned long long cumulative = 0;
+	unsigned long long latency;
+	unsigned int bucket = 0;
 
 
-	log_debug_med("%s() entry\n", __func__);
+	while ((bucket < (RX_LATENCY_BUCKETS - 1)) &&
+	       ((cumulative + hist->buckets[bucket]) <
+					(hist->pkts * percentile / 100.0))) {
+		cumulative += hist->buckets[bucket];
+		bucket++;
+	}
 
-	log_prog_banner();
+	latency = rx_latency_bucket_max(bucket);
+	if (latency > hist->max) {
+		latency = hist->max;
+	}
 
-	switch (option_err) {
-	case OE_UNKNOWN_OPT:
-		log_msg(LOG_SEV_ERR, "Unknown option.\n");
-		break;
-	case OE_NO_SRC_ADDR:
-		log_msg(LOG_SEV_ERR, "No incoming address specified.\n");
-		break;
-	case OE_MULTI_SRC_ADDRS:
-		log_msg(LOG_SEV_ERR, "Too many incoming addresses.\n");
-		break;
-	case OE_NO_DST_ADDRS:
-		log_msg(LOG_SEV_ERR, "No outgoing address(es) specified.\n");
-		break;
-	case OE_SRC_GRP_ADDR:
-		log_msg(LOG_SEV_ERR, "Invalid traffic source.\n");
-		break;	
-	case OE_IF_ADDR:
-		log_msg(LOG_SEV_ERR, "Invalid interface address.\n");
-		break;
-	case OE_SRC_PORT:
-		log_msg(LOG_SEV_ERR, "Invalid or missing source port.\n");
-		break;
-	case OE_DST_PORT:
-		log_msg(LOG_SEV_ERR, "Invalid destination port.\n");
-		break;
-	case OE_INET_DST_ADDR:
-		log_msg(LOG_SEV_ERR, "Invalid IPv4 destination address.\n");
-		break;
-	case OE_INET_TX_MCTTL_RANGE:
-		log_msg(LOG_SEV_ERR, "Invalid multicast IPv4 transmit "
-			"time-to-live.\n");
-		break;
-	case OE_INET_OUT_INTF:
-		log_msg(LOG_SEV_ERR, "Invalid IPv4 multicast output "
-			"interface.\n");
-		break;
-	case OE_INET6_OUT_INTF:
-		log_msg(LOG_SEV_ERR, "Invalid IPv6 multicast output "
-			"interface.\n");
-		break;
-	case OE_INET6_DST_ADDR:
-		log_msg(LOG_SEV_ERR, "Invalid IPv6 destination address.\n");
-		break;
-	case OE_INET6_TX_HOPS_RANGE:
-		log_msg(LOG_SEV_ERR, "Invalid IPv6 transmit hop-count.\n");
-		break;
-	case OE_MEMORY_ERROR:
-		log_msg(LOG_SEV_ERR, "Fatal memory error during option "
-			"parsing.\n");
-		break;
-	case OE_UNKNOWN_ERROR:
-		log_msg(LOG_SEV_ERR, "Unknown option error.\n");
-		break;
-	default:
-		log_msg(LOG_SEV_ERR, "Option error not specified.\n");
-		break;
+	return latency;
+
+}
+
+
+/*
+ * Called once the received batch has been sent to every destination.
+ */
+void rx_batch_latency(const struct rx_batch *rx_batch,
+		      const unsigned int pkts_num,
+		      struct packet_counters *pkt_counters)
+{
+	struct timespec now;
+	unsigned long long now_nsecs;
+	unsigned int i;
+
+
+	if (!rx_batch->latency || (pkts_num == 0)) {
+		return;
 	}
 
-	log_debug_med("%s() exit\n", __func__);
+	clock_gettime(CLOCK_REALTIME, &now);
+	now_nsecs = (now.tv_sec * 1000000000ULL) + now.tv_nsec;
+
+	for (i = 0; i < pkts_num; i++) {
+		if (rx_batch->rx_nsecs[i] == 0) {
+			continue;
+		}
+		latency_hist_add(&pkt_counters->rx_latency,
+			(now_nsecs > rx_batch->rx_nsecs[i]) ?
+				now_nsecs - rx_batch->rx_nsecs[i] : 0, 1);
+	}
 
 }
 
 
-void cleanup_prog_parms(struct program_parameters *prog_parms)
+/*
+ * -rxlatency also measures each family's and each destination's latency,
+ * from the datagram's receive timestamp to its send completing.
+ */
+int init_tx_latency(struct tx_dests *tx_dests,
+		    const unsigned long long *rx_nsecs)
 {
+	struct latency_hist *dest_latency;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	if (prog_parms->inet_tx_sock_parms.dests != NULL) {
-		free(prog_parms->inet_tx_sock_parms.dests);
-		prog_parms->inet_tx_sock_parms.dests = NULL;
+	tx_dests->latency = calloc(1, sizeof(struct latency_hist));
+	dest_latency = calloc(tx_dests->dests_num + tx_dests->conn_dests_num,
+						sizeof(struct latency_hist));
+	if ((tx_dests->latency == NULL) || (dest_latency == NULL)) {
+		log_debug_low("%s(): calloc() failed\n", __func__);
+		log_debug_med("%s() exit\n", __func__);
+		errno = ENOMEM;
+		return -1;
 	}
 
-	if (prog_parms->inet6_tx_sock_parms.dests != NULL) {
-		free(prog_parms->inet6_tx_sock_parms.dests);
-		prog_parms->inet6_tx_sock_parms.dests = NULL;
-	}
+	tx_dests->rx_nsecs = rx_nsecs;
+	tx_dests->dest_latency = dest_latency;
 
 	log_debug_med("%s() exit\n", __func__);
 
+	return 0;
+
 }
 
 
-void init_sock_fds(struct socket_fds *sock_fds)
+/*
+ * Called as a send of pkts datagrams, received at rx_nsecs[0] onwards, to
+ * destinations completes. A datagram without a receive time isn't timed.
+ */
+void tx_dests_latency(struct tx_dests *tx_dests,
+		      const unsigned int dest_nums[],
+		      const unsigned int dest_num,
+		      const unsigned int sent_num,
+		      const unsigned long long rx_nsecs[],
+		      const unsigned int pkts)
 {
+	struct timespec now;
+	unsigned long long latency;
+	unsigned int pkt_num;
+	unsigned int i;
 
-	sock_fds->inet_in_sock_fd = -1;
-	sock_fds->inet6_in_sock_fd = -1;
-	sock_fds->inet_out_sock_fd = -1;
-	sock_fds->inet6_out_sock_fd = -1;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	tx_dests->sent_nsecs = (now.tv_sec * 1000000000ULL) + now.tv_nsec;
+
+	for (pkt_num = 0; pkt_num < pkts; pkt_num++) {
+		if (rx_nsecs[pkt_num] == 0) {
+			continue;
+		}
+		latency = (tx_dests->sent_nsecs > rx_nsecs[pkt_num]) ?
+				tx_dests->sent_nsecs - rx_nsecs[pkt_num] : 0;
+		for (i = dest_num; i < (dest_num + sent_num); i++) {
+			latency_hist_add(&tx_dests->dest_latency[
+				(dest_nums != NULL) ? dest_nums[i] : i],
+				latency, 1);
+		}
+	}
 
 }
 
 
-void inet_to_inet_rcast(int *inet_in_sock_fd,
-			const struct inet_rx_sock_params *rx_sock_parms,
-			int *inet_out_sock_fd,
-			const struct inet_tx_sock_params *tx_sock_parms,
-			struct packet_counters *pkt_counters)
+/*
+ * Called once datagrams received at rx_nsecs have been sent to the
+ * family's destinations, the last send completing at sent_nsecs.
+ */
+void tx_family_latency(struct tx_dests *tx_dests,
+		       const unsigned long long rx_nsecs,
+		       const unsigned int pkts)
 {
-	uint8_t pkt_buf[PKT_BUF_SIZE];
-	ssize_t rx_pkt_len;
-	int txed_pkts;
 
 
-	log_debug_med("%s() entry\n", __func__);
+	latency_hist_add(tx_dests->latency,
+		(tx_dests->sent_nsecs > rx_nsecs) ?
+				tx_dests->sent_nsecs - rx_nsecs : 0, pkts);
 
-	*inet_in_sock_fd = open_inet_rx_sock(rx_sock_parms);
-	if (*inet_in_sock_fd == -1) {
-		exit_errno(__func__, __LINE__, errno);
+}
+
+
+/*
+ * A connected destination is sent a run of the batch at once, each
+ * datagram with its own receive time.
+ */
+void tx_conn_dest_latency(struct tx_dests *tx_dests,
+			  const unsigned int dest_num,
+			  const struct iovec pkts[],
+			  const struct mmsghdr mmsgs[],
+			  const unsigned int sent_num)
+{
+	struct timespec now;
+	unsigned long long rx_nsecs;
+	unsigned int i;
+
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	tx_dests->sent_nsecs = (now.tv_sec * 1000000000ULL) + now.tv_nsec;
+
+	for (i = 0; i < sent_num; i++) {
+		rx_nsecs = tx_dests->rx_nsecs[mmsgs[i].msg_hdr.msg_iov - pkts];
+		if (rx_nsecs == 0) {
+			continue;
+		}
+		latency_hist_add(&tx_dests->dest_latency[dest_num],
+			(tx_dests->sent_nsecs > rx_nsecs) ?
+				tx_dests->sent_nsecs - rx_nsecs : 0, 1);
 	}
 
-	*inet_out_sock_fd = open_inet_tx_sock(tx_sock_parms);
-	if (*inet_out_sock_fd == -1) {
-		exit_errno(__func__, __LINE__, errno);
+}
+
+
+int rx_batch_xsk_recv(const int sock_fd,
+		      struct rx_batch *rx_batch,
+		      struct packet_counters *pkt_counters)
+{
+	struct pollfd rx_fds[2];
+	unsigned int frames_num;
+	unsigned int pkts_num = 0;
+	unsigned int i;
+	int rx_pkts;
+	int ret;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	/*
+	 * The previous batch's frames have been transmitted by now, so they
+	 * can go back on the fill ring.
+	 */
+	xsk_rx_release(rx_batch->xsk);
+
+	frames_num = xsk_rx(rx_batch->xsk, rx_batch->xsk_frames,
+								XDP_RX_BATCH);
+	if (frames_num == 0) {
+		rx_fds[0].fd = rx_batch->xsk->sock_fd;
+		rx_fds[0].events = POLLIN;
+		rx_fds[1].fd = sock_fd;
+		rx_fds[1].events = POLLIN;
+
+		ret = poll(rx_fds, 2, -1);
+		if (ret <= 0) {
+			log_debug_med("%s() exit\n", __func__);
+			return 0;
+		}
+		pkt_counters->xdp_rx_polls++;
+
+		if (rx_fds[1].revents & POLLIN) {
+			rx_pkts = rx_batch_sock_recv(sock_fd, rx_batch,
+								pkt_counters);
+			pkt_counters->xdp_stack_pkts += rx_pkts;
+			log_debug_med("%s() exit\n", __func__);
+			return rx_pkts;
+		}
+
+		frames_num = xsk_rx(rx_batch->xsk, rx_batch->xsk_frames,
+								XDP_RX_BATCH);
 	}
 
-	for ( ;; ) {
-		rx_pkt_len = recv(*inet_in_sock_fd, pkt_buf, PKT_BUF_SIZE, 0);
-		log_debug_low("%s(): recv() == %d\n", __func__, rx_pkt_len);
-		log_debug_low("%s(): errno == %d, %s\n", __func__, errno,
-							strerror(errno));
-		if (rx_pkt_len > 0) {
-			pkt_counters->inet_in_pkts++;
-			txed_pkts = inet_tx_rcast(*inet_out_sock_fd, pkt_buf,
-				rx_pkt_len, tx_sock_parms->dests);
-			pkt_counters->inet_out_pkts += txed_pkts;
+	for (i = 0; i < frames_num; i++) {
+		if (xsk_udp_payload(&rx_batch->xsk_frames[i],
+					&rx_batch->pkts[pkts_num]) == 0) {
+			pkts_num++;
 		}
 	}
 
+	pkt_counters->xdp_rx_pkts += pkts_num;
+
 	log_debug_med("%s() exit\n", __func__);
 
+	return pkts_num;
+
 }
 
 
-void inet_to_inet6_rcast(int *inet_in_sock_fd,
-			 const struct inet_rx_sock_params *rx_sock_parms,
-			 int *inet6_out_sock_fd,
-			 const struct inet6_tx_sock_params *tx_sock_parms,
-			 struct packet_counters *pkt_counters)
+
+int rx_batch_pkt_ring_recv(struct rx_batch *rx_batch,
+			   struct packet_counters *pkt_counters)
 {
-	uint8_t pkt_buf[PKT_BUF_SIZE];
-	ssize_t rx_pkt_len;
-	int txed_pkts;
+	struct pollfd rx_fd;
+	unsigned int blocks_done;
+	unsigned int rx_pkts;
+	unsigned int pkts_num = 0;
+	unsigned int i;
+	int ret;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	*inet_in_sock_fd = open_inet_rx_sock(rx_sock_parms);
-	if (*inet_in_sock_fd == -1) {
-		exit_errno(__func__, __LINE__, errno);
+	rx_pkts = pktring_rx(rx_batch->pkt_ring, rx_batch->ring_pkts,
+				PKT_RING_RX_BATCH, &blocks_done);
+
+	/*
+	 * The kernel's ring statistics are read each time a block is handed
+	 * back, so they keep up with the ring without a system call per
+	 * packet.
+	 */
+	if (blocks_done > 0) {
+		pkt_counters->pkt_ring_blocks += blocks_done;
+		update_pkt_ring_counters(rx_batch->pkt_ring, pkt_counters);
 	}
 
-	*inet6_out_sock_fd = open_inet6_tx_sock(tx_sock_parms);
-	if (*inet6_out_sock_fd == -1) {
-		exit_errno(__func__, __LINE__, errno);
+	if (rx_pkts == 0) {
+		rx_fd.fd = rx_batch->pkt_ring->sock_fd;
+		rx_fd.events = POLLIN;
+
+		ret = poll(&rx_fd, 1, -1);
+		if (ret <= 0) {
+			log_debug_med("%s() exit\n", __func__);
+			return 0;
+		}
+
+		rx_pkts = pktring_rx(rx_batch->pkt_ring, rx_batch->ring_pkts,
+					PKT_RING_RX_BATCH, &blocks_done);
 	}
 
-	for ( ;; ) {
-		rx_pkt_len = recv(*inet_in_sock_fd, pkt_buf, PKT_BUF_SIZE, 0);
-		log_debug_low("%s(): recv() == %d\n", __func__, rx_pkt_len);
-		log_debug_low("%s(): errno == %d, %s\n", __func__, errno,
-							strerror(errno));
-		if (rx_pkt_len > 0) {
-			pkt_counters->inet_in_pkts++;
-			txed_pkts = inet6_tx_rcast(*inet6_out_sock_fd,
-				pkt_buf, rx_pkt_len, tx_sock_parms->dests);
-			pkt_counters->inet6_out_pkts += txed_pkts;
+	for (i = 0; i < rx_pkts; i++) {
+		if (pktring_udp_payload(&rx_batch->ring_pkts[i],
+					&rx_batch->pkts[pkts_num]) == 0) {
+			pkts_num++;
 		}
 	}
 
+	pkt_counters->pkt_ring_pkts += pkts_num;
+
 	log_debug_med("%s() exit\n", __func__);
 
+	return pkts_num;
+
 }
 
 
-void inet_to_inet_inet6_rcast(int *inet_in_sock_fd,
-			      const struct inet_rx_sock_params *rx_sock_parms,
-			      int *inet_out_sock_fd,
-			      const struct inet_tx_sock_params
-							*inet_tx_sock_parms,
-			      int *inet6_out_sock_fd,
-			      const struct inet6_tx_sock_params
-							*inet6_tx_sock_parms,
+void update_pkt_ring_counters(const struct pktring *pkt_ring,
 			      struct packet_counters *pkt_counters)
 {
-	uint8_t pkt_buf[PKT_BUF_SIZE];
-	ssize_t rx_pkt_len;
-	int txed_inet_pkts;
-	int txed_inet6_pkts;
+	struct tpacket_stats_v3 ring_stats;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	*inet_in_sock_fd = open_inet_rx_sock(rx_sock_parms);
-	if (*inet_in_sock_fd == -1) {
-		exit_errno(__func__, __LINE__, errno);
+	/*
+	 * Reading the statistics resets them, so they are accumulated.
+	 */
+	if (pktring_stats(pkt_ring, &ring_stats) == 0) {
+		pkt_counters->pkt_ring_kernel_pkts += ring_stats.tp_packets;
+		pkt_counters->pkt_ring_drops += ring_stats.tp_drops;
+		pkt_counters->pkt_ring_freezes += ring_stats.tp_freeze_q_cnt;
 	}
 
-	*inet_out_sock_fd = open_inet_tx_sock(inet_tx_sock_parms);
-	if (*inet_out_sock_fd == -1) {
-		exit_errno(__func__, __LINE__, errno);
-	}
+	log_debug_med("%s() exit\n", __func__);
 
-	*inet6_out_sock_fd = open_inet6_tx_sock(inet6_tx_sock_parms);
-	if (*inet6_out_sock_fd == -1) {
-		exit_errno(__func__, __LINE__, errno);
-	}
+}
 
-	for ( ;; ) {
-		rx_pkt_len = recv(*inet_in_sock_fd, pkt_buf, PKT_BUF_SIZE, 0);
-		log_debug_low("%s(): recv() == %d\n", __func__, rx_pkt_len);
-		log_debug_low("%s(): errno == %d, %s\n", __func__, errno,
-							strerror(errno));
-		if (rx_pkt_len > 0) {
-			pkt_counters->inet_in_pkts++;
-			txed_inet_pkts = inet_tx_rcast(*inet_out_sock_fd,
-				pkt_buf, rx_pkt_len, inet_tx_sock_parms->dests);
-			pkt_counters->inet_out_pkts += txed_inet_pkts;
-			txed_inet6_pkts = inet6_tx_rcast(*inet6_out_sock_fd,
-				pkt_buf, rx_pkt_len,
-				inet6_tx_sock_parms->dests);
-			pkt_counters->inet6_out_pkts += txed_inet6_pkts;
+
+unsigned int rx_batch_split_gro(struct rx_batch *rx_batch,
+				const unsigned int rx_msgs,
+				struct packet_counters *pkt_counters)
+{
+	struct cmsghdr *cmsg;
+	uint8_t *msg_buf;
+	size_t msg_len;
+	size_t seg_size;
+	int gso_size;
+	unsigned long long rx_nsecs = 0;
+	unsigned int pkts_num = 0;
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	/*
+	 * A coalesced buffer carries its segment size in a UDP_GRO control
+	 * message. Every segment is that size except possibly the last.
+	 */
+	for (i = 0; i < rx_msgs; i++) {
+		msg_buf = rx_batch->iovs[i].iov_base;
+		msg_len = rx_batch->mmsgs[i].msg_len;
+		seg_size = msg_len;
+		if (msg_len == 0) {
+			continue;
+		}
+
+		for (cmsg = CMSG_FIRSTHDR(&rx_batch->mmsgs[i].msg_hdr);
+		     cmsg != NULL;
+		     cmsg = CMSG_NXTHDR(&rx_batch->mmsgs[i].msg_hdr, cmsg)) {
+			if ((cmsg->cmsg_level == SOL_UDP) &&
+			    (cmsg->cmsg_type == UDP_GRO)) {
+				memcpy(&gso_size, CMSG_DATA(cmsg),
+					sizeof(gso_size));
+				if ((gso_size > 0) && (gso_size < msg_len)) {
+					seg_size = gso_size;
+				}
+			}
+		}
+
+		if (seg_size < msg_len) {
+			pkt_counters->rx_gro_bufs++;
+			pkt_counters->rx_gro_segs += (msg_len + seg_size - 1) /
+								seg_size;
+		}
+
+		/* the segments share the buffer's receive time */
+		if (rx_batch->tstamps) {
+			rx_nsecs = rx_tstamp_nsecs(&rx_batch->rx_tstamps[i]);
+		}
+
+		while (msg_len > seg_size) {
+			rx_batch->pkts[pkts_num].iov_base = msg_buf;
+			rx_batch->pkts[pkts_num].iov_len = seg_size;
+			if (rx_batch->tstamps) {
+				rx_batch->rx_nsecs[pkts_num] = rx_nsecs;
+			}
+			pkts_num++;
+			msg_buf += seg_size;
+			msg_len -= seg_size;
 		}
+		rx_batch->pkts[pkts_num].iov_base = msg_buf;
+		rx_batch->pkts[pkts_num].iov_len = msg_len;
+		if (rx_batch->tstamps) {
+			rx_batch->rx_nsecs[pkts_num] = rx_nsecs;
+		}
+		pkts_num++;
 	}
 
 	log_debug_med("%s() exit\n", __func__);
 
+	return pkts_num;
+
 }
 
 
-void inet6_to_inet6_rcast(int *inet6_in_sock_fd,
-			  const struct inet6_rx_sock_params *rx_sock_parms,
-			  int *inet6_out_sock_fd,
-			  const struct inet6_tx_sock_params *tx_sock_parms,
-			  struct packet_counters *pkt_counters)
+int uring_rcast(const int rx_sock_fd,
+		unsigned long long *in_pkts,
+		const struct uring_tx_leg tx_legs[],
+		const unsigned int tx_legs_num,
+		struct packet_counters *pkt_counters)
 {
-	uint8_t pkt_buf[PKT_BUF_SIZE];
-	ssize_t rx_pkt_len;
-	int txed_pkts;
+	struct uring ring;
+	struct uring_buf_ring buf_ring;
+	uint8_t *bufs;
+	unsigned int buf_refs[URING_BUFS_NUM];
+	unsigned int bufs_avail = URING_BUFS_NUM;
+	unsigned int bufs_freed;
+	unsigned int dests_num = 0;
+	unsigned int recv_armed = 0;
+	unsigned int recv_pkts = 0;
+	unsigned int recv_errs = 0;
+	int recv_stop_err = 0;
+	struct io_uring_cqe *cqe;
+	unsigned long long user_data;
+	unsigned int cqe_flags;
+	int cqe_res;
+	unsigned short bid;
+	unsigned int leg;
+	unsigned int i;
+	int ret;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	*inet6_in_sock_fd = open_inet6_rx_sock(rx_sock_parms);
-	if (*inet6_in_sock_fd == -1) {
-		exit_errno(__func__, __LINE__, errno);
+	for (leg = 0; leg < tx_legs_num; leg++) {
+		dests_num += tx_legs[leg].tx_dests->dests_num;
 	}
 
-	*inet6_out_sock_fd = open_inet6_tx_sock(tx_sock_parms);
-	if (*inet6_out_sock_fd == -1) {
-		exit_errno(__func__, __LINE__, errno);
+	bufs = malloc(URING_BUFS_NUM * PKT_BUF_SIZE);
+	if (bufs == NULL) {
+		errno = ENOMEM;
+		ret = -1;
+	} else {
+		ret = uring_init(&ring, URING_ENTRIES);
+	}
+
+	if ((ret == 0) && (uring_buf_ring_init(&ring, &buf_ring,
+				URING_BUFS_NUM, URING_BUF_GROUP) == -1)) {
+		ret = errno;
+		uring_exit(&ring);
+		errno = ret;
+		ret = -1;
+	}
+
+	if (ret == -1) {
+		log_msg(LOG_SEV_WARNING, "io_uring engine unavailable (%s), "
+			"using loop engine.\n", strerror(errno));
+		free(bufs);
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
 	}
 
+	for (i = 0; i < URING_BUFS_NUM; i++) {
+		buf_refs[i] = 0;
+		uring_buf_ring_add(&buf_ring, &bufs[i * PKT_BUF_SIZE],
+							PKT_BUF_SIZE, i);
+	}
+	uring_buf_ring_advance(&buf_ring);
+
+	/*
+	 * A single multishot receive hands each datagram over in one of the
+	 * provided buffers. Each datagram then gets a send per destination,
+	 * and its buffer is given back to the kernel once the last of those
+	 * sends completes. Submitting the sends and collecting both the sends'
+	 * and the receives' completions all happen in the one
+	 * io_uring_enter() call, so many packets and destinations share each
+	 * system call.
+	 *
+	 * The receive stops when it runs out of buffers, so it is only
+	 * re-armed once some have been given back.
+	 *
+	 * A kernel that has provided buffer rings (5.19) but not multishot
+	 * receives (6.0) fails the first receive with EINVAL, so that, or a
+	 * run of failed receives with no datagram between them, hands over
+	 * to the loop engine rather than re-arming for ever. The sends in
+	 * flight are completed first, as their buffers go with the io_uring.
+	 */
 	for ( ;; ) {
-		rx_pkt_len = recv(*inet6_in_sock_fd, pkt_buf, PKT_BUF_SIZE, 0);
-		log_debug_low("%s(): recv() == %d\n", __func__, rx_pkt_len);
-		log_debug_low("%s(): errno == %d, %s\n", __func__, errno,
-							strerror(errno));
-		if (rx_pkt_len > 0) {
-			pkt_counters->inet6_in_pkts++;
-			txed_pkts = inet6_tx_rcast(*inet6_out_sock_fd,
-				pkt_buf, rx_pkt_len, tx_sock_parms->dests);
-			pkt_counters->inet6_out_pkts += txed_pkts;
+		if (!recv_armed && (recv_stop_err != 0)) {
+			if (bufs_avail == URING_BUFS_NUM) {
+				break;
+			}
+		} else if (!recv_armed && (bufs_avail > 0)) {
+			while (uring_recv_arm(&ring, rx_sock_fd) == -1) {
+				uring_submit(&ring, 0, pkt_counters);
+			}
+			recv_armed = 1;
+		}
+
+		uring_submit(&ring, 1, pkt_counters);
+
+		bufs_freed = 0;
+
+		while ((cqe = uring_peek_cqe(&ring)) != NULL) {
+			user_data = cqe->user_data;
+			cqe_res = cqe->res;
+			cqe_flags = cqe->flags;
+			uring_cqe_seen(&ring);
+			pkt_counters->uring_cqes++;
+
+			if (URING_UD_LEG(user_data) > 0) {
+				leg = URING_UD_LEG(user_data) - 1;
+				bid = URING_UD_BID(user_data);
+				if (cqe_res >= 0) {
+					(*tx_legs[leg].out_pkts)++;
+					tx_dest_sent(tx_legs[leg].tx_dests,
+						URING_UD_DEST(user_data), 1,
+						cqe_res);
+				} else {
+					tx_dest_failed(tx_legs[leg].tx_dests,
+						URING_UD_DEST(user_data),
+						-cqe_res);
+				}
+				buf_refs[bid]--;
+				if (buf_refs[bid] == 0) {
+					uring_buf_ring_add(&buf_ring,
+						&bufs[bid * PKT_BUF_SIZE],
+						PKT_BUF_SIZE, bid);
+					bufs_freed++;
+				}
+				continue;
+			}
+
+			if (!(cqe_flags & IORING_CQE_F_MORE)) {
+				recv_armed = 0;
+			}
+
+			/* ENOBUFS is the receive running out of buffers */
+			if ((cqe_res < 0) && (cqe_res != -ENOBUFS)) {
+				pkt_counters->uring_recv_errs++;
+				if ((recv_pkts == 0) &&
+				    ((cqe_res == -EINVAL) ||
+				     (cqe_res == -EOPNOTSUPP))) {
+					recv_stop_err = -cqe_res;
+				} else if (recv_errs == 0) {
+					log_msg(LOG_SEV_WARNING, "io_uring "
+						"receive failed (%s).\n",
+						strerror(-cqe_res));
+				}
+				recv_errs++;
+				if (recv_errs >= URING_RECV_ERRS_MAX) {
+					recv_stop_err = -cqe_res;
+				}
+			}
+
+			if ((cqe_res < 0) ||
+			    !(cqe_flags & IORING_CQE_F_BUFFER)) {
+				continue;
+			}
+
+			recv_pkts = 1;
+			recv_errs = 0;
+			(*in_pkts)++;
+			pkt_counters->rx_bytes += cqe_res;
+			bufs_avail--;
+
+			bid = cqe_flags >> IORING_CQE_BUFFER_SHIFT;
+			buf_refs[bid] = dests_num;
+
+			for (leg = 0; leg < tx_legs_num; leg++) {
+				uring_dests_send(&ring, &tx_legs[leg], leg,
+					&bufs[bid * PKT_BUF_SIZE], cqe_res,
+					bid, pkt_counters);
+			}
+		}
+
+		if (bufs_freed > 0) {
+			uring_buf_ring_advance(&buf_ring);
+			bufs_avail += bufs_freed;
 		}
 	}
 
-	log_debug_med("\t%s() exit\n", __func__);
+	uring_exit(&ring);
+	uring_buf_ring_exit(&buf_ring);
+	free(bufs);
+
+	log_msg(LOG_SEV_WARNING, "io_uring engine unavailable (%s), "
+		"using loop engine.\n", strerror(recv_stop_err));
+
+	log_debug_med("%s() exit\n", __func__);
+
+	errno = recv_stop_err;
+	return -1;
 
 }
 
 
-void inet6_to_inet_rcast(int *inet6_in_sock_fd,
-			 const struct inet6_rx_sock_params *rx_sock_parms,
-			 int *inet_out_sock_fd,
-			 const struct inet_tx_sock_params *tx_sock_parms,
-			 struct packet_counters *pkt_counters)
+void uring_submit(struct uring *ring,
+		  const unsigned int wait_nr,
+		  struct packet_counters *pkt_counters)
 {
-	uint8_t pkt_buf[PKT_BUF_SIZE];
-	ssize_t rx_pkt_len;
-	int txed_pkts;
+	int ret;
 
 
-	log_debug("%s() entry\n", __func__);
+	log_debug_med("%s() entry\n", __func__);
 
-	*inet6_in_sock_fd = open_inet6_rx_sock(rx_sock_parms);
-	if (*inet6_in_sock_fd == -1) {
-		exit_errno(__func__, __LINE__, errno);
+	ret = uring_enter(ring, wait_nr);
+	if (ret == -1) {
+		if (errno != EINTR) {
+			exit_errno(__func__, __LINE__, errno);
+		}
+	} else {
+		pkt_counters->uring_enters++;
+		pkt_counters->uring_sqes += ret;
 	}
 
-	*inet_out_sock_fd = open_inet_tx_sock(tx_sock_parms);
-	if (*inet_out_sock_fd == -1) {
-		exit_errno(__func__, __LINE__, errno);
-	}
+	log_debug_med("%s() exit\n", __func__);
 
-	for ( ;; ) {
-		rx_pkt_len = recv(*inet6_in_sock_fd, pkt_buf, PKT_BUF_SIZE, 0);
-		log_debug_low("%s(): recv() == %d\n", __func__, rx_pkt_len);
-		log_debug_low("%s(): errno == %d, %s\n", __func__, errno,
-							strerror(errno));
-		if (rx_pkt_len > 0) {
-			pkt_counters->inet6_in_pkts++;
-			txed_pkts = inet_tx_rcast(*inet_out_sock_fd, pkt_buf,
-				rx_pkt_len, tx_sock_parms->dests);
-			pkt_counters->inet_out_pkts += txed_pkts;
+}
+
+
+void uring_dests_send(struct uring *ring,
+		      const struct uring_tx_leg *tx_leg,
+		      const unsigned int leg,
+		      void *pkt,
+		      const unsigned int pkt_len,
+		      const unsigned short bid,
+		      struct packet_counters *pkt_counters)
+{
+	const struct msghdr *dest_msg;
+	struct io_uring_sqe *sqe;
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	for (i = 0; i < tx_leg->tx_dests->dests_num; i++) {
+		dest_msg = &tx_leg->tx_dests->mmsgs[i].msg_hdr;
+
+		sqe = uring_get_sqe(ring);
+		while (sqe == NULL) {
+			uring_submit(ring, 0, pkt_counters);
+			sqe = uring_get_sqe(ring);
 		}
+
+		sqe->opcode = IORING_OP_SEND;
+		sqe->fd = tx_leg->sock_fd;
+		sqe->addr = (unsigned long)pkt;
+		sqe->len = pkt_len;
+		sqe->addr2 = (unsigned long)dest_msg->msg_name;
+		sqe->addr_len = dest_msg->msg_namelen;
+		sqe->user_data = URING_UD(leg + 1, i, bid);
 	}
 
+	log_debug_med("%s() exit\n", __func__);
+
 }
 
-void inet6_to_inet_inet6_rcast(int *inet6_in_sock_fd,
-			       const struct inet6_rx_sock_params *rx_sock_parms,
-			       int *inet_out_sock_fd,
-			       const struct inet_tx_sock_params
-							*inet_tx_sock_parms,
-			       int *inet6_out_sock_fd,
-			       const struct inet6_tx_sock_params
-							*inet6_tx_sock_parms,
-			       struct packet_counters *pkt_counters)
+
+int uring_recv_arm(struct uring *ring,
+		   const int rx_sock_fd)
 {
-	uint8_t pkt_buf[PKT_BUF_SIZE];
-	ssize_t rx_pkt_len;
-	int txed_inet_pkts;
-	int txed_inet6_pkts;
+	struct io_uring_sqe *sqe;
 
 
-	log_debug("%s() entry\n", __func__);
+	log_debug_med("%s() entry\n", __func__);
 
-	*inet6_in_sock_fd = open_inet6_rx_sock(rx_sock_parms);
-	if (*inet6_in_sock_fd == -1) {
-		exit_errno(__func__, __LINE__, errno);
+	sqe = uring_get_sqe(ring);
+	if (sqe == NULL) {
+		log_debug_med("%s() exit\n", __func__);
+		return -1;
 	}
 
-	*inet_out_sock_fd = open_inet_tx_sock(inet_tx_sock_parms);
-	if (*inet_out_sock_fd == -1) {
-		exit_errno(__func__, __LINE__, errno);
-	}
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = rx_sock_fd;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BUF_GROUP;
+	sqe->user_data = 0;
 
-	*inet6_out_sock_fd = open_inet6_tx_sock(inet6_tx_sock_parms);
-	if (*inet6_out_sock_fd == -1) {
-		exit_errno(__func__, __LINE__, errno);
-	}
+	log_debug_med("%s() exit\n", __func__);
 
-	for ( ;; ) {
-		rx_pkt_len = recv(*inet6_in_sock_fd, pkt_buf, PKT_BUF_SIZE, 0);
-		log_debug_low("%s(): recv() == %d\n", __func__, rx_pkt_len);
-		log_debug_low("%s(): errno == %d, %s\n", __func__, errno,
-							strerror(errno));
-		if (rx_pkt_len > 0) {
-			pkt_counters->inet6_in_pkts++;
-			txed_inet_pkts = inet_tx_rcast(*inet_out_sock_fd,
-				pkt_buf, rx_pkt_len, inet_tx_sock_parms->dests);
-			pkt_counters->inet_out_pkts += txed_inet_pkts;
-			txed_inet6_pkts = inet6_tx_rcast(*inet6_out_sock_fd,
-				pkt_buf, rx_pkt_len,
-				inet6_tx_sock_parms->dests);
-			pkt_counters->inet6_out_pkts += txed_inet6_pkts;
-		}
-	}
+	return 0;
 
 }
 
 
-void exit_errno(const char *func_name, const unsigned int linenum, int errnum)
+
+/*
+ * The pipe engine's receive thread copies each datagram into a buffer shared
+ * with the transmit threads, and pushes a descriptor of it into each of
+ * their rings, so that IPv4 and IPv6 transmission proceed in parallel and a
+ * slow family doesn't hold up the other. A datagram is dropped for a family
+ * whose ring is full, and for all of them if the buffer is full.
+ */
+void pipe_rcast(const int rx_sock_fd,
+		struct rx_batch *rx_batch,
+		unsigned long long *in_pkts,
+		unsigned long long *in_drops,
+		struct pipe_tx_leg tx_legs[],
+		struct packet_counters *pkt_counters)
 {
+	uint8_t *buf;
+	unsigned long long buf_head = 0;
+	int rx_pkts;
+	int i;
 
 
-	log_debug("%s() entry\n", __func__);
+	log_debug_med("%s() entry\n", __func__);
 
-	log_msg(LOG_SEV_ERR, "%s():%d error: %s\n", func_name, linenum,
-		strerror(errnum));
+	buf = calloc(1, PIPE_BUF_SIZE);
+	if (buf == NULL) {
+		exit_errno(__func__, __LINE__, ENOMEM);
+	}
 
-	log_debug("%s() exit\n", __func__);
+	pipe_tx_legs_start(tx_legs, buf);
 
-	exit(EXIT_FAILURE);
+	for ( ;; ) {
+		rx_pkts = rx_batch_recv(rx_sock_fd, rx_batch, pkt_counters);
+		*in_pkts += rx_pkts;
+		*in_drops = rx_batch->rx_drops;
+		for (i = 0; i < rx_pkts; i++) {
+			pipe_pkt_push(&rx_batch->pkts[i], buf, &buf_head,
+							tx_legs, pkt_counters);
+		}
+		if (rx_pkts > 0) {
+			for (i = 0; i < PIPE_TX_LEGS; i++) {
+				spsc_ring_wake(&tx_legs[i].ring);
+			}
+		}
+	}
+
+	log_debug_med("%s() exit\n", __func__);
 
 }
 
 
-void init_packet_counters(struct packet_counters *pkt_counters)
+void pipe_tx_legs_start(struct pipe_tx_leg tx_legs[],
+			const uint8_t *buf)
 {
+	sigset_t all_sigs;
+	sigset_t old_sigs;
+	unsigned int i;
+	int ret;
 
 
-	pkt_counters->inet_in_pkts = 0;
-	pkt_counters->inet_out_pkts = 0;
-	pkt_counters->inet6_in_pkts = 0;
-	pkt_counters->inet6_out_pkts = 0;
+	log_debug_med("%s() entry\n", __func__);
+
+	sigfillset(&all_sigs);
+	pthread_sigmask(SIG_SETMASK, &all_sigs, &old_sigs);
+
+	for (i = 0; i < PIPE_TX_LEGS; i++) {
+		if (spsc_ring_init(&tx_legs[i].ring, PIPE_RING_SIZE) == -1) {
+			exit_errno(__func__, __LINE__, errno);
+		}
+		tx_legs[i].buf = buf;
+
+		ret = pthread_create(&tx_legs[i].thread, NULL, pipe_tx_thread,
+								&tx_legs[i]);
+		if (ret != 0) {
+			exit_errno(__func__, __LINE__, ret);
+		}
+
+		rt_thread_setup(tx_legs[i].thread,
+			(i == 0) ? "inet tx" : "inet6 tx",
+			rt_cpu(prog_parms.tx_cpus, prog_parms.tx_cpus_num, i),
+			prog_parms.rt_prio);
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old_sigs, NULL);
+
+	log_debug_med("%s() exit\n", __func__);
 
 }
 
 
-void daemonise(void)
+void pipe_pkt_push(const struct iovec *pkt,
+		   uint8_t *buf,
+		   unsigned long long *buf_head,
+		   struct pipe_tx_leg tx_legs[],
+		   struct packet_counters *pkt_counters)
 {
+	const struct spsc_desc *oldest;
+	struct spsc_desc desc;
+	unsigned long long buf_tail;
+	unsigned int buf_offset;
+	unsigned int used;
+	unsigned int i;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	create_child_process();
+	/*
+	 * Datagrams are kept contiguous, skipping the end of the buffer if
+	 * one doesn't fit there.
+	 */
+	desc.offset = *buf_head;
+	desc.len = pkt->iov_len;
+	buf_offset = desc.offset % PIPE_BUF_SIZE;
+	if ((buf_offset + desc.len) > PIPE_BUF_SIZE) {
+		desc.offset += PIPE_BUF_SIZE - buf_offset;
+		buf_offset = 0;
+	}
 
-	create_new_session();
+	/*
+	 * The buffer space still in use starts at the oldest datagram any
+	 * transmit thread hasn't finished with.
+	 */
+	buf_tail = *buf_head;
+	for (i = 0; i < PIPE_TX_LEGS; i++) {
+		oldest = spsc_ring_oldest(&tx_legs[i].ring);
+		if ((oldest != NULL) && (oldest->offset < buf_tail)) {
+			buf_tail = oldest->offset;
+		}
+	}
 
-	change_to_rootdir();
+	if ((desc.offset + desc.len - buf_tail) > PIPE_BUF_SIZE) {
+		pkt_counters->pipe_buf_full++;
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
 
-	open_syslog_log();
+	memcpy(&buf[buf_offset], pkt->iov_base, desc.len);
+	*buf_head = desc.offset + desc.len;
 
-	close_stdfiles();
+	for (i = 0; i < PIPE_TX_LEGS; i++) {
+		if (spsc_ring_push(&tx_legs[i].ring, &desc) == -1) {
+			pkt_counters->pipe_ring_full[i]++;
+		} else {
+			used = spsc_ring_used(&tx_legs[i].ring);
+			if (used > pkt_counters->pipe_ring_hwm[i]) {
+				pkt_counters->pipe_ring_hwm[i] = used;
+			}
+		}
+	}
 
 	log_debug_med("%s() exit\n", __func__);
 
 }
 
 
-void create_child_process(void)
+void *pipe_tx_thread(void *arg)
 {
-	pid_t pid;
+	struct pipe_tx_leg *tx_leg = arg;
+	const struct spsc_desc *descs[PIPE_TX_BATCH];
+	struct iovec pkts[PIPE_TX_BATCH];
+	unsigned int descs_num;
+	unsigned int i;
+	int txed_pkts;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	pid = fork();
-	if (pid < 0) {
-		exit_errno(__func__, __LINE__, errno);
-	} else if (pid > 0) {
-		exit(EXIT_SUCCESS);
+	for ( ;; ) {
+		descs_num = spsc_ring_peek(&tx_leg->ring, descs,
+							PIPE_TX_BATCH);
+		if (descs_num == 0) {
+			spsc_ring_wait(&tx_leg->ring);
+			continue;
+		}
+
+		for (i = 0; i < descs_num; i++) {
+			pkts[i].iov_base = (void *)&tx_leg->buf[
+					descs[i]->offset % PIPE_BUF_SIZE];
+			pkts[i].iov_len = descs[i]->len;
+		}
+
+		txed_pkts = tx_dests_rcast(tx_leg->sock_fd, pkts, descs_num,
+					tx_leg->tx_dests, tx_leg->pkt_counters);
+		*tx_leg->out_pkts += txed_pkts;
+
+		/*
+		 * Only now that they're sent can the receive thread reuse
+		 * the datagrams' buffer space.
+		 */
+		spsc_ring_release(&tx_leg->ring, descs_num);
 	}
 
 	log_debug_med("%s() exit\n", __func__);
 
+	return NULL;
+
 }
 
 
-void create_new_session(void)
+void close_sockets(const struct socket_fds *sock_fds)
 {
-	pid_t sid;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	sid = setsid();
-	if (sid < 0) {
-		exit_errno(__func__, __LINE__, errno);
-	}
+	close_inet_rx_sock(sock_fds->inet_in_sock_fd);
+	close_inet6_rx_sock(sock_fds->inet6_in_sock_fd);
+	close_inet_tx_sock(sock_fds->inet_out_sock_fd);
+	close_inet6_tx_sock(sock_fds->inet6_out_sock_fd);
+	close_xdp_sock(sock_fds->xdp_sock_fd);
 
 	log_debug_med("%s() exit\n", __func__);
 
 }
 
 
-void change_to_rootdir(void)
+void close_flows(void)
 {
+	unsigned int i;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	if ((chdir("/")) < 0) {
-		exit_errno(__func__, __LINE__, errno);
+	if (flows == NULL) {
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
+
+	for (i = 0; i < prog_parms.flows_num; i++) {
+		if (flows[i].rx_sock_fd != -1) {
+			close(flows[i].rx_sock_fd);
+		}
+		close_inet_tx_sock(flows[i].inet_out_sock_fd);
+		close_inet6_tx_sock(flows[i].inet6_out_sock_fd);
 	}
 
 	log_debug_med("%s() exit\n", __func__);
@@ -2061,363 +12090,531 @@ void change_to_rootdir(void)
 }
 
 
-void open_syslog_log(void)
+
+void sum_packet_counters(struct packet_counters *total_counters)
 {
-	pid_t daemon_pid;
+	unsigned int i;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	daemon_pid = getpid();
+	*total_counters = pkt_counters;
 
-	snprintf(syslog_ident, syslog_ident_len, "%s[%d]", program_name,
-		daemon_pid);
-	syslog_ident[syslog_ident_len - 1] = '\0';
+	for (i = 0; i < PIPE_TX_LEGS; i++) {
+		add_packet_counters(total_counters, &pipe_tx_counters[i]);
+	}
 
-	log_open(LOG_DEST_SYSLOG, syslog_ident, LOG_SYSLOG_DAEMON, NULL, NULL,
-		 NULL, NULL);
+	if (workers != NULL) {
+		for (i = 0; i < prog_parms.workers_num - 1; i++) {
+			add_packet_counters(total_counters,
+						&workers[i].pkt_counters);
+		}
+	}
 
 	log_debug_med("%s() exit\n", __func__);
 
 }
 
 
-void close_stdfiles(void)
+void add_packet_counters(struct packet_counters *total_counters,
+			 const struct packet_counters *pkt_counters)
 {
+	unsigned int i;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	close(STDIN_FILENO);
-        close(STDOUT_FILENO);
-        close(STDERR_FILENO);	
+	total_counters->inet_in_pkts += pkt_counters->inet_in_pkts;
+	total_counters->inet6_in_pkts += pkt_counters->inet6_in_pkts;
+	total_counters->inet_in_drops += pkt_counters->inet_in_drops;
+	total_counters->inet6_in_drops += pkt_counters->inet6_in_drops;
+	total_counters->inet_out_pkts += pkt_counters->inet_out_pkts;
+	total_counters->inet6_out_pkts += pkt_counters->inet6_out_pkts;
+	total_counters->rx_batches += pkt_counters->rx_batches;
+	total_counters->rx_batch_pkts += pkt_counters->rx_batch_pkts;
+	total_counters->rx_batches_full += pkt_counters->rx_batches_full;
+	total_counters->rx_busy_polls += pkt_counters->rx_busy_polls;
+	total_counters->rx_busy_empty += pkt_counters->rx_busy_empty;
+	total_counters->rx_busy_backoffs += pkt_counters->rx_busy_backoffs;
+	total_counters->rx_buf_drops += pkt_counters->rx_buf_drops;
+	total_counters->rx_buf_grows += pkt_counters->rx_buf_grows;
+	total_counters->rx_bytes += pkt_counters->rx_bytes;
+	latency_hist_sum(&total_counters->rx_latency,
+						&pkt_counters->rx_latency);
+	total_counters->rx_gro_bufs += pkt_counters->rx_gro_bufs;
+	total_counters->rx_gro_segs += pkt_counters->rx_gro_segs;
+	total_counters->tx_gso_sends += pkt_counters->tx_gso_sends;
+	total_counters->tx_gso_segs += pkt_counters->tx_gso_segs;
+	total_counters->tx_zc_sends += pkt_counters->tx_zc_sends;
+	total_counters->tx_zc_hits += pkt_counters->tx_zc_hits;
+	total_counters->tx_zc_fallbacks += pkt_counters->tx_zc_fallbacks;
+	total_counters->tx_zc_timeouts += pkt_counters->tx_zc_timeouts;
+	total_counters->uring_enters += pkt_counters->uring_enters;
+	total_counters->uring_sqes += pkt_counters->uring_sqes;
+	total_counters->uring_cqes += pkt_counters->uring_cqes;
+	total_counters->uring_recv_errs += pkt_counters->uring_recv_errs;
+	total_counters->xdp_rx_pkts += pkt_counters->xdp_rx_pkts;
+	total_counters->xdp_rx_polls += pkt_counters->xdp_rx_polls;
+	total_counters->xdp_stack_pkts += pkt_counters->xdp_stack_pkts;
+	total_counters->xdp_ring_full += pkt_counters->xdp_ring_full;
+	total_counters->xdp_fill_empty += pkt_counters->xdp_fill_empty;
+	total_counters->xdp_dropped += pkt_counters->xdp_dropped;
+	total_counters->pkt_ring_pkts += pkt_counters->pkt_ring_pkts;
+	total_counters->pkt_ring_blocks += pkt_counters->pkt_ring_blocks;
+	total_counters->pkt_ring_kernel_pkts += pkt_counters->pkt_ring_kernel_pkts;
+	total_counters->pkt_ring_drops += pkt_counters->pkt_ring_drops;
+	total_counters->pkt_ring_freezes += pkt_counters->pkt_ring_freezes;
+	for (i = 0; i < PIPE_TX_LEGS; i++) {
+		if (pkt_counters->pipe_ring_hwm[i] >
+					total_counters->pipe_ring_hwm[i]) {
+			total_counters->pipe_ring_hwm[i] =
+						pkt_counters->pipe_ring_hwm[i];
+		}
+		total_counters->pipe_ring_full[i] +=
+						pkt_counters->pipe_ring_full[i];
+	}
+	total_counters->pipe_buf_full += pkt_counters->pipe_buf_full;
+	total_counters->tx_backlog_queued += pkt_counters->tx_backlog_queued;
+	total_counters->tx_backlog_drops += pkt_counters->tx_backlog_drops;
+	total_counters->tx_paced += pkt_counters->tx_paced;
+	total_counters->tx_pace_drops += pkt_counters->tx_pace_drops;
 
 	log_debug_med("%s() exit\n", __func__);
 
 }
 
 
-void install_exit_signal_handlers(void)
+void log_packet_counters(const enum REPLICAST_MODE rc_mode,
+			 const struct packet_counters *pkt_counters)
 {
+	const struct rcast_mode *mode;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	install_sigterm_handler(&sigterm_action);
+	mode = find_rcast_mode(rc_mode);
+	if (mode != NULL) {
+		if (mode->rx_family == AF_INET) {
+			log_msg(LOG_SEV_INFO, "inet pkts in %lld, ",
+						pkt_counters->inet_in_pkts);
+			log_msg(LOG_SEV_INFO, "rx drops %lld, ",
+						pkt_counters->inet_in_drops);
+		} else {
+			log_msg(LOG_SEV_INFO, "inet6 pkts in %lld, ",
+						pkt_counters->inet6_in_pkts);
+			log_msg(LOG_SEV_INFO, "rx drops %lld, ",
+						pkt_counters->inet6_in_drops);
+		}
+		if (mode->inet_tx) {
+			log_msg(LOG_SEV_INFO, "inet pkts out %lld%s",
+				pkt_counters->inet_out_pkts,
+				mode->inet6_tx ? ", " : "\n");
+		}
+		if (mode->inet6_tx) {
+			log_msg(LOG_SEV_INFO, "inet6 pkts out %lld\n",
+						pkt_counters->inet6_out_pkts);
+		}
+	} else if (rc_mode == RCMODE_FLOWS) {
+		log_flow_counters();
+	}
 
-	install_sigint_handler(&sigint_action);
+	log_udp_mib_counters(rc_mode);
 
-	log_debug_med("%s() exit\n", __func__);
+	log_rx_batch_counters(pkt_counters);
 
-}
+	log_rx_busy_counters(pkt_counters);
 
+	log_rx_buf_counters(pkt_counters);
 
-void install_usr_signal_handlers(void)
-{
+	log_rx_latency_counters(pkt_counters);
 
+	log_tx_gso_counters(pkt_counters);
 
-	log_debug_med("%s() entry\n", __func__);
+	log_tx_zerocopy_counters(pkt_counters);
 
-	install_sigusr1_handler(&sigusr1_action);
+	log_uring_counters(pkt_counters);
 
-	install_sigusr2_handler(&sigusr2_action);
+	log_xdp_counters(pkt_counters);
+
+	log_pkt_ring_counters(pkt_counters);
+
+	log_pipe_counters(pkt_counters);
+
+	log_tx_backlog_counters(pkt_counters);
+
+	log_tx_pace_counters(pkt_counters);
 
 	log_debug_med("%s() exit\n", __func__);
 
 }
 
 
-void install_sigterm_handler(struct sigaction *sigterm_action)
+/*
+ * The counts since replicast started, of datagrams dropped for a full
+ * buffer by any UDP socket in the network namespace, for the families in
+ * use.
+ */
+void log_udp_mib_counters(const enum REPLICAST_MODE rc_mode)
 {
+	const unsigned int inet_used = (rc_mode != RCMODE_INET6_TO_INET6);
+	const unsigned int inet6_used = (rc_mode != RCMODE_INET_TO_INET);
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	sigterm_action->sa_handler = sigterm_handler;
-
-        sigemptyset(&sigterm_action->sa_mask);
-	sigaddset(&sigterm_action->sa_mask, SIGINT);
-	sigaddset(&sigterm_action->sa_mask, SIGUSR1);
-	sigaddset(&sigterm_action->sa_mask, SIGUSR2);
-
-        sigterm_action->sa_flags = 0;
+	if (inet_used && udp_mibs.inet_ok) {
+		log_msg(LOG_SEV_INFO, "inet udp rcvbuf errors %lld, ",
+			udp_mibs.inet.rcvbuf_errors -
+					udp_mibs.inet_start.rcvbuf_errors);
+		log_msg(LOG_SEV_INFO, "sndbuf errors %lld\n",
+			udp_mibs.inet.sndbuf_errors -
+					udp_mibs.inet_start.sndbuf_errors);
+	}
 
-        sigaction(SIGTERM, sigterm_action, NULL);
+	if (inet6_used && udp_mibs.inet6_ok) {
+		log_msg(LOG_SEV_INFO, "inet6 udp rcvbuf errors %lld, ",
+			udp_mibs.inet6.rcvbuf_errors -
+					udp_mibs.inet6_start.rcvbuf_errors);
+		log_msg(LOG_SEV_INFO, "sndbuf errors %lld\n",
+			udp_mibs.inet6.sndbuf_errors -
+					udp_mibs.inet6_start.sndbuf_errors);
+	}
 
 	log_debug_med("%s() exit\n", __func__);
 
 }
 
 
-void install_sigint_handler(struct sigaction *sigint_action)
+/*
+ * The totals for all the flows, then each flow's own counters.
+ */
+void log_flow_counters(void)
 {
+	unsigned long long in_pkts = 0;
+	unsigned long long in_drops = 0;
+	unsigned long long inet_out_pkts = 0;
+	unsigned long long inet6_out_pkts = 0;
+	unsigned int i;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	sigint_action->sa_handler = sigint_handler;
+	if (flows == NULL) {
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
 
-        sigemptyset(&sigint_action->sa_mask);
-	sigaddset(&sigint_action->sa_mask, SIGTERM);
-	sigaddset(&sigint_action->sa_mask, SIGUSR1);
-	sigaddset(&sigint_action->sa_mask, SIGUSR2);
+	for (i = 0; i < prog_parms.flows_num; i++) {
+		in_pkts += flows[i].in_pkts;
+		in_drops += flows[i].in_drops;
+		inet_out_pkts += flows[i].inet_out_pkts;
+		inet6_out_pkts += flows[i].inet6_out_pkts;
+	}
 
-        sigint_action->sa_flags = 0;
+	log_msg(LOG_SEV_INFO, "flows pkts in %lld, ", in_pkts);
+	log_msg(LOG_SEV_INFO, "rx drops %lld, ", in_drops);
+	log_msg(LOG_SEV_INFO, "inet pkts out %lld, ", inet_out_pkts);
+	log_msg(LOG_SEV_INFO, "inet6 pkts out %lld\n", inet6_out_pkts);
 
-        sigaction(SIGINT, sigint_action, NULL);
+	for (i = 0; i < prog_parms.flows_num; i++) {
+		log_msg(LOG_SEV_INFO, "flow %d, line %d: ", i,
+			prog_parms.flows[i].line);
+		log_msg(LOG_SEV_INFO, "pkts in %lld, ", flows[i].in_pkts);
+		log_msg(LOG_SEV_INFO, "rx drops %lld, ", flows[i].in_drops);
+		log_msg(LOG_SEV_INFO, "inet pkts out %lld, ",
+						flows[i].inet_out_pkts);
+		log_msg(LOG_SEV_INFO, "inet6 pkts out %lld\n",
+						flows[i].inet6_out_pkts);
+	}
 
 	log_debug_med("%s() exit\n", __func__);
 
 }
 
 
-void install_sigusr1_handler(struct sigaction *sigusr1_action)
+void log_rx_batch_counters(const struct packet_counters *pkt_counters)
 {
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	sigusr1_action->sa_handler = sigusr1_handler;
-
-        sigemptyset(&sigusr1_action->sa_mask);
-	sigaddset(&sigusr1_action->sa_mask, SIGUSR2);
-
-        sigusr1_action->sa_flags = SA_RESTART;
+	if (pkt_counters->rx_batches > 0) {
+		log_msg(LOG_SEV_INFO, "rx batches %lld, ",
+						pkt_counters->rx_batches);
+		log_msg(LOG_SEV_INFO, "avg fill %.1f, ",
+			(double)pkt_counters->rx_batch_pkts /
+						pkt_counters->rx_batches);
+		log_msg(LOG_SEV_INFO, "full %lld\n",
+						pkt_counters->rx_batches_full);
+	}
 
-        sigaction(SIGUSR1, sigusr1_action, NULL);
+	if (pkt_counters->rx_gro_bufs > 0) {
+		log_msg(LOG_SEV_INFO, "rx gro bufs %lld, ",
+						pkt_counters->rx_gro_bufs);
+		log_msg(LOG_SEV_INFO, "avg segs %.1f\n",
+			(double)pkt_counters->rx_gro_segs /
+						pkt_counters->rx_gro_bufs);
+	}
 
 	log_debug_med("%s() exit\n", __func__);
 
 }
 
 
-void install_sigusr2_handler(struct sigaction *sigusr2_action)
+void log_rx_busy_counters(const struct packet_counters *pkt_counters)
 {
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	sigusr2_action->sa_handler = sigusr2_handler;
-
-        sigemptyset(&(sigusr2_action->sa_mask));
-	sigaddset(&sigusr2_action->sa_mask, SIGUSR1);
-
-        sigusr2_action->sa_flags = SA_RESTART;
-
-        sigaction(SIGUSR2, sigusr2_action, NULL);
+	if (pkt_counters->rx_busy_polls > 0) {
+		log_msg(LOG_SEV_INFO, "rx busy polls %lld, ",
+						pkt_counters->rx_busy_polls);
+		log_msg(LOG_SEV_INFO, "empty %lld, ",
+						pkt_counters->rx_busy_empty);
+		log_msg(LOG_SEV_INFO, "backoffs %lld\n",
+						pkt_counters->rx_busy_backoffs);
+	}
 
 	log_debug_med("%s() exit\n", __func__);
 
 }
 
 
-void sigterm_handler(int signum)
+void log_rx_buf_counters(const struct packet_counters *pkt_counters)
 {
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	exit_program();
+	if ((pkt_counters->rx_buf_drops > 0) ||
+	    (pkt_counters->rx_buf_grows > 0)) {
+		log_msg(LOG_SEV_INFO, "rx buf drops %lld, ",
+						pkt_counters->rx_buf_drops);
+		log_msg(LOG_SEV_INFO, "grows %lld\n",
+						pkt_counters->rx_buf_grows);
+	}
 
 	log_debug_med("%s() exit\n", __func__);
 
 }
 
 
-void sigint_handler(int signum)
+void log_rx_latency_counters(const struct packet_counters *pkt_counters)
 {
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	exit_program();
+	log_latency_hist("rx to tx", &pkt_counters->rx_latency);
 
 	log_debug_med("%s() exit\n", __func__);
 
-
 }
 
 
-void sigusr1_handler(int signum)
+void log_latency_hist(const char *name_str,
+		      const struct latency_hist *hist)
 {
+	static const double percentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+	unsigned int i;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	log_packet_counters(prog_parms.rc_mode, &pkt_counters);
+	if (hist->pkts == 0) {
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
 
-	log_debug_med("%s() exit\n", __func__);
+	log_msg(LOG_SEV_INFO, "%s latency usecs", name_str);
+
+	for (i = 0; i < (sizeof(percentiles) / sizeof(percentiles[0])); i++) {
+		log_msg(LOG_SEV_INFO, " p%g %.1f,", percentiles[i],
+			latency_hist_percentile(hist, percentiles[i]) / 1000.0);
+	}
+
+	log_msg(LOG_SEV_INFO, " max %.1f (%lld pkts)\n", hist->max / 1000.0,
+								hist->pkts);
 
+	log_debug_med("%s() exit\n", __func__);
 
 }
 
 
-void sigusr2_handler(int signum)
+/*
+ * Each family's latency, over the main thread and the workers.
+ */
+void log_tx_latency(const struct packet_counters *pkt_counters)
 {
+	struct latency_hist total_hist;
+	unsigned int i;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	log_prog_banner();
-
-	log_prog_parms(&prog_parms);
+	memset(&total_hist, 0, sizeof(total_hist));
+	sum_tx_latency(&total_hist, pkt_counters->inet_tx_dests);
+	for (i = 0; (workers != NULL) && (i < prog_parms.workers_num - 1);
+									i++) {
+		sum_tx_latency(&total_hist,
+				workers[i].pkt_counters.inet_tx_dests);
+	}
+	log_latency_hist("inet rx to tx", &total_hist);
+
+	memset(&total_hist, 0, sizeof(total_hist));
+	sum_tx_latency(&total_hist, pkt_counters->inet6_tx_dests);
+	for (i = 0; (workers != NULL) && (i < prog_parms.workers_num - 1);
+									i++) {
+		sum_tx_latency(&total_hist,
+				workers[i].pkt_counters.inet6_tx_dests);
+	}
+	log_latency_hist("inet6 rx to tx", &total_hist);
 
 	log_debug_med("%s() exit\n", __func__);
 
+}
+
+
+void sum_tx_latency(struct latency_hist *total_hist,
+		    const struct tx_dests *tx_dests)
+{
+
+
+	if ((tx_dests != NULL) && (tx_dests->latency != NULL)) {
+		latency_hist_sum(total_hist, tx_dests->latency);
+	}
 
 }
 
 
-int open_inet_rx_sock(const struct inet_rx_sock_params *sock_parms)
+void exit_program(void)
 {
-	int ret;
-	int sock_fd;
-	int one = 1;
-	struct sockaddr_in sa_in_rxaddr;
-	struct ip_mreq ip_mcast_req;
+	struct packet_counters total_counters;
+	unsigned int i;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
-	if (sock_fd == -1) {
-		return -1;
-	}
+	update_xdp_counters(sock_fds.xdp_sock_fd, &pkt_counters);
 
-	ret = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &one,
-		sizeof(one));
-	if (ret == -1) {
-		return -1;
-	}
+	close_sockets(&sock_fds);
 
-	memset(&sa_in_rxaddr, 0, sizeof(sa_in_rxaddr));
-	sa_in_rxaddr.sin_family = AF_INET;
-	sa_in_rxaddr.sin_addr =  sock_parms->rx_addr;
-	sa_in_rxaddr.sin_port = htons(sock_parms->port);
-	ret = bind(sock_fd, (struct sockaddr *) &sa_in_rxaddr,
-		sizeof(sa_in_rxaddr));
-	if (ret == -1) {
-		return -1;
-	}
+	close_flows();
 
-	if (IN_MULTICAST(ntohl(sock_parms->rx_addr.s_addr))) {
-		ip_mcast_req.imr_multiaddr = sock_parms->rx_addr;
-		ip_mcast_req.imr_interface = sock_parms->in_intf_addr;
-		ret = setsockopt(sock_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP,
-			&ip_mcast_req, sizeof(ip_mcast_req));
-		if (ret == -1) {
-			return -1;
+	if (workers != NULL) {
+		for (i = 0; i < prog_parms.workers_num - 1; i++) {
+			close_sockets(&workers[i].sock_fds);
 		}
 	}
 
-	log_debug_med("%s() exit\n", __func__);
+	sum_packet_counters(&total_counters);
 
-	return sock_fd;
+	log_packet_counters(prog_parms.rc_mode, &total_counters);
 
-}
+	log_tx_backlogs(&pkt_counters);
 
+	log_tx_rates(&pkt_counters);
 
-void close_inet_rx_sock(const int sock_fd)
-{
+	log_tx_dests_stats(&pkt_counters);
 
+	log_tx_latency(&pkt_counters);
 
-	log_debug_med("%s() entry\n", __func__);
+	close_shm_stats();
 
-	if (sock_fd != -1) {
-		close(sock_fd);
-	}
+	close_metrics();
+
+	cleanup_prog_parms(&prog_parms);
 
 	log_debug_med("%s() exit\n", __func__);
 
+	log_close();
+
+	exit(EXIT_SUCCESS);
+
 }
 
 
-int open_inet6_rx_sock(const struct inet6_rx_sock_params *sock_parms)
+void log_tx_gso_counters(const struct packet_counters *pkt_counters)
 {
-	int ret;
-	int sock_fd;
-	const int one = 1;
-	struct sockaddr_in6 sa_in6_rxaddr;
-	struct ipv6_mreq ipv6_mcast_req;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	sock_fd = socket(AF_INET6, SOCK_DGRAM, 0);
-	if (sock_fd == -1) {
-		log_debug_low("%s(): socket() == %d\n", __func__, sock_fd);
-		log_debug_low("%s(): errno == %d\n", __func__, errno);
-		log_debug_med("%s() exit\n", __func__);
-		return -1;
-	}
-
-	ret = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &one,
-		sizeof(one));
-	if (ret == -1) {
-		log_debug_low("%s(): setsockopt(SO_REUSEADDR) == %d\n",
-			__func__, ret);
-		log_debug_low("%s(): errno == %d\n", __func__, errno);
-		log_debug_med("%s() exit\n", __func__);
-		return -1;
+	if (pkt_counters->tx_gso_sends > 0) {
+		log_msg(LOG_SEV_INFO, "tx gso sends %lld, ",
+						pkt_counters->tx_gso_sends);
+		log_msg(LOG_SEV_INFO, "avg segs %.1f\n",
+			(double)pkt_counters->tx_gso_segs /
+						pkt_counters->tx_gso_sends);
 	}
 
-	ret = setsockopt(sock_fd, IPPROTO_IPV6, IPV6_V6ONLY, &one,
-		sizeof(one));
-	if (ret == -1) {
-		log_debug_low("%s(): setsockopt(IPV6_V6ONLY) == %d\n",
-			__func__, ret);
-		log_debug_low("%s(): errno == %d\n", __func__, errno);
-		log_debug_med("%s() exit\n", __func__);
-		return -1;
-	}
+	log_debug_med("%s() exit\n", __func__);
 
-	memset(&sa_in6_rxaddr, 0, sizeof(sa_in6_rxaddr));
-	sa_in6_rxaddr.sin6_family = AF_INET6;
-	sa_in6_rxaddr.sin6_addr = sock_parms->rx_addr;
-	sa_in6_rxaddr.sin6_port = htons(sock_parms->port);
-	if (IN6_IS_ADDR_MC_LINKLOCAL(&sa_in6_rxaddr.sin6_addr) ||
-	    IN6_IS_ADDR_LINKLOCAL(&sa_in6_rxaddr.sin6_addr) ) {
-		sa_in6_rxaddr.sin6_scope_id = sock_parms->in_intf_idx;
-	}
-	ret = bind(sock_fd, (struct sockaddr *) &sa_in6_rxaddr,
-		sizeof(sa_in6_rxaddr));
-	if (ret == -1) {
-		log_debug_low("%s(): bind() == %d\n", __func__, ret);
-		log_debug_low("%s(): errno == %d\n", __func__, errno);
-		log_debug_med("%s() exit\n", __func__);
-		return -1;
-	}
+}
 
-	if (IN6_IS_ADDR_MULTICAST(&sock_parms->rx_addr)) {
-		ipv6_mcast_req.ipv6mr_multiaddr = sock_parms->rx_addr;
-		ipv6_mcast_req.ipv6mr_interface = sock_parms->in_intf_idx;
-		ret = setsockopt(sock_fd, IPPROTO_IPV6, IPV6_ADD_MEMBERSHIP,
-			&ipv6_mcast_req, sizeof(ipv6_mcast_req));
-		if (ret == -1) {
-			log_debug_low("%s(): setsockopt(IPV6_ADD_MEMBERSHIP)",
-				__func__);
-			log_debug_low(" == %d\n", ret);
-			log_debug_low("%s(): errno == %d\n", __func__, errno);
-			log_debug_med("%s() exit\n", __func__);
-			return -1;
-		}
+
+void log_tx_zerocopy_counters(const struct packet_counters *pkt_counters)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if ((pkt_counters->tx_zc_sends > 0) ||
+	    (pkt_counters->tx_zc_fallbacks > 0)) {
+		log_msg(LOG_SEV_INFO, "tx zerocopy sends %lld, ",
+						pkt_counters->tx_zc_sends);
+		log_msg(LOG_SEV_INFO, "hits %lld, ",
+						pkt_counters->tx_zc_hits);
+		log_msg(LOG_SEV_INFO, "fallbacks %lld, ",
+						pkt_counters->tx_zc_fallbacks);
+		log_msg(LOG_SEV_INFO, "wait timeouts %lld\n",
+						pkt_counters->tx_zc_timeouts);
 	}
 
 	log_debug_med("%s() exit\n", __func__);
 
-	return sock_fd;
+}
+
+
+void log_uring_counters(const struct packet_counters *pkt_counters)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (pkt_counters->uring_enters > 0) {
+		log_msg(LOG_SEV_INFO, "uring enters %lld, ",
+						pkt_counters->uring_enters);
+		log_msg(LOG_SEV_INFO, "sqes/enter %.1f, ",
+			(double)pkt_counters->uring_sqes /
+						pkt_counters->uring_enters);
+		log_msg(LOG_SEV_INFO, "cqes/enter %.1f, ",
+			(double)pkt_counters->uring_cqes /
+						pkt_counters->uring_enters);
+		log_msg(LOG_SEV_INFO, "recv errors %lld\n",
+					pkt_counters->uring_recv_errs);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
 
 }
 
 
-void close_inet6_rx_sock(const int sock_fd)
+void update_xdp_counters(const int xdp_sock_fd,
+			 struct packet_counters *pkt_counters)
 {
+	struct xdp_statistics xdp_stats;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	if (sock_fd != -1) {
-		close(sock_fd);
+	if ((xdp_sock_fd != -1) && (xsk_stats(xdp_sock_fd, &xdp_stats) == 0)) {
+		pkt_counters->xdp_ring_full = xdp_stats.rx_ring_full;
+		pkt_counters->xdp_fill_empty =
+					xdp_stats.rx_fill_ring_empty_descs;
+		pkt_counters->xdp_dropped = xdp_stats.rx_dropped +
+					xdp_stats.rx_invalid_descs;
 	}
 
 	log_debug_med("%s() exit\n", __func__);
@@ -2425,70 +12622,99 @@ void close_inet6_rx_sock(const int sock_fd)
 }
 
 
-int open_inet_tx_sock(const struct inet_tx_sock_params *sock_parms)
+void log_xdp_counters(const struct packet_counters *pkt_counters)
 {
-	int sock_fd;
-	uint8_t ttl;
-	uint8_t loop;
-	int ret;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
-	if (sock_fd == -1) {
-		return -1;
+	if ((pkt_counters->xdp_rx_pkts > 0) ||
+	    (pkt_counters->xdp_stack_pkts > 0)) {
+		log_msg(LOG_SEV_INFO, "xdp rx pkts %lld, ",
+						pkt_counters->xdp_rx_pkts);
+		log_msg(LOG_SEV_INFO, "polls %lld, ",
+						pkt_counters->xdp_rx_polls);
+		log_msg(LOG_SEV_INFO, "stack rx pkts %lld\n",
+						pkt_counters->xdp_stack_pkts);
+		log_msg(LOG_SEV_INFO, "xdp rx ring full %lld, ",
+						pkt_counters->xdp_ring_full);
+		log_msg(LOG_SEV_INFO, "fill ring empty %lld, ",
+						pkt_counters->xdp_fill_empty);
+		log_msg(LOG_SEV_INFO, "dropped %lld\n",
+						pkt_counters->xdp_dropped);
 	}
 
-	if (sock_parms->mc_dests_num > 0) {
+	log_debug_med("%s() exit\n", __func__);
 
-		log_debug_low("%s() sock_parms->mc_dests_num = %d\n", __func__,
-			sock_parms->mc_dests_num);
+}
 
-		if (sock_parms->mc_ttl > 0) {
-			ttl = sock_parms->mc_ttl & 0xff;
-			ret = setsockopt(sock_fd, IPPROTO_IP, IP_MULTICAST_TTL,
-				&ttl, sizeof(ttl));	
-			if (ret == -1) {
-				return -1;
-			}
-		}
 
-		if (sock_parms->mc_loop == 1) {
-			loop = 1;
-		} else {
-			loop = 0;
-		}
-		ret = setsockopt(sock_fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop,
-			sizeof(loop));
-		if (ret == -1) {
-			return -1;
-		}
+void log_pkt_ring_counters(const struct packet_counters *pkt_counters)
+{
 
-		ret = setsockopt(sock_fd, IPPROTO_IP, IP_MULTICAST_IF,
-			&sock_parms->out_intf_addr,
-			sizeof(sock_parms->out_intf_addr));
-		if (ret == -1) {
-			return -1;
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (pkt_counters->pkt_ring_pkts > 0) {
+		log_msg(LOG_SEV_INFO, "pkt ring rx pkts %lld, ",
+						pkt_counters->pkt_ring_pkts);
+		log_msg(LOG_SEV_INFO, "blocks %lld",
+						pkt_counters->pkt_ring_blocks);
+		if (pkt_counters->pkt_ring_blocks > 0) {
+			log_msg(LOG_SEV_INFO, ", avg pkts/block %.1f",
+				(double)pkt_counters->pkt_ring_pkts /
+						pkt_counters->pkt_ring_blocks);
 		}
- 
+		log_msg(LOG_SEV_INFO, "\n");
+		log_msg(LOG_SEV_INFO, "pkt ring kernel pkts %lld, ",
+					pkt_counters->pkt_ring_kernel_pkts);
+		log_msg(LOG_SEV_INFO, "drops %lld, ",
+						pkt_counters->pkt_ring_drops);
+		log_msg(LOG_SEV_INFO, "freezes %lld\n",
+						pkt_counters->pkt_ring_freezes);
 	}
 
 	log_debug_med("%s() exit\n", __func__);
 
-	return sock_fd;
+}
+
+
+void log_pipe_counters(const struct packet_counters *pkt_counters)
+{
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if (prog_parms.engine == ENGINE_PIPE) {
+		log_msg(LOG_SEV_INFO, "pipe inet ring hwm %lld, ",
+					pkt_counters->pipe_ring_hwm[0]);
+		log_msg(LOG_SEV_INFO, "full drops %lld\n",
+					pkt_counters->pipe_ring_full[0]);
+		log_msg(LOG_SEV_INFO, "pipe inet6 ring hwm %lld, ",
+					pkt_counters->pipe_ring_hwm[1]);
+		log_msg(LOG_SEV_INFO, "full drops %lld\n",
+					pkt_counters->pipe_ring_full[1]);
+		log_msg(LOG_SEV_INFO, "pipe buf full drops %lld\n",
+					pkt_counters->pipe_buf_full);
+	}
+
+	log_debug_med("%s() exit\n", __func__);
 
 }
 
 
-void close_inet_tx_sock(int sock_fd)
+void log_tx_backlog_counters(const struct packet_counters *pkt_counters)
 {
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	if (sock_fd != -1) {
-		close(sock_fd);
+	if ((pkt_counters->tx_backlog_queued > 0) ||
+	    (pkt_counters->tx_backlog_drops > 0)) {
+		log_msg(LOG_SEV_INFO, "tx backlog queued %lld, ",
+					pkt_counters->tx_backlog_queued);
+		log_msg(LOG_SEV_INFO, "drops %lld\n",
+					pkt_counters->tx_backlog_drops);
 	}
 
 	log_debug_med("%s() exit\n", __func__);
@@ -2496,85 +12722,104 @@ void close_inet_tx_sock(int sock_fd)
 }
 
 
-int open_inet6_tx_sock(const struct inet6_tx_sock_params *sock_parms)
+void log_tx_pace_counters(const struct packet_counters *pkt_counters)
 {
-	int sock_fd;
-	int ret;
-	const int one = 1;
-	int32_t hops;
-	uint32_t loop;
-	uint32_t out_ifidx;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	sock_fd = socket(AF_INET6, SOCK_DGRAM, 0);
-	if (sock_fd == -1) {
-		return -1;
+	if ((pkt_counters->tx_paced > 0) || (pkt_counters->tx_pace_drops > 0)) {
+		log_msg(LOG_SEV_INFO, "tx paced %lld, ",
+					pkt_counters->tx_paced);
+		log_msg(LOG_SEV_INFO, "drops %lld\n",
+					pkt_counters->tx_pace_drops);
 	}
 
-	ret = setsockopt(sock_fd, IPPROTO_IPV6, IPV6_V6ONLY, &one,
-		sizeof(one));
-	if (ret == -1) {
-		log_debug_low("%s(): setsockopt(IPV6_V6ONLY) == %d\n",
-			__func__, ret);
-		log_debug_low("%s(): errno == %d\n", __func__, errno);
+	log_debug_med("%s() exit\n", __func__);
+
+}
+
+
+void log_tx_backlog_dests(const char *family_str,
+			  const struct tx_dests *tx_dests)
+{
+	const struct tx_backlog *backlog;
+	char dest_str[AIP_STR_INET6_MAX_LEN + 1];
+	struct timespec now;
+	unsigned long long blocked_usecs;
+	unsigned int i;
+
+
+	log_debug_med("%s() entry\n", __func__);
+
+	if ((tx_dests == NULL) || (tx_dests->backlog_size == 0)) {
 		log_debug_med("%s() exit\n", __func__);
-		return -1;
+		return;
 	}
 
-	if (sock_parms->mc_dests_num > 0) {
-
-		log_debug_low("%s() sock_parms->mc_dests_num = %d\n", __func__,
-			sock_parms->mc_dests_num);
+	clock_gettime(CLOCK_MONOTONIC, &now);
 
-		if (sock_parms->mc_hops > 0) {
-			hops = sock_parms->mc_hops & 0xff;
-			ret = setsockopt(sock_fd, IPPROTO_IPV6,
-				IPV6_MULTICAST_HOPS, &hops, sizeof(hops));	
-			if (ret == -1) {
-				return -1;
-			}
-		}
+	for (i = 0; i < (tx_dests->dests_num + tx_dests->conn_dests_num);
+									i++) {
+		backlog = &tx_dests->backlogs[i];
 
-		if (sock_parms->mc_loop == 1) {
-			loop = 1;
+		if (backlog->dest->sa_family == AF_INET) {
+			ap_htop_inet(&((const struct sockaddr_in *)
+						backlog->dest)->sin_addr,
+				ntohs(((const struct sockaddr_in *)
+						backlog->dest)->sin_port),
+				dest_str, sizeof(dest_str));
 		} else {
-			loop = 0;
-		}
-		ret = setsockopt(sock_fd, IPPROTO_IPV6, IPV6_MULTICAST_LOOP,
-			&loop, sizeof(loop));
-		if (ret == -1) {
-			return -1;
+			ap_htop_inet6(&((const struct sockaddr_in6 *)
+						backlog->dest)->sin6_addr,
+				ntohs(((const struct sockaddr_in6 *)
+						backlog->dest)->sin6_port),
+				dest_str, sizeof(dest_str));
 		}
 
-		if (sock_parms->out_intf_idx) {
-			out_ifidx = sock_parms->out_intf_idx;
-			ret = setsockopt(sock_fd, IPPROTO_IPV6,
-				IPV6_MULTICAST_IF, &out_ifidx,
-				sizeof(out_ifidx));
-			if (ret == -1) {
-				return -1;
-			}
+		blocked_usecs = backlog->blocked_usecs;
+		if (backlog->depth > 0) {
+			blocked_usecs +=
+				((now.tv_sec - backlog->blocked_start.tv_sec) *
+								1000000) +
+				((now.tv_nsec - backlog->blocked_start.tv_nsec) /
+									1000);
 		}
 
+		log_msg(LOG_SEV_INFO, "%s tx backlog %s: depth %d, hwm %d, ",
+			family_str, dest_str, backlog->depth, backlog->hwm);
+		log_msg(LOG_SEV_INFO, "queued %lld, drops %lld, ",
+			backlog->queued, backlog->drops);
+		log_msg(LOG_SEV_INFO, "blocked %.3f secs\n",
+			blocked_usecs / 1000000.0);
 	}
 
 	log_debug_med("%s() exit\n", __func__);
 
-	return sock_fd;
-			
 }
 
 
-void close_inet6_tx_sock(int sock_fd)
+/*
+ * The backlogs belong to the forwarding threads, so are logged per thread
+ * rather than summed.
+ */
+void log_tx_backlogs(const struct packet_counters *pkt_counters)
 {
+	unsigned int i;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	if (sock_fd != -1) {
-		close(sock_fd);
+	log_tx_backlog_dests("inet", pkt_counters->inet_tx_dests);
+	log_tx_backlog_dests("inet6", pkt_counters->inet6_tx_dests);
+
+	if (workers != NULL) {
+		for (i = 0; i < prog_parms.workers_num - 1; i++) {
+			log_tx_backlog_dests("inet",
+					workers[i].pkt_counters.inet_tx_dests);
+			log_tx_backlog_dests("inet6",
+					workers[i].pkt_counters.inet6_tx_dests);
+		}
 	}
 
 	log_debug_med("%s() exit\n", __func__);
@@ -2582,142 +12827,186 @@ void close_inet6_tx_sock(int sock_fd)
 }
 
 
-int inet_tx_rcast(const int sock_fd,
-		  const void *pkt,
-		  const size_t pkt_len,
- 		  const struct sockaddr_in inet_dests[])
+void log_tx_rate_bucket(const char *name_str,
+			const struct tx_rate_bucket *bucket)
 {
-	const struct sockaddr_in *sa_dest;
-	unsigned int tx_success = 0;
-	ssize_t ret;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	sa_dest = inet_dests;
-
-	while (sa_dest->sin_family == AF_INET) {
-		ret = sendto(sock_fd, pkt, pkt_len, 0,
-			(struct sockaddr *)sa_dest,
-			sizeof(struct sockaddr_in));
-		if (ret != -1) {
-			tx_success++;
-		}
-		log_debug_low("%s(): sendto() == %d\n", __func__, ret);
-		log_debug_low("%s(): errno == %d\n", __func__, errno);
-
-		sa_dest++;
-	}
+	log_msg(LOG_SEV_INFO, "%s tx rate conform %lld pkts %lld bytes, ",
+		name_str, bucket->conform_pkts, bucket->conform_bytes);
+	log_msg(LOG_SEV_INFO, "exceed %lld pkts %lld bytes\n",
+		bucket->exceed_pkts, bucket->exceed_bytes);
 
 	log_debug_med("%s() exit\n", __func__);
 
-	return tx_success;
-
 }
 
 
-int inet6_tx_rcast(const int sock_fd,
-		   const void *pkt,
-		   const size_t pkt_len,
- 		   const struct sockaddr_in6 inet6_dests[])
+void log_tx_rate_dests(const char *family_str,
+		       const struct tx_dests *tx_dests)
 {
-	const struct sockaddr_in6 *sa6_dest;
-	unsigned int tx_success = 0;
-	ssize_t ret;
+	const struct sockaddr *dest;
+	char dest_str[AIP_STR_INET6_MAX_LEN + 1];
+	char name_str[AIP_STR_INET6_MAX_LEN + 32];
+	unsigned int i;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	sa6_dest = inet6_dests;
+	if (tx_dests == NULL) {
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
 
-	while (sa6_dest->sin6_family == AF_INET6) {
-		ret = sendto(sock_fd, pkt, pkt_len, 0, 	
-			(struct sockaddr *)sa6_dest,
-			sizeof(struct sockaddr_in6));
-		if (ret != -1) {
-			tx_success++;
+	if (tx_dests->rate_intf.rate > 0) {
+		snprintf(name_str, sizeof(name_str), "%s out intf",
+								family_str);
+		log_tx_rate_bucket(name_str, &tx_dests->rate_intf);
+	}
+
+	if (tx_dests->rate_dests == NULL) {
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
+
+	for (i = 0; i < (tx_dests->dests_num + tx_dests->conn_dests_num);
+									i++) {
+		if (tx_dests->rate_dests[i].rate == 0) {
+			continue;
+		}
+
+		if (i < tx_dests->dests_num) {
+			dest = tx_dests->mmsgs[i].msg_hdr.msg_name;
+		} else {
+			dest = tx_dests->conn_dests[i - tx_dests->dests_num];
+		}
+
+		if (dest->sa_family == AF_INET) {
+			ap_htop_inet(&((const struct sockaddr_in *)
+						dest)->sin_addr,
+				ntohs(((const struct sockaddr_in *)
+						dest)->sin_port),
+				dest_str, sizeof(dest_str));
+		} else {
+			ap_htop_inet6(&((const struct sockaddr_in6 *)
+						dest)->sin6_addr,
+				ntohs(((const struct sockaddr_in6 *)
+						dest)->sin6_port),
+				dest_str, sizeof(dest_str));
 		}
-		log_debug_low("%s(): sendto() == %d\n", __func__, ret);
-		log_debug_low("%s(): errno == %d\n", __func__, errno);
 
-		sa6_dest++;
+		snprintf(name_str, sizeof(name_str), "%s dest %s", family_str,
+								dest_str);
+		log_tx_rate_bucket(name_str, &tx_dests->rate_dests[i]);
 	}
-	
-	log_debug_med("%s() exit\n", __func__);
 
-	return tx_success;
+	log_debug_med("%s() exit\n", __func__);
 
 }
 
 
-void close_sockets(const struct socket_fds *sock_fds)
+/*
+ * Rate limits aren't supported with multiple workers, so the main thread's
+ * buckets are the only ones.
+ */
+void log_tx_rates(const struct packet_counters *pkt_counters)
 {
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	close_inet_rx_sock(sock_fds->inet_in_sock_fd);
-	close_inet6_rx_sock(sock_fds->inet6_in_sock_fd);
-	close_inet_tx_sock(sock_fds->inet_out_sock_fd);
-	close_inet6_tx_sock(sock_fds->inet6_out_sock_fd);
+	if (tx_rate_global.rate > 0) {
+		log_tx_rate_bucket("global", &tx_rate_global);
+	}
+
+	log_tx_rate_dests("inet", pkt_counters->inet_tx_dests);
+	log_tx_rate_dests("inet6", pkt_counters->inet6_tx_dests);
 
 	log_debug_med("%s() exit\n", __func__);
 
 }
 
 
-void log_packet_counters(const enum REPLICAST_MODE rc_mode,
-			 const struct packet_counters *pkt_counters)
+/*
+ * Formats the address and port of a destination numbered like its counters.
+ */
+void tx_dest_str(const struct tx_dests *tx_dests,
+		 const unsigned int dest_num,
+		 char *dest_str,
+		 const size_t dest_str_size)
+{
+	const struct sockaddr *dest;
+
+
+	if (dest_num < tx_dests->dests_num) {
+		dest = tx_dests->mmsgs[dest_num].msg_hdr.msg_name;
+	} else {
+		dest = tx_dests->conn_dests[dest_num - tx_dests->dests_num];
+	}
+
+	if (dest->sa_family == AF_INET) {
+		ap_htop_inet(&((const struct sockaddr_in *)dest)->sin_addr,
+			ntohs(((const struct sockaddr_in *)dest)->sin_port),
+			dest_str, dest_str_size);
+	} else {
+		ap_htop_inet6(&((const struct sockaddr_in6 *)dest)->sin6_addr,
+			ntohs(((const struct sockaddr_in6 *)dest)->sin6_port),
+			dest_str, dest_str_size);
+	}
+
+}
+
+
+void log_tx_dest_stats(const char *name_str,
+		       const struct tx_dests *tx_dests)
 {
+	const struct tx_dest_stats *dest_stats;
+	char latency_str[96];
+	char dest_str[AIP_STR_INET6_MAX_LEN + 1];
+	unsigned long long errs;
+	unsigned int i;
+	unsigned int j;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	switch (rc_mode) {
-	case RCMODE_INET_TO_INET:
-		log_msg(LOG_SEV_INFO, "inet pkts in %lld, ",
-						pkt_counters->inet_in_pkts);
-		log_msg(LOG_SEV_INFO, "inet pkts out %lld\n",
-						pkt_counters->inet_out_pkts);
-		break;
-	case RCMODE_INET_TO_INET6:
-		log_msg(LOG_SEV_INFO, "inet pkts in %lld, ",
-						pkt_counters->inet_in_pkts);
-		log_msg(LOG_SEV_INFO, "inet6 pkts out %lld\n",
-						pkt_counters->inet6_out_pkts);
-		break;
-	case RCMODE_INET_TO_INET_INET6:
-		log_msg(LOG_SEV_INFO, "inet pkts in %lld, ",
-						pkt_counters->inet_in_pkts);
-		log_msg(LOG_SEV_INFO, "inet pkts out %lld, ",
-						pkt_counters->inet_out_pkts);
-		log_msg(LOG_SEV_INFO, "inet6 pkts out %lld\n",
-						pkt_counters->inet6_out_pkts);
-		break;
-	case RCMODE_INET6_TO_INET6:
-		log_msg(LOG_SEV_INFO, "inet6 pkts in %lld, ",
-						pkt_counters->inet6_in_pkts);
-		log_msg(LOG_SEV_INFO, "inet6 pkts out %lld\n",
-						pkt_counters->inet6_out_pkts);
-		break;
-	case RCMODE_INET6_TO_INET:
-		log_msg(LOG_SEV_INFO, "inet6 pkts in %lld, ",
-						pkt_counters->inet6_in_pkts);
-		log_msg(LOG_SEV_INFO, "inet pkts out %lld\n",
-						pkt_counters->inet_out_pkts);
-		break;
-	case RCMODE_INET6_TO_INET_INET6:
-		log_msg(LOG_SEV_INFO, "inet6 pkts in %lld, ",
-						pkt_counters->inet6_in_pkts);
-		log_msg(LOG_SEV_INFO, "inet pkts out %lld, ",
-						pkt_counters->inet_out_pkts);
-		log_msg(LOG_SEV_INFO, "inet6 pkts out %lld\n",
-						pkt_counters->inet6_out_pkts);
-		break;
-	default:
-		break;
+	if ((tx_dests == NULL) || (tx_dests->dest_stats == NULL)) {
+		log_debug_med("%s() exit\n", __func__);
+		return;
+	}
+
+	for (i = 0; i < (tx_dests->dests_num + tx_dests->conn_dests_num);
+									i++) {
+		dest_stats = &tx_dests->dest_stats[i];
 
+		tx_dest_str(tx_dests, i, dest_str, sizeof(dest_str));
+
+		errs = 0;
+		for (j = 0; j < TX_DEST_ERRS; j++) {
+			errs += dest_stats->errs[j];
+		}
+
+		log_msg(LOG_SEV_INFO, "%s dest %s: pkts out %lld, ",
+			name_str, dest_str, dest_stats->pkts);
+		log_msg(LOG_SEV_INFO, "bytes out %lld, errors %lld",
+			dest_stats->bytes, errs);
+		for (j = 0; j < TX_DEST_ERRS; j++) {
+			if (dest_stats->errs[j] > 0) {
+				log_msg(LOG_SEV_INFO, ", %s %lld",
+					tx_dest_err_strs[j],
+					dest_stats->errs[j]);
+			}
+		}
+		log_msg(LOG_SEV_INFO, "\n");
 
+		if (tx_dests->dest_latency != NULL) {
+			snprintf(latency_str, sizeof(latency_str),
+				"%s dest %s rx to tx", name_str, dest_str);
+			log_latency_hist(latency_str,
+						&tx_dests->dest_latency[i]);
+		}
 	}
 
 	log_debug_med("%s() exit\n", __func__);
@@ -2725,22 +13014,44 @@ void log_packet_counters(const enum REPLICAST_MODE rc_mode,
 }
 
 
-void exit_program(void)
+/*
+ * Like the backlogs, the destination counters belong to the forwarding
+ * threads, so are logged per thread, and per flow, rather than summed.
+ */
+void log_tx_dests_stats(const struct packet_counters *pkt_counters)
 {
+	char name_str[32];
+	unsigned int i;
 
 
 	log_debug_med("%s() entry\n", __func__);
 
-	close_sockets(&sock_fds);
-
-	log_packet_counters(prog_parms.rc_mode, &pkt_counters);
+	log_tx_dest_stats("inet", pkt_counters->inet_tx_dests);
+	log_tx_dest_stats("inet6", pkt_counters->inet6_tx_dests);
+
+	if (workers != NULL) {
+		for (i = 0; i < prog_parms.workers_num - 1; i++) {
+			snprintf(name_str, sizeof(name_str),
+				"worker %u inet", i + 1);
+			log_tx_dest_stats(name_str,
+					workers[i].pkt_counters.inet_tx_dests);
+			snprintf(name_str, sizeof(name_str),
+				"worker %u inet6", i + 1);
+			log_tx_dest_stats(name_str,
+					workers[i].pkt_counters.inet6_tx_dests);
+		}
+	}
 
-	cleanup_prog_parms(&prog_parms);
+	if (flows != NULL) {
+		for (i = 0; i < prog_parms.flows_num; i++) {
+			snprintf(name_str, sizeof(name_str), "flow %u inet", i);
+			log_tx_dest_stats(name_str, flows[i].inet_tx_dests);
+			snprintf(name_str, sizeof(name_str), "flow %u inet6",
+									i);
+			log_tx_dest_stats(name_str, flows[i].inet6_tx_dests);
+		}
+	}
 
 	log_debug_med("%s() exit\n", __func__);
 
-	log_close();
-
-	exit(EXIT_SUCCESS);
-
 }
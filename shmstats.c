@@ -0,0 +1,318 @@
+/*
+ * shmstats - a memory mapped file of counters, published by one writer
+ * under a sequence lock and read without disturbing it
+ *
+ * Copyright (C) 2011 Mark Smith <markzzzsmith@yahoo.com.au>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shmstats.h"
+
+
+static size_t shm_stats_align(const size_t size);
+
+
+const char *shm_stats_dest_err_strs[SHM_STATS_DEST_ERRS] = {
+	"econnrefused",
+	"ehostunreach",
+	"enetunreach",
+	"emsgsize",
+	"enobufs",
+	"other",
+};
+
+
+static size_t shm_stats_align(const size_t size)
+{
+
+
+	return (size + SHM_STATS_CACHE_LINE - 1) &
+					~((size_t)SHM_STATS_CACHE_LINE - 1);
+
+}
+
+
+int shm_stats_create(struct shm_stats *stats,
+		     const char *path,
+		     const unsigned int counters_max,
+		     const unsigned int flows_max,
+		     const unsigned int dests_max,
+		     const unsigned int publish_msecs)
+{
+	struct shm_stats_header *header;
+	size_t counters_offset;
+	size_t flows_offset;
+	size_t dests_offset;
+	size_t size;
+	int err;
+
+
+	counters_offset = shm_stats_align(sizeof(struct shm_stats_header));
+	flows_offset = shm_stats_align(counters_offset +
+			(counters_max * sizeof(struct shm_stats_counter)));
+	dests_offset = shm_stats_align(flows_offset +
+			(flows_max * sizeof(struct shm_stats_flow)));
+	size = shm_stats_align(dests_offset +
+			(dests_max * sizeof(struct shm_stats_dest)));
+
+	/*
+	 * A new file rather than a truncated one, as readers still mapping an
+	 * old file would fault on the pages truncated.
+	 */
+	if ((unlink(path) == -1) && (errno != ENOENT)) {
+		return -1;
+	}
+
+	stats->fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (stats->fd == -1) {
+		return -1;
+	}
+
+	if (ftruncate(stats->fd, size) == -1) {
+		err = errno;
+		close(stats->fd);
+		errno = err;
+		return -1;
+	}
+
+	stats->map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+							stats->fd, 0);
+	if (stats->map == MAP_FAILED) {
+		err = errno;
+		close(stats->fd);
+		errno = err;
+		return -1;
+	}
+	stats->size = size;
+
+	/*
+	 * The new file is zeroed, so only the layout needs filling in, with
+	 * the magic number last, so that a reader can't see a partial header.
+	 */
+	header = stats->map;
+	header->version = SHM_STATS_VERSION;
+	header->header_size = sizeof(struct shm_stats_header);
+	header->counter_size = sizeof(struct shm_stats_counter);
+	header->flow_size = sizeof(struct shm_stats_flow);
+	header->dest_size = sizeof(struct shm_stats_dest);
+	header->file_size = size;
+	header->counters_offset = counters_offset;
+	header->flows_offset = flows_offset;
+	header->dests_offset = dests_offset;
+	header->counters_max = counters_max;
+	header->flows_max = flows_max;
+	header->dests_max = dests_max;
+	header->pid = getpid();
+	header->start_nsecs = shm_stats_nsecs();
+	header->publish_msecs = publish_msecs;
+	__atomic_store_n(&header->magic, SHM_STATS_MAGIC, __ATOMIC_RELEASE);
+
+	stats->header = header;
+
+	return 0;
+
+}
+
+
+int shm_stats_open(struct shm_stats *stats,
+		   const char *path)
+{
+	const struct shm_stats_header *header;
+	struct stat st;
+	int err;
+
+
+	stats->fd = open(path, O_RDONLY);
+	if (stats->fd == -1) {
+		return -1;
+	}
+
+	if (fstat(stats->fd, &st) == -1) {
+		err = errno;
+		close(stats->fd);
+		errno = err;
+		return -1;
+	}
+
+	if (st.st_size < (off_t)sizeof(struct shm_stats_header)) {
+		close(stats->fd);
+		errno = EINVAL;
+		return -1;
+	}
+
+	stats->map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, stats->fd,
+									0);
+	if (stats->map == MAP_FAILED) {
+		err = errno;
+		close(stats->fd);
+		errno = err;
+		return -1;
+	}
+	stats->size = st.st_size;
+
+	header = stats->map;
+	if ((__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) !=
+							SHM_STATS_MAGIC) ||
+	    (header->file_size > stats->size) ||
+	    ((header->counters_offset +
+	      ((uint64_t)header->counters_max * header->counter_size)) >
+							header->file_size) ||
+	    ((header->flows_offset +
+	      ((uint64_t)header->flows_max * header->flow_size)) >
+							header->file_size) ||
+	    ((header->dests_offset +
+	      ((uint64_t)header->dests_max * header->dest_size)) >
+							header->file_size)) {
+		shm_stats_close(stats);
+		errno = EINVAL;
+		return -1;
+	}
+	if (header->version != SHM_STATS_VERSION) {
+		shm_stats_close(stats);
+		errno = EPROTONOSUPPORT;
+		return -1;
+	}
+
+	stats->header = stats->map;
+
+	return 0;
+
+}
+
+
+void shm_stats_close(struct shm_stats *stats)
+{
+
+
+	munmap(stats->map, stats->size);
+	close(stats->fd);
+
+}
+
+
+/*
+ * The release fence keeps the odd seq ahead of the updates, and the release
+ * store keeps the updates ahead of the even seq.
+ */
+void shm_stats_write_begin(struct shm_stats_header *header)
+{
+
+
+	__atomic_store_n(&header->seq, header->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+}
+
+
+void shm_stats_write_end(struct shm_stats_header *header)
+{
+
+
+	__atomic_store_n(&header->seq, header->seq + 1, __ATOMIC_RELEASE);
+
+}
+
+
+/*
+ * Copies the whole file into snapshot, which must be the size of the
+ * mapping, retrying while the writer is part way through an update. The
+ * writer only publishes every few hundred milliseconds, taking far less
+ * than that, so a retry nearly always succeeds.
+ */
+int shm_stats_read(const struct shm_stats *stats,
+		   void *snapshot)
+{
+	const struct shm_stats_header *header = stats->header;
+	uint64_t seq;
+	unsigned int tries;
+
+
+	for (tries = 0; tries < SHM_STATS_READ_TRIES; tries++) {
+		seq = __atomic_load_n(&header->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			sched_yield();
+			continue;
+		}
+
+		memcpy(snapshot, stats->map, stats->size);
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&header->seq, __ATOMIC_RELAXED) == seq) {
+			return 0;
+		}
+	}
+
+	errno = EAGAIN;
+	return -1;
+
+}
+
+
+struct shm_stats_counter *shm_stats_counter(
+				const struct shm_stats_header *header,
+				const unsigned int counter_num)
+{
+
+
+	return (struct shm_stats_counter *)((uint8_t *)header +
+		header->counters_offset + (counter_num * header->counter_size));
+
+}
+
+
+struct shm_stats_flow *shm_stats_flow(const struct shm_stats_header *header,
+				      const unsigned int flow_num)
+{
+
+
+	return (struct shm_stats_flow *)((uint8_t *)header +
+		header->flows_offset + (flow_num * header->flow_size));
+
+}
+
+
+struct shm_stats_dest *shm_stats_dest(const struct shm_stats_header *header,
+				      const unsigned int dest_num)
+{
+
+
+	return (struct shm_stats_dest *)((uint8_t *)header +
+		header->dests_offset + (dest_num * header->dest_size));
+
+}
+
+
+uint64_t shm_stats_nsecs(void)
+{
+	struct timespec ts;
+
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+
+}
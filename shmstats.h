@@ -0,0 +1,146 @@
+/*
+ * shmstats - a memory mapped file of counters, published by one writer
+ * under a sequence lock and read without disturbing it
+ *
+ * Copyright (C) 2011 Mark Smith <markzzzsmith@yahoo.com.au>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#ifndef __SHMSTATS_H
+#define __SHMSTATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+enum SHMSTATS_DEFS {
+	SHM_STATS_MAGIC = 0x52435354,
+	SHM_STATS_VERSION = 1,
+	SHM_STATS_NAME_LEN = 128,
+	SHM_STATS_DEST_ERRS = 6,
+	SHM_STATS_CACHE_LINE = 64,
+	SHM_STATS_READ_TRIES = 1000,
+};
+
+/*
+ * The file starts with the header, followed by the named counters, the
+ * flows and the destinations, at the offsets and of the sizes the header
+ * gives, so a reader can skip fields added to the end of a record. The
+ * version only changes if an existing field does.
+ *
+ * The writer makes seq odd while it updates the file, and even again
+ * afterwards. A reader's copy is consistent if seq was the same even
+ * number before and after it.
+ */
+struct shm_stats_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t counter_size;
+	uint32_t flow_size;
+	uint32_t dest_size;
+	uint64_t file_size;
+	uint64_t counters_offset;
+	uint64_t flows_offset;
+	uint64_t dests_offset;
+	uint32_t counters_max;
+	uint32_t flows_max;
+	uint32_t dests_max;
+	int32_t pid;
+	uint64_t start_nsecs;
+	uint32_t publish_msecs;
+
+	uint64_t seq __attribute__((aligned(SHM_STATS_CACHE_LINE)));
+	uint64_t publish_nsecs;
+	uint64_t publishes;
+	uint32_t counters_num;
+	uint32_t flows_num;
+	uint32_t dests_num;
+};
+
+struct shm_stats_counter {
+	char name[SHM_STATS_NAME_LEN];
+	uint64_t value;
+};
+
+struct shm_stats_flow {
+	char name[SHM_STATS_NAME_LEN];
+	uint64_t in_pkts;
+	uint64_t in_drops;
+	uint64_t inet_out_pkts;
+	uint64_t inet6_out_pkts;
+};
+
+/*
+ * The failed sends are counted by errno, in the order of
+ * shm_stats_dest_err_strs[]. The latencies, in nsecs, are from receiving
+ * a datagram to its send to the destination completing, with latency_pkts
+ * 0 unless they're measured.
+ */
+struct shm_stats_dest {
+	char name[SHM_STATS_NAME_LEN];
+	uint64_t pkts;
+	uint64_t bytes;
+	uint64_t errs[SHM_STATS_DEST_ERRS];
+	uint64_t latency_pkts;
+	uint64_t latency_p50;
+	uint64_t latency_p99;
+	uint64_t latency_p999;
+	uint64_t latency_max;
+};
+
+struct shm_stats {
+	int fd;
+	void *map;
+	size_t size;
+	struct shm_stats_header *header;
+};
+
+
+extern const char *shm_stats_dest_err_strs[SHM_STATS_DEST_ERRS];
+
+int shm_stats_create(struct shm_stats *stats,
+		     const char *path,
+		     const unsigned int counters_max,
+		     const unsigned int flows_max,
+		     const unsigned int dests_max,
+		     const unsigned int publish_msecs);
+
+int shm_stats_open(struct shm_stats *stats,
+		   const char *path);
+
+void shm_stats_close(struct shm_stats *stats);
+
+void shm_stats_write_begin(struct shm_stats_header *header);
+
+void shm_stats_write_end(struct shm_stats_header *header);
+
+int shm_stats_read(const struct shm_stats *stats,
+		   void *snapshot);
+
+struct shm_stats_counter *shm_stats_counter(
+				const struct shm_stats_header *header,
+				const unsigned int counter_num);
+
+struct shm_stats_flow *shm_stats_flow(const struct shm_stats_header *header,
+				      const unsigned int flow_num);
+
+struct shm_stats_dest *shm_stats_dest(const struct shm_stats_header *header,
+				      const unsigned int dest_num);
+
+uint64_t shm_stats_nsecs(void);
+
+#endif /* __SHMSTATS_H */
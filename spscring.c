@@ -0,0 +1,219 @@
+/*
+ * spscring - lock-free single producer, single consumer ring of buffer
+ * descriptors, for handing datagrams from one thread to another
+ *
+ * Copyright (C) 2011 Mark Smith <markzzzsmith@yahoo.com.au>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA. 
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/eventfd.h>
+
+#include "spscring.h"
+
+
+#define spsc_load_acquire(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define spsc_store_release(p, v)	__atomic_store_n((p), (v), \
+							__ATOMIC_RELEASE)
+
+
+int spsc_ring_init(struct spsc_ring *ring,
+		   const unsigned int size)
+{
+
+
+	memset(ring, 0, sizeof(*ring));
+	ring->wake_fd = -1;
+
+	if ((size == 0) || ((size & (size - 1)) != 0)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	ring->descs = calloc(size, sizeof(struct spsc_desc));
+	if (ring->descs == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	ring->wake_fd = eventfd(0, EFD_CLOEXEC);
+	if (ring->wake_fd == -1) {
+		free(ring->descs);
+		ring->descs = NULL;
+		return -1;
+	}
+
+	ring->size = size;
+	ring->mask = size - 1;
+
+	return 0;
+
+}
+
+
+void spsc_ring_free(struct spsc_ring *ring)
+{
+
+
+	if (ring->wake_fd != -1) {
+		close(ring->wake_fd);
+		ring->wake_fd = -1;
+	}
+
+	free(ring->descs);
+	ring->descs = NULL;
+
+}
+
+
+/*
+ * Producer side. Returns -1 if the ring is full.
+ */
+int spsc_ring_push(struct spsc_ring *ring,
+		   const struct spsc_desc *desc)
+{
+	unsigned int head = ring->head;
+
+
+	if ((head - spsc_load_acquire(&ring->tail)) >= ring->size) {
+		return -1;
+	}
+
+	ring->descs[head & ring->mask] = *desc;
+	spsc_store_release(&ring->head, head + 1);
+
+	return 0;
+
+}
+
+
+/*
+ * Producer side, the number of descriptors the consumer hasn't released.
+ */
+unsigned int spsc_ring_used(const struct spsc_ring *ring)
+{
+
+
+	return ring->head - spsc_load_acquire(&ring->tail);
+
+}
+
+
+/*
+ * Producer side, the oldest descriptor the consumer hasn't released, or NULL
+ * if the ring is empty. The consumer may release it at any time, but the
+ * slot isn't reused until the producer pushes into it again.
+ */
+const struct spsc_desc *spsc_ring_oldest(const struct spsc_ring *ring)
+{
+	unsigned int tail = spsc_load_acquire(&ring->tail);
+
+
+	if (tail == ring->head) {
+		return NULL;
+	}
+
+	return &ring->descs[tail & ring->mask];
+
+}
+
+
+/*
+ * Producer side, wakes the consumer if it is waiting in spsc_ring_wait().
+ * The full barrier pairs with the one in spsc_ring_wait(), so that either
+ * the consumer sees the new head, or the producer sees it waiting.
+ */
+void spsc_ring_wake(struct spsc_ring *ring)
+{
+	const uint64_t one = 1;
+
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&ring->consumer_waiting, __ATOMIC_RELAXED)) {
+		if (write(ring->wake_fd, &one, sizeof(one)) == -1) {
+			return;
+		}
+	}
+
+}
+
+
+/*
+ * Consumer side. Returns the number of descriptors available, up to
+ * descs_max, which stay valid until they are released.
+ */
+unsigned int spsc_ring_peek(const struct spsc_ring *ring,
+			    const struct spsc_desc *descs[],
+			    const unsigned int descs_max)
+{
+	unsigned int tail = ring->tail;
+	unsigned int avail;
+	unsigned int i;
+
+
+	avail = spsc_load_acquire(&ring->head) - tail;
+	if (avail > descs_max) {
+		avail = descs_max;
+	}
+
+	for (i = 0; i < avail; i++) {
+		descs[i] = &ring->descs[(tail + i) & ring->mask];
+	}
+
+	return avail;
+
+}
+
+
+void spsc_ring_release(struct spsc_ring *ring,
+		       const unsigned int descs_num)
+{
+
+
+	spsc_store_release(&ring->tail, ring->tail + descs_num);
+
+}
+
+
+/*
+ * Consumer side, blocks until the ring isn't empty. A signal or a spurious
+ * wake up may return early with the ring still empty.
+ */
+void spsc_ring_wait(struct spsc_ring *ring)
+{
+	uint64_t wakes;
+
+
+	__atomic_store_n(&ring->consumer_waiting, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&ring->head, __ATOMIC_RELAXED) == ring->tail) {
+		if (read(ring->wake_fd, &wakes, sizeof(wakes)) == -1) {
+			wakes = 0;
+		}
+	}
+
+	__atomic_store_n(&ring->consumer_waiting, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+}
@@ -0,0 +1,80 @@
+/*
+ * spscring - lock-free single producer, single consumer ring of buffer
+ * descriptors, for handing datagrams from one thread to another
+ *
+ * Copyright (C) 2011 Mark Smith <markzzzsmith@yahoo.com.au>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA. 
+ */
+#ifndef __SPSCRING_H
+#define __SPSCRING_H
+
+
+enum SPSCRING_DEFS {
+	SPSCRING_CACHE_LINE = 64,
+};
+
+/*
+ * A descriptor of a datagram held in a buffer shared by the producer and
+ * the consumer. The offset is free running, and is reduced modulo the
+ * buffer size by the user.
+ */
+struct spsc_desc {
+	unsigned long long offset;
+	unsigned int len;
+};
+
+/*
+ * The producer's and the consumer's indexes are kept in separate cache
+ * lines, so that each side only writes to its own.
+ */
+struct spsc_ring {
+	struct spsc_desc *descs;
+	unsigned int size;
+	unsigned int mask;
+	int wake_fd;
+
+	unsigned int head __attribute__((aligned(SPSCRING_CACHE_LINE)));
+
+	unsigned int tail __attribute__((aligned(SPSCRING_CACHE_LINE)));
+	unsigned int consumer_waiting;
+};
+
+
+int spsc_ring_init(struct spsc_ring *ring,
+		   const unsigned int size);
+
+void spsc_ring_free(struct spsc_ring *ring);
+
+int spsc_ring_push(struct spsc_ring *ring,
+		   const struct spsc_desc *desc);
+
+unsigned int spsc_ring_used(const struct spsc_ring *ring);
+
+const struct spsc_desc *spsc_ring_oldest(const struct spsc_ring *ring);
+
+void spsc_ring_wake(struct spsc_ring *ring);
+
+unsigned int spsc_ring_peek(const struct spsc_ring *ring,
+			    const struct spsc_desc *descs[],
+			    const unsigned int descs_max);
+
+void spsc_ring_release(struct spsc_ring *ring,
+		       const unsigned int descs_num);
+
+void spsc_ring_wait(struct spsc_ring *ring);
+
+#endif /* __SPSCRING_H */
@@ -0,0 +1,283 @@
+/*
+ * txbench - compare transmitting each datagram to many destinations through
+ * one unconnected UDP socket against a connected UDP socket per destination
+ *
+ * Copyright (C) 2011 Mark Smith <markzzzsmith@yahoo.com.au>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+/*
+ * Usage: txbench [dests ...]
+ *
+ * For each number of destinations (10, 100 and 1000 by default), binds that
+ * many UDP sockets to 127.0.0.1, then times sending a burst of datagrams to
+ * all of them, first the way replicast does by default, with sendmmsg()
+ * naming each destination, and then the way -4connect does, with send() on a
+ * socket connected to each destination. The receiving sockets are never
+ * read, so datagrams beyond their buffers are dropped by the kernel after
+ * the send has completed.
+ *
+ * Only the system calls are timed. Both ways are reimplemented here as a
+ * bare sendmmsg() and send() loop, rather than going through replicast's
+ * tx_dests_rcast(), so the results are the difference between the two kinds
+ * of send, without replicast's per destination counters, error handling or
+ * batching around them. replicast's own cost per datagram, either way, is
+ * measured with rcbench.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+
+enum TXBENCH_DEFS {
+	TXBENCH_PORT_BASE = 20000,
+	TXBENCH_PKT_LEN = 1316,
+	TXBENCH_SENDS = 1000000,
+};
+
+
+struct bench_dests {
+	unsigned int num;
+	struct sockaddr_in *addrs;
+	int *rx_fds;
+	int *conn_fds;
+	int tx_fd;
+	struct mmsghdr *mmsgs;
+};
+
+
+static uint8_t pkt[TXBENCH_PKT_LEN];
+
+
+static double now_secs(void)
+{
+	struct timespec ts;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+
+}
+
+
+static int open_bench_dests(struct bench_dests *dests, const unsigned int num)
+{
+	static struct iovec pkt_iov = { pkt, sizeof(pkt) };
+	unsigned int i;
+
+
+	dests->num = num;
+	dests->addrs = calloc(num, sizeof(struct sockaddr_in));
+	dests->rx_fds = calloc(num, sizeof(int));
+	dests->conn_fds = calloc(num, sizeof(int));
+	dests->mmsgs = calloc(num, sizeof(struct mmsghdr));
+	if ((dests->addrs == NULL) || (dests->rx_fds == NULL) ||
+	    (dests->conn_fds == NULL) || (dests->mmsgs == NULL)) {
+		return -1;
+	}
+
+	dests->tx_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (dests->tx_fd == -1) {
+		return -1;
+	}
+
+	for (i = 0; i < num; i++) {
+		dests->addrs[i].sin_family = AF_INET;
+		dests->addrs[i].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		dests->addrs[i].sin_port = htons(TXBENCH_PORT_BASE + i);
+
+		dests->rx_fds[i] = socket(AF_INET, SOCK_DGRAM, 0);
+		if ((dests->rx_fds[i] == -1) ||
+		    (bind(dests->rx_fds[i],
+			  (const struct sockaddr *)&dests->addrs[i],
+			  sizeof(struct sockaddr_in)) == -1)) {
+			return -1;
+		}
+
+		dests->conn_fds[i] = socket(AF_INET, SOCK_DGRAM, 0);
+		if ((dests->conn_fds[i] == -1) ||
+		    (connect(dests->conn_fds[i],
+			     (const struct sockaddr *)&dests->addrs[i],
+			     sizeof(struct sockaddr_in)) == -1)) {
+			return -1;
+		}
+
+		dests->mmsgs[i].msg_hdr.msg_name = &dests->addrs[i];
+		dests->mmsgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+		dests->mmsgs[i].msg_hdr.msg_iov = &pkt_iov;
+		dests->mmsgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	return 0;
+
+}
+
+
+static void close_bench_dests(struct bench_dests *dests)
+{
+	unsigned int i;
+
+
+	for (i = 0; i < dests->num; i++) {
+		close(dests->rx_fds[i]);
+		close(dests->conn_fds[i]);
+	}
+	close(dests->tx_fd);
+
+	free(dests->addrs);
+	free(dests->rx_fds);
+	free(dests->conn_fds);
+	free(dests->mmsgs);
+
+}
+
+
+/*
+ * Both return the number of datagram sends that succeeded, out of
+ * rounds * dests->num. They stand in for the system calls
+ * tx_dests_rcast() makes, not for the function itself.
+ */
+static unsigned long unconn_rcast(const struct bench_dests *dests,
+				  const unsigned int rounds)
+{
+	unsigned long sends = 0;
+	unsigned int round;
+	unsigned int dest_num;
+	int ret;
+
+
+	for (round = 0; round < rounds; round++) {
+		dest_num = 0;
+		while (dest_num < dests->num) {
+			ret = sendmmsg(dests->tx_fd, &dests->mmsgs[dest_num],
+				dests->num - dest_num, 0);
+			if (ret > 0) {
+				sends += ret;
+				dest_num += ret;
+			} else {
+				dest_num++;
+			}
+		}
+	}
+
+	return sends;
+
+}
+
+
+static unsigned long conn_rcast(const struct bench_dests *dests,
+				const unsigned int rounds)
+{
+	unsigned long sends = 0;
+	unsigned int round;
+	unsigned int dest_num;
+
+
+	for (round = 0; round < rounds; round++) {
+		for (dest_num = 0; dest_num < dests->num; dest_num++) {
+			if (send(dests->conn_fds[dest_num], pkt, sizeof(pkt),
+				 0) != -1) {
+				sends++;
+			}
+		}
+	}
+
+	return sends;
+
+}
+
+
+static void log_bench_result(const char *name,
+			     const unsigned int dests_num,
+			     const unsigned long sends,
+			     const double secs)
+{
+
+
+	printf("%5u dests, %-11s %9.0f sends/sec, %7.1f nsecs/send "
+		"(%lu sends)\n", dests_num, name, sends / secs,
+		(secs * 1e9) / sends, sends);
+
+}
+
+
+int main(int argc, char *argv[])
+{
+	static const unsigned int default_dests[] = { 10, 100, 1000 };
+	struct bench_dests dests;
+	struct rlimit nofile;
+	unsigned int dests_num;
+	unsigned int rounds;
+	unsigned long sends;
+	unsigned int i;
+	unsigned int runs;
+	double start;
+
+
+	memset(pkt, 0xa5, sizeof(pkt));
+
+	/* two sockets for each destination */
+	if (getrlimit(RLIMIT_NOFILE, &nofile) == 0) {
+		nofile.rlim_cur = nofile.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &nofile);
+	}
+
+	runs = (argc > 1) ? (argc - 1) : 3;
+	for (i = 0; i < runs; i++) {
+		dests_num = (argc > 1) ? strtoul(argv[i + 1], NULL, 10) :
+							default_dests[i];
+		if ((dests_num == 0) ||
+		    (dests_num > (65535 - TXBENCH_PORT_BASE))) {
+			fprintf(stderr, "invalid number of destinations\n");
+			return EXIT_FAILURE;
+		}
+		rounds = TXBENCH_SENDS / dests_num;
+
+		if (open_bench_dests(&dests, dests_num) == -1) {
+			fprintf(stderr, "opening %u destinations: %s\n",
+				dests_num, strerror(errno));
+			return EXIT_FAILURE;
+		}
+
+		start = now_secs();
+		sends = unconn_rcast(&dests, rounds);
+		log_bench_result("unconnected", dests_num, sends,
+			now_secs() - start);
+
+		start = now_secs();
+		sends = conn_rcast(&dests, rounds);
+		log_bench_result("connected", dests_num, sends,
+			now_secs() - start);
+
+		close_bench_dests(&dests);
+	}
+
+	return EXIT_SUCCESS;
+
+}
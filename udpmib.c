@@ -0,0 +1,130 @@
+/*
+ * udpmib - read the UDP counters of the kernel's IPv4 and IPv6 MIBs from
+ * /proc/net/snmp and /proc/net/snmp6
+ *
+ * Copyright (C) 2011 Mark Smith <markzzzsmith@yahoo.com.au>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA. 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "udpmib.h"
+
+
+enum UDPMIB_DEFS {
+	UDPMIB_LINE_SIZE = 1024,
+};
+
+
+/*
+ * /proc/net/snmp has a line of counter names for each protocol, followed by
+ * a line of their values, e.g.
+ *
+ * Udp: InDatagrams NoPorts InErrors OutDatagrams RcvbufErrors SndbufErrors
+ * Udp: 341013 312703 488470 1140920 488470 0
+ *
+ * The columns are found by name, as counters have been added over time.
+ */
+int udp_mib_inet_read(struct udp_mib *mib)
+{
+	FILE *snmp;
+	char names[UDPMIB_LINE_SIZE];
+	char values[UDPMIB_LINE_SIZE];
+	char *names_save;
+	char *values_save;
+	char *name;
+	char *value;
+	int found = 0;
+
+
+	snmp = fopen("/proc/net/snmp", "r");
+	if (snmp == NULL) {
+		return -1;
+	}
+
+	while (fgets(names, sizeof(names), snmp) != NULL) {
+		if (strncmp(names, "Udp: ", 5) == 0) {
+			found = (fgets(values, sizeof(values), snmp) != NULL);
+			break;
+		}
+	}
+
+	fclose(snmp);
+
+	if (!found) {
+		return -1;
+	}
+
+	mib->rcvbuf_errors = 0;
+	mib->sndbuf_errors = 0;
+
+	name = strtok_r(names, " \n", &names_save);
+	value = strtok_r(values, " \n", &values_save);
+	while ((name != NULL) && (value != NULL)) {
+		if (strcmp(name, "RcvbufErrors") == 0) {
+			mib->rcvbuf_errors = strtoull(value, NULL, 10);
+		} else if (strcmp(name, "SndbufErrors") == 0) {
+			mib->sndbuf_errors = strtoull(value, NULL, 10);
+		}
+		name = strtok_r(NULL, " \n", &names_save);
+		value = strtok_r(NULL, " \n", &values_save);
+	}
+
+	return 0;
+
+}
+
+
+/*
+ * /proc/net/snmp6 has a counter name and value on each line, e.g.
+ *
+ * Udp6RcvbufErrors                	13815
+ */
+int udp_mib_inet6_read(struct udp_mib *mib)
+{
+	FILE *snmp6;
+	char line[UDPMIB_LINE_SIZE];
+	char name[64];
+	unsigned long long value;
+
+
+	snmp6 = fopen("/proc/net/snmp6", "r");
+	if (snmp6 == NULL) {
+		return -1;
+	}
+
+	mib->rcvbuf_errors = 0;
+	mib->sndbuf_errors = 0;
+
+	while (fgets(line, sizeof(line), snmp6) != NULL) {
+		if (sscanf(line, "%63s %llu", name, &value) != 2) {
+			continue;
+		}
+		if (strcmp(name, "Udp6RcvbufErrors") == 0) {
+			mib->rcvbuf_errors = value;
+		} else if (strcmp(name, "Udp6SndbufErrors") == 0) {
+			mib->sndbuf_errors = value;
+		}
+	}
+
+	fclose(snmp6);
+
+	return 0;
+
+}
@@ -0,0 +1,40 @@
+/*
+ * udpmib - read the UDP counters of the kernel's IPv4 and IPv6 MIBs from
+ * /proc/net/snmp and /proc/net/snmp6
+ *
+ * Copyright (C) 2011 Mark Smith <markzzzsmith@yahoo.com.au>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA. 
+ */
+#ifndef __UDPMIB_H
+#define __UDPMIB_H
+
+
+/*
+ * The counts of datagrams the kernel dropped because a socket's receive or
+ * send buffer was full, for every UDP socket in the network namespace.
+ */
+struct udp_mib {
+	unsigned long long rcvbuf_errors;
+	unsigned long long sndbuf_errors;
+};
+
+
+int udp_mib_inet_read(struct udp_mib *mib);
+
+int udp_mib_inet6_read(struct udp_mib *mib);
+
+#endif /* __UDPMIB_H */
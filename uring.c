@@ -0,0 +1,320 @@
+/*
+ * uring - minimal Linux io_uring submission and completion ring routines,
+ * using the system calls directly
+ *
+ * Copyright (C) 2011 Mark Smith <markzzzsmith@yahoo.com.au>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA. 
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "uring.h"
+
+
+/*
+ * The kernel and this process share the ring heads and tails, so reads of
+ * the other side's index need acquire ordering, and publishing our own
+ * index needs release ordering.
+ */
+#define uring_load_acquire(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define uring_store_release(p, v)	__atomic_store_n((p), (v), \
+							__ATOMIC_RELEASE)
+
+
+int uring_init(struct uring *ring,
+	       const unsigned int entries)
+{
+	struct io_uring_params params;
+	int ring_fd;
+	void *cq_ring;
+
+
+	memset(ring, 0, sizeof(*ring));
+	ring->ring_fd = -1;
+
+	/*
+	 * Replication produces a completion per destination for each
+	 * received datagram, so the completion ring is made larger than the
+	 * submission ring.
+	 */
+	memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = entries * 4;
+
+	ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+	if (ring_fd == -1) {
+		return -1;
+	}
+	ring->ring_fd = ring_fd;
+
+	ring->sq_ring_size = params.sq_off.array +
+					(params.sq_entries * sizeof(unsigned int));
+	ring->cq_ring_size = params.cq_off.cqes +
+			(params.cq_entries * sizeof(struct io_uring_cqe));
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_ring_size > ring->sq_ring_size) {
+			ring->sq_ring_size = ring->cq_ring_size;
+		}
+		ring->cq_ring_size = ring->sq_ring_size;
+	}
+
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED) {
+		ring->sq_ring = NULL;
+		uring_exit(ring);
+		return -1;
+	}
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		cq_ring = ring->sq_ring;
+	} else {
+		cq_ring = mmap(NULL, ring->cq_ring_size,
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			ring_fd, IORING_OFF_CQ_RING);
+		if (cq_ring == MAP_FAILED) {
+			uring_exit(ring);
+			return -1;
+		}
+		ring->cq_ring = cq_ring;
+	}
+
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		ring->sqes = NULL;
+		uring_exit(ring);
+		return -1;
+	}
+
+	ring->sq_head = ring->sq_ring + params.sq_off.head;
+	ring->sq_tail = ring->sq_ring + params.sq_off.tail;
+	ring->sq_mask = *(unsigned int *)(ring->sq_ring +
+							params.sq_off.ring_mask);
+	ring->sq_entries = params.sq_entries;
+	ring->sq_array = ring->sq_ring + params.sq_off.array;
+	ring->sq_local_tail = *ring->sq_tail;
+
+	ring->cq_head = cq_ring + params.cq_off.head;
+	ring->cq_tail = cq_ring + params.cq_off.tail;
+	ring->cq_mask = *(unsigned int *)(cq_ring + params.cq_off.ring_mask);
+	ring->cqes = cq_ring + params.cq_off.cqes;
+
+	return 0;
+
+}
+
+
+void uring_exit(struct uring *ring)
+{
+
+
+	if (ring->sqes != NULL) {
+		munmap(ring->sqes, ring->sqes_size);
+		ring->sqes = NULL;
+	}
+
+	if (ring->cq_ring != NULL) {
+		munmap(ring->cq_ring, ring->cq_ring_size);
+		ring->cq_ring = NULL;
+	}
+
+	if (ring->sq_ring != NULL) {
+		munmap(ring->sq_ring, ring->sq_ring_size);
+		ring->sq_ring = NULL;
+	}
+
+	if (ring->ring_fd != -1) {
+		close(ring->ring_fd);
+		ring->ring_fd = -1;
+	}
+
+}
+
+
+struct io_uring_sqe *uring_get_sqe(struct uring *ring)
+{
+	unsigned int head;
+	unsigned int idx;
+	struct io_uring_sqe *sqe;
+
+
+	head = uring_load_acquire(ring->sq_head);
+	if ((ring->sq_local_tail - head) >= ring->sq_entries) {
+		return NULL;
+	}
+
+	idx = ring->sq_local_tail & ring->sq_mask;
+	ring->sq_array[idx] = idx;
+	ring->sq_local_tail++;
+
+	sqe = &ring->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+
+	return sqe;
+
+}
+
+
+unsigned int uring_sq_pending(const struct uring *ring)
+{
+
+
+	/*
+	 * Without SQPOLL the kernel only consumes entries inside
+	 * io_uring_enter(), so anything between its head and our tail,
+	 * published or not, is still to be submitted.
+	 */
+	return ring->sq_local_tail - uring_load_acquire(ring->sq_head);
+
+}
+
+
+int uring_enter(struct uring *ring,
+		const unsigned int wait_nr)
+{
+	unsigned int to_submit;
+	unsigned int flags = 0;
+	int ret;
+
+
+	uring_store_release(ring->sq_tail, ring->sq_local_tail);
+	to_submit = uring_sq_pending(ring);
+
+	if (wait_nr > 0) {
+		flags |= IORING_ENTER_GETEVENTS;
+	}
+
+	ret = syscall(__NR_io_uring_enter, ring->ring_fd, to_submit, wait_nr,
+		flags, NULL, 0);
+
+	return ret;
+
+}
+
+
+struct io_uring_cqe *uring_peek_cqe(struct uring *ring)
+{
+	unsigned int head;
+	unsigned int tail;
+
+
+	head = *ring->cq_head;
+	tail = uring_load_acquire(ring->cq_tail);
+	if (head == tail) {
+		return NULL;
+	}
+
+	return &ring->cqes[head & ring->cq_mask];
+
+}
+
+
+void uring_cqe_seen(struct uring *ring)
+{
+
+
+	uring_store_release(ring->cq_head, *ring->cq_head + 1);
+
+}
+
+
+int uring_buf_ring_init(struct uring *ring,
+			struct uring_buf_ring *buf_ring,
+			const unsigned int entries,
+			const unsigned short bgid)
+{
+	struct io_uring_buf_reg reg;
+	int ret;
+
+
+	buf_ring->entries = entries;
+	buf_ring->mask = entries - 1;
+	buf_ring->bgid = bgid;
+	buf_ring->local_tail = 0;
+
+	buf_ring->br_size = entries * sizeof(struct io_uring_buf);
+	buf_ring->br = mmap(NULL, buf_ring->br_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf_ring->br == MAP_FAILED) {
+		buf_ring->br = NULL;
+		return -1;
+	}
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long)buf_ring->br;
+	reg.ring_entries = entries;
+	reg.bgid = bgid;
+
+	ret = syscall(__NR_io_uring_register, ring->ring_fd,
+		IORING_REGISTER_PBUF_RING, &reg, 1);
+	if (ret == -1) {
+		munmap(buf_ring->br, buf_ring->br_size);
+		buf_ring->br = NULL;
+		return -1;
+	}
+
+	return 0;
+
+}
+
+
+void uring_buf_ring_add(struct uring_buf_ring *buf_ring,
+			void *buf,
+			const unsigned int buf_len,
+			const unsigned short bid)
+{
+	struct io_uring_buf *ring_buf;
+
+
+	ring_buf = &buf_ring->br->bufs[buf_ring->local_tail & buf_ring->mask];
+	ring_buf->addr = (unsigned long)buf;
+	ring_buf->len = buf_len;
+	ring_buf->bid = bid;
+
+	buf_ring->local_tail++;
+
+}
+
+
+void uring_buf_ring_advance(struct uring_buf_ring *buf_ring)
+{
+
+
+	uring_store_release(&buf_ring->br->tail, buf_ring->local_tail);
+
+}
+
+
+/* only once the ring it was registered with has been closed */
+void uring_buf_ring_exit(struct uring_buf_ring *buf_ring)
+{
+
+
+	if (buf_ring->br != NULL) {
+		munmap(buf_ring->br, buf_ring->br_size);
+		buf_ring->br = NULL;
+	}
+
+}
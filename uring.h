@@ -0,0 +1,93 @@
+/*
+ * uring - minimal Linux io_uring submission and completion ring routines,
+ * using the system calls directly
+ *
+ * Copyright (C) 2011 Mark Smith <markzzzsmith@yahoo.com.au>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA. 
+ */
+#ifndef __URING_H
+#define __URING_H
+
+#include <stddef.h>
+
+#include <linux/io_uring.h>
+
+
+struct uring {
+	int ring_fd;
+
+	void *sq_ring;
+	size_t sq_ring_size;
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int sq_mask;
+	unsigned int sq_entries;
+	unsigned int *sq_array;
+	unsigned int sq_local_tail;
+
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	void *cq_ring;
+	size_t cq_ring_size;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int cq_mask;
+	struct io_uring_cqe *cqes;
+};
+
+struct uring_buf_ring {
+	struct io_uring_buf_ring *br;
+	size_t br_size;
+	unsigned int entries;
+	unsigned int mask;
+	unsigned short bgid;
+	unsigned short local_tail;
+};
+
+
+int uring_init(struct uring *ring,
+	       const unsigned int entries);
+
+void uring_exit(struct uring *ring);
+
+struct io_uring_sqe *uring_get_sqe(struct uring *ring);
+
+unsigned int uring_sq_pending(const struct uring *ring);
+
+int uring_enter(struct uring *ring,
+		const unsigned int wait_nr);
+
+struct io_uring_cqe *uring_peek_cqe(struct uring *ring);
+
+void uring_cqe_seen(struct uring *ring);
+
+int uring_buf_ring_init(struct uring *ring,
+			struct uring_buf_ring *buf_ring,
+			const unsigned int entries,
+			const unsigned short bgid);
+
+void uring_buf_ring_add(struct uring_buf_ring *buf_ring,
+			void *buf,
+			const unsigned int buf_len,
+			const unsigned short bid);
+
+void uring_buf_ring_advance(struct uring_buf_ring *buf_ring);
+
+void uring_buf_ring_exit(struct uring_buf_ring *buf_ring);
+
+#endif /* __URING_H */
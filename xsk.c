@@ -0,0 +1,635 @@
+/*
+ * xsk - minimal Linux AF_XDP receive socket, with an XDP program that
+ * redirects a single UDP destination address and port to it
+ *
+ * Copyright (C) 2011 Mark Smith <markzzzsmith@yahoo.com.au>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA. 
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include "xsk.h"
+
+
+/*
+ * The kernel and this process share the ring producer and consumer
+ * indexes, so reads of the kernel's index need acquire ordering, and
+ * publishing our own index needs release ordering.
+ */
+#define xsk_load_acquire(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define xsk_store_release(p, v)		__atomic_store_n((p), (v), \
+							__ATOMIC_RELEASE)
+
+/*
+ * eBPF instruction encoding, as per the kernel's include/linux/filter.h.
+ */
+#define XSK_INSN(c, d, s, o, i)						\
+	((struct bpf_insn) {						\
+		.code = (c), .dst_reg = (d), .src_reg = (s),		\
+		.off = (o), .imm = (i) })
+
+#define XSK_MOV64_REG(d, s)	XSK_INSN(BPF_ALU64 | BPF_MOV | BPF_X, d, s, 0, 0)
+#define XSK_MOV64_IMM(d, i)	XSK_INSN(BPF_ALU64 | BPF_MOV | BPF_K, d, 0, 0, i)
+#define XSK_ADD64_IMM(d, i)	XSK_INSN(BPF_ALU64 | BPF_ADD | BPF_K, d, 0, 0, i)
+#define XSK_AND32_IMM(d, i)	XSK_INSN(BPF_ALU | BPF_AND | BPF_K, d, 0, 0, i)
+#define XSK_LDX_MEM(sz, d, s, o) XSK_INSN(BPF_LDX | BPF_MEM | (sz), d, s, o, 0)
+#define XSK_JGT64_REG(d, s, o)	XSK_INSN(BPF_JMP | BPF_JGT | BPF_X, d, s, o, 0)
+#define XSK_JNE32_IMM(d, i, o)	XSK_INSN(BPF_JMP32 | BPF_JNE | BPF_K, d, 0, o, i)
+#define XSK_CALL(f)		XSK_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, f)
+#define XSK_EXIT()		XSK_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0)
+
+enum XSK_PROG_DEFS {
+	XSK_PROG_INSNS_MAX = 64,
+	XSK_ETH_HLEN = 14,
+	XSK_IP_HLEN = 20,
+	XSK_IP6_HLEN = 40,
+	XSK_UDP_HLEN = 8,
+};
+
+struct xsk_prog {
+	struct bpf_insn insns[XSK_PROG_INSNS_MAX];
+	unsigned int insns_num;
+	unsigned int pass_jumps[XSK_PROG_INSNS_MAX];
+	unsigned int pass_jumps_num;
+};
+
+
+static int xsk_bpf(const int cmd,
+		   union bpf_attr *attr);
+
+static int xsk_ring_map(struct xsk_ring *ring,
+			const int sock_fd,
+			const struct xdp_ring_offset *off,
+			const unsigned int size,
+			const size_t desc_size,
+			const off_t pgoff);
+
+static void xsk_ring_unmap(struct xsk_ring *ring);
+
+static int xsk_setup(struct xsk *xsk,
+		     const unsigned int ifindex,
+		     const unsigned int queue_id,
+		     const unsigned int skb_mode);
+
+static void xsk_prog_emit(struct xsk_prog *prog,
+			  const struct bpf_insn insn);
+
+static void xsk_prog_match(struct xsk_prog *prog,
+			   const int size,
+			   const short offset,
+			   const int value);
+
+static void xsk_prog_build(struct xsk_prog *prog,
+			   const int map_fd,
+			   const int family,
+			   const void *dst_addr,
+			   const unsigned int dst_port);
+
+
+static int xsk_bpf(const int cmd,
+		   union bpf_attr *attr)
+{
+
+
+	return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+
+}
+
+
+static int xsk_ring_map(struct xsk_ring *ring,
+			const int sock_fd,
+			const struct xdp_ring_offset *off,
+			const unsigned int size,
+			const size_t desc_size,
+			const off_t pgoff)
+{
+
+
+	ring->size = size;
+	ring->mask = size - 1;
+	ring->map_size = off->desc + (size * desc_size);
+	ring->map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, sock_fd, pgoff);
+	if (ring->map == MAP_FAILED) {
+		ring->map = NULL;
+		return -1;
+	}
+
+	ring->producer = ring->map + off->producer;
+	ring->consumer = ring->map + off->consumer;
+	ring->descs = ring->map + off->desc;
+
+	return 0;
+
+}
+
+
+static void xsk_ring_unmap(struct xsk_ring *ring)
+{
+
+
+	if (ring->map != NULL) {
+		munmap(ring->map, ring->map_size);
+		ring->map = NULL;
+	}
+
+}
+
+
+int xsk_open(struct xsk *xsk,
+	     const unsigned int ifindex,
+	     const unsigned int queue_id,
+	     const unsigned int skb_mode)
+{
+	int saved_errno;
+
+
+	memset(xsk, 0, sizeof(*xsk));
+	xsk->sock_fd = -1;
+	xsk->map_fd = -1;
+	xsk->prog_fd = -1;
+	xsk->link_fd = -1;
+
+	if (xsk_setup(xsk, ifindex, queue_id, skb_mode) == -1) {
+		saved_errno = errno;
+		xsk_close(xsk);
+		errno = saved_errno;
+		return -1;
+	}
+
+	return 0;
+
+}
+
+
+static int xsk_setup(struct xsk *xsk,
+		     const unsigned int ifindex,
+		     const unsigned int queue_id,
+		     const unsigned int skb_mode)
+{
+	struct xdp_umem_reg umem_reg;
+	struct xdp_mmap_offsets offs;
+	struct sockaddr_xdp sxdp;
+	socklen_t offs_len;
+	unsigned int ring_size;
+	unsigned int i;
+
+
+	xsk->sock_fd = socket(AF_XDP, SOCK_RAW, 0);
+	if (xsk->sock_fd == -1) {
+		return -1;
+	}
+
+	xsk->umem_size = XSK_FRAMES_NUM * XSK_FRAME_SIZE;
+	xsk->umem = mmap(NULL, xsk->umem_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if (xsk->umem == MAP_FAILED) {
+		xsk->umem = NULL;
+		return -1;
+	}
+
+	xsk->held_addrs = calloc(XSK_FRAMES_NUM, sizeof(uint64_t));
+	if (xsk->held_addrs == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	memset(&umem_reg, 0, sizeof(umem_reg));
+	umem_reg.addr = (unsigned long)xsk->umem;
+	umem_reg.len = xsk->umem_size;
+	umem_reg.chunk_size = XSK_FRAME_SIZE;
+	umem_reg.headroom = 0;
+	if (setsockopt(xsk->sock_fd, SOL_XDP, XDP_UMEM_REG, &umem_reg,
+						sizeof(umem_reg)) == -1) {
+		return -1;
+	}
+
+	/*
+	 * The fill ring can hold every frame, so frames handed back after
+	 * being received never have to wait for room in it.
+	 */
+	ring_size = XSK_FRAMES_NUM;
+	if (setsockopt(xsk->sock_fd, SOL_XDP, XDP_UMEM_FILL_RING, &ring_size,
+						sizeof(ring_size)) == -1) {
+		return -1;
+	}
+
+	ring_size = XSK_COMP_RING_SIZE;
+	if (setsockopt(xsk->sock_fd, SOL_XDP, XDP_UMEM_COMPLETION_RING,
+				&ring_size, sizeof(ring_size)) == -1) {
+		return -1;
+	}
+
+	ring_size = XSK_FRAMES_NUM;
+	if (setsockopt(xsk->sock_fd, SOL_XDP, XDP_RX_RING, &ring_size,
+						sizeof(ring_size)) == -1) {
+		return -1;
+	}
+
+	offs_len = sizeof(offs);
+	if (getsockopt(xsk->sock_fd, SOL_XDP, XDP_MMAP_OFFSETS, &offs,
+							&offs_len) == -1) {
+		return -1;
+	}
+
+	if ((xsk_ring_map(&xsk->fill, xsk->sock_fd, &offs.fr, XSK_FRAMES_NUM,
+		sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING) == -1) ||
+	    (xsk_ring_map(&xsk->comp, xsk->sock_fd, &offs.cr,
+		XSK_COMP_RING_SIZE, sizeof(uint64_t),
+		XDP_UMEM_PGOFF_COMPLETION_RING) == -1) ||
+	    (xsk_ring_map(&xsk->rx, xsk->sock_fd, &offs.rx, XSK_FRAMES_NUM,
+		sizeof(struct xdp_desc), XDP_PGOFF_RX_RING) == -1)) {
+		return -1;
+	}
+
+	for (i = 0; i < XSK_FRAMES_NUM; i++) {
+		((uint64_t *)xsk->fill.descs)[i] = i * XSK_FRAME_SIZE;
+	}
+	xsk_store_release(xsk->fill.producer, XSK_FRAMES_NUM);
+
+	memset(&sxdp, 0, sizeof(sxdp));
+	sxdp.sxdp_family = AF_XDP;
+	sxdp.sxdp_ifindex = ifindex;
+	sxdp.sxdp_queue_id = queue_id;
+	if (skb_mode) {
+		sxdp.sxdp_flags = XDP_COPY;
+	}
+	if (bind(xsk->sock_fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) == -1) {
+		return -1;
+	}
+
+	return 0;
+
+}
+
+
+static void xsk_prog_emit(struct xsk_prog *prog,
+			  const struct bpf_insn insn)
+{
+
+
+	prog->insns[prog->insns_num++] = insn;
+
+}
+
+
+/*
+ * Load a packet field and jump to the pass exit if it doesn't match. The
+ * loaded value is the field's bytes in network order, so the match value
+ * must be too.
+ */
+static void xsk_prog_match(struct xsk_prog *prog,
+			   const int size,
+			   const short offset,
+			   const int value)
+{
+
+
+	xsk_prog_emit(prog, XSK_LDX_MEM(size, BPF_REG_5, BPF_REG_2, offset));
+	prog->pass_jumps[prog->pass_jumps_num++] = prog->insns_num;
+	xsk_prog_emit(prog, XSK_JNE32_IMM(BPF_REG_5, value, 0));
+
+}
+
+
+static void xsk_prog_build(struct xsk_prog *prog,
+			   const int map_fd,
+			   const int family,
+			   const void *dst_addr,
+			   const unsigned int dst_port)
+{
+	const struct in_addr *in_addr = dst_addr;
+	const struct in6_addr *in6_addr = dst_addr;
+	unsigned int hdrs_len;
+	unsigned int i;
+
+
+	prog->insns_num = 0;
+	prog->pass_jumps_num = 0;
+
+	if (family == AF_INET) {
+		hdrs_len = XSK_ETH_HLEN + XSK_IP_HLEN + XSK_UDP_HLEN;
+	} else {
+		hdrs_len = XSK_ETH_HLEN + XSK_IP6_HLEN + XSK_UDP_HLEN;
+	}
+
+	/*
+	 * r6 = ctx, r2 = data, r3 = data_end, and the headers must all be
+	 * within the frame before any of them can be read.
+	 */
+	xsk_prog_emit(prog, XSK_MOV64_REG(BPF_REG_6, BPF_REG_1));
+	xsk_prog_emit(prog, XSK_LDX_MEM(BPF_W, BPF_REG_2, BPF_REG_6,
+				offsetof(struct xdp_md, data)));
+	xsk_prog_emit(prog, XSK_LDX_MEM(BPF_W, BPF_REG_3, BPF_REG_6,
+				offsetof(struct xdp_md, data_end)));
+	xsk_prog_emit(prog, XSK_MOV64_REG(BPF_REG_4, BPF_REG_2));
+	xsk_prog_emit(prog, XSK_ADD64_IMM(BPF_REG_4, hdrs_len));
+	prog->pass_jumps[prog->pass_jumps_num++] = prog->insns_num;
+	xsk_prog_emit(prog, XSK_JGT64_REG(BPF_REG_4, BPF_REG_3, 0));
+
+	/*
+	 * Only unfragmented IPv4 datagrams without options, and IPv6
+	 * datagrams without extension headers, are redirected. Anything
+	 * else goes to the stack and is received by the UDP socket.
+	 */
+	if (family == AF_INET) {
+		xsk_prog_match(prog, BPF_H, 12, htons(ETH_P_IP));
+		xsk_prog_match(prog, BPF_B, XSK_ETH_HLEN, 0x45);
+		xsk_prog_match(prog, BPF_B, XSK_ETH_HLEN + 9, IPPROTO_UDP);
+
+		xsk_prog_emit(prog, XSK_LDX_MEM(BPF_H, BPF_REG_5, BPF_REG_2,
+							XSK_ETH_HLEN + 6));
+		xsk_prog_emit(prog, XSK_AND32_IMM(BPF_REG_5, htons(0x3fff)));
+		prog->pass_jumps[prog->pass_jumps_num++] = prog->insns_num;
+		xsk_prog_emit(prog, XSK_JNE32_IMM(BPF_REG_5, 0, 0));
+
+		if (dst_addr != NULL) {
+			xsk_prog_match(prog, BPF_W, XSK_ETH_HLEN + 16,
+							in_addr->s_addr);
+		}
+		xsk_prog_match(prog, BPF_H, XSK_ETH_HLEN + XSK_IP_HLEN + 2,
+							htons(dst_port));
+	} else {
+		xsk_prog_match(prog, BPF_H, 12, htons(ETH_P_IPV6));
+		xsk_prog_match(prog, BPF_B, XSK_ETH_HLEN + 6, IPPROTO_UDP);
+		if (dst_addr != NULL) {
+			for (i = 0; i < 4; i++) {
+				xsk_prog_match(prog, BPF_W,
+					XSK_ETH_HLEN + 24 + (i * 4),
+					in6_addr->s6_addr32[i]);
+			}
+		}
+		xsk_prog_match(prog, BPF_H, XSK_ETH_HLEN + XSK_IP6_HLEN + 2,
+							htons(dst_port));
+	}
+
+	/*
+	 * return bpf_redirect_map(&xsks, ctx->rx_queue_index, XDP_PASS),
+	 * which passes the frame if this queue has no socket in the map.
+	 */
+	xsk_prog_emit(prog, XSK_INSN(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1,
+					BPF_PSEUDO_MAP_FD, 0, map_fd));
+	xsk_prog_emit(prog, XSK_INSN(0, 0, 0, 0, 0));
+	xsk_prog_emit(prog, XSK_LDX_MEM(BPF_W, BPF_REG_2, BPF_REG_6,
+				offsetof(struct xdp_md, rx_queue_index)));
+	xsk_prog_emit(prog, XSK_MOV64_IMM(BPF_REG_3, XDP_PASS));
+	xsk_prog_emit(prog, XSK_CALL(BPF_FUNC_redirect_map));
+	xsk_prog_emit(prog, XSK_EXIT());
+
+	for (i = 0; i < prog->pass_jumps_num; i++) {
+		prog->insns[prog->pass_jumps[i]].off = prog->insns_num -
+						prog->pass_jumps[i] - 1;
+	}
+
+	xsk_prog_emit(prog, XSK_MOV64_IMM(BPF_REG_0, XDP_PASS));
+	xsk_prog_emit(prog, XSK_EXIT());
+
+}
+
+
+int xsk_udp_redirect_attach(struct xsk *xsk,
+			    const unsigned int ifindex,
+			    const unsigned int queue_id,
+			    const unsigned int skb_mode,
+			    const int family,
+			    const void *dst_addr,
+			    const unsigned int dst_port)
+{
+	struct xsk_prog prog;
+	union bpf_attr attr;
+	unsigned int key = queue_id;
+	int value = xsk->sock_fd;
+
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_type = BPF_MAP_TYPE_XSKMAP;
+	attr.key_size = sizeof(key);
+	attr.value_size = sizeof(value);
+	attr.max_entries = queue_id + 1;
+	xsk->map_fd = xsk_bpf(BPF_MAP_CREATE, &attr);
+	if (xsk->map_fd == -1) {
+		return -1;
+	}
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_fd = xsk->map_fd;
+	attr.key = (unsigned long)&key;
+	attr.value = (unsigned long)&value;
+	attr.flags = BPF_ANY;
+	if (xsk_bpf(BPF_MAP_UPDATE_ELEM, &attr) == -1) {
+		return -1;
+	}
+
+	xsk_prog_build(&prog, xsk->map_fd, family, dst_addr, dst_port);
+
+	memset(&attr, 0, sizeof(attr));
+	attr.prog_type = BPF_PROG_TYPE_XDP;
+	attr.insns = (unsigned long)prog.insns;
+	attr.insn_cnt = prog.insns_num;
+	attr.license = (unsigned long)"GPL";
+	xsk->prog_fd = xsk_bpf(BPF_PROG_LOAD, &attr);
+	if (xsk->prog_fd == -1) {
+		return -1;
+	}
+
+	/*
+	 * Attaching through a BPF link detaches the program automatically
+	 * when the link is closed, including when the process exits.
+	 */
+	memset(&attr, 0, sizeof(attr));
+	attr.link_create.prog_fd = xsk->prog_fd;
+	attr.link_create.target_ifindex = ifindex;
+	attr.link_create.attach_type = BPF_XDP;
+	if (skb_mode) {
+		attr.link_create.flags = XDP_FLAGS_SKB_MODE;
+	}
+	xsk->link_fd = xsk_bpf(BPF_LINK_CREATE, &attr);
+	if (xsk->link_fd == -1) {
+		return -1;
+	}
+
+	return 0;
+
+}
+
+
+unsigned int xsk_rx(struct xsk *xsk,
+		    struct iovec frames[],
+		    const unsigned int frames_max)
+{
+	const struct xdp_desc *descs = xsk->rx.descs;
+	const struct xdp_desc *desc;
+	unsigned int prod;
+	unsigned int cons;
+	unsigned int frames_num;
+	unsigned int i;
+
+
+	prod = xsk_load_acquire(xsk->rx.producer);
+	cons = *xsk->rx.consumer;
+
+	frames_num = prod - cons;
+	if (frames_num > frames_max) {
+		frames_num = frames_max;
+	}
+	if (frames_num > (XSK_FRAMES_NUM - xsk->held_num)) {
+		frames_num = XSK_FRAMES_NUM - xsk->held_num;
+	}
+
+	for (i = 0; i < frames_num; i++) {
+		desc = &descs[(cons + i) & xsk->rx.mask];
+		frames[i].iov_base = xsk->umem + desc->addr;
+		frames[i].iov_len = desc->len;
+		xsk->held_addrs[xsk->held_num++] = desc->addr;
+	}
+
+	xsk_store_release(xsk->rx.consumer, cons + frames_num);
+
+	return frames_num;
+
+}
+
+
+void xsk_rx_release(struct xsk *xsk)
+{
+	uint64_t *fill_addrs = xsk->fill.descs;
+	unsigned int prod;
+	unsigned int i;
+
+
+	if (xsk->held_num == 0) {
+		return;
+	}
+
+	prod = *xsk->fill.producer;
+
+	for (i = 0; i < xsk->held_num; i++) {
+		fill_addrs[(prod + i) & xsk->fill.mask] = xsk->held_addrs[i];
+	}
+
+	xsk_store_release(xsk->fill.producer, prod + xsk->held_num);
+
+	xsk->held_num = 0;
+
+}
+
+
+int xsk_udp_payload(const struct iovec *frame,
+		    struct iovec *payload)
+{
+	const uint8_t *pkt = frame->iov_base;
+	size_t hdrs_len;
+	uint16_t ether_type;
+	uint16_t udp_len;
+
+
+	if (frame->iov_len < XSK_ETH_HLEN) {
+		return -1;
+	}
+
+	memcpy(&ether_type, pkt + 12, sizeof(ether_type));
+
+	if (ntohs(ether_type) == ETH_P_IP) {
+		hdrs_len = XSK_ETH_HLEN + ((pkt[XSK_ETH_HLEN] & 0x0f) * 4);
+	} else if (ntohs(ether_type) == ETH_P_IPV6) {
+		hdrs_len = XSK_ETH_HLEN + XSK_IP6_HLEN;
+	} else {
+		return -1;
+	}
+
+	if (frame->iov_len < (hdrs_len + XSK_UDP_HLEN)) {
+		return -1;
+	}
+
+	memcpy(&udp_len, pkt + hdrs_len + 4, sizeof(udp_len));
+	udp_len = ntohs(udp_len);
+	if ((udp_len < XSK_UDP_HLEN) ||
+	    (frame->iov_len < (hdrs_len + udp_len))) {
+		return -1;
+	}
+
+	payload->iov_base = (uint8_t *)pkt + hdrs_len + XSK_UDP_HLEN;
+	payload->iov_len = udp_len - XSK_UDP_HLEN;
+
+	return 0;
+
+}
+
+
+int xsk_stats(const int sock_fd,
+	      struct xdp_statistics *stats)
+{
+	socklen_t stats_len = sizeof(*stats);
+
+
+	return getsockopt(sock_fd, SOL_XDP, XDP_STATISTICS, stats,
+								&stats_len);
+
+}
+
+
+void xsk_close(struct xsk *xsk)
+{
+
+
+	if (xsk->link_fd != -1) {
+		close(xsk->link_fd);
+		xsk->link_fd = -1;
+	}
+
+	if (xsk->prog_fd != -1) {
+		close(xsk->prog_fd);
+		xsk->prog_fd = -1;
+	}
+
+	if (xsk->map_fd != -1) {
+		close(xsk->map_fd);
+		xsk->map_fd = -1;
+	}
+
+	xsk_ring_unmap(&xsk->rx);
+	xsk_ring_unmap(&xsk->comp);
+	xsk_ring_unmap(&xsk->fill);
+
+	if (xsk->sock_fd != -1) {
+		close(xsk->sock_fd);
+		xsk->sock_fd = -1;
+	}
+
+	if (xsk->held_addrs != NULL) {
+		free(xsk->held_addrs);
+		xsk->held_addrs = NULL;
+	}
+
+	if (xsk->umem != NULL) {
+		munmap(xsk->umem, xsk->umem_size);
+		xsk->umem = NULL;
+	}
+
+}
@@ -0,0 +1,93 @@
+/*
+ * xsk - minimal Linux AF_XDP receive socket, with an XDP program that
+ * redirects a single UDP destination address and port to it
+ *
+ * Copyright (C) 2011 Mark Smith <markzzzsmith@yahoo.com.au>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA. 
+ */
+#ifndef __XSK_H
+#define __XSK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <linux/if_xdp.h>
+#include <sys/uio.h>
+
+
+enum XSK_DEFS {
+	XSK_FRAME_SIZE = 2048,
+	XSK_FRAMES_NUM = 4096,
+	XSK_COMP_RING_SIZE = 64,
+};
+
+struct xsk_ring {
+	void *map;
+	size_t map_size;
+	unsigned int *producer;
+	unsigned int *consumer;
+	void *descs;
+	unsigned int size;
+	unsigned int mask;
+};
+
+struct xsk {
+	int sock_fd;
+	int map_fd;
+	int prog_fd;
+	int link_fd;
+
+	uint8_t *umem;
+	size_t umem_size;
+
+	struct xsk_ring fill;
+	struct xsk_ring comp;
+	struct xsk_ring rx;
+
+	uint64_t *held_addrs;
+	unsigned int held_num;
+};
+
+
+int xsk_open(struct xsk *xsk,
+	     const unsigned int ifindex,
+	     const unsigned int queue_id,
+	     const unsigned int skb_mode);
+
+int xsk_udp_redirect_attach(struct xsk *xsk,
+			    const unsigned int ifindex,
+			    const unsigned int queue_id,
+			    const unsigned int skb_mode,
+			    const int family,
+			    const void *dst_addr,
+			    const unsigned int dst_port);
+
+unsigned int xsk_rx(struct xsk *xsk,
+		    struct iovec frames[],
+		    const unsigned int frames_max);
+
+void xsk_rx_release(struct xsk *xsk);
+
+int xsk_udp_payload(const struct iovec *frame,
+		    struct iovec *payload);
+
+int xsk_stats(const int sock_fd,
+	      struct xdp_statistics *stats);
+
+void xsk_close(struct xsk *xsk);
+
+#endif /* __XSK_H */